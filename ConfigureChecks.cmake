@@ -14,10 +14,12 @@ CHECK_INCLUDE_FILE(libgen.h HAVE_LIBGEN_H)
 CHECK_INCLUDE_FILE(unistd.h HAVE_UNISTD_H)
 CHECK_INCLUDE_FILE(direct.h HAVE_DIRECT_H)
 CHECK_INCLUDE_FILE(stdint.h HAVE_STDINT_H)
+CHECK_INCLUDE_FILE(sys/time.h HAVE_SYS_TIME_H)
 
 CHECK_SYMBOL_EXISTS(abort "stdlib.h" HAVE_ABORT)
 
 CHECK_FUNCTION_EXISTS(getcwd HAVE_GETCWD)
+CHECK_FUNCTION_EXISTS(gettimeofday HAVE_GETTIMEOFDAY)
 CHECK_FUNCTION_EXISTS(toascii HAVE_TOASCII)
 
 CHECK_LIBRARY_EXISTS(dl dlopen "" HAVE_LIBDL)
@@ -28,6 +30,22 @@ ELSE (HAVE_LIBDL)
     SET(LIBDL "")
 ENDIF (HAVE_LIBDL)
 
+# Optional compression libraries (compressed debugging sections)
+FIND_PACKAGE(ZLIB)
+SET(YASM_COMPRESS_LIBS "")
+IF (ZLIB_FOUND)
+    SET(HAVE_ZLIB 1)
+    INCLUDE_DIRECTORIES(${ZLIB_INCLUDE_DIR})
+    SET(YASM_COMPRESS_LIBS ${YASM_COMPRESS_LIBS} ${ZLIB_LIBRARIES})
+ENDIF (ZLIB_FOUND)
+
+CHECK_INCLUDE_FILE(zstd.h HAVE_ZSTD_H)
+CHECK_LIBRARY_EXISTS(zstd ZSTD_compress "" HAVE_LIBZSTD)
+IF (HAVE_ZSTD_H AND HAVE_LIBZSTD)
+    SET(HAVE_ZSTD 1)
+    SET(YASM_COMPRESS_LIBS ${YASM_COMPRESS_LIBS} zstd)
+ENDIF (HAVE_ZSTD_H AND HAVE_LIBZSTD)
+
 CONFIGURE_FILE(libyasm-stdint.h.cmake
                ${CMAKE_CURRENT_BINARY_DIR}/libyasm-stdint.h)
 CONFIGURE_FILE(config.h.cmake ${CMAKE_CURRENT_BINARY_DIR}/config.h)
@@ -0,0 +1,159 @@
+#!/usr/bin/env python
+# Run yasm over synthetic workloads and report throughput.
+#
+#  Copyright (C) 2026  Yasm developers
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+# Each workload is generated by genbench in both NASM and GAS syntax, then
+# assembled with every object format / debug format combination.  The best
+# wall-clock time of several runs is reported together with the throughput
+# in source lines and megabytes per second and the peak resident set size
+# of the yasm process.  Peak RSS needs os.wait4 (i.e. a Unix host); it is
+# reported as "-" elsewhere.
+import os
+import sys
+import time
+import subprocess
+from optparse import OptionParser
+
+workloads = ["insns", "branches", "sections", "symbols", "data", "macros",
+             "includes", "equs", "locals"]
+syntaxes = ["nasm", "gas"]
+formats = [
+    ("elf32", "null"),
+    ("elf32", "dwarf2"),
+    ("elf32", "stabs"),
+    ("elf64", "null"),
+    ("elf64", "dwarf2"),
+    ("win32", "null"),
+    ("win32", "cv8"),
+    ("win64", "null"),
+    ("win64", "cv8"),
+    ("macho32", "null"),
+    ("bin", "null"),
+]
+
+def run(cmd):
+    """Run cmd, returning (exit status, wall seconds, peak RSS in KiB)."""
+    devnull = open(os.devnull, "w")
+    start = time.time()
+    proc = subprocess.Popen(cmd, stdout=devnull, stderr=devnull)
+    if hasattr(os, "wait4"):
+        pid, status, rusage = os.wait4(proc.pid, 0)
+        elapsed = time.time() - start
+        proc.returncode = status
+        rss = rusage.ru_maxrss
+        if sys.platform == "darwin":
+            rss = rss // 1024   # bytes on Darwin
+    else:
+        status = proc.wait()
+        elapsed = time.time() - start
+        rss = None
+    devnull.close()
+    return status, elapsed, rss
+
+def generate(opts, workload, syntax):
+    """Generate workload; returns (filename, lines, bytes)."""
+    fn = os.path.abspath(os.path.join(opts.workdir,
+                                      "%s-%s.asm" % (workload, syntax)))
+    cmd = [opts.genbench, "-p", syntax, "-s", str(opts.scale), workload, fn]
+    out = subprocess.Popen(cmd, stdout=subprocess.PIPE).communicate()[0]
+    lines, nbytes = [int(x) for x in out.split()]
+    return fn, lines, nbytes
+
+def main():
+    parser = OptionParser(usage="%prog [options]")
+    parser.add_option("--yasm", default="./yasm",
+                      help="yasm executable to benchmark")
+    parser.add_option("--genbench", default="./genbench",
+                      help="genbench workload generator executable")
+    parser.add_option("--workdir", default="bench-work",
+                      help="directory for generated sources and output")
+    parser.add_option("-s", "--scale", type="float", default=1.0,
+                      help="scale factor for workload sizes")
+    parser.add_option("-r", "--repeat", type="int", default=3,
+                      help="number of runs per combination (best is kept)")
+    parser.add_option("-w", "--workload", action="append",
+                      help="workload to run (may be repeated; default all)")
+    parser.add_option("-p", "--parser", action="append",
+                      help="nasm or gas (may be repeated; default both)")
+    parser.add_option("-f", "--format", action="append",
+                      help="objfmt[/dbgfmt] to run (may be repeated; "
+                           "default all)")
+    (opts, args) = parser.parse_args()
+
+    if not os.path.isdir(opts.workdir):
+        os.makedirs(opts.workdir)
+    outfile = os.path.join(opts.workdir, "out.o")
+
+    fmts = formats
+    if opts.format:
+        fmts = []
+        for f in opts.format:
+            if "/" in f:
+                fmts.append(tuple(f.split("/", 1)))
+            else:
+                fmts.append((f, "null"))
+
+    print("%-9s %-4s %-15s %9s %12s %8s %9s" %
+          ("workload", "syn", "format", "time(s)", "lines/s", "MB/s",
+           "RSS(MB)"))
+    failed = 0
+    for workload in opts.workload or workloads:
+        for syntax in opts.parser or syntaxes:
+            fn, lines, nbytes = generate(opts, workload, syntax)
+            for objfmt, dbgfmt in fmts:
+                cmd = [opts.yasm, "-p", syntax, "-f", objfmt, "-g", dbgfmt,
+                       "-o", outfile, fn]
+                best = None
+                peak = None
+                for i in range(opts.repeat):
+                    status, elapsed, rss = run(cmd)
+                    if status != 0:
+                        break
+                    if best is None or elapsed < best:
+                        best = elapsed
+                    if rss is not None and (peak is None or rss > peak):
+                        peak = rss
+                name = "%s/%s" % (objfmt, dbgfmt)
+                if status != 0:
+                    print("%-9s %-4s %-15s FAILED: %s" %
+                          (workload, syntax, name, " ".join(cmd)))
+                    failed += 1
+                    continue
+                best = max(best, 1e-6)
+                if peak is None:
+                    rss = "-"
+                else:
+                    rss = "%.1f" % (peak / 1024.0)
+                print("%-9s %-4s %-15s %9.3f %12.0f %8.2f %9s" %
+                      (workload, syntax, name, best, lines / best,
+                       nbytes / best / 1048576.0, rss))
+                sys.stdout.flush()
+
+    if failed:
+        return 1
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,509 @@
+/*
+ * Synthetic assembly workload generator for benchmarking
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Generates NASM or GAS syntax source files for one of a fixed set of
+ * workloads.  Output depends only on the workload, syntax, count, and seed,
+ * so the same arguments always produce the same files.  On success, the
+ * total number of lines and bytes written (across all files) is printed to
+ * standard output.
+ */
+
+typedef enum { SYN_NASM, SYN_GAS } syntax;
+
+typedef struct workload {
+    const char *name;
+    unsigned long default_count;
+    void (*gen) (FILE *f, const char *outname, unsigned long count);
+    const char *desc;
+} workload;
+
+static syntax syn = SYN_NASM;
+static unsigned long rng_state;
+static unsigned long total_lines = 0;
+static unsigned long total_bytes = 0;
+
+static const char *regs[] = {"eax", "ebx", "ecx", "edx", "esi", "edi"};
+#define NREGS   (sizeof(regs)/sizeof(regs[0]))
+
+/* Small deterministic PRNG (xorshift32); the C library rand() differs
+ * between platforms.
+ */
+static unsigned long
+rnd(void)
+{
+    unsigned long x = rng_state;
+    x ^= (x << 13) & 0xFFFFFFFFUL;
+    x ^= x >> 17;
+    x ^= (x << 5) & 0xFFFFFFFFUL;
+    rng_state = x;
+    return x;
+}
+
+static unsigned long
+rnd_range(unsigned long n)
+{
+    return rnd() % n;
+}
+
+static void
+emit(FILE *f, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vfprintf(f, fmt, ap);
+    va_end(ap);
+    fputc('\n', f);
+    if (n > 0)
+        total_bytes += (unsigned long)n;
+    total_bytes++;
+    total_lines++;
+}
+
+static void
+emit_header(FILE *f)
+{
+    if (syn == SYN_NASM)
+        emit(f, "section .text");
+    else
+        emit(f, ".text");
+}
+
+/* One random non-branch instruction. */
+static void
+emit_insn(FILE *f)
+{
+    const char *r1 = regs[rnd_range(NREGS)];
+    const char *r2 = regs[rnd_range(NREGS)];
+    unsigned long imm = rnd_range(0x10000);
+
+    switch (rnd_range(6)) {
+        case 0:
+            if (syn == SYN_NASM)
+                emit(f, "    mov %s, %s", r1, r2);
+            else
+                emit(f, "    movl %%%s, %%%s", r2, r1);
+            break;
+        case 1:
+            if (syn == SYN_NASM)
+                emit(f, "    add %s, %lu", r1, imm);
+            else
+                emit(f, "    addl $%lu, %%%s", imm, r1);
+            break;
+        case 2:
+            if (syn == SYN_NASM)
+                emit(f, "    mov %s, [%s+%s*4+%lu]", r1, r2, r1, imm);
+            else
+                emit(f, "    movl %lu(%%%s,%%%s,4), %%%s", imm, r2, r1, r1);
+            break;
+        case 3:
+            if (syn == SYN_NASM)
+                emit(f, "    lea %s, [%s+%lu]", r1, r2, imm & 0x7f);
+            else
+                emit(f, "    leal %lu(%%%s), %%%s", imm & 0x7f, r2, r1);
+            break;
+        case 4:
+            if (syn == SYN_NASM)
+                emit(f, "    xor %s, %s", r1, r2);
+            else
+                emit(f, "    xorl %%%s, %%%s", r2, r1);
+            break;
+        default:
+            if (syn == SYN_NASM)
+                emit(f, "    cmp dword [%s+%lu], %lu", r2, imm, imm & 0xff);
+            else
+                emit(f, "    cmpl $%lu, %lu(%%%s)", imm & 0xff, imm, r2);
+            break;
+    }
+}
+
+/* Straight-line code. */
+static void
+gen_insns(FILE *f, /*@unused@*/ const char *outname, unsigned long count)
+{
+    unsigned long i;
+
+    emit_header(f);
+    for (i=0; i<count; i++)
+        emit_insn(f);
+}
+
+/* Dense short branches to nearby labels, with occasional padding so that
+ * some of them have to be expanded to near form by the optimizer.
+ */
+static void
+gen_branches(FILE *f, /*@unused@*/ const char *outname, unsigned long count)
+{
+    static const char *jcc[] = {"jmp", "jz", "jnz", "jc", "jnc", "jl", "jg"};
+    unsigned long i;
+
+    emit_header(f);
+    for (i=0; i<count; i++) {
+        long dist = (long)rnd_range(32) - 16;
+        unsigned long target;
+
+        emit(f, "L%lu:", i);
+        if (dist == 0)
+            dist = 1;
+        if (dist < 0 && (unsigned long)(-dist) > i)
+            dist = -dist;
+        target = (unsigned long)((long)i + dist);
+        if (target >= count)
+            target = count-1;
+        emit(f, "    %s L%lu", jcc[rnd_range(sizeof(jcc)/sizeof(jcc[0]))],
+             target);
+
+        if (rnd_range(64) == 0) {
+            unsigned long pad = 16 + rnd_range(112);
+            if (syn == SYN_NASM)
+                emit(f, "    times %lu nop", pad);
+            else
+                emit(f, "    .fill %lu, 1, 0x90", pad);
+        } else
+            emit_insn(f);
+    }
+}
+
+/* Many small sections, each referencing the next. */
+static void
+gen_sections(FILE *f, /*@unused@*/ const char *outname, unsigned long count)
+{
+    unsigned long i, j;
+
+    for (i=0; i<count; i++) {
+        if (syn == SYN_NASM) {
+            emit(f, "section .text.s%lu progbits alloc exec", i);
+            emit(f, "S%lu:", i);
+            emit(f, "    call S%lu", (i+1) % count);
+        } else {
+            emit(f, ".section .text.s%lu, \"ax\", @progbits", i);
+            emit(f, "S%lu:", i);
+            emit(f, "    call S%lu", (i+1) % count);
+        }
+        for (j=0; j<4; j++)
+            emit_insn(f);
+    }
+}
+
+/* Many global symbols, each with data referencing an earlier symbol. */
+static void
+gen_symbols(FILE *f, /*@unused@*/ const char *outname, unsigned long count)
+{
+    unsigned long i;
+
+    if (syn == SYN_NASM)
+        emit(f, "section .data");
+    else
+        emit(f, ".data");
+    for (i=0; i<count; i++) {
+        /* Hashed-looking prefix, like mangled names */
+        unsigned long hash = rnd();
+        unsigned long ref = rnd_range(i+1);
+        if (syn == SYN_NASM) {
+            emit(f, "global sym_%08lx_%lu", hash, i);
+            emit(f, "sym_%08lx_%lu: dd sym_%lu_ref+%lu", hash, i, ref,
+                 rnd_range(256));
+        } else {
+            emit(f, ".globl sym_%08lx_%lu", hash, i);
+            emit(f, "sym_%08lx_%lu: .long sym_%lu_ref+%lu", hash, i, ref,
+                 rnd_range(256));
+        }
+        emit(f, "sym_%lu_ref:", i);
+    }
+}
+
+/* Large data tables; count is the number of lines (16 bytes per line). */
+static void
+gen_data(FILE *f, /*@unused@*/ const char *outname, unsigned long count)
+{
+    unsigned long i;
+    int j;
+    char buf[128];
+
+    if (syn == SYN_NASM)
+        emit(f, "section .data");
+    else
+        emit(f, ".data");
+    for (i=0; i<count; i++) {
+        char *p = buf;
+        unsigned long kind = rnd_range(16);
+
+        if (kind < 12) {
+            strcpy(p, syn == SYN_NASM ? "    db " : "    .byte ");
+            p += strlen(p);
+            for (j=0; j<16; j++)
+                p += sprintf(p, j ? ",0x%02lx" : "0x%02lx", rnd_range(256));
+        } else if (kind < 15) {
+            strcpy(p, syn == SYN_NASM ? "    dd " : "    .long ");
+            p += strlen(p);
+            for (j=0; j<4; j++)
+                p += sprintf(p, j ? ",0x%08lx" : "0x%08lx", rnd());
+        } else {
+            if (syn == SYN_NASM)
+                sprintf(p, "    db 'string %08lx', 0", rnd());
+            else
+                sprintf(p, "    .asciz \"string %08lx\"", rnd());
+        }
+        emit(f, "%s", buf);
+    }
+}
+
+#define MACRO_DEPTH     16
+
+/* A chain of MACRO_DEPTH nested macros, invoked count times. */
+static void
+gen_macros(FILE *f, /*@unused@*/ const char *outname, unsigned long count)
+{
+    unsigned long i;
+    int d;
+
+    for (d=0; d<MACRO_DEPTH; d++) {
+        if (syn == SYN_NASM) {
+            emit(f, "%%macro m%d 1", d);
+            if (d > 0)
+                emit(f, "    m%d %%1+1", d-1);
+            emit(f, "    add eax, %%1");
+            emit(f, "%%endmacro");
+        } else {
+            emit(f, ".macro m%d a", d);
+            if (d > 0)
+                emit(f, "    m%d \\a+1", d-1);
+            emit(f, "    addl $\\a, %%eax");
+            emit(f, ".endm");
+        }
+    }
+    emit_header(f);
+    for (i=0; i<count; i++)
+        emit(f, "    m%d %lu", MACRO_DEPTH-1, rnd_range(1000));
+}
+
+#define INCLUDE_LINES   100
+
+/* A chain of count include files, each including the next. */
+static void
+gen_includes(FILE *f, const char *outname, unsigned long count)
+{
+    unsigned long i, j;
+    size_t namelen = strlen(outname)+32;
+    char *incname = malloc(namelen);
+    FILE *inc;
+
+    if (!incname) {
+        fprintf(stderr, "out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    emit_header(f);
+    inc = f;
+    for (i=0; i<count; i++) {
+        sprintf(incname, "%s.%lu.inc", outname, i);
+        if (syn == SYN_NASM)
+            emit(inc, "%%include \"%s\"", incname);
+        else
+            emit(inc, ".include \"%s\"", incname);
+        if (inc != f)
+            fclose(inc);
+        inc = fopen(incname, "wt");
+        if (!inc) {
+            fprintf(stderr, "Could not open `%s'.\n", incname);
+            exit(EXIT_FAILURE);
+        }
+        for (j=0; j<INCLUDE_LINES; j++)
+            emit_insn(inc);
+    }
+    if (inc != f)
+        fclose(inc);
+    free(incname);
+}
+
+/* A long chain of EQU constants, each defined in terms of the previous one,
+ * with every constant used by an instruction.
+ */
+static void
+gen_equs(FILE *f, /*@unused@*/ const char *outname, unsigned long count)
+{
+    unsigned long i;
+
+    emit_header(f);
+    if (syn == SYN_NASM)
+        emit(f, "C0 equ 1");
+    else
+        emit(f, ".equ C0, 1");
+    for (i=1; i<count; i++) {
+        unsigned long mul = 1+rnd_range(7), add = rnd_range(256);
+        if (syn == SYN_NASM) {
+            emit(f, "C%lu equ (C%lu*%lu+%lu) & 0xffff", i, i-1, mul, add);
+            emit(f, "    mov eax, C%lu", i);
+        } else {
+            emit(f, ".equ C%lu, (C%lu*%lu+%lu) & 0xffff", i, i-1, mul, add);
+            emit(f, "    movl $C%lu, %%eax", i);
+        }
+    }
+}
+
+/* Many small functions, each with a handful of local labels (NASM .label
+ * or GAS numeric labels) referenced backward and forward.
+ */
+#define LOCALS_PER_FUNC 8
+
+static void
+gen_locals(FILE *f, /*@unused@*/ const char *outname, unsigned long count)
+{
+    unsigned long i, j;
+
+    emit_header(f);
+    for (i=0; i<count; i++) {
+        emit(f, "func%lu:", i);
+        for (j=0; j<LOCALS_PER_FUNC; j++) {
+            unsigned long target = rnd_range(LOCALS_PER_FUNC);
+
+            if (syn == SYN_NASM) {
+                emit(f, ".L%lu:", j);
+                emit(f, "    jnz .L%lu", target);
+            } else {
+                emit(f, "%lu:", j);
+                emit(f, "    jnz %lu%c", target, target <= j ? 'b' : 'f');
+            }
+            emit_insn(f);
+        }
+        emit(f, "    ret");
+    }
+}
+
+static const workload workloads[] = {
+    {"insns", 1000000, gen_insns, "straight-line instructions"},
+    {"branches", 200000, gen_branches, "dense short branches"},
+    {"sections", 5000, gen_sections, "many small sections"},
+    {"symbols", 100000, gen_symbols, "many global symbols"},
+    {"data", 200000, gen_data, "large data tables (lines)"},
+    {"macros", 20000, gen_macros, "deeply nested macro invocations"},
+    {"includes", 1000, gen_includes, "long include chain (files)"},
+    {"equs", 1000, gen_equs, "long chain of EQU constants"},
+    {"locals", 50000, gen_locals, "functions with local labels"}
+};
+#define NWORKLOADS  (sizeof(workloads)/sizeof(workloads[0]))
+
+static void
+usage(const char *argv0)
+{
+    size_t i;
+
+    fprintf(stderr,
+            "Usage: %s [-p nasm|gas] [-n count] [-s scale] [-r seed] "
+            "<workload> <outfile>\n", argv0);
+    fprintf(stderr, "Workloads (default count):\n");
+    for (i=0; i<NWORKLOADS; i++)
+        fprintf(stderr, "    %-10s %s (%lu)\n", workloads[i].name,
+                workloads[i].desc, workloads[i].default_count);
+}
+
+int
+main(int argc, char *argv[])
+{
+    const workload *w = NULL;
+    unsigned long count = 0;
+    double scale = 1.0;
+    const char *outname;
+    FILE *out;
+    int i;
+    size_t j;
+
+    rng_state = 2463534242UL;
+
+    for (i=1; i<argc && argv[i][0] == '-'; i++) {
+        if (i+1 >= argc) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        if (strcmp(argv[i], "-p") == 0) {
+            i++;
+            if (strcmp(argv[i], "nasm") == 0)
+                syn = SYN_NASM;
+            else if (strcmp(argv[i], "gas") == 0)
+                syn = SYN_GAS;
+            else {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "-n") == 0)
+            count = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-s") == 0)
+            scale = atof(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0)
+            rng_state = strtoul(argv[++i], NULL, 10);
+        else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc - i != 2) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (j=0; j<NWORKLOADS; j++) {
+        if (strcmp(argv[i], workloads[j].name) == 0)
+            w = &workloads[j];
+    }
+    if (!w) {
+        fprintf(stderr, "Unknown workload `%s'.\n", argv[i]);
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (rng_state == 0)
+        rng_state = 1;  /* xorshift is stuck at 0 */
+
+    if (count == 0)
+        count = (unsigned long)(w->default_count*scale);
+    if (count == 0)
+        count = 1;
+
+    outname = argv[i+1];
+    out = fopen(outname, "wt");
+    if (!out) {
+        fprintf(stderr, "Could not open `%s'.\n", outname);
+        return EXIT_FAILURE;
+    }
+
+    w->gen(out, outname, count);
+
+    if (ferror(out)) {
+        fprintf(stderr, "Error writing `%s'.\n", outname);
+        fclose(out);
+        return EXIT_FAILURE;
+    }
+    fclose(out);
+
+    printf("%lu %lu\n", total_lines, total_bytes);
+    return EXIT_SUCCESS;
+}
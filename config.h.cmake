@@ -23,9 +23,21 @@
 /* Define to 1 if you have the `getcwd' function. */
 #cmakedefine HAVE_GETCWD 1
 
+/* Define to 1 if you have the <sys/time.h> header file. */
+#cmakedefine HAVE_SYS_TIME_H 1
+
+/* Define to 1 if you have the `gettimeofday' function. */
+#cmakedefine HAVE_GETTIMEOFDAY 1
+
 /* Define to 1 if you have the `toascii' function. */
 #cmakedefine HAVE_TOASCII 1
 
+/* Define to 1 if zlib is available (compressed debugging sections). */
+#cmakedefine HAVE_ZLIB 1
+
+/* Define to 1 if libzstd is available (compressed debugging sections). */
+#cmakedefine HAVE_ZSTD 1
+
 /* Name of package */
 #define PACKAGE "yasm"
 
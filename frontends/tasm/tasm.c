@@ -628,6 +628,7 @@ cleanup(yasm_object *object)
         yasm_intnum_cleanup();
 
         yasm_errwarn_cleanup();
+        yasm_intern_cleanup();
 
         BitVector_Shutdown();
     }
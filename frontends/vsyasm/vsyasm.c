@@ -54,6 +54,8 @@ void yasm_init_plugin(void);
 /*@null@*/ /*@only@*/ static char *objext = NULL;
 /*@null@*/ /*@only@*/ static char *listext = NULL, *mapext = NULL;
 /*@null@*/ /*@only@*/ static char *machine_name = NULL;
+/*@null@*/ /*@only@*/ static char *trace_filename = NULL;
+/*@null@*/ /*@dependent@*/ static FILE *trace_file = NULL;
 static int special_options = 0;
 /*@null@*/ /*@dependent@*/ static const yasm_arch_module *
     cur_arch_module = NULL;
@@ -111,6 +113,7 @@ static int opt_preproc_option(char *cmd, /*@null@*/ char *param, int extra);
 static int opt_ewmsg_handler(char *cmd, /*@null@*/ char *param, int extra);
 static int opt_prefix_handler(char *cmd, /*@null@*/ char *param, int extra);
 static int opt_suffix_handler(char *cmd, /*@null@*/ char *param, int extra);
+static int opt_trace_handler(char *cmd, /*@null@*/ char *param, int extra);
 #if defined(CMAKE_BUILD) && defined(BUILD_SHARED_LIBS)
 static int opt_plugin_handler(char *cmd, /*@null@*/ char *param, int extra);
 #endif
@@ -211,6 +214,9 @@ static opt_option options[] =
       N_("append argument to name of all external symbols"), N_("suffix") },
     { 0, "postfix", 1, opt_suffix_handler, 0,
       N_("append argument to name of all external symbols"), N_("suffix") },
+    { 0, "trace", 1, opt_trace_handler, 0,
+      N_("write timeline of assembly phases in Trace Event (JSON) format"),
+      N_("filename") },
 #if defined(CMAKE_BUILD) && defined(BUILD_SHARED_LIBS)
     { 'N', "plugin", 1, opt_plugin_handler, 0,
       N_("load plugin module"), N_("plugin") },
@@ -428,24 +434,32 @@ do_assemble(const char *in_filename)
     }
 
     /* Parse! */
+    yasm_trace_begin("parse", in_filename);
     cur_parser_module->do_parse(object, preproc, list_filename != NULL,
                                 linemap, errwarns);
+    yasm_trace_end();
 
     if (check_errors(errwarns, object, linemap, preproc, arch) == EXIT_FAILURE)
         return EXIT_FAILURE;
 
     /* Finalize parse */
+    yasm_trace_begin("finalize", in_filename);
     yasm_object_finalize(object, errwarns);
+    yasm_trace_end();
     if (check_errors(errwarns, object, linemap, preproc, arch) == EXIT_FAILURE)
         return EXIT_FAILURE;
 
     /* Optimize */
+    yasm_trace_begin("optimize", in_filename);
     yasm_object_optimize(object, errwarns);
+    yasm_trace_end();
     if (check_errors(errwarns, object, linemap, preproc, arch) == EXIT_FAILURE)
         return EXIT_FAILURE;
 
     /* generate any debugging information */
+    yasm_trace_begin("dbgfmt", cur_dbgfmt_module->keyword);
     yasm_dbgfmt_generate(object, linemap, errwarns);
+    yasm_trace_end();
     if (check_errors(errwarns, object, linemap, preproc, arch) == EXIT_FAILURE)
         return EXIT_FAILURE;
 
@@ -462,9 +476,11 @@ do_assemble(const char *in_filename)
     }
 
     /* Write the object file */
+    yasm_trace_begin("objfmt", cur_objfmt_module->keyword);
     yasm_objfmt_output(object, obj?obj:stderr,
                        yasm__strcasecmp(cur_dbgfmt_module->keyword, "null"),
                        errwarns);
+    yasm_trace_end();
 
     /* Close object file */
     if (obj)
@@ -492,7 +508,9 @@ do_assemble(const char *in_filename)
         /* Initialize the list format */
         cur_listfmt = yasm_listfmt_create(cur_listfmt_module, in_filename,
                                           obj_filename);
+        yasm_trace_begin("listfmt", cur_listfmt_module->keyword);
         yasm_listfmt_output(cur_listfmt, list, linemap, arch);
+        yasm_trace_end();
         yasm_listfmt_destroy(cur_listfmt);
         fclose(list);
     }
@@ -709,9 +727,23 @@ main(int argc, char *argv[])
     if (!mapext)
         mapext = yasm__xstrdup("map");
 
-    /* Assemble each input file.  Terminate on first error. */
+    /* Start the event trace */
+    if (trace_filename) {
+        trace_file = open_file(trace_filename, "wt");
+        if (!trace_file) {
+            cleanup();
+            return EXIT_FAILURE;
+        }
+        yasm_trace_open(trace_file);
+    }
+
+    /* Assemble each input file.  Terminate on first error.  Each file is
+     * traced on its own track.
+     */
+    i = 0;
     STAILQ_FOREACH(infile, &input_files, link)
     {
+        yasm_trace_set_track((unsigned int)i++, infile->param);
         if (do_assemble(infile->param) == EXIT_FAILURE) {
             cleanup();
             return EXIT_FAILURE;
@@ -760,11 +792,18 @@ check_errors(yasm_errwarns *errwarns, yasm_object *object,
 static void
 cleanup(void)
 {
+    if (trace_file) {
+        yasm_trace_close();
+        fclose(trace_file);
+        trace_file = NULL;
+    }
+
     if (DO_FREE) {
         yasm_floatnum_cleanup();
         yasm_intnum_cleanup();
 
         yasm_errwarn_cleanup();
+        yasm_intern_cleanup();
 
         BitVector_Shutdown();
     }
@@ -787,6 +826,8 @@ cleanup(void)
             yasm_xfree(machine_name);
         if (objfmt_keyword)
             yasm_xfree(objfmt_keyword);
+        if (trace_filename)
+            yasm_xfree(trace_filename);
         free_preproc_saved_options();
     }
 
@@ -1212,6 +1253,17 @@ opt_suffix_handler(/*@unused@*/ char *cmd, char *param, /*@unused@*/ int extra)
     return 0;
 }
 
+static int
+opt_trace_handler(/*@unused@*/ char *cmd, char *param,
+                  /*@unused@*/ int extra)
+{
+    assert(param != NULL);
+    if (trace_filename)
+        yasm_xfree(trace_filename);
+    trace_filename = yasm__xstrdup(param);
+    return 0;
+}
+
 #if defined(CMAKE_BUILD) && defined(BUILD_SHARED_LIBS)
 static int
 opt_plugin_handler(/*@unused@*/ char *cmd, char *param,
@@ -27,6 +27,7 @@
 #include <util.h>
 
 #include <ctype.h>
+#include <time.h>
 #include <libyasm/compat-queue.h>
 #include <libyasm/bitvect.h>
 #include <libyasm.h>
@@ -51,6 +52,7 @@
 /*@null@*/ /*@only@*/ static char *list_filename = NULL, *map_filename = NULL;
 /*@null@*/ /*@only@*/ static char *machine_name = NULL;
 static int special_options = 0;
+static yasm_debug_compress debug_compress = YASM_DEBUG_COMPRESS_NONE;
 /*@null@*/ /*@dependent@*/ static yasm_arch *cur_arch = NULL;
 /*@null@*/ /*@dependent@*/ static const yasm_arch_module *
     cur_arch_module = NULL;
@@ -78,6 +80,51 @@ static enum {
     EWSTYLE_VC
 } ewmsg_style = EWSTYLE_GNU;
 
+/* Event trace output (--trace) */
+/*@null@*/ /*@only@*/ static char *trace_filename = NULL;
+/*@null@*/ /*@dependent@*/ static FILE *trace_file = NULL;
+
+/* Assembly statistics (--stats, --stats-json) */
+static int show_stats = 0;
+/*@null@*/ /*@only@*/ static char *stats_json_filename = NULL;
+
+enum stats_phase {
+    STATS_PREPROC = 0,
+    STATS_PARSE,
+    STATS_FINALIZE,
+    STATS_OPTIMIZE,
+    STATS_DBGFMT,
+    STATS_OUTPUT,
+    STATS_LIST,
+    STATS_NUM_PHASES
+};
+
+/*@observer@*/ static const char *stats_phase_names[STATS_NUM_PHASES] = {
+    "preprocess",
+    "parse",
+    "finalize",
+    "optimize",
+    "debug-info",
+    "output",
+    "listing"
+};
+
+static struct {
+    double wall, cpu;           /* accumulated times */
+    double wall_start, cpu_start;
+} stats_phases[STATS_NUM_PHASES];
+
+static struct {
+    unsigned long bytecodes;
+    unsigned long symbols;
+    unsigned long relocs;
+    unsigned long lines;
+    unsigned long output_bytes;
+    size_t heap_cur;
+    size_t heap_peak;
+    unsigned long allocs;
+} stats_counters;
+
 /*@null@*/ /*@dependent@*/ static FILE *open_file(const char *filename,
                                                   const char *mode);
 static void check_errors(/*@only@*/ yasm_errwarns *errwarns,
@@ -107,7 +154,11 @@ static int opt_preproc_option(char *cmd, /*@null@*/ char *param, int extra);
 static int opt_ewmsg_handler(char *cmd, /*@null@*/ char *param, int extra);
 static int opt_makedep_handler(char *cmd, /*@null@*/ char *param, int extra);
 static int opt_prefix_handler(char *cmd, /*@null@*/ char *param, int extra);
+static int opt_compress_debug_handler(char *cmd, /*@null@*/ char *param,
+                                      int extra);
 static int opt_suffix_handler(char *cmd, /*@null@*/ char *param, int extra);
+static int opt_stats_handler(char *cmd, /*@null@*/ char *param, int extra);
+static int opt_trace_handler(char *cmd, /*@null@*/ char *param, int extra);
 #if defined(CMAKE_BUILD) && defined(BUILD_SHARED_LIBS)
 static int opt_plugin_handler(char *cmd, /*@null@*/ char *param, int extra);
 #endif
@@ -137,6 +188,13 @@ static void apply_preproc_standard_macros(const yasm_stdmac *stdmacs);
 static void apply_preproc_saved_options(void);
 static void print_list_keyword_desc(const char *name, const char *keyword);
 
+static void stats_init_heap(void);
+static void stats_wrap_preproc(yasm_preproc *preproc);
+static void stats_begin(enum stats_phase phase);
+static void stats_end(enum stats_phase phase);
+static void stats_count_object(yasm_object *object);
+static void stats_output(void);
+
 /* values for special_options */
 #define SPECIAL_SHOW_HELP 0x01
 #define SPECIAL_SHOW_VERSION 0x02
@@ -210,6 +268,17 @@ static opt_option options[] =
       N_("append argument to name of all external symbols"), N_("suffix") },
     { 0, "postfix", 1, opt_suffix_handler, 0,
       N_("append argument to name of all external symbols"), N_("suffix") },
+    { 0, "compress-debug-sections", 0, opt_compress_debug_handler, 0,
+      N_("compress ELF debugging sections (=zlib (default), zstd or none)"),
+      NULL },
+    { 0, "stats", 0, opt_stats_handler, 0,
+      N_("print per-phase timings and counters to stderr"), NULL },
+    { 0, "stats-json", 1, opt_stats_handler, 1,
+      N_("write per-phase timings and counters in JSON format"),
+      N_("filename") },
+    { 0, "trace", 1, opt_trace_handler, 0,
+      N_("write timeline of assembly phases in Trace Event (JSON) format"),
+      N_("filename") },
 #if defined(CMAKE_BUILD) && defined(BUILD_SHARED_LIBS)
     { 'N', "plugin", 1, opt_plugin_handler, 0,
       N_("load plugin module"), N_("plugin") },
@@ -367,6 +436,19 @@ do_assemble(void)
     linemap = yasm_linemap_create();
     yasm_linemap_set(linemap, in_filename, 0, 1, 1);
 
+    /* Start the event trace */
+    if (trace_filename) {
+        trace_file = open_file(trace_filename, "wt");
+        if (!trace_file) {
+            yasm_linemap_destroy(linemap);
+            yasm_errwarns_destroy(errwarns);
+            cleanup(NULL);
+            return EXIT_FAILURE;
+        }
+        yasm_trace_open(trace_file);
+        yasm_trace_set_track(0, in_filename);
+    }
+
     /* determine the object filename if not specified */
     if (!obj_filename) {
         if (in_filename == NULL)
@@ -474,9 +556,12 @@ do_assemble(void)
         yasm_object_set_global_prefix(object, global_prefix);
     if (global_suffix)
         yasm_object_set_global_suffix(object, global_suffix);
+    object->debug_compress = debug_compress;
 
     cur_preproc = yasm_preproc_create(cur_preproc_module, in_filename,
                                       object->symtab, linemap, errwarns);
+    if (show_stats)
+        stats_wrap_preproc(cur_preproc);
 
     apply_preproc_builtins();
     apply_preproc_standard_macros(cur_parser_module->stdmacs);
@@ -518,21 +603,37 @@ do_assemble(void)
     }
 
     /* Parse! */
+    stats_begin(STATS_PARSE);
+    yasm_trace_begin("parse", in_filename);
     cur_parser_module->do_parse(object, cur_preproc, list_filename != NULL,
                                 linemap, errwarns);
+    yasm_trace_end();
+    stats_end(STATS_PARSE);
 
     check_errors(errwarns, object, linemap);
 
     /* Finalize parse */
+    stats_begin(STATS_FINALIZE);
+    yasm_trace_begin("finalize", in_filename);
     yasm_object_finalize(object, errwarns);
+    yasm_trace_end();
+    stats_end(STATS_FINALIZE);
     check_errors(errwarns, object, linemap);
 
     /* Optimize */
+    stats_begin(STATS_OPTIMIZE);
+    yasm_trace_begin("optimize", in_filename);
     yasm_object_optimize(object, errwarns);
+    yasm_trace_end();
+    stats_end(STATS_OPTIMIZE);
     check_errors(errwarns, object, linemap);
 
     /* generate any debugging information */
+    stats_begin(STATS_DBGFMT);
+    yasm_trace_begin("dbgfmt", cur_dbgfmt_module->keyword);
     yasm_dbgfmt_generate(object, linemap, errwarns);
+    yasm_trace_end();
+    stats_end(STATS_DBGFMT);
     check_errors(errwarns, object, linemap);
 
     /* open the object file for output (if not already opened by dbg objfmt) */
@@ -545,13 +646,23 @@ do_assemble(void)
     }
 
     /* Write the object file */
+    stats_begin(STATS_OUTPUT);
+    yasm_trace_begin("objfmt", cur_objfmt_module->keyword);
     yasm_objfmt_output(object, obj?obj:stderr,
                        yasm__strcasecmp(cur_dbgfmt_module->keyword, "null"),
                        errwarns);
+    yasm_trace_end();
+    stats_end(STATS_OUTPUT);
 
     /* Close object file */
-    if (obj)
+    if (obj) {
+        if (show_stats && fseek(obj, 0L, SEEK_END) == 0) {
+            long pos = ftell(obj);
+            if (pos > 0)
+                stats_counters.output_bytes = (unsigned long)pos;
+        }
         fclose(obj);
+    }
 
     /* If we had an error at this point, we also need to delete the output
      * object file (to make sure it's not left newer than the source).
@@ -570,10 +681,20 @@ do_assemble(void)
         /* Initialize the list format */
         cur_listfmt = yasm_listfmt_create(cur_listfmt_module, in_filename,
                                           obj_filename);
+        stats_begin(STATS_LIST);
+        yasm_trace_begin("listfmt", cur_listfmt_module->keyword);
         yasm_listfmt_output(cur_listfmt, list, linemap, cur_arch);
+        yasm_trace_end();
+        stats_end(STATS_LIST);
         fclose(list);
     }
 
+    if (show_stats) {
+        stats_counters.lines = yasm_linemap_get_current(linemap);
+        stats_count_object(object);
+        stats_output();
+    }
+
     yasm_errwarns_output_all(errwarns, linemap, warning_error,
                              print_yasm_error, print_yasm_warning);
 
@@ -593,6 +714,19 @@ main(int argc, char *argv[])
 
     errfile = stderr;
 
+    /* Heap statistics require the allocation hooks to be installed before
+     * anything is allocated, so look for the stats options ahead of the
+     * normal command line parse.
+     */
+    for (i=1; i<(size_t)argc; i++) {
+        if (strcmp(argv[i], "--") == 0)
+            break;
+        if (strncmp(argv[i], "--stats", 7) == 0) {
+            stats_init_heap();
+            break;
+        }
+    }
+
 #if defined(HAVE_SETLOCALE) && defined(HAVE_LC_MESSAGES)
     setlocale(LC_MESSAGES, "");
 #endif
@@ -790,6 +924,12 @@ check_errors(yasm_errwarns *errwarns, yasm_object *object,
 static void
 cleanup(yasm_object *object)
 {
+    if (trace_file) {
+        yasm_trace_close();
+        fclose(trace_file);
+        trace_file = NULL;
+    }
+
     if (DO_FREE) {
         if (cur_listfmt)
             yasm_listfmt_destroy(cur_listfmt);
@@ -802,6 +942,7 @@ cleanup(yasm_object *object)
         yasm_intnum_cleanup();
 
         yasm_errwarn_cleanup();
+        yasm_intern_cleanup();
 
         BitVector_Shutdown();
     }
@@ -819,6 +960,10 @@ cleanup(yasm_object *object)
             yasm_xfree(machine_name);
         if (objfmt_keyword)
             yasm_xfree(objfmt_keyword);
+        if (stats_json_filename)
+            yasm_xfree(stats_json_filename);
+        if (trace_filename)
+            yasm_xfree(trace_filename);
     }
 
     if (errfile != stderr && errfile != stdout)
@@ -1206,6 +1351,65 @@ opt_suffix_handler(/*@unused@*/ char *cmd, char *param, /*@unused@*/ int extra)
     return 0;
 }
 
+static int
+opt_compress_debug_handler(char *cmd, /*@unused@*/ char *param,
+                           /*@unused@*/ int extra)
+{
+    /* The method is optional, so it is parsed here rather than passed as a
+     * required parameter.
+     */
+    const char *method = strchr(cmd, '=');
+
+    if (!method || yasm__strcasecmp(method+1, "zlib") == 0) {
+#ifdef HAVE_ZLIB
+        debug_compress = YASM_DEBUG_COMPRESS_ZLIB;
+#else
+        print_error(_("%s: %s compression is not available in this build"),
+                    _("FATAL"), "zlib");
+        exit(EXIT_FAILURE);
+#endif
+    } else if (yasm__strcasecmp(method+1, "zstd") == 0) {
+#ifdef HAVE_ZSTD
+        debug_compress = YASM_DEBUG_COMPRESS_ZSTD;
+#else
+        print_error(_("%s: %s compression is not available in this build"),
+                    _("FATAL"), "zstd");
+        exit(EXIT_FAILURE);
+#endif
+    } else if (yasm__strcasecmp(method+1, "none") == 0)
+        debug_compress = YASM_DEBUG_COMPRESS_NONE;
+    else {
+        print_error(_("%s: unrecognized %s `%s'"), _("FATAL"),
+                    _("debug section compression"), method+1);
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
+
+static int
+opt_stats_handler(/*@unused@*/ char *cmd, char *param, int extra)
+{
+    show_stats = 1;
+    if (extra == 1) {
+        assert(param != NULL);
+        if (stats_json_filename)
+            yasm_xfree(stats_json_filename);
+        stats_json_filename = yasm__xstrdup(param);
+    }
+    return 0;
+}
+
+static int
+opt_trace_handler(/*@unused@*/ char *cmd, char *param,
+                  /*@unused@*/ int extra)
+{
+    assert(param != NULL);
+    if (trace_filename)
+        yasm_xfree(trace_filename);
+    trace_filename = yasm__xstrdup(param);
+    return 0;
+}
+
 #if defined(CMAKE_BUILD) && defined(BUILD_SHARED_LIBS)
 static int
 opt_plugin_handler(/*@unused@*/ char *cmd, char *param,
@@ -1421,3 +1625,243 @@ print_yasm_warning(const char *filename, unsigned long line, const char *msg)
         fprintf(errfile, fmt_noline[ewmsg_style], filename, _("warning: "),
                 msg);
 }
+
+/*
+ *  Assembly statistics
+ */
+
+/* Header prepended to each allocation to track heap usage.  The union
+ * keeps the returned memory suitably aligned for any type.
+ */
+typedef union stats_memhdr {
+    size_t size;
+    long l;
+    double d;
+    long double ld;
+    void *p;
+} stats_memhdr;
+
+static void * (*stats_orig_xmalloc) (size_t size);
+static void * (*stats_orig_xrealloc) (void *oldmem, size_t size);
+static void (*stats_orig_xfree) (void *p);
+
+static void
+stats_heap_add(size_t size)
+{
+    stats_counters.heap_cur += size;
+    if (stats_counters.heap_cur > stats_counters.heap_peak)
+        stats_counters.heap_peak = stats_counters.heap_cur;
+    stats_counters.allocs++;
+}
+
+static void *
+stats_xmalloc(size_t size)
+{
+    stats_memhdr *hdr = stats_orig_xmalloc(sizeof(stats_memhdr)+size);
+    hdr->size = size;
+    stats_heap_add(size);
+    return hdr+1;
+}
+
+static void *
+stats_xcalloc(size_t nelem, size_t elsize)
+{
+    void *newmem = stats_xmalloc(nelem*elsize);
+    memset(newmem, 0, nelem*elsize);
+    return newmem;
+}
+
+static void *
+stats_xrealloc(void *oldmem, size_t size)
+{
+    stats_memhdr *hdr;
+
+    if (!oldmem)
+        return stats_xmalloc(size);
+
+    hdr = (stats_memhdr *)oldmem - 1;
+    stats_counters.heap_cur -= hdr->size;
+    hdr = stats_orig_xrealloc(hdr, sizeof(stats_memhdr)+size);
+    hdr->size = size;
+    stats_heap_add(size);
+    return hdr+1;
+}
+
+static void
+stats_xfree(void *p)
+{
+    stats_memhdr *hdr;
+
+    if (!p)
+        return;
+    hdr = (stats_memhdr *)p - 1;
+    stats_counters.heap_cur -= hdr->size;
+    stats_orig_xfree(hdr);
+}
+
+/* Installs the heap-tracking allocation hooks.  Must be called before any
+ * memory is allocated through yasm_xmalloc().
+ */
+static void
+stats_init_heap(void)
+{
+    stats_orig_xmalloc = yasm_xmalloc;
+    stats_orig_xrealloc = yasm_xrealloc;
+    stats_orig_xfree = yasm_xfree;
+    yasm_xmalloc = stats_xmalloc;
+    yasm_xcalloc = stats_xcalloc;
+    yasm_xrealloc = stats_xrealloc;
+    yasm_xfree = stats_xfree;
+}
+
+static double
+stats_cpu_time(void)
+{
+    return (double)clock()/CLOCKS_PER_SEC;
+}
+
+static void
+stats_begin(enum stats_phase phase)
+{
+    if (!show_stats)
+        return;
+    stats_phases[phase].wall_start = yasm_stats_wall_time();
+    stats_phases[phase].cpu_start = stats_cpu_time();
+}
+
+static void
+stats_end(enum stats_phase phase)
+{
+    if (!show_stats)
+        return;
+    stats_phases[phase].wall +=
+        yasm_stats_wall_time() - stats_phases[phase].wall_start;
+    stats_phases[phase].cpu += stats_cpu_time() - stats_phases[phase].cpu_start;
+}
+
+/* Preprocessing is driven line by line from within the parser, so it's
+ * timed by interposing on the preprocessor's get_line function.
+ */
+static yasm_preproc_module stats_preproc_module;
+static char * (*stats_orig_get_line) (yasm_preproc *preproc);
+
+static char *
+stats_preproc_get_line(yasm_preproc *preproc)
+{
+    char *line;
+    stats_begin(STATS_PREPROC);
+    line = stats_orig_get_line(preproc);
+    stats_end(STATS_PREPROC);
+    return line;
+}
+
+static void
+stats_wrap_preproc(yasm_preproc *preproc)
+{
+    yasm_preproc_base *base = (yasm_preproc_base *)preproc;
+    stats_preproc_module = *base->module;
+    stats_orig_get_line = stats_preproc_module.get_line;
+    stats_preproc_module.get_line = stats_preproc_get_line;
+    base->module = &stats_preproc_module;
+}
+
+static int
+stats_count_section(yasm_section *sect, /*@unused@*/ void *d)
+{
+    yasm_bytecode *bc = yasm_section_bcs_first(sect);
+
+    /* Skip the locally created empty bytecode */
+    for (bc = yasm_bc__next(bc); bc; bc = yasm_bc__next(bc))
+        stats_counters.bytecodes++;
+    stats_counters.relocs += yasm_section_num_relocs(sect);
+    return 0;
+}
+
+static void
+stats_count_object(yasm_object *object)
+{
+    const yasm_symtab_iter *iter;
+
+    yasm_object_sections_traverse(object, NULL, stats_count_section);
+
+    for (iter = yasm_symtab_first(object->symtab); iter;
+         iter = yasm_symtab_next(iter))
+        stats_counters.symbols++;
+}
+
+static void
+stats_output(void)
+{
+    static const char *counter_fmt = "  %-20s %12lu\n";
+    double total_wall = 0.0, total_cpu = 0.0;
+    int i;
+
+    /* Preprocessing time is included in the parse phase; separate it out */
+    stats_phases[STATS_PARSE].wall -= stats_phases[STATS_PREPROC].wall;
+    stats_phases[STATS_PARSE].cpu -= stats_phases[STATS_PREPROC].cpu;
+
+    for (i=0; i<STATS_NUM_PHASES; i++) {
+        total_wall += stats_phases[i].wall;
+        total_cpu += stats_phases[i].cpu;
+    }
+
+    if (!stats_json_filename) {
+        fprintf(stderr, "%-22s %12s %12s\n", "phase", "wall (s)", "cpu (s)");
+        for (i=0; i<STATS_NUM_PHASES; i++)
+            fprintf(stderr, "  %-20s %12.6f %12.6f\n", stats_phase_names[i],
+                    stats_phases[i].wall, stats_phases[i].cpu);
+        fprintf(stderr, "  %-20s %12.6f %12.6f\n", "total", total_wall,
+                total_cpu);
+        fprintf(stderr, "%s\n", "counters");
+        fprintf(stderr, counter_fmt, "lines", stats_counters.lines);
+        fprintf(stderr, counter_fmt, "bytecodes", stats_counters.bytecodes);
+        fprintf(stderr, counter_fmt, "spans",
+                yasm_stats_counters.spans);
+        fprintf(stderr, counter_fmt, "span expansions",
+                yasm_stats_counters.expansions);
+        fprintf(stderr, counter_fmt, "symbols", stats_counters.symbols);
+        fprintf(stderr, counter_fmt, "relocations", stats_counters.relocs);
+        fprintf(stderr, counter_fmt, "expressions",
+                yasm_stats_counters.exprs);
+        fprintf(stderr, counter_fmt, "allocations", stats_counters.allocs);
+        fprintf(stderr, counter_fmt, "peak heap bytes",
+                (unsigned long)stats_counters.heap_peak);
+        fprintf(stderr, counter_fmt, "output bytes",
+                stats_counters.output_bytes);
+    } else {
+        FILE *f;
+
+        if (strcmp(stats_json_filename, "-") == 0)
+            f = stdout;
+        else {
+            f = open_file(stats_json_filename, "wt");
+            if (!f)
+                return;
+        }
+
+        fprintf(f, "{\n  \"phases\": {\n");
+        for (i=0; i<STATS_NUM_PHASES; i++)
+            fprintf(f, "    \"%s\": {\"wall\": %.6f, \"cpu\": %.6f},\n",
+                    stats_phase_names[i], stats_phases[i].wall,
+                    stats_phases[i].cpu);
+        fprintf(f, "    \"total\": {\"wall\": %.6f, \"cpu\": %.6f}\n",
+                total_wall, total_cpu);
+        fprintf(f, "  },\n  \"counters\": {\n");
+        fprintf(f, "    \"lines\": %lu,\n", stats_counters.lines);
+        fprintf(f, "    \"bytecodes\": %lu,\n", stats_counters.bytecodes);
+        fprintf(f, "    \"spans\": %lu,\n", yasm_stats_counters.spans);
+        fprintf(f, "    \"span_expansions\": %lu,\n",
+                yasm_stats_counters.expansions);
+        fprintf(f, "    \"symbols\": %lu,\n", stats_counters.symbols);
+        fprintf(f, "    \"relocations\": %lu,\n", stats_counters.relocs);
+        fprintf(f, "    \"expressions\": %lu,\n", yasm_stats_counters.exprs);
+        fprintf(f, "    \"allocations\": %lu,\n", stats_counters.allocs);
+        fprintf(f, "    \"peak_heap_bytes\": %lu,\n",
+                (unsigned long)stats_counters.heap_peak);
+        fprintf(f, "    \"output_bytes\": %lu\n", stats_counters.output_bytes);
+        fprintf(f, "  }\n}\n");
+
+        if (f != stdout)
+            fclose(f);
+    }
+}
@@ -70,6 +70,8 @@ typedef unsigned long uintptr_t;
 #include <libyasm/module.h>
 
 #include <libyasm/hamt.h>
+#include <libyasm/intern.h>
 #include <libyasm/md5.h>
+#include <libyasm/stats.h>
 
 #endif
@@ -74,8 +74,6 @@ static STAILQ_HEAD(warn_head, warn) yasm_warns;
 static unsigned long warn_class_enabled;
 
 typedef struct errwarn_data {
-    /*@reldef@*/ SLIST_ENTRY(errwarn_data) link;
-
     enum { WE_UNKNOWN, WE_ERROR, WE_WARNING, WE_PARSERERROR } type;
 
     unsigned long line;
@@ -85,16 +83,27 @@ typedef struct errwarn_data {
 } errwarn_data;
 
 struct yasm_errwarns {
-    /*@reldef@*/ SLIST_HEAD(errwarn_head, errwarn_data) errwarns;
+    /* Errors/warnings in the order they were added; sorted by line (keeping
+     * that order for equal lines) when output.
+     */
+    /*@only@*/ errwarn_data *errwarns;
+    size_t num_errwarns;
+    size_t alloc_errwarns;
+
+    /* Highest line of any error/warning, and the index of the most recently
+     * added error/warning with that line.
+     */
+    unsigned long max_line;
+    size_t max_line_we;
+
+    /* Number of errors/warnings of type WE_PARSERERROR */
+    size_t num_parsererrs;
 
     /* Total error count */
     unsigned int ecount;
 
     /* Total warning count */
     unsigned int wcount;
-
-    /* Last inserted error/warning.  Used to speed up insertions. */
-    /*@null@*/ errwarn_data *previous_we;
 };
 
 /* Static buffer for use by conv_unprint(). */
@@ -183,63 +192,78 @@ def_fatal(const char *fmt, va_list va)
     exit(EXIT_FAILURE);
 }
 
-/* Create an errwarn structure in the correct linked list location.
- * If replace_parser_error is nonzero, overwrites the last error if its
- * type is WE_PARSERERROR.
+/* Find the error/warning that a new one at line would follow once sorted:
+ * the last added of those with the highest line <= line, or if there are
+ * none, the first one in sorted order.  Returns NULL if there are no
+ * errors/warnings.
+ */
+static /*@null@*/ errwarn_data *
+errwarn_data_prev(yasm_errwarns *errwarns, unsigned long line)
+{
+    errwarn_data *prev = NULL, *first = NULL;
+    size_t i;
+
+    if (errwarns->num_errwarns == 0)
+        return NULL;
+    if (line >= errwarns->max_line)
+        return &errwarns->errwarns[errwarns->max_line_we];
+
+    for (i=0; i<errwarns->num_errwarns; i++) {
+        errwarn_data *we = &errwarns->errwarns[i];
+        if (we->line <= line) {
+            if (!prev || we->line >= prev->line)
+                prev = we;
+        } else if (!first || we->line < first->line)
+            first = we;
+    }
+    return prev ? prev : first;
+}
+
+/* Create an errwarn structure at the end of the errwarns vector.
+ * If replace_parser_error is nonzero, overwrites the error that the new one
+ * would follow (once sorted) if its type is WE_PARSERERROR.
  */
 static errwarn_data *
 errwarn_data_new(yasm_errwarns *errwarns, unsigned long line,
                  int replace_parser_error)
 {
-    errwarn_data *first, *next, *ins_we, *we;
-    enum { INS_NONE, INS_HEAD, INS_AFTER } action = INS_NONE;
+    errwarn_data *we;
 
-    /* Find the entry with either line=line or the last one with line<line.
-     * Start with the last entry added to speed the search.
-     */
-    ins_we = errwarns->previous_we;
-    first = SLIST_FIRST(&errwarns->errwarns);
-    if (!ins_we || !first)
-        action = INS_HEAD;
-    while (action == INS_NONE) {
-        next = SLIST_NEXT(ins_we, link);
-        if (line < ins_we->line) {
-            if (ins_we == first)
-                action = INS_HEAD;
-            else
-                ins_we = first;
-        } else if (!next)
-            action = INS_AFTER;
-        else if (line >= ins_we->line && line < next->line)
-            action = INS_AFTER;
-        else
-            ins_we = next;
+    /* Only search for an error to replace if there could be one */
+    if (replace_parser_error && errwarns->num_parsererrs > 0) {
+        we = errwarn_data_prev(errwarns, line);
+        if (we && we->type == WE_PARSERERROR) {
+            /* overwrite last error */
+            errwarns->num_parsererrs--;
+            we->type = WE_UNKNOWN;
+            if (we->msg)
+                yasm_xfree(we->msg);
+            if (we->xrefmsg)
+                yasm_xfree(we->xrefmsg);
+            we->xrefline = 0;
+            we->msg = NULL;
+            we->xrefmsg = NULL;
+            return we;
+        }
     }
 
-    if (replace_parser_error && ins_we && ins_we->type == WE_PARSERERROR) {
-        /* overwrite last error */      
-        we = ins_we;
-    } else {
-        /* add a new error */
-        we = yasm_xmalloc(sizeof(errwarn_data));
-
-        we->type = WE_UNKNOWN;
-        we->line = line;
-        we->xrefline = 0;
-        we->msg = NULL;
-        we->xrefmsg = NULL;
-
-        if (action == INS_HEAD)
-            SLIST_INSERT_HEAD(&errwarns->errwarns, we, link);
-        else if (action == INS_AFTER) {
-            assert(ins_we != NULL);
-            SLIST_INSERT_AFTER(ins_we, we, link);
-        } else
-            yasm_internal_error(N_("Unexpected errwarn insert action"));
+    /* add a new error */
+    if (errwarns->num_errwarns >= errwarns->alloc_errwarns) {
+        errwarns->alloc_errwarns *= 2;
+        errwarns->errwarns = yasm_xrealloc(errwarns->errwarns,
+            errwarns->alloc_errwarns*sizeof(errwarn_data));
+    }
+    if (errwarns->num_errwarns == 0 || line >= errwarns->max_line) {
+        errwarns->max_line = line;
+        errwarns->max_line_we = errwarns->num_errwarns;
     }
+    we = &errwarns->errwarns[errwarns->num_errwarns++];
 
-    /* Remember previous err/warn */
-    errwarns->previous_we = we;
+    we->type = WE_UNKNOWN;
+    we->line = line;
+    we->xrefline = 0;
+    we->msg = NULL;
+    we->xrefmsg = NULL;
 
     return we;
 }
@@ -420,30 +444,33 @@ yasm_errwarns *
 yasm_errwarns_create(void)
 {
     yasm_errwarns *errwarns = yasm_xmalloc(sizeof(yasm_errwarns));
-    SLIST_INIT(&errwarns->errwarns);
+    errwarns->alloc_errwarns = 16;
+    errwarns->errwarns =
+        yasm_xmalloc(errwarns->alloc_errwarns*sizeof(errwarn_data));
+    errwarns->num_errwarns = 0;
+    errwarns->max_line = 0;
+    errwarns->max_line_we = 0;
+    errwarns->num_parsererrs = 0;
     errwarns->ecount = 0;
     errwarns->wcount = 0;
-    errwarns->previous_we = NULL;
     return errwarns;
 }
 
 void
 yasm_errwarns_destroy(yasm_errwarns *errwarns)
 {
-    errwarn_data *we;
+    size_t i;
 
     /* Delete all error/warnings */
-    while (!SLIST_EMPTY(&errwarns->errwarns)) {
-        we = SLIST_FIRST(&errwarns->errwarns);
+    for (i=0; i<errwarns->num_errwarns; i++) {
+        errwarn_data *we = &errwarns->errwarns[i];
         if (we->msg)
             yasm_xfree(we->msg);
         if (we->xrefmsg)
             yasm_xfree(we->xrefmsg);
-
-        SLIST_REMOVE_HEAD(&errwarns->errwarns, link);
-        yasm_xfree(we);
     }
 
+    yasm_xfree(errwarns->errwarns);
     yasm_xfree(errwarns);
 }
 
@@ -456,9 +483,10 @@ yasm_errwarn_propagate(yasm_errwarns *errwarns, unsigned long line)
 
         yasm_error_fetch(&eclass, &we->msg, &we->xrefline, &we->xrefmsg);
         if (eclass != YASM_ERROR_GENERAL
-            && (eclass & YASM_ERROR_PARSE) == YASM_ERROR_PARSE)
+            && (eclass & YASM_ERROR_PARSE) == YASM_ERROR_PARSE) {
             we->type = WE_PARSERERROR;
-        else
+            errwarns->num_parsererrs++;
+        } else
             we->type = WE_ERROR;
         errwarns->ecount++;
     }
@@ -482,20 +510,42 @@ yasm_errwarns_num_errors(yasm_errwarns *errwarns, int warning_as_error)
         return errwarns->ecount;
 }
 
+static int
+errwarn_data_compare(const void *a, const void *b)
+{
+    const errwarn_data *wa = a, *wb = b;
+    if (wa->line < wb->line)
+        return -1;
+    if (wa->line > wb->line)
+        return 1;
+    return 0;
+}
+
 void
 yasm_errwarns_output_all(yasm_errwarns *errwarns, yasm_linemap *lm,
                          int warning_as_error,
                          yasm_print_error_func print_error,
                          yasm_print_warning_func print_warning)
 {
-    errwarn_data *we;
     const char *filename, *xref_filename;
     unsigned long line, xref_line;
+    yasm_linemap_cursor cursor;
+    size_t i;
 
-    /* Output error/warnings. */
-    SLIST_FOREACH(we, &errwarns->errwarns, link) {
+    /* Sort by line.  Mergesort is stable, so errors/warnings on the same
+     * line stay in the order they were added.
+     */
+    yasm__mergesort(errwarns->errwarns, errwarns->num_errwarns,
+                    sizeof(errwarn_data), errwarn_data_compare);
+    if (errwarns->num_errwarns > 0)
+        errwarns->max_line_we = errwarns->num_errwarns-1;
+
+    /* Output error/warnings.  Lines are ascending, so use a cursor. */
+    yasm_linemap_cursor_init(&cursor);
+    for (i=0; i<errwarns->num_errwarns; i++) {
+        errwarn_data *we = &errwarns->errwarns[i];
         /* Output error/warning */
-        yasm_linemap_lookup(lm, we->line, &filename, &line);
+        yasm_linemap_lookup_cursor(lm, &cursor, we->line, &filename, &line);
         if (we->xrefline)
             yasm_linemap_lookup(lm, we->xrefline, &xref_filename, &xref_line);
         else {
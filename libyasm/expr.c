@@ -40,6 +40,7 @@
 #include "section.h"
 
 #include "arch.h"
+#include "stats.h"
 
 
 static /*@only@*/ yasm_expr *expr_level_op
@@ -51,11 +52,31 @@ static int expr_traverse_nodes_post(/*@null@*/ yasm_expr *e,
                                                  /*@null@*/ void *d));
 static void expr_delete_term(yasm_expr__item *term, int recurse);
 
-/* Bitmap of used items.  We should really never need more than 2 at a time,
- * so 31 is pretty much overkill.
+/* Expression items are only live between their creation and the
+ * yasm_expr_create() call that consumes them, so only a few are ever in use
+ * at once.  They are handed out from a small per-thread pool tracked by a
+ * bitmap of used items; if the pool is ever exhausted (e.g. by a deeply
+ * nested expression built bottom-up), further items are heap allocated.
  */
-static unsigned long itempool_used = 0;
-static yasm_expr__item itempool[31];
+#define EXPR_ITEMPOOL_SIZE  32
+#define EXPR_ITEMPOOL_FULL  0xFFFFFFFFUL
+
+typedef struct expr_itempool {
+    unsigned long used;     /* bitmap of used items */
+    yasm_expr__item items[EXPR_ITEMPOOL_SIZE];
+} expr_itempool;
+
+static YASM_THREAD_LOCAL expr_itempool itempool;
+
+static void
+expr_release_item(yasm_expr__item *item)
+{
+    if (item >= &itempool.items[0] &&
+        item < &itempool.items[EXPR_ITEMPOOL_SIZE])
+        itempool.used &= ~(1UL<<(item-itempool.items));
+    else
+        yasm_xfree(item);
+}
 
 /* allocate a new expression node, with children as defined.
  * If it's a unary operator, put the element in left and set right=NULL. */
@@ -65,8 +86,8 @@ yasm_expr_create(yasm_expr_op op, yasm_expr__item *left,
                  yasm_expr__item *right, unsigned long line)
 {
     yasm_expr *ptr, *sube;
-    unsigned long z;
     ptr = yasm_xmalloc(sizeof(yasm_expr));
+    yasm_stats_counters.exprs++;
 
     ptr->op = op;
     ptr->numterms = 0;
@@ -74,10 +95,7 @@ yasm_expr_create(yasm_expr_op op, yasm_expr__item *left,
     ptr->terms[1].type = YASM_EXPR_NONE;
     if (left) {
         ptr->terms[0] = *left;  /* structure copy */
-        z = (unsigned long)(left-itempool);
-        if (z>=31)
-            yasm_internal_error(N_("could not find expritem in pool"));
-        itempool_used &= ~(1<<z);
+        expr_release_item(left);
         ptr->numterms++;
 
         /* Search downward until we find something *other* than an
@@ -97,10 +115,7 @@ yasm_expr_create(yasm_expr_op op, yasm_expr__item *left,
 
     if (right) {
         ptr->terms[1] = *right; /* structure copy */
-        z = (unsigned long)(right-itempool);
-        if (z>=31)
-            yasm_internal_error(N_("could not find expritem in pool"));
-        itempool_used &= ~(1<<z);
+        expr_release_item(right);
         ptr->numterms++;
 
         /* Search downward until we find something *other* than an
@@ -126,17 +141,14 @@ yasm_expr_create(yasm_expr_op op, yasm_expr__item *left,
 static yasm_expr__item *
 expr_get_item(void)
 {
-    int z = 0;
-    unsigned long v = itempool_used & 0x7fffffff;
-
-    while (v & 1) {
-        v >>= 1;
-        z++;
-    }
-    if (z>=31)
-        yasm_internal_error(N_("too many expritems"));
-    itempool_used |= 1<<z;
-    return &itempool[z];
+    unsigned long free_items = ~itempool.used & EXPR_ITEMPOOL_FULL;
+    int z;
+
+    if (free_items == 0)
+        return yasm_xmalloc(sizeof(yasm_expr__item));
+    BitCountTrailingZeros(z, free_items);
+    itempool.used |= 1UL<<z;
+    return &itempool.items[z];
 }
 
 yasm_expr__item *
@@ -806,11 +818,63 @@ typedef struct yasm__exprentry {
     /*@null@*/ const yasm_expr *e;
 } yasm__exprentry;
 
+static yasm_expr *expr_level_tree(yasm_expr *e, int fold_const,
+                                  int simplify_ident, int simplify_reg_mul,
+                                  int calc_bc_dist,
+                                  yasm_expr_xform_func expr_xform_extra,
+                                  void *expr_xform_extra_data);
+static yasm_expr *expr_expand_equ(yasm_expr *e, yasm__exprhead *eh);
+
+/* Get a copy of the expanded value of an equ symbol, or NULL (with an error
+ * set) on a circular reference.  The expanded value (with all equ's it
+ * references expanded and simplified) is computed once per symbol and
+ * cached; later uses just copy it.  Symbols in the cached value that were
+ * defined as equ's after it was cached are expanded on each copy.
+ */
+static /*@null@*/ yasm_expr *
+expr_expand_equ_sym(yasm_symrec *sym, const yasm_expr *equ_expr,
+                    yasm__exprhead *eh)
+{
+    const yasm_expr *cached;
+    yasm__exprentry *np, ee;
+    yasm_expr *e;
+
+    /* Check for circular reference */
+    SLIST_FOREACH(np, eh, next) {
+        if (np->e == equ_expr) {
+            yasm_error_set(YASM_ERROR_TOO_COMPLEX,
+                           N_("circular reference detected"));
+            return NULL;
+        }
+    }
+
+    /* Remember we saw this equ while expanding it */
+    ee.e = equ_expr;
+    SLIST_INSERT_HEAD(eh, &ee, next);
+
+    cached = yasm_symrec__get_equ_cache(sym);
+    if (!cached) {
+        e = expr_expand_equ(yasm_expr_copy(equ_expr), eh);
+        if (!yasm_error_occurred())
+            e = expr_level_tree(e, 1, 1, 0, 0, NULL, NULL);
+        if (yasm_error_occurred()) {
+            /* Don't cache a partial or erroneous expansion */
+            SLIST_REMOVE_HEAD(eh, next);
+            return e;
+        }
+        yasm_symrec__set_equ_cache(sym, e);
+        cached = e;
+    }
+
+    e = expr_expand_equ(yasm_expr_copy(cached), eh);
+    SLIST_REMOVE_HEAD(eh, next);
+    return e;
+}
+
 static yasm_expr *
 expr_expand_equ(yasm_expr *e, yasm__exprhead *eh)
 {
     int i;
-    yasm__exprentry ee;
 
     /* traverse terms */
     for (i=0; i<e->numterms; i++) {
@@ -819,25 +883,12 @@ expr_expand_equ(yasm_expr *e, yasm__exprhead *eh)
         /* Expand equ's. */
         if (e->terms[i].type == YASM_EXPR_SYM &&
             (equ_expr = yasm_symrec_get_equ(e->terms[i].data.sym))) {
-            yasm__exprentry *np;
-
-            /* Check for circular reference */
-            SLIST_FOREACH(np, eh, next) {
-                if (np->e == equ_expr) {
-                    yasm_error_set(YASM_ERROR_TOO_COMPLEX,
-                                   N_("circular reference detected"));
-                    return e;
-                }
-            }
-
+            yasm_expr *expn = expr_expand_equ_sym(e->terms[i].data.sym,
+                                                  equ_expr, eh);
+            if (!expn)
+                return e;
             e->terms[i].type = YASM_EXPR_EXPR;
-            e->terms[i].data.expn = yasm_expr_copy(equ_expr);
-
-            /* Remember we saw this equ and recurse */
-            ee.e = equ_expr;
-            SLIST_INSERT_HEAD(eh, &ee, next);
-            e->terms[i].data.expn = expr_expand_equ(e->terms[i].data.expn, eh);
-            SLIST_REMOVE_HEAD(eh, next);
+            e->terms[i].data.expn = expn;
         } else if (e->terms[i].type == YASM_EXPR_EXPR)
             /* Recurse */
             e->terms[i].data.expn = expr_expand_equ(e->terms[i].data.expn, eh);
@@ -1111,6 +1162,7 @@ yasm_expr__copy_except(const yasm_expr *e, int except)
     
     n = yasm_xmalloc(sizeof(yasm_expr) +
                      sizeof(yasm_expr__item)*(e->numterms<2?0:e->numterms-2));
+    yasm_stats_counters.exprs++;
 
     n->op = e->op;
     n->line = e->line;
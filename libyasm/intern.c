@@ -0,0 +1,383 @@
+/*
+ * String interning
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util.h"
+
+#include <ctype.h>
+
+#include "intern.h"
+
+
+/* Each interned string is stored right after its header. */
+typedef struct intern_hdr {
+    size_t len;
+    unsigned long hash;
+} intern_hdr;
+
+/* Block of interned string storage.  Headers are aligned within the block
+ * to INTERN_ALIGN bytes; the block data starts INTERN_BLKHDR bytes after
+ * the start of the block.
+ */
+typedef struct intern_block {
+    /*@null@*/ /*@owned@*/ struct intern_block *next;
+    size_t used;                /* bytes used in data */
+    size_t size;                /* bytes allocated for data */
+} intern_block;
+
+#define INTERN_ALIGN \
+    (sizeof(unsigned long) > sizeof(size_t) ? sizeof(unsigned long) \
+                                            : sizeof(size_t))
+#define INTERN_ROUNDUP(x)   (((x)+INTERN_ALIGN-1) & ~(INTERN_ALIGN-1))
+#define INTERN_BLKHDR       INTERN_ROUNDUP(sizeof(intern_block))
+#define INTERN_BLOCK_SIZE   65536
+
+/* Hash table slot.  Empty slots have a NULL str. */
+typedef struct intern_slot {
+    unsigned long hash;
+    /*@null@*/ /*@dependent@*/ const char *str;
+} intern_slot;
+
+#define INTERN_INITIAL_SLOTS    1024
+
+/* A string pool: an open addressing (linear probing) hash table of strings
+ * kept in blocks.  nslots is a power of 2 (or 0 before first use) and the
+ * table is kept at most 3/4 full.
+ */
+typedef struct intern_pool {
+    /*@null@*/ /*@only@*/ intern_slot *slots;
+    unsigned long nslots;
+    unsigned long nstrs;
+    /*@null@*/ /*@owned@*/ intern_block *blocks;
+} intern_pool;
+
+/* The pool is per-thread, so separate threads can assemble concurrently
+ * without locking; each gets its own copy of every string it interns.
+ */
+static YASM_THREAD_LOCAL intern_pool pool;
+
+#define INTERN_HDR(istr)    ((const intern_hdr *)(istr) - 1)
+
+/* Hash (FNV-1a) the first len bytes of str, lowercasing if lower is set. */
+static unsigned long
+intern_hash_str(const char *str, size_t len, int lower)
+{
+    unsigned long hash = 2166136261UL;
+    const unsigned char *c = (const unsigned char *)str;
+    const unsigned char *end = c+len;
+
+    if (lower) {
+        for (; c<end; c++)
+            hash = ((hash ^ (unsigned char)tolower(*c)) * 16777619UL)
+                & 0xFFFFFFFFUL;
+    } else {
+        for (; c<end; c++)
+            hash = ((hash ^ *c) * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    return hash;
+}
+
+static int
+intern_match(const char *istr, const char *str, size_t len, int lower)
+{
+    size_t i;
+
+    if (INTERN_HDR(istr)->len != len)
+        return 0;
+    if (!lower)
+        return memcmp(istr, str, len) == 0;
+    for (i=0; i<len; i++) {
+        if ((unsigned char)istr[i] != tolower((unsigned char)str[i]))
+            return 0;
+    }
+    return 1;
+}
+
+/* Find the slot for str: either the slot holding it or the empty slot
+ * where it would be inserted.
+ */
+static intern_slot *
+intern_find_slot(const intern_pool *p, const char *str, size_t len,
+                 unsigned long hash, int lower)
+{
+    unsigned long mask = p->nslots-1;
+    unsigned long i = hash & mask;
+
+    for (;;) {
+        intern_slot *slot = &p->slots[i];
+        if (!slot->str || (slot->hash == hash &&
+                           intern_match(slot->str, str, len, lower)))
+            return slot;
+        i = (i+1) & mask;
+    }
+}
+
+static void
+intern_grow(intern_pool *p)
+{
+    intern_slot *oldslots = p->slots;
+    unsigned long oldnslots = p->nslots;
+    unsigned long i, mask;
+
+    p->nslots = oldnslots ? oldnslots*2 : INTERN_INITIAL_SLOTS;
+    mask = p->nslots-1;
+    p->slots = yasm_xmalloc(p->nslots*sizeof(intern_slot));
+    for (i=0; i<p->nslots; i++)
+        p->slots[i].str = NULL;
+
+    for (i=0; i<oldnslots; i++) {
+        unsigned long j;
+        if (!oldslots[i].str)
+            continue;
+        j = oldslots[i].hash & mask;
+        while (p->slots[j].str)
+            j = (j+1) & mask;
+        p->slots[j] = oldslots[i];
+    }
+    if (oldslots)
+        yasm_xfree(oldslots);
+}
+
+/* Copy a string into block storage, lowercasing it if lower is set. */
+static /*@dependent@*/ const char *
+intern_store(intern_pool *p, const char *str, size_t len, unsigned long hash,
+             int lower)
+{
+    intern_block *blk = p->blocks;
+    size_t need = INTERN_ROUNDUP(sizeof(intern_hdr)+len+1);
+    intern_hdr *hdr;
+    char *istr;
+    size_t i;
+
+    if (!blk || blk->size - blk->used < need) {
+        size_t size = INTERN_BLOCK_SIZE;
+        if (size < need)
+            size = need;
+        blk = yasm_xmalloc(INTERN_BLKHDR+size);
+        blk->used = 0;
+        blk->size = size;
+        /* Keep the block with the most free space at the head */
+        if (p->blocks && p->blocks->size - p->blocks->used > size - need) {
+            blk->next = p->blocks->next;
+            p->blocks->next = blk;
+        } else {
+            blk->next = p->blocks;
+            p->blocks = blk;
+        }
+    }
+
+    hdr = (intern_hdr *)((char *)blk + INTERN_BLKHDR + blk->used);
+    blk->used += need;
+    hdr->len = len;
+    hdr->hash = hash;
+    istr = (char *)(hdr+1);
+    if (lower) {
+        for (i=0; i<len; i++)
+            istr[i] = tolower((unsigned char)str[i]);
+    } else
+        memcpy(istr, str, len);
+    istr[len] = '\0';
+    return istr;
+}
+
+static /*@dependent@*/ /*@null@*/ const char *
+intern_lookup(const char *str, size_t len, int lower, int add)
+{
+    intern_pool *p = &pool;
+    unsigned long hash;
+    intern_slot *slot;
+
+    if (p->nslots == 0) {
+        if (!add)
+            return NULL;
+        intern_grow(p);
+    }
+
+    hash = intern_hash_str(str, len, lower);
+    slot = intern_find_slot(p, str, len, hash, lower);
+    if (slot->str || !add)
+        return slot->str;
+
+    slot->hash = hash;
+    slot->str = intern_store(p, str, len, hash, lower);
+    if (++p->nstrs > p->nslots/4*3) {
+        const char *istr = slot->str;
+        intern_grow(p);
+        return istr;
+    }
+    return slot->str;
+}
+
+const char *
+yasm_intern(const char *str)
+{
+    return intern_lookup(str, strlen(str), 0, 1);
+}
+
+const char *
+yasm_intern_len(const char *str, size_t len)
+{
+    return intern_lookup(str, len, 0, 1);
+}
+
+const char *
+yasm_intern_lower(const char *str)
+{
+    return intern_lookup(str, strlen(str), 1, 1);
+}
+
+const char *
+yasm_intern_find(const char *str)
+{
+    return intern_lookup(str, strlen(str), 0, 0);
+}
+
+const char *
+yasm_intern_find_lower(const char *str)
+{
+    return intern_lookup(str, strlen(str), 1, 0);
+}
+
+unsigned long
+yasm_intern_hash(const char *istr)
+{
+    return INTERN_HDR(istr)->hash;
+}
+
+size_t
+yasm_intern_length(const char *istr)
+{
+    return INTERN_HDR(istr)->len;
+}
+
+void
+yasm_intern_cleanup(void)
+{
+    intern_pool *p = &pool;
+
+    while (p->blocks) {
+        intern_block *blk = p->blocks;
+        p->blocks = blk->next;
+        yasm_xfree(blk);
+    }
+    if (p->slots)
+        yasm_xfree(p->slots);
+    p->slots = NULL;
+    p->nslots = 0;
+    p->nstrs = 0;
+}
+
+/* Interned string map: an open addressing hash table keyed by interned
+ * string pointer, using the precomputed string hashes.  Empty slots have a
+ * NULL key.
+ */
+typedef struct intern_map_slot {
+    /*@null@*/ /*@dependent@*/ const char *key;
+    /*@null@*/ /*@dependent@*/ void *data;
+} intern_map_slot;
+
+struct yasm_intern_map {
+    /*@only@*/ intern_map_slot *slots;
+    unsigned long nslots;       /* power of 2 */
+    unsigned long nkeys;
+};
+
+#define INTERN_MAP_INITIAL_SLOTS    16
+
+yasm_intern_map *
+yasm_intern_map_create(void)
+{
+    yasm_intern_map *map = yasm_xmalloc(sizeof(yasm_intern_map));
+    unsigned long i;
+
+    map->nslots = INTERN_MAP_INITIAL_SLOTS;
+    map->nkeys = 0;
+    map->slots = yasm_xmalloc(map->nslots*sizeof(intern_map_slot));
+    for (i=0; i<map->nslots; i++)
+        map->slots[i].key = NULL;
+    return map;
+}
+
+void
+yasm_intern_map_destroy(yasm_intern_map *map)
+{
+    yasm_xfree(map->slots);
+    yasm_xfree(map);
+}
+
+static intern_map_slot *
+intern_map_find_slot(const yasm_intern_map *map, const char *istr)
+{
+    unsigned long mask = map->nslots-1;
+    unsigned long i = INTERN_HDR(istr)->hash & mask;
+
+    while (map->slots[i].key && map->slots[i].key != istr)
+        i = (i+1) & mask;
+    return &map->slots[i];
+}
+
+void *
+yasm_intern_map_get(const yasm_intern_map *map, const char *istr)
+{
+    const intern_map_slot *slot = intern_map_find_slot(map, istr);
+    return slot->key ? slot->data : NULL;
+}
+
+void **
+yasm_intern_map_slot(yasm_intern_map *map, const char *istr)
+{
+    intern_map_slot *slot = intern_map_find_slot(map, istr);
+
+    if (slot->key)
+        return &slot->data;
+
+    if (map->nkeys+1 > map->nslots/4*3) {
+        intern_map_slot *oldslots = map->slots;
+        unsigned long oldnslots = map->nslots;
+        unsigned long i;
+
+        map->nslots *= 2;
+        map->slots = yasm_xmalloc(map->nslots*sizeof(intern_map_slot));
+        for (i=0; i<map->nslots; i++)
+            map->slots[i].key = NULL;
+        for (i=0; i<oldnslots; i++) {
+            if (oldslots[i].key)
+                *intern_map_find_slot(map, oldslots[i].key) = oldslots[i];
+        }
+        yasm_xfree(oldslots);
+        slot = intern_map_find_slot(map, istr);
+    }
+
+    map->nkeys++;
+    slot->key = istr;
+    slot->data = NULL;
+    return &slot->data;
+}
+
+unsigned long
+yasm_intern_map_size(const yasm_intern_map *map)
+{
+    return map->nkeys;
+}
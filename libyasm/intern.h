@@ -0,0 +1,149 @@
+/**
+ * \file libyasm/intern.h
+ * \brief YASM string interning interface.
+ *
+ * \license
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * \endlicense
+ */
+#ifndef YASM_INTERN_H
+#define YASM_INTERN_H
+
+#ifndef YASM_LIB_DECL
+#define YASM_LIB_DECL
+#endif
+
+/** Interned strings are kept in a per-thread pool.  Interning the same
+ * string twice in the same thread returns the same pointer, so interned
+ * strings may be compared for equality with ==.  Strings interned by
+ * different threads must not be compared this way.  Interned strings are
+ * never modified and live until yasm_intern_cleanup() is called by the
+ * thread that interned them.  Each interned string also carries its length
+ * and a precomputed hash.
+ */
+
+/** Intern a string.
+ * \param str       string
+ * \return Interned copy of str.
+ */
+YASM_LIB_DECL
+/*@dependent@*/ const char *yasm_intern(const char *str);
+
+/** Intern a string with known length.  The string need not be
+ * zero-terminated.
+ * \param str       string
+ * \param len       length of string (in bytes)
+ * \return Interned (zero-terminated) copy of str.
+ */
+YASM_LIB_DECL
+/*@dependent@*/ const char *yasm_intern_len(const char *str, size_t len);
+
+/** Intern the lowercase version of a string.
+ * \param str       string
+ * \return Interned lowercased copy of str.
+ */
+YASM_LIB_DECL
+/*@dependent@*/ const char *yasm_intern_lower(const char *str);
+
+/** Look up a string in the intern pool without adding it.
+ * \param str       string
+ * \return Interned copy of str, or NULL if str has not been interned.
+ */
+YASM_LIB_DECL
+/*@dependent@*/ /*@null@*/ const char *yasm_intern_find(const char *str);
+
+/** Look up the lowercase version of a string in the intern pool without
+ * adding it.
+ * \param str       string
+ * \return Interned lowercased copy of str, or NULL if it has not been
+ *         interned.
+ */
+YASM_LIB_DECL
+/*@dependent@*/ /*@null@*/ const char *yasm_intern_find_lower(const char *str);
+
+/** Get the hash of an interned string.
+ * \param istr      interned string
+ * \return Hash value.
+ */
+YASM_LIB_DECL
+unsigned long yasm_intern_hash(const char *istr);
+
+/** Get the length of an interned string.
+ * \param istr      interned string
+ * \return Length of string (in bytes), not including terminating 0.
+ */
+YASM_LIB_DECL
+size_t yasm_intern_length(const char *istr);
+
+/** Free all strings interned by the calling thread.  Any such interned
+ * string pointers become invalid.  The pool is recreated as needed if
+ * strings are interned afterwards.
+ */
+YASM_LIB_DECL
+void yasm_intern_cleanup(void);
+
+/** Map from interned strings to data pointers (opaque type).  Keys are
+ * compared by pointer, so they must be interned strings.
+ */
+typedef struct yasm_intern_map yasm_intern_map;
+
+/** Create a new, empty, interned string map.
+ * \return New map.
+ */
+YASM_LIB_DECL
+/*@only@*/ yasm_intern_map *yasm_intern_map_create(void);
+
+/** Destroy an interned string map.  The data pointers are not freed.
+ * \param map       map
+ */
+YASM_LIB_DECL
+void yasm_intern_map_destroy(/*@only@*/ yasm_intern_map *map);
+
+/** Get the data associated with an interned string.
+ * \param map       map
+ * \param istr      interned string
+ * \return Data, or NULL if istr is not in the map.
+ */
+YASM_LIB_DECL
+/*@dependent@*/ /*@null@*/ void *yasm_intern_map_get
+    (const yasm_intern_map *map, const char *istr);
+
+/** Get the data slot for an interned string, adding it to the map (with
+ * NULL data) if not already present.  The returned pointer is only valid
+ * until the next call to this function on the same map.
+ * \param map       map
+ * \param istr      interned string
+ * \return Pointer to data slot for istr.
+ */
+YASM_LIB_DECL
+void **yasm_intern_map_slot(yasm_intern_map *map, const char *istr);
+
+/** Get the number of strings in an interned string map.
+ * \param map       map
+ * \return Number of strings.
+ */
+YASM_LIB_DECL
+unsigned long yasm_intern_map_size(const yasm_intern_map *map);
+
+#endif
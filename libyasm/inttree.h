@@ -5,47 +5,28 @@
 #define YASM_LIB_DECL
 #endif
 
-/* The interval_tree.h and interval_tree.cc files contain code for 
- * interval trees implemented using red-black-trees as described in
- * the book _Introduction_To_Algorithms_ by Cormen, Leisserson, 
- * and Rivest.
+/* Static interval index.  Intervals are appended with IT_insert() and the
+ * index is built once with IT_build(); it cannot be modified afterwards.
+ * The nodes are kept in a single array sorted by low endpoint, which is
+ * treated as an implicit balanced binary tree (the middle element of each
+ * subrange is its root) augmented with the maximum high endpoint of each
+ * subtree.  Queries thus need no per-node allocation or pointer chasing.
  */
 
 typedef struct IntervalTreeNode {
-    struct IntervalTreeNode *left, *right, *parent;
     void *data;
     long low;
     long high;
-    long maxHigh;
-    int red; /* if red=0 then the node is black */
+    long maxHigh;   /* maximum high in subtree rooted here; set by IT_build */
 } IntervalTreeNode;
 
-typedef struct it_recursion_node {
-    /* This structure stores the information needed when we take the
-     * right branch in searching for intervals but possibly come back
-     * and check the left branch as well.
-     */
-    IntervalTreeNode *start_node;
-    unsigned int parentIndex;
-    int tryRightBranch;
-} it_recursion_node;
-
 typedef struct IntervalTree {
-    /* A sentinel is used for root and for nil.  These sentinels are
-     * created when ITTreeCreate is called.  root->left should always
-     * point to the node which is the root of the tree.  nil points to a
-     * node which should always be black but has aribtrary children and
-     * parent and no key or info.  The point of using these sentinels is so
-     * that the root and nil nodes do not require special cases in the code
-     */
-    IntervalTreeNode *root;
-    IntervalTreeNode *nil;
-
 /*private:*/
-    unsigned int recursionNodeStackSize;
-    it_recursion_node * recursionNodeStack;
-    unsigned int currentParent;
-    unsigned int recursionNodeStackTop;
+    IntervalTreeNode *nodes;
+    unsigned long num_nodes;
+    unsigned long alloc_nodes;
+    int root_level;     /* level of implicit root node; -1 if empty */
+    int built;
 } IntervalTree;
 
 YASM_LIB_DECL
@@ -55,14 +36,9 @@ void IT_destroy(IntervalTree *);
 YASM_LIB_DECL
 void IT_print(const IntervalTree *);
 YASM_LIB_DECL
-void *IT_delete_node(IntervalTree *, IntervalTreeNode *, long *low,
-                     long *high);
-YASM_LIB_DECL
-IntervalTreeNode *IT_insert(IntervalTree *, long low, long high, void *data);
-YASM_LIB_DECL
-IntervalTreeNode *IT_get_predecessor(const IntervalTree *, IntervalTreeNode *);
+void IT_insert(IntervalTree *, long low, long high, void *data);
 YASM_LIB_DECL
-IntervalTreeNode *IT_get_successor(const IntervalTree *, IntervalTreeNode *);
+void IT_build(IntervalTree *);
 YASM_LIB_DECL
 void IT_enumerate(IntervalTree *, long low, long high, void *cbd,
                   void (*callback) (IntervalTreeNode *node, void *cbd));
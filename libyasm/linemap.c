@@ -27,7 +27,7 @@
 #include "util.h"
 
 #include "coretype.h"
-#include "hamt.h"
+#include "intern.h"
 
 #include "errwarn.h"
 #include "linemap.h"
@@ -50,13 +50,16 @@ typedef struct line_source_info {
     /* first bytecode on line; NULL if no bytecodes on line */
     /*@null@*/ /*@dependent@*/ yasm_bytecode *bc;
 
-    /* source code line */
-    /*@owned@*/ char *source;
+    /* offset of source code line in source_text; 0 if no source */
+    unsigned long source;
 } line_source_info;
 
 struct yasm_linemap {
-    /* Shared storage for filenames */
-    /*@only@*/ /*@null@*/ HAMT *filenames;
+    /* Filenames used in mappings (interned), in order of first use */
+    /*@only@*/ yasm_intern_map *filename_map;
+    /*@only@*/ const char **filenames;
+    unsigned long num_filenames;
+    unsigned long alloc_filenames;
 
     /* Current virtual line number. */
     unsigned long current;
@@ -69,12 +72,34 @@ struct yasm_linemap {
     /* Bytecode and source line information */
     /*@only@*/ line_source_info *source_info;
     size_t source_info_size;
+
+    /* Text of all source lines, each NUL-terminated, in order of addition.
+     * Offset 0 holds an empty string so that a zero offset can mean
+     * "no source".
+     */
+    /*@only@*/ char *source_text;
+    unsigned long source_text_len;
+    unsigned long source_text_alloc;
 };
 
-static void
-filename_delete_one(/*@only@*/ void *d)
+/* Intern a filename and add it to the linemap's list of filenames. */
+static /*@dependent@*/ const char *
+linemap_add_filename(yasm_linemap *linemap, const char *filename)
 {
-    yasm_xfree(d);
+    const char *ifilename = yasm_intern(filename);
+    void **slot = yasm_intern_map_slot(linemap->filename_map, ifilename);
+
+    if (*slot)
+        return ifilename;
+    *slot = (void *)ifilename;
+
+    if (linemap->num_filenames >= linemap->alloc_filenames) {
+        linemap->alloc_filenames *= 2;
+        linemap->filenames = yasm_xrealloc(linemap->filenames,
+            linemap->alloc_filenames*sizeof(const char *));
+    }
+    linemap->filenames[linemap->num_filenames++] = ifilename;
+    return ifilename;
 }
 
 void
@@ -82,9 +107,7 @@ yasm_linemap_set(yasm_linemap *linemap, const char *filename,
                  unsigned long virtual_line, unsigned long file_line,
                  unsigned long line_inc)
 {
-    char *copy;
     unsigned long i;
-    int replace = 0;
     line_mapping *mapping = NULL;
 
     if (virtual_line == 0) {
@@ -123,14 +146,8 @@ yasm_linemap_set(yasm_linemap *linemap, const char *filename,
         else
             filename = "unknown";
     }
-    if (filename) {
-        /* Copy the filename (via shared storage) */
-        copy = yasm__xstrdup(filename);
-        /*@-aliasunique@*/
-        mapping->filename = HAMT_insert(linemap->filenames, copy, copy,
-                                        &replace, filename_delete_one);
-        /*@=aliasunique@*/
-    }
+    if (filename)
+        mapping->filename = linemap_add_filename(linemap, filename);
 
     mapping->line = virtual_line;
     mapping->file_line = file_line;
@@ -166,7 +183,10 @@ yasm_linemap_create(void)
     size_t i;
     yasm_linemap *linemap = yasm_xmalloc(sizeof(yasm_linemap));
 
-    linemap->filenames = HAMT_create(0, yasm_internal_error_);
+    linemap->filename_map = yasm_intern_map_create();
+    linemap->filenames = yasm_xmalloc(8*sizeof(const char *));
+    linemap->num_filenames = 0;
+    linemap->alloc_filenames = 8;
 
     linemap->current = 1;
 
@@ -181,26 +201,27 @@ yasm_linemap_create(void)
                                         sizeof(line_source_info));
     for (i=0; i<linemap->source_info_size; i++) {
         linemap->source_info[i].bc = NULL;
-        linemap->source_info[i].source = NULL;
+        linemap->source_info[i].source = 0;
     }
 
+    linemap->source_text_alloc = 4096;
+    linemap->source_text = yasm_xmalloc(linemap->source_text_alloc);
+    linemap->source_text[0] = '\0';
+    linemap->source_text_len = 1;
+
     return linemap;
 }
 
 void
 yasm_linemap_destroy(yasm_linemap *linemap)
 {
-    size_t i;
-    for (i=0; i<linemap->source_info_size; i++) {
-        if (linemap->source_info[i].source)
-            yasm_xfree(linemap->source_info[i].source);
-    }
     yasm_xfree(linemap->source_info);
+    yasm_xfree(linemap->source_text);
 
     yasm_xfree(linemap->map_vector);
 
-    if (linemap->filenames)
-        HAMT_destroy(linemap->filenames, filename_delete_one);
+    yasm_intern_map_destroy(linemap->filename_map);
+    yasm_xfree(linemap->filenames);
 
     yasm_xfree(linemap);
 }
@@ -215,7 +236,8 @@ void
 yasm_linemap_add_source(yasm_linemap *linemap, yasm_bytecode *bc,
                         const char *source)
 {
-    size_t i;
+    line_source_info *info;
+    size_t i, len;
 
     while (linemap->current > linemap->source_info_size) {
         /* allocate another size bins when full for 2x space */
@@ -223,17 +245,42 @@ yasm_linemap_add_source(yasm_linemap *linemap, yasm_bytecode *bc,
             2*linemap->source_info_size*sizeof(line_source_info));
         for (i=linemap->source_info_size; i<linemap->source_info_size*2; i++) {
             linemap->source_info[i].bc = NULL;
-            linemap->source_info[i].source = NULL;
+            linemap->source_info[i].source = 0;
         }
         linemap->source_info_size *= 2;
     }
 
-    /* Delete existing info for that line (if any) */
-    if (linemap->source_info[linemap->current-1].source)
-        yasm_xfree(linemap->source_info[linemap->current-1].source);
+    len = strlen(source)+1;
+    info = &linemap->source_info[linemap->current-1];
+    info->bc = bc;
+
+    /* Replacing a line's source: reuse its existing text if the new text
+     * fits there.  If the old text is at the end of the buffer, it's simply
+     * overwritten (and the buffer grown) by the append below.
+     */
+    if (info->source != 0) {
+        char *old = linemap->source_text + info->source;
+        size_t oldlen = strlen(old)+1;
+
+        if (len <= oldlen) {
+            memcpy(old, source, len);
+            return;
+        }
+        if (info->source + oldlen == linemap->source_text_len)
+            linemap->source_text_len = info->source;
+    }
 
-    linemap->source_info[linemap->current-1].bc = bc;
-    linemap->source_info[linemap->current-1].source = yasm__xstrdup(source);
+    /* Append the text to the source buffer */
+    if (linemap->source_text_len + len > linemap->source_text_alloc) {
+        while (linemap->source_text_len + len > linemap->source_text_alloc)
+            linemap->source_text_alloc *= 2;
+        linemap->source_text = yasm_xrealloc(linemap->source_text,
+                                             linemap->source_text_alloc);
+    }
+    memcpy(linemap->source_text + linemap->source_text_len, source, len);
+
+    info->source = linemap->source_text_len;
+    linemap->source_text_len += len;
 }
 
 unsigned long
@@ -242,20 +289,18 @@ yasm_linemap_goto_next(yasm_linemap *linemap)
     return ++(linemap->current);
 }
 
-void
-yasm_linemap_lookup(yasm_linemap *linemap, unsigned long line,
-                    const char **filename, unsigned long *file_line)
+/* Binary search through map to find highest mapping index with line <= line,
+ * looking only at indices lo and above (the mapping at lo must satisfy this).
+ */
+static unsigned long
+linemap_search(const yasm_linemap *linemap, unsigned long lo,
+               unsigned long line)
 {
-    line_mapping *mapping;
-    unsigned long vindex, step;
+    unsigned long vindex = lo, step;
 
-    assert(line <= linemap->current);
-
-    /* Binary search through map to find highest line_index <= index */
-    vindex = 0;
-    /* start step as the greatest power of 2 <= size */
+    /* start step as the greatest power of 2 <= remaining size */
     step = 1;
-    while (step*2<=linemap->map_size)
+    while (step*2 <= linemap->map_size-lo)
         step*=2;
     while (step>0) {
         if (vindex+step < linemap->map_size
@@ -263,6 +308,62 @@ yasm_linemap_lookup(yasm_linemap *linemap, unsigned long line,
             vindex += step;
         step /= 2;
     }
+    return vindex;
+}
+
+void
+yasm_linemap_lookup(yasm_linemap *linemap, unsigned long line,
+                    const char **filename, unsigned long *file_line)
+{
+    line_mapping *mapping;
+
+    assert(line <= linemap->current);
+
+    mapping = &linemap->map_vector[linemap_search(linemap, 0, line)];
+
+    *filename = mapping->filename;
+    *file_line = (line ? mapping->file_line + mapping->line_inc*(line-mapping->line) : 0);
+}
+
+void
+yasm_linemap_cursor_init(yasm_linemap_cursor *cursor)
+{
+    cursor->index = 0;
+}
+
+/* Number of mappings to step through linearly from the cursor before
+ * giving up and binary searching the remainder of the map.
+ */
+#define LINEMAP_CURSOR_STEPS    8
+
+void
+yasm_linemap_lookup_cursor(yasm_linemap *linemap, yasm_linemap_cursor *cursor,
+                           unsigned long line, const char **filename,
+                           unsigned long *file_line)
+{
+    line_mapping *mapping;
+    unsigned long vindex = cursor->index;
+    int steps;
+
+    assert(line <= linemap->current);
+
+    /* The map may have been truncated since the cursor was last used, and
+     * lines may go backwards; restart from the beginning in either case.
+     */
+    if (vindex >= linemap->map_size
+        || linemap->map_vector[vindex].line > line)
+        vindex = 0;
+
+    for (steps=0; steps<LINEMAP_CURSOR_STEPS; steps++) {
+        if (vindex+1 >= linemap->map_size
+            || linemap->map_vector[vindex+1].line > line)
+            break;
+        vindex++;
+    }
+    if (steps == LINEMAP_CURSOR_STEPS)
+        vindex = linemap_search(linemap, vindex, line);
+
+    cursor->index = vindex;
     mapping = &linemap->map_vector[vindex];
 
     *filename = mapping->filename;
@@ -273,7 +374,14 @@ int
 yasm_linemap_traverse_filenames(yasm_linemap *linemap, /*@null@*/ void *d,
                                 int (*func) (const char *filename, void *d))
 {
-    return HAMT_traverse(linemap->filenames, d, (int (*) (void *, void *))func);
+    unsigned long i;
+
+    for (i=0; i<linemap->num_filenames; i++) {
+        int retval = func(linemap->filenames[i], d);
+        if (retval != 0)
+            return retval;
+    }
+    return 0;
 }
 
 int
@@ -287,7 +395,10 @@ yasm_linemap_get_source(yasm_linemap *linemap, unsigned long line,
     }
 
     *bcp = linemap->source_info[line-1].bc;
-    *sourcep = linemap->source_info[line-1].source;
-
-    return (!(*sourcep));
+    if (linemap->source_info[line-1].source == 0) {
+        *sourcep = NULL;
+        return 1;
+    }
+    *sourcep = linemap->source_text + linemap->source_info[line-1].source;
+    return 0;
 }
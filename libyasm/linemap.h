@@ -34,6 +34,13 @@
 #define YASM_LIB_DECL
 #endif
 
+/** Lookup cursor for yasm_linemap_lookup_cursor().  Contents are private;
+ * use yasm_linemap_cursor_init() to initialize.
+ */
+typedef struct yasm_linemap_cursor {
+    unsigned long index;    /**< Index of mapping found by previous lookup */
+} yasm_linemap_cursor;
+
 /** Create a new line mapping repository.
  * \return New repository.
  */
@@ -60,7 +67,8 @@ unsigned long yasm_linemap_get_current(yasm_linemap *linemap);
  * \param sourcep       pointer to return source code line pointer into
  * \return Zero if source line information available for line, nonzero if not.
  * \note If source line information is not available, bcp and sourcep targets
- * are set to NULL.
+ * are set to NULL.  The returned source pointer is only valid until the
+ * next call to yasm_linemap_add_source().
  */
 YASM_LIB_DECL
 int yasm_linemap_get_source(yasm_linemap *linemap, unsigned long line,
@@ -73,7 +81,11 @@ int yasm_linemap_get_source(yasm_linemap *linemap, unsigned long line,
  * \param linemap       line mapping repository
  * \param bc            bytecode (if any)
  * \param source        source code line
- * \note The source code line pointer is NOT kept, it is strdup'ed.
+ * \note The source code line pointer is NOT kept; the text is copied into
+ *       a buffer shared by all lines of the linemap.  As that buffer may be
+ *       reallocated or (when replacing a line's source) overwritten, any
+ *       pointer previously returned by yasm_linemap_get_source() becomes
+ *       invalid.
  */
 YASM_LIB_DECL
 void yasm_linemap_add_source(yasm_linemap *linemap,
@@ -125,6 +137,31 @@ void yasm_linemap_lookup(yasm_linemap *linemap, unsigned long line,
                          /*@out@*/ const char **filename,
                          /*@out@*/ unsigned long *file_line);
 
+/** Initialize a lookup cursor for yasm_linemap_lookup_cursor().
+ * \param cursor        cursor
+ */
+YASM_LIB_DECL
+void yasm_linemap_cursor_init(/*@out@*/ yasm_linemap_cursor *cursor);
+
+/** Look up the associated physical file and line for a virtual line, using
+ * a cursor to remember the position of the previous lookup.  Equivalent to
+ * yasm_linemap_lookup(), but a series of lookups in ascending virtual line
+ * order takes amortized constant time per lookup.  Lookups in any other
+ * order are still correct, just no faster than yasm_linemap_lookup().
+ * \param linemap       line mapping repository
+ * \param cursor        lookup cursor (initialized by
+ *                      yasm_linemap_cursor_init())
+ * \param line          virtual line
+ * \param filename      physical file name (output)
+ * \param file_line     physical line number (output)
+ */
+YASM_LIB_DECL
+void yasm_linemap_lookup_cursor(yasm_linemap *linemap,
+                                yasm_linemap_cursor *cursor,
+                                unsigned long line,
+                                /*@out@*/ const char **filename,
+                                /*@out@*/ unsigned long *file_line);
+
 /** Traverses all filenames used in a linemap, calling a function on each
  * filename.
  * \param linemap       line mapping repository
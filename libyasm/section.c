@@ -31,6 +31,7 @@
 #include "libyasm-stdint.h"
 #include "coretype.h"
 #include "hamt.h"
+#include "intern.h"
 #include "valparam.h"
 #include "assocdat.h"
 
@@ -49,6 +50,7 @@
 #include "objfmt.h"
 
 #include "inttree.h"
+#include "stats.h"
 
 
 struct yasm_section {
@@ -56,7 +58,7 @@ struct yasm_section {
 
     /*@dependent@*/ yasm_object *object;    /* Pointer to parent object */
 
-    /*@owned@*/ char *name;     /* strdup()'ed name (given by user) */
+    /*@dependent@*/ const char *name;   /* interned name (given by user) */
 
     /* associated data; NULL if none */
     /*@null@*/ /*@only@*/ yasm__assoc_data *assoc_data;
@@ -73,12 +75,21 @@ struct yasm_section {
     /* the bytecodes for the section's contents */
     /*@reldef@*/ STAILQ_HEAD(yasm_bytecodehead, yasm_bytecode) bcs;
 
-    /* the relocations for the section */
-    /*@reldef@*/ STAILQ_HEAD(yasm_relochead, yasm_reloc) relocs;
+    /* the relocations for the section, stored by value; each entry is
+     * reloc_size bytes (an object format extension of yasm_reloc)
+     */
+    /*@null@*/ /*@owned@*/ unsigned char *relocs;
+    size_t reloc_size;
+    unsigned long num_relocs;
+    unsigned long alloc_relocs;
+    int relocs_sorted;          /* relocs are in ascending address order */
 
-    void (*destroy_reloc) (/*@only@*/ void *reloc);
+    /*@null@*/ void (*destroy_reloc) (void *reloc);
 };
 
+/* Size of the block buffer used by yasm_section_relocs_write(). */
+#define RELOC_WRITE_BUFSIZE     4096
+
 static void yasm_section_destroy(/*@only@*/ yasm_section *sect);
 
 /* Wrapper around directive for HAMT insertion */
@@ -226,11 +237,15 @@ yasm_object_create(const char *src_filename, const char *obj_filename,
     object->global_prefix = yasm__xstrdup("");
     object->global_suffix = yasm__xstrdup("");
 
+    /* Debugging sections are not compressed unless requested */
+    object->debug_compress = YASM_DEBUG_COMPRESS_NONE;
+
     /* Create empty symbol table */
     object->symtab = yasm_symtab_create();
 
-    /* Initialize sections linked list */
+    /* Initialize sections linked list and name map */
     STAILQ_INIT(&object->sections);
+    object->section_map = yasm_intern_map_create();
 
     /* Create directives HAMT */
     object->directives = HAMT_create(1, yasm_internal_error_);
@@ -315,15 +330,13 @@ yasm_object_get_general(yasm_object *object, const char *name,
 {
     yasm_section *s;
     yasm_bytecode *bc;
+    const char *iname = yasm_intern(name);
+    void **slot = yasm_intern_map_slot(object->section_map, iname);
 
-    /* Search through current sections to see if we already have one with
-     * that name.
-     */
-    STAILQ_FOREACH(s, &object->sections, link) {
-        if (strcmp(s->name, name) == 0) {
-            *isnew = 0;
-            return s;
-        }
+    /* See if we already have a section with that name. */
+    if (*slot) {
+        *isnew = 0;
+        return *slot;
     }
 
     /* No: we have to allocate and create a new one. */
@@ -333,7 +346,8 @@ yasm_object_get_general(yasm_object *object, const char *name,
     STAILQ_INSERT_TAIL(&object->sections, s, link);
 
     s->object = object;
-    s->name = yasm__xstrdup(name);
+    *slot = s;
+    s->name = iname;
     s->assoc_data = NULL;
     s->align = align;
 
@@ -347,7 +361,11 @@ yasm_object_get_general(yasm_object *object, const char *name,
     STAILQ_INSERT_TAIL(&s->bcs, bc, link);
 
     /* Initialize relocs */
-    STAILQ_INIT(&s->relocs);
+    s->relocs = NULL;
+    s->reloc_size = 0;
+    s->num_relocs = 0;
+    s->alloc_relocs = 0;
+    s->relocs_sorted = 1;
     s->destroy_reloc = NULL;
 
     s->code = code;
@@ -475,6 +493,7 @@ yasm_object_destroy(yasm_object *object)
         yasm_section_destroy(cur);
         cur = next;
     }
+    yasm_intern_map_destroy(object->section_map);
 
     /* Delete directives HAMT */
     HAMT_destroy(object->directives, directive_level1_delete);
@@ -559,43 +578,144 @@ yasm_object_sections_traverse(yasm_object *object, /*@null@*/ void *d,
 yasm_section *
 yasm_object_find_general(yasm_object *object, const char *name)
 {
-    yasm_section *cur;
-
-    STAILQ_FOREACH(cur, &object->sections, link) {
-        if (strcmp(cur->name, name) == 0)
-            return cur;
-    }
-    return NULL;
+    const char *iname = yasm_intern_find(name);
+    if (!iname)
+        return NULL;
+    return yasm_intern_map_get(object->section_map, iname);
 }
 /*@=onlytrans@*/
 
-void
-yasm_section_add_reloc(yasm_section *sect, yasm_reloc *reloc,
-                       void (*destroy_func) (/*@only@*/ void *reloc))
+yasm_reloc *
+yasm_section_add_reloc(yasm_section *sect, const yasm_reloc *reloc,
+                       size_t size, void (*destroy_func) (void *reloc))
 {
-    STAILQ_INSERT_TAIL(&sect->relocs, reloc, link);
-    if (!destroy_func)
-        yasm_internal_error(N_("NULL destroy function given to add_reloc"));
-    else if (sect->destroy_reloc && destroy_func != sect->destroy_reloc)
+    yasm_reloc *r;
+
+    if (size < sizeof(yasm_reloc))
+        yasm_internal_error(N_("reloc size too small in add_reloc"));
+    if (sect->num_relocs == 0) {
+        sect->reloc_size = size;
+        sect->destroy_reloc = destroy_func;
+    } else if (size != sect->reloc_size)
+        yasm_internal_error(N_("different reloc size given to add_reloc"));
+    else if (destroy_func != sect->destroy_reloc)
         yasm_internal_error(N_("different destroy function given to add_reloc"));
-    sect->destroy_reloc = destroy_func;
+
+    if (sect->num_relocs >= sect->alloc_relocs) {
+        sect->alloc_relocs = sect->alloc_relocs ? sect->alloc_relocs*2 : 64;
+        sect->relocs = yasm_xrealloc(sect->relocs,
+                                     sect->alloc_relocs*sect->reloc_size);
+    }
+
+    r = (yasm_reloc *)(sect->relocs + sect->num_relocs*sect->reloc_size);
+    if (sect->num_relocs > 0 && sect->relocs_sorted &&
+        reloc->addr < ((yasm_reloc *)((unsigned char *)r - size))->addr)
+        sect->relocs_sorted = 0;
+    memcpy(r, reloc, size);
+    sect->num_relocs++;
+    return r;
+}
+
+unsigned long
+yasm_section_num_relocs(const yasm_section *sect)
+{
+    return sect->num_relocs;
 }
 
 /*@null@*/ yasm_reloc *
 yasm_section_relocs_first(yasm_section *sect)
 {
-    return STAILQ_FIRST(&sect->relocs);
+    if (sect->num_relocs == 0)
+        return NULL;
+    return (yasm_reloc *)sect->relocs;
 }
 
-#undef yasm_section_reloc_next
 /*@null@*/ yasm_reloc *
-yasm_section_reloc_next(yasm_reloc *reloc)
+yasm_section_reloc_next(yasm_section *sect, yasm_reloc *reloc)
 {
-    return STAILQ_NEXT(reloc, link);
+    unsigned char *next = (unsigned char *)reloc + sect->reloc_size;
+    if (next >= sect->relocs + sect->num_relocs*sect->reloc_size)
+        return NULL;
+    return (yasm_reloc *)next;
 }
 
+/* LSD radix sort on the address, one byte per pass.  Passes over address
+ * bytes that are zero in every relocation are skipped.
+ */
 void
-yasm_reloc_get(yasm_reloc *reloc, yasm_intnum **addrp, yasm_symrec **symp)
+yasm_section_relocs_sort(yasm_section *sect)
+{
+    unsigned long count[256];
+    unsigned long i, n = sect->num_relocs, maxaddr = 0;
+    size_t size = sect->reloc_size;
+    unsigned char *src = sect->relocs, *dst, *tmp;
+    unsigned int shift;
+
+    if (sect->relocs_sorted || n < 2)
+        return;
+
+    for (i=0; i<n; i++) {
+        unsigned long addr = ((yasm_reloc *)(src + i*size))->addr;
+        if (addr > maxaddr)
+            maxaddr = addr;
+    }
+
+    dst = yasm_xmalloc(n*size);
+    for (shift=0; shift < sizeof(unsigned long)*CHAR_BIT &&
+         (maxaddr >> shift) != 0; shift += 8) {
+        unsigned long sum = 0;
+
+        memset(count, 0, sizeof(count));
+        for (i=0; i<n; i++)
+            count[(((yasm_reloc *)(src + i*size))->addr >> shift) & 0xFF]++;
+        for (i=0; i<256; i++) {
+            unsigned long c = count[i];
+            count[i] = sum;
+            sum += c;
+        }
+        for (i=0; i<n; i++) {
+            unsigned char *r = src + i*size;
+            memcpy(dst + size*count[(((yasm_reloc *)r)->addr >> shift) & 0xFF]++,
+                   r, size);
+        }
+        tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    /* src now holds the sorted relocations; free the other buffer */
+    yasm_xfree(dst);
+    sect->relocs = src;
+    sect->alloc_relocs = n;
+    sect->relocs_sorted = 1;
+}
+
+unsigned long
+yasm_section_relocs_write(yasm_section *sect, FILE *f, size_t entry_size,
+                          yasm_reloc_write_func func, void *d)
+{
+    unsigned char buf[RELOC_WRITE_BUFSIZE];
+    unsigned long i, per_block, total = 0;
+
+    if (entry_size == 0 || entry_size > RELOC_WRITE_BUFSIZE)
+        yasm_internal_error(N_("bad entry size in relocs_write"));
+    per_block = RELOC_WRITE_BUFSIZE / entry_size;
+
+    for (i=0; i<sect->num_relocs; ) {
+        unsigned long j, nblock = sect->num_relocs - i;
+        if (nblock > per_block)
+            nblock = per_block;
+        for (j=0; j<nblock; j++, i++)
+            func((yasm_reloc *)(sect->relocs + i*sect->reloc_size),
+                 buf + j*entry_size, d);
+        fwrite(buf, entry_size, nblock, f);
+        total += nblock*entry_size;
+    }
+    return total;
+}
+
+void
+yasm_reloc_get(yasm_reloc *reloc, unsigned long *addrp, yasm_symrec **symp)
 {
     *addrp = reloc->addr;
     *symp = reloc->sym;
@@ -651,6 +771,144 @@ yasm_section_bcs_traverse(yasm_section *sect,
     return 0;
 }
 
+void
+yasm_section_tobytes(yasm_section *sect, yasm_errwarns *errwarns,
+                     const char *gap_warning, void *d,
+                     yasm_output_value_func output_value,
+                     yasm_output_reloc_func output_reloc,
+                     yasm_section_contents *contents)
+{
+    yasm_bytecode *cur = STAILQ_FIRST(&sect->bcs), *bc;
+    unsigned char *buf;
+    unsigned long alloc = 0, pos = 0, offset = 0, alloc_gaps = 0;
+
+    contents->gaps = NULL;
+    contents->num_gaps = 0;
+
+    /* Skip our locally created empty bytecode first. */
+    cur = STAILQ_NEXT(cur, link);
+
+    /* Offsets are final, so the buffer can be sized up front (leaving out
+     * reserved space, which is recorded as gaps) and each bytecode
+     * converted in place.
+     */
+    for (bc = cur; bc; bc = STAILQ_NEXT(bc, link)) {
+        if (bc->callback->special != YASM_BC_SPECIAL_RESERVE)
+            alloc += yasm_bc_next_offset(bc) - bc->offset;
+    }
+    buf = alloc > 0 ? yasm_xmalloc(alloc) : NULL;
+
+    while (cur) {
+        /*@null@*/ /*@only@*/ unsigned char *bigbuf;
+        unsigned long bcsize = alloc - pos;
+        int gap;
+
+        bigbuf = yasm_bc_tobytes(cur, buf ? buf+pos : NULL, &bcsize, &gap, d,
+                                 output_value, output_reloc);
+
+        if (bcsize > 0 && gap) {
+            yasm_section_gap *last = NULL;
+
+            yasm_warn_set(YASM_WARN_UNINIT_CONTENTS, gap_warning);
+            if (contents->num_gaps > 0)
+                last = &contents->gaps[contents->num_gaps-1];
+            if (last && last->offset+last->size == offset)
+                last->size += bcsize;
+            else {
+                if (contents->num_gaps >= alloc_gaps) {
+                    alloc_gaps = alloc_gaps ? alloc_gaps*2 : 8;
+                    contents->gaps = yasm_xrealloc(contents->gaps,
+                        alloc_gaps*sizeof(yasm_section_gap));
+                }
+                last = &contents->gaps[contents->num_gaps++];
+                last->offset = offset;
+                last->size = bcsize;
+            }
+        } else if (bcsize > 0) {
+            if (bcsize > alloc - pos) {
+                /* Only if the bytecode didn't match its optimized length */
+                alloc = pos + bcsize;
+                buf = yasm_xrealloc(buf, alloc);
+            }
+            if (bigbuf)
+                memcpy(buf+pos, bigbuf, bcsize);
+            pos += bcsize;
+        }
+        offset += bcsize;
+
+        if (bigbuf)
+            yasm_xfree(bigbuf);
+
+        yasm_errwarn_propagate(errwarns, cur->line);
+        cur = STAILQ_NEXT(cur, link);
+    }
+
+    if (pos == 0 && buf) {
+        yasm_xfree(buf);
+        buf = NULL;
+    }
+    contents->data = buf;
+    contents->size = offset;
+}
+
+void
+yasm_section_contents_write(const yasm_section_contents *contents, FILE *f)
+{
+    static const unsigned char zeros[4096] = {0};
+    unsigned long i, pos = 0, offset = 0;
+
+    for (i=0; i<contents->num_gaps; i++) {
+        const yasm_section_gap *gap = &contents->gaps[i];
+        unsigned long left = gap->size;
+
+        if (gap->offset > offset) {
+            fwrite(contents->data+pos, gap->offset-offset, 1, f);
+            pos += gap->offset-offset;
+        }
+        while (left > sizeof(zeros)) {
+            fwrite(zeros, sizeof(zeros), 1, f);
+            left -= sizeof(zeros);
+        }
+        fwrite(zeros, left, 1, f);
+        offset = gap->offset + gap->size;
+    }
+    if (contents->size > offset)
+        fwrite(contents->data+pos, contents->size-offset, 1, f);
+}
+
+void
+yasm_section_contents_copy(const yasm_section_contents *contents,
+                           unsigned char *buf)
+{
+    unsigned long i, pos = 0, offset = 0;
+
+    for (i=0; i<contents->num_gaps; i++) {
+        const yasm_section_gap *gap = &contents->gaps[i];
+
+        if (gap->offset > offset) {
+            memcpy(buf+offset, contents->data+pos, gap->offset-offset);
+            pos += gap->offset-offset;
+        }
+        memset(buf+gap->offset, 0, gap->size);
+        offset = gap->offset + gap->size;
+    }
+    if (contents->size > offset)
+        memcpy(buf+offset, contents->data+pos, contents->size-offset);
+}
+
+void
+yasm_section_contents_delete(yasm_section_contents *contents)
+{
+    if (contents->data)
+        yasm_xfree(contents->data);
+    if (contents->gaps)
+        yasm_xfree(contents->gaps);
+    contents->data = NULL;
+    contents->size = 0;
+    contents->gaps = NULL;
+    contents->num_gaps = 0;
+}
+
 const char *
 yasm_section_get_name(const yasm_section *sect)
 {
@@ -674,12 +932,11 @@ static void
 yasm_section_destroy(yasm_section *sect)
 {
     yasm_bytecode *cur, *next;
-    yasm_reloc *r_cur, *r_next;
+    unsigned long i;
 
     if (!sect)
         return;
 
-    yasm_xfree(sect->name);
     yasm__assoc_data_destroy(sect->assoc_data);
 
     /* Delete bytecodes */
@@ -691,13 +948,12 @@ yasm_section_destroy(yasm_section *sect)
     }
 
     /* Delete relocations */
-    r_cur = STAILQ_FIRST(&sect->relocs);
-    while (r_cur) {
-        r_next = STAILQ_NEXT(r_cur, link);
-        yasm_intnum_destroy(r_cur->addr);
-        sect->destroy_reloc(r_cur);
-        r_cur = r_next;
+    if (sect->destroy_reloc) {
+        for (i=0; i<sect->num_relocs; i++)
+            sect->destroy_reloc(sect->relocs + i*sect->reloc_size);
     }
+    if (sect->relocs)
+        yasm_xfree(sect->relocs);
 
     yasm_xfree(sect);
 }
@@ -930,6 +1186,7 @@ optimize_add_span(void *add_span_data, yasm_bytecode *bc, int id,
     yasm_span *span;
     span = create_span(bc, id, value, neg_thres, pos_thres, optd->os);
     TAILQ_INSERT_TAIL(&optd->spans, span, link);
+    yasm_stats_counters.spans++;
 }
 
 static void
@@ -1318,6 +1575,7 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
     optd.os = os;
 
     /* Step 1a */
+    yasm_trace_begin("optimize", "step 1a");
     STAILQ_FOREACH(sect, &object->sections, link) {
         unsigned long offset = 0;
 
@@ -1366,6 +1624,7 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
             bc = STAILQ_NEXT(bc, link);
         }
     }
+    yasm_trace_end();
 
     if (saw_error) {
         optimize_cleanup(&optd);
@@ -1373,6 +1632,7 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
     }
 
     /* Step 1b */
+    yasm_trace_begin("optimize", "step 1b");
     TAILQ_FOREACH_SAFE(span, &optd.spans, link, span_temp) {
         span_create_terms(span);
         if (yasm_error_occurred()) {
@@ -1400,6 +1660,7 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
         }
         span->cur_val = span->new_val;
     }
+    yasm_trace_end();
 
     if (saw_error) {
         optimize_cleanup(&optd);
@@ -1407,12 +1668,16 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
     }
 
     /* Step 1c */
-    if (update_all_bc_offsets(object, errwarns)) {
+    yasm_trace_begin("optimize", "step 1c");
+    retval = update_all_bc_offsets(object, errwarns);
+    yasm_trace_end();
+    if (retval) {
         optimize_cleanup(&optd);
         return;
     }
 
     /* Step 1d */
+    yasm_trace_begin("optimize", "step 1d");
     STAILQ_INIT(&optd.QB);
     TAILQ_FOREACH(span, &optd.spans, link) {
         yasm_intnum *intn;
@@ -1444,6 +1709,7 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
             span->active = 2;
         }
     }
+    yasm_trace_end();
 
     /* Do we need step 2?  If not, go ahead and exit. */
     if (STAILQ_EMPTY(&optd.QB)) {
@@ -1461,12 +1727,14 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
     }
 
     /* Build up interval tree */
+    yasm_trace_begin("optimize", "interval tree");
     TAILQ_FOREACH(span, &optd.spans, link) {
         for (i=0; i<span->num_terms; i++)
             optimize_itree_add(optd.itree, span, &span->terms[i]);
         if (span->rel_term)
             optimize_itree_add(optd.itree, span, span->rel_term);
     }
+    IT_build(optd.itree);
 
     /* Look for cycles in times expansion (span.id==0) */
     TAILQ_FOREACH(span, &optd.spans, link) {
@@ -1480,6 +1748,7 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
             saw_error = 1;
         }
     }
+    yasm_trace_end();
 
     if (saw_error) {
         optimize_cleanup(&optd);
@@ -1487,6 +1756,7 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
     }
 
     /* Step 2 */
+    yasm_trace_begin("optimize", "step 2");
     STAILQ_INIT(&optd.QA);
     while (!STAILQ_EMPTY(&optd.QA) || !(STAILQ_EMPTY(&optd.QB))) {
         unsigned long orig_len;
@@ -1521,6 +1791,7 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
                                 span->new_val, &span->neg_thres,
                                 &span->pos_thres);
         yasm_errwarn_propagate(errwarns, span->bc->line);
+        yasm_stats_counters.expansions++;
 
         if (retval < 0) {
             /* error */
@@ -1576,6 +1847,7 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
             os = STAILQ_NEXT(os, link);
         }
     }
+    yasm_trace_end();
 
     if (saw_error) {
         optimize_cleanup(&optd);
@@ -1583,6 +1855,8 @@ yasm_object_optimize(yasm_object *object, yasm_errwarns *errwarns)
     }
 
     /* Step 3 */
+    yasm_trace_begin("optimize", "step 3");
     update_all_bc_offsets(object, errwarns);
+    yasm_trace_end();
     optimize_cleanup(&optd);
 }
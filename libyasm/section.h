@@ -35,16 +35,45 @@
 #endif
 
 /** Basic YASM relocation.  Object formats will need to extend this
- * structure with additional fields for relocation type, etc.
+ * structure with additional fields for relocation type, etc.  Relocations
+ * are stored by value in a per-section array, so the extended structure
+ * must not be self-referential.
  */
 typedef struct yasm_reloc yasm_reloc;
 
 struct yasm_reloc {
-    /*@reldef@*/ STAILQ_ENTRY(yasm_reloc) link; /**< Link to next reloc */
-    yasm_intnum *addr;          /**< Offset (address) within section */
+    unsigned long addr;         /**< Offset (address) within section */
     /*@dependent@*/ yasm_symrec *sym;       /**< Relocated symbol */
 };
 
+/** Relocation serialization function for yasm_section_relocs_write().
+ * \param reloc     relocation
+ * \param buf       output buffer (entry_size bytes)
+ * \param d         data passed to yasm_section_relocs_write()
+ */
+typedef void (*yasm_reloc_write_func)
+    (yasm_reloc *reloc, unsigned char *buf, void *d);
+
+/** Run of uninitialized (zero) bytes in rendered section contents. */
+typedef struct yasm_section_gap {
+    unsigned long offset;       /**< Offset of gap within section */
+    unsigned long size;         /**< Size of gap in bytes */
+} yasm_section_gap;
+
+/** Section contents rendered by yasm_section_tobytes().  Gaps (e.g. from
+ * reserve bytecodes) are not stored in the data buffer, so that large
+ * reserved areas don't need to be held in memory; they are listed
+ * separately and read as zeros.
+ */
+typedef struct yasm_section_contents {
+    /** Bytes of everything but the gaps, in section order; NULL if none. */
+    /*@null@*/ /*@only@*/ unsigned char *data;
+    unsigned long size;         /**< Total size (including gaps) */
+    /** Gaps, in ascending order of offset; NULL if none. */
+    /*@null@*/ /*@only@*/ yasm_section_gap *gaps;
+    unsigned long num_gaps;     /**< Number of gaps */
+} yasm_section_contents;
+
 /** Structure of functions that can be overridden
  */
 typedef struct yasm_overrides {
@@ -54,6 +83,13 @@ typedef struct yasm_overrides {
     (*value_finalize)(yasm_value *value, yasm_bytecode *precbc);
 } yasm_overrides;
 
+/** Compression methods for debugging information sections. */
+typedef enum yasm_debug_compress {
+    YASM_DEBUG_COMPRESS_NONE = 0,   /**< Uncompressed */
+    YASM_DEBUG_COMPRESS_ZLIB,       /**< zlib (deflate) */
+    YASM_DEBUG_COMPRESS_ZSTD        /**< Zstandard */
+} yasm_debug_compress;
+
 /** An object.  This is the internal representation of an object file. */
 struct yasm_object {
     /*@owned@*/ char *src_filename;     /**< Source filename */
@@ -73,6 +109,9 @@ struct yasm_object {
     /** Linked list of sections. */
     /*@reldef@*/ STAILQ_HEAD(yasm_sectionhead, yasm_section) sections;
 
+    /** Sections indexed by (interned) name. */
+    /*@owned@*/ struct yasm_intern_map *section_map;
+
     /** Directives, organized as two level HAMT; first level is parser,
      * second level is directive name.
      */
@@ -83,6 +122,11 @@ struct yasm_object {
 
     /** Suffix appended to externally-visible symbols (empty string if none) */
     /*@owned@*/ char *global_suffix;
+
+    /** Compression for debugging sections, honored by object formats that
+     * support it (YASM_DEBUG_COMPRESS_NONE by default).
+     */
+    yasm_debug_compress debug_compress;
 };
 
 /** Create a new object.  A default section is created as the first section.
@@ -276,16 +320,27 @@ void yasm_section_add_data(yasm_section *sect,
 
 /** Add a relocation to a section.
  * \param sect          section
- * \param reloc         relocation
- * \param destroy_func  function that can destroy the relocation
- * \note Does not make a copy of reloc.  The same destroy_func must be
+ * \param reloc         relocation (object format extended structure)
+ * \param size          size of the extended relocation structure
+ * \param destroy_func  function that destroys any data owned by the
+ *                      relocation (but not the relocation itself); may be
+ *                      NULL
+ * \return Stored copy of the relocation; valid until the next relocation is
+ *         added to the section.
+ * \note Makes a copy of reloc.  The same size and destroy_func must be
  * used for all relocations in a section or an internal error will occur.
- * The section will destroy the relocation address; it is the caller's
- * responsibility to destroy any other allocated data.
  */
 YASM_LIB_DECL
-void yasm_section_add_reloc(yasm_section *sect, yasm_reloc *reloc,
-    void (*destroy_func) (/*@only@*/ void *reloc));
+yasm_reloc *yasm_section_add_reloc
+    (yasm_section *sect, const yasm_reloc *reloc, size_t size,
+     /*@null@*/ void (*destroy_func) (void *reloc));
+
+/** Get the number of relocations in a section.
+ * \param sect          section
+ * \return Number of relocations.
+ */
+YASM_LIB_DECL
+unsigned long yasm_section_num_relocs(const yasm_section *sect);
 
 /** Get the first relocation for a section.
  * \param sect          section
@@ -295,13 +350,37 @@ YASM_LIB_DECL
 /*@null@*/ yasm_reloc *yasm_section_relocs_first(yasm_section *sect);
 
 /** Get the next relocation for a section.
+ * \param sect          section
  * \param reloc         previous relocation
  * \return Next relocation for section.  NULL if no more relocations.
  */
-/*@null@*/ yasm_reloc *yasm_section_reloc_next(yasm_reloc *reloc);
-#ifndef YASM_DOXYGEN
-#define yasm_section_reloc_next(x)      STAILQ_NEXT((x), link)
-#endif
+YASM_LIB_DECL
+/*@null@*/ yasm_reloc *yasm_section_reloc_next(yasm_section *sect,
+                                              yasm_reloc *reloc);
+
+/** Sort the relocations of a section by ascending address.  The sort is
+ * stable, so relocations at the same address keep the order they were
+ * added in.  Does nothing if the relocations are already in order (the
+ * usual case, as relocations are generated while walking the section).
+ * \param sect          section
+ */
+YASM_LIB_DECL
+void yasm_section_relocs_sort(yasm_section *sect);
+
+/** Serialize all relocations of a section to a file.  Each relocation is
+ * converted by func into a fixed-size entry; the entries are collected
+ * into blocks and written with one fwrite() per block.
+ * \param sect          section
+ * \param f             output file
+ * \param entry_size    size of each serialized relocation, in bytes
+ * \param func          serialization function
+ * \param d             data to pass to func
+ * \return Total number of bytes written.
+ */
+YASM_LIB_DECL
+unsigned long yasm_section_relocs_write
+    (yasm_section *sect, FILE *f, size_t entry_size,
+     yasm_reloc_write_func func, /*@null@*/ void *d);
 
 /** Get the basic relocation information for a relocation.
  * \param reloc         relocation
@@ -309,7 +388,7 @@ YASM_LIB_DECL
  * \param symp          relocated symbol (returned)
  */
 YASM_LIB_DECL
-void yasm_reloc_get(yasm_reloc *reloc, yasm_intnum **addrp,
+void yasm_reloc_get(yasm_reloc *reloc, unsigned long *addrp,
                     /*@dependent@*/ yasm_symrec **symp);
 
 /** Get the first bytecode in a section.
@@ -357,9 +436,57 @@ int yasm_section_bcs_traverse
     (yasm_section *sect, /*@null@*/ yasm_errwarns *errwarns,
      /*@null@*/ void *d, int (*func) (yasm_bytecode *bc, /*@null@*/ void *d));
 
+/** Convert all bytecodes in a section to bytes in memory.  This renders
+ * the section contents independently of the object format's file layout;
+ * the object format can then place them wherever it likes.  Bytecodes are
+ * converted in order with yasm_bc_tobytes(); gaps (e.g. from reserve
+ * bytecodes) are recorded as zero runs after issuing a warning.
+ * \param sect          section
+ * \param errwarns      error/warning set; yasm_errwarn_propagate() is
+ *                      called after each bytecode (with its line number)
+ * \param gap_warning   warning message for zero-filled gaps
+ * \param d             data to pass to output_value and output_reloc
+ * \param output_value  function to call to convert values into their byte
+ *                      representation
+ * \param output_reloc  function to call to output relocation entries
+ *                      for a single sym (may be NULL)
+ * \param contents      section contents (returned); free with
+ *                      yasm_section_contents_delete()
+ */
+YASM_LIB_DECL
+void yasm_section_tobytes
+    (yasm_section *sect, yasm_errwarns *errwarns, const char *gap_warning,
+     /*@null@*/ void *d, yasm_output_value_func output_value,
+     /*@null@*/ yasm_output_reloc_func output_reloc,
+     /*@out@*/ yasm_section_contents *contents);
+
+/** Write rendered section contents to a file.  Gaps are written as zeros,
+ * a block at a time.
+ * \param contents      section contents
+ * \param f             file
+ */
+YASM_LIB_DECL
+void yasm_section_contents_write(const yasm_section_contents *contents,
+                                 FILE *f);
+
+/** Copy rendered section contents, with gaps zero-filled, into a buffer.
+ * \param contents      section contents
+ * \param buf           buffer (at least contents->size bytes)
+ */
+YASM_LIB_DECL
+void yasm_section_contents_copy(const yasm_section_contents *contents,
+                                /*@out@*/ unsigned char *buf);
+
+/** Free the data and gap list of rendered section contents.  The contents
+ * are left empty.
+ * \param contents      section contents
+ */
+YASM_LIB_DECL
+void yasm_section_contents_delete(yasm_section_contents *contents);
+
 /** Get name of a section.
  * \param   sect    section
- * \return Section name.
+ * \return Section name (an interned string; see yasm_intern()).
  */
 YASM_LIB_DECL
 /*@observer@*/ const char *yasm_section_get_name(const yasm_section *sect);
@@ -0,0 +1,149 @@
+/*
+ * Assembly statistics counters and event tracing
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util.h"
+
+#include <time.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+
+#include "stats.h"
+
+
+YASM_LIB_DECL
+yasm_stats yasm_stats_counters = {0, 0, 0};
+
+void
+yasm_stats_reset(void)
+{
+    yasm_stats_counters.exprs = 0;
+    yasm_stats_counters.spans = 0;
+    yasm_stats_counters.expansions = 0;
+}
+
+double
+yasm_stats_wall_time(void)
+{
+#ifdef HAVE_GETTIMEOFDAY
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec/1000000.0;
+#else
+    return (double)time(NULL);
+#endif
+}
+
+/* Trace output state.  Only one trace may be active at a time. */
+static /*@null@*/ /*@dependent@*/ FILE *trace_file = NULL;
+static double trace_start;      /* wall time of yasm_trace_open() */
+static unsigned int trace_track = 0;
+static unsigned long trace_depth = 0;   /* open spans on current track */
+static int trace_first = 1;     /* no events written yet */
+
+static void
+trace_write_string(const char *str)
+{
+    fputc('"', trace_file);
+    for (; *str; str++) {
+        unsigned char c = (unsigned char)*str;
+        if (c == '"' || c == '\\')
+            fprintf(trace_file, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(trace_file, "\\u%04x", c);
+        else
+            fputc(c, trace_file);
+    }
+    fputc('"', trace_file);
+}
+
+static void
+trace_event_start(char ph)
+{
+    fputs(trace_first ? "[\n" : ",\n", trace_file);
+    trace_first = 0;
+    fprintf(trace_file, "{\"ph\":\"%c\",\"pid\":1,\"tid\":%u,\"ts\":%.3f", ph,
+            trace_track, (yasm_stats_wall_time() - trace_start)*1000000.0);
+}
+
+void
+yasm_trace_open(FILE *f)
+{
+    trace_file = f;
+    trace_start = yasm_stats_wall_time();
+    trace_track = 0;
+    trace_depth = 0;
+    trace_first = 1;
+}
+
+void
+yasm_trace_close(void)
+{
+    if (!trace_file)
+        return;
+    while (trace_depth > 0)
+        yasm_trace_end();
+    fputs(trace_first ? "[]\n" : "\n]\n", trace_file);
+    trace_file = NULL;
+}
+
+void
+yasm_trace_set_track(unsigned int track, const char *name)
+{
+    if (!trace_file)
+        return;
+    while (trace_depth > 0)
+        yasm_trace_end();
+    trace_track = track;
+    trace_event_start('M');
+    fputs(",\"name\":\"thread_name\",\"args\":{\"name\":", trace_file);
+    trace_write_string(name);
+    fputs("}}", trace_file);
+}
+
+void
+yasm_trace_begin(const char *cat, const char *name)
+{
+    if (!trace_file)
+        return;
+    trace_event_start('B');
+    fputs(",\"cat\":", trace_file);
+    trace_write_string(cat);
+    fputs(",\"name\":", trace_file);
+    trace_write_string(name);
+    fputc('}', trace_file);
+    trace_depth++;
+}
+
+void
+yasm_trace_end(void)
+{
+    if (!trace_file || trace_depth == 0)
+        return;
+    trace_event_start('E');
+    fputc('}', trace_file);
+    trace_depth--;
+}
@@ -0,0 +1,96 @@
+/**
+ * \file libyasm/stats.h
+ * \brief YASM assembly statistics counters and event tracing.
+ *
+ * \license
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ * \endlicense
+ */
+#ifndef YASM_STATS_H
+#define YASM_STATS_H
+
+#ifndef YASM_LIB_DECL
+#define YASM_LIB_DECL
+#endif
+
+/** Counters of internal libyasm activity, for performance reporting.
+ * These are only ever incremented by libyasm; a frontend may read them
+ * (e.g. after each assembly phase) or reset them with yasm_stats_reset().
+ */
+typedef struct yasm_stats {
+    unsigned long exprs;            /**< Expressions allocated */
+    unsigned long spans;            /**< Optimizer spans created */
+    unsigned long expansions;       /**< Optimizer span expansions */
+} yasm_stats;
+
+/** Global statistics counters. */
+YASM_LIB_DECL
+extern yasm_stats yasm_stats_counters;
+
+/** Reset all statistics counters to zero. */
+YASM_LIB_DECL
+void yasm_stats_reset(void);
+
+/** Get the current wall-clock time.
+ * \return Time in seconds since an arbitrary epoch.
+ */
+YASM_LIB_DECL
+double yasm_stats_wall_time(void);
+
+/** Start writing trace events to a file.  Events are written in the
+ * Trace Event Format (a JSON array) understood by chrome://tracing and
+ * Perfetto.  Until this is called, the other yasm_trace functions do
+ * nothing.
+ * \param f    file to write trace to
+ */
+YASM_LIB_DECL
+void yasm_trace_open(FILE *f);
+
+/** Finish writing trace events.  Any spans still open are ended.  The
+ * file passed to yasm_trace_open() is not closed.
+ */
+YASM_LIB_DECL
+void yasm_trace_close(void);
+
+/** Select the track that subsequent events are recorded on.  Each track is
+ * shown as a separate timeline (thread) in the trace viewer.
+ * \param track        track number
+ * \param name         track name shown in viewer
+ */
+YASM_LIB_DECL
+void yasm_trace_set_track(unsigned int track, const char *name);
+
+/** Begin a trace span.  Spans nest, and are ended by yasm_trace_end() in
+ * last-in, first-out order.
+ * \param cat          category (e.g. "optimize")
+ * \param name         span name (e.g. a filename or macro name)
+ */
+YASM_LIB_DECL
+void yasm_trace_begin(const char *cat, const char *name);
+
+/** End the most recently begun trace span. */
+YASM_LIB_DECL
+void yasm_trace_end(void);
+
+#endif
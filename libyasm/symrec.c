@@ -27,17 +27,16 @@
 #include "util.h"
 
 #include <limits.h>
-#include <ctype.h>
 
 #include "libyasm-stdint.h"
 #include "coretype.h"
 #include "valparam.h"
-#include "hamt.h"
 #include "assocdat.h"
 
 #include "errwarn.h"
 #include "intnum.h"
 #include "floatnum.h"
+#include "intern.h"
 #include "expr.h"
 #include "symrec.h"
 
@@ -57,85 +56,112 @@ typedef enum {
                                    purpose */
 } sym_type;
 
+/* Symbol data that is rarely set; allocated on demand. */
+typedef struct symrec_extra {
+    /* expanded and simplified equ value; NULL if not yet computed */
+    /*@null@*/ /*@owned@*/ yasm_expr *equ_cache;
+    /*@null@*/ /*@owned@*/ yasm_valparamhead *objext_valparams;
+    /*@null@*/ /*@owned@*/ yasm_expr *common_size;
+    unsigned int size;          /* 0 if not user-defined */
+    const char *segment;        /* for segmented systems like DOS */
+
+    /* associated data other than that in the symbol's data slot */
+    /*@null@*/ /*@only@*/ yasm__assoc_data *assoc_data;
+} symrec_extra;
+
+/* Symbol data not needed while traversing the symbol table; kept in a
+ * side table (see symrec_chunk).
+ */
+typedef struct symrec_info {
+    unsigned long def_line;     /* line where symbol was first defined */
+    unsigned long decl_line;    /* line where symbol was first declared */
+    unsigned long use_line;     /* line where symbol was first used */
+    /*@null@*/ /*@owned@*/ symrec_extra *extra;
+} symrec_info;
+
 struct yasm_symrec {
-    char *name;
+    const char *name;
     sym_type type;
     yasm_sym_status status;
     yasm_sym_vis visibility;
-    unsigned long def_line;     /* line where symbol was first defined */
-    unsigned long decl_line;    /* line where symbol was first declared */
-    unsigned long use_line;     /* line where symbol was first used */
     union {
         yasm_expr *expn;        /* equ value */
 
         /* bytecode immediately preceding a label */
         /*@dependent@*/ yasm_bytecode *precbc;
     } value;
-    unsigned int size;          /* 0 if not user-defined */
-    const char *segment;        /* for segmented systems like DOS */
 
-    /* associated data; NULL if none */
-    /*@null@*/ /*@only@*/ yasm__assoc_data *assoc_data;
-};
+    /* Associated data slot.  This is claimed by the first callback to add
+     * data to the symbol (in practice, the object format); any other
+     * associated data goes in info->extra->assoc_data.
+     */
+    /*@null@*/ const yasm_assoc_data_callback *data_cb;
+    /*@null@*/ /*@owned@*/ void *data;
 
-/* Linked list of symbols not in the symbol table. */
-typedef struct non_table_symrec_s {
-     /*@reldef@*/ SLIST_ENTRY(non_table_symrec_s) link;
-     /*@owned@*/ yasm_symrec *rec;
-} non_table_symrec;
+    /*@dependent@*/ symrec_info *info;
 
-struct yasm_symtab {
-    /* The symbol table: a hash array mapped trie (HAMT). */
-    /*@only@*/ HAMT *sym_table;
-    /* Symbols not in the table */
-    SLIST_HEAD(nontablesymhead_s, non_table_symrec_s) non_table_syms;
-
-    int case_sensitive;
+    /* next symbol in symbol table, in order of creation */
+    /*@null@*/ /*@dependent@*/ yasm_symrec *next;
 };
 
-static void
-objext_valparams_destroy(void *data)
-{
-    yasm_vps_destroy((yasm_valparamhead *)data);
-}
+/* Symbols (both in and not in the table) are allocated from chunks owned by
+ * the symbol table, so that symbols created together are adjacent in memory,
+ * and are only freed when the symbol table is destroyed.
+ */
+#define SYMREC_CHUNK_SIZE   256
 
-static void
-objext_valparams_print(void *data, FILE *f, int indent_level)
-{
-    yasm_vps_print((yasm_valparamhead *)data, f);
-}
+typedef struct symrec_chunk {
+    /*@null@*/ /*@owned@*/ struct symrec_chunk *next;
+    yasm_symrec recs[SYMREC_CHUNK_SIZE];
+    symrec_info info[SYMREC_CHUNK_SIZE];
+} symrec_chunk;
 
-static yasm_assoc_data_callback objext_valparams_cb = {
-    objext_valparams_destroy,
-    objext_valparams_print
-};
+/* Hash table slot.  Empty slots have a NULL sym. */
+typedef struct symtab_slot {
+    unsigned long hash;
+    /*@null@*/ /*@dependent@*/ yasm_symrec *sym;
+} symtab_slot;
 
-static void
-common_size_destroy(void *data)
-{
-    yasm_expr **e = (yasm_expr **)data;
-    yasm_expr_destroy(*e);
-    yasm_xfree(data);
-}
+#define SYMTAB_INITIAL_SLOTS    256
 
-static void
-common_size_print(void *data, FILE *f, int indent_level)
-{
-    yasm_expr **e = (yasm_expr **)data;
-    yasm_expr_print(*e, f);
-}
+struct yasm_symtab {
+    /* The symbol table: an open addressing (linear probing) hash table,
+     * keyed by interned symbol name (lowercased if the table is case
+     * insensitive).  nslots is a power of 2 and the table is kept at most
+     * 3/4 full.
+     */
+    /*@only@*/ symtab_slot *slots;
+    unsigned long nslots;
+    unsigned long nsyms;
 
-static yasm_assoc_data_callback common_size_cb = {
-    common_size_destroy,
-    common_size_print
+    /* Symbols in the table, in order of creation.  Traversal follows this
+     * order so that output doesn't depend on the hash function.
+     */
+    /*@null@*/ /*@owned@*/ yasm_symrec *first;
+    /*@dependent@*/ yasm_symrec **last_next;
+
+    /* Symbol storage; only the first chunk may be partially used */
+    /*@null@*/ /*@owned@*/ symrec_chunk *chunks;
+    unsigned int chunk_used;
+
+    int case_sensitive;
 };
 
 yasm_symtab *
 yasm_symtab_create(void)
 {
     yasm_symtab *symtab = yasm_xmalloc(sizeof(yasm_symtab));
-    symtab->sym_table = HAMT_create(0, yasm_internal_error_);
-    SLIST_INIT(&symtab->non_table_syms);
+    unsigned long i;
+
+    symtab->nslots = SYMTAB_INITIAL_SLOTS;
+    symtab->slots = yasm_xmalloc(symtab->nslots*sizeof(symtab_slot));
+    for (i=0; i<symtab->nslots; i++)
+        symtab->slots[i].sym = NULL;
+    symtab->nsyms = 0;
+    symtab->first = NULL;
+    symtab->last_next = &symtab->first;
+    symtab->chunks = NULL;
+    symtab->chunk_used = SYMREC_CHUNK_SIZE;
     symtab->case_sensitive = 1;
     return symtab;
 }
@@ -147,116 +173,201 @@ yasm_symtab_set_case_sensitive(yasm_symtab *symtab, int sensitive)
 }
 
 static void
-symrec_destroy_one(/*@only@*/ void *d)
+symrec_destroy_one(yasm_symrec *sym)
 {
-    yasm_symrec *sym = d;
-    yasm_xfree(sym->name);
+    symrec_extra *extra = sym->info->extra;
+
     if (sym->type == SYM_EQU && (sym->status & YASM_SYM_VALUED))
         yasm_expr_destroy(sym->value.expn);
-    yasm__assoc_data_destroy(sym->assoc_data);
-    yasm_xfree(sym);
+    if (sym->data_cb)
+        sym->data_cb->destroy(sym->data);
+    if (extra) {
+        if (extra->equ_cache)
+            yasm_expr_destroy(extra->equ_cache);
+        if (extra->objext_valparams)
+            yasm_vps_destroy(extra->objext_valparams);
+        if (extra->common_size)
+            yasm_expr_destroy(extra->common_size);
+        yasm__assoc_data_destroy(extra->assoc_data);
+        yasm_xfree(extra);
+    }
+}
+
+static symrec_extra *
+symrec_get_extra(yasm_symrec *sym)
+{
+    symrec_extra *extra = sym->info->extra;
+
+    if (!extra) {
+        extra = yasm_xmalloc(sizeof(symrec_extra));
+        extra->equ_cache = NULL;
+        extra->objext_valparams = NULL;
+        extra->common_size = NULL;
+        extra->size = 0;
+        extra->segment = NULL;
+        extra->assoc_data = NULL;
+        sym->info->extra = extra;
+    }
+    return extra;
 }
 
 static /*@partial@*/ yasm_symrec *
-symrec_new_common(/*@keep@*/ char *name, int case_sensitive)
+symrec_new_common(yasm_symtab *symtab, /*@dependent@*/ const char *name)
 {
-    yasm_symrec *rec = yasm_xmalloc(sizeof(yasm_symrec));
+    yasm_symrec *rec;
 
-    if (!case_sensitive) {
-        char *c;
-        for (c=name; *c; c++)
-            *c = tolower(*c);
+    if (symtab->chunk_used == SYMREC_CHUNK_SIZE) {
+        symrec_chunk *chunk = yasm_xmalloc(sizeof(symrec_chunk));
+        chunk->next = symtab->chunks;
+        symtab->chunks = chunk;
+        symtab->chunk_used = 0;
     }
+    rec = &symtab->chunks->recs[symtab->chunk_used];
+    rec->info = &symtab->chunks->info[symtab->chunk_used];
+    symtab->chunk_used++;
 
     rec->name = name;
     rec->type = SYM_UNKNOWN;
-    rec->def_line = 0;
-    rec->decl_line = 0;
-    rec->use_line = 0;
     rec->visibility = YASM_SYM_LOCAL;
-    rec->size = 0;
-    rec->segment = NULL;
-    rec->assoc_data = NULL;
+    rec->data_cb = NULL;
+    rec->data = NULL;
+    rec->next = NULL;
+    rec->info->def_line = 0;
+    rec->info->decl_line = 0;
+    rec->info->use_line = 0;
+    rec->info->extra = NULL;
     return rec;
 }
 
+/* Find the slot for an interned name: either the slot holding it or the
+ * empty slot where it would be inserted.
+ */
+static symtab_slot *
+symtab_find_slot(const yasm_symtab *symtab, const char *iname,
+                 unsigned long hash)
+{
+    unsigned long mask = symtab->nslots-1;
+    unsigned long i = hash & mask;
+
+    for (;;) {
+        symtab_slot *slot = &symtab->slots[i];
+        if (!slot->sym || slot->sym->name == iname)
+            return slot;
+        i = (i+1) & mask;
+    }
+}
+
+static void
+symtab_grow(yasm_symtab *symtab)
+{
+    symtab_slot *oldslots = symtab->slots;
+    unsigned long oldnslots = symtab->nslots;
+    unsigned long i, mask;
+
+    symtab->nslots *= 2;
+    mask = symtab->nslots-1;
+    symtab->slots = yasm_xmalloc(symtab->nslots*sizeof(symtab_slot));
+    for (i=0; i<symtab->nslots; i++)
+        symtab->slots[i].sym = NULL;
+
+    for (i=0; i<oldnslots; i++) {
+        unsigned long j;
+        if (!oldslots[i].sym)
+            continue;
+        j = oldslots[i].hash & mask;
+        while (symtab->slots[j].sym)
+            j = (j+1) & mask;
+        symtab->slots[j] = oldslots[i];
+    }
+    yasm_xfree(oldslots);
+}
+
 static /*@partial@*/ /*@dependent@*/ yasm_symrec *
-symtab_get_or_new_in_table(yasm_symtab *symtab, /*@only@*/ char *name)
+symtab_get_or_new_in_table(yasm_symtab *symtab, const char *name)
 {
-    yasm_symrec *rec = symrec_new_common(name, symtab->case_sensitive);
-    int replace = 0;
+    const char *iname = symtab->case_sensitive ? yasm_intern(name)
+                                               : yasm_intern_lower(name);
+    unsigned long hash = yasm_intern_hash(iname);
+    symtab_slot *slot = symtab_find_slot(symtab, iname, hash);
+    yasm_symrec *rec;
+
+    if (slot->sym)
+        return slot->sym;
 
+    rec = symrec_new_common(symtab, iname);
     rec->status = YASM_SYM_NOSTATUS;
 
-    if (!symtab->case_sensitive) {
-        char *c;
-        for (c=name; *c; c++)
-            *c = tolower(*c);
-    }
+    slot->hash = hash;
+    slot->sym = rec;
+    *symtab->last_next = rec;
+    symtab->last_next = &rec->next;
 
-    return HAMT_insert(symtab->sym_table, name, rec, &replace,
-                       symrec_destroy_one);
+    if (++symtab->nsyms > symtab->nslots/4*3)
+        symtab_grow(symtab);
+
+    return rec;
 }
 
 static /*@partial@*/ /*@dependent@*/ yasm_symrec *
-symtab_get_or_new_not_in_table(yasm_symtab *symtab, /*@only@*/ char *name)
+symtab_get_or_new_not_in_table(yasm_symtab *symtab, const char *name)
 {
-    non_table_symrec *sym = yasm_xmalloc(sizeof(non_table_symrec));
-    sym->rec = symrec_new_common(name, symtab->case_sensitive);
-
-    sym->rec->status = YASM_SYM_NOTINTABLE;
-
-    SLIST_INSERT_HEAD(&symtab->non_table_syms, sym, link);
+    yasm_symrec *rec =
+        symrec_new_common(symtab, symtab->case_sensitive ?
+                          yasm_intern(name) : yasm_intern_lower(name));
 
-    return sym->rec;
+    rec->status = YASM_SYM_NOTINTABLE;
+    return rec;
 }
 
 /* create a new symrec */
-/*@-freshtrans -mustfree@*/
 static /*@partial@*/ /*@dependent@*/ yasm_symrec *
 symtab_get_or_new(yasm_symtab *symtab, const char *name, int in_table)
 {
-    char *symname = yasm__xstrdup(name);
-
     if (in_table)
-        return symtab_get_or_new_in_table(symtab, symname);
+        return symtab_get_or_new_in_table(symtab, name);
     else
-        return symtab_get_or_new_not_in_table(symtab, symname);
+        return symtab_get_or_new_not_in_table(symtab, name);
 }
-/*@=freshtrans =mustfree@*/
 
 int
 yasm_symtab_traverse(yasm_symtab *symtab, void *d,
                      int (*func) (yasm_symrec *sym, void *d))
 {
-    return HAMT_traverse(symtab->sym_table, d, (int (*) (void *, void *))func);
+    yasm_symrec *sym;
+
+    for (sym = symtab->first; sym; sym = sym->next) {
+        int retval = func(sym, d);
+        if (retval != 0)
+            return retval;
+    }
+    return 0;
 }
 
 const yasm_symtab_iter *
 yasm_symtab_first(const yasm_symtab *symtab)
 {
-    return (const yasm_symtab_iter *)HAMT_first(symtab->sym_table);
+    return (const yasm_symtab_iter *)symtab->first;
 }
 
 /*@null@*/ const yasm_symtab_iter *
 yasm_symtab_next(const yasm_symtab_iter *prev)
 {
-    return (const yasm_symtab_iter *)HAMT_next((const HAMTEntry *)prev);
+    return (const yasm_symtab_iter *)((const yasm_symrec *)prev)->next;
 }
 
 yasm_symrec *
 yasm_symtab_iter_value(const yasm_symtab_iter *cur)
 {
-    return (yasm_symrec *)HAMTEntry_get_data((const HAMTEntry *)cur);
+    return (yasm_symrec *)cur;
 }
 
 yasm_symrec *
 yasm_symtab_abs_sym(yasm_symtab *symtab)
 {
     yasm_symrec *rec = symtab_get_or_new(symtab, "", 1);
-    rec->def_line = 0;
-    rec->decl_line = 0;
-    rec->use_line = 0;
+    rec->info->def_line = 0;
+    rec->info->decl_line = 0;
+    rec->info->use_line = 0;
     rec->type = SYM_EQU;
     rec->value.expn =
         yasm_expr_create_ident(yasm_expr_int(yasm_intnum_create_uint(0)), 0);
@@ -268,37 +379,40 @@ yasm_symrec *
 yasm_symtab_use(yasm_symtab *symtab, const char *name, unsigned long line)
 {
     yasm_symrec *rec = symtab_get_or_new(symtab, name, 1);
-    if (rec->use_line == 0)
-        rec->use_line = line;   /* set line number of first use */
+    if (rec->info->use_line == 0)
+        rec->info->use_line = line; /* set line number of first use */
     rec->status |= YASM_SYM_USED;
     return rec;
 }
 
 yasm_symrec *
-yasm_symtab_get(yasm_symtab *symtab, const char *name)
+yasm_symtab_use_not_in_table(yasm_symtab *symtab, const char *name,
+                             unsigned long line)
 {
-    if (!symtab->case_sensitive) {
-        char *_name = yasm__xstrdup(name);
-        char *c;
-        yasm_symrec *ret;
-        for (c=_name; *c; c++)
-            *c = tolower(*c);
-        ret = HAMT_search(symtab->sym_table, _name);
-        yasm_xfree(_name);
-        return ret;
-    } else
-      return HAMT_search(symtab->sym_table, name);
+    yasm_symrec *rec = symtab_get_or_new_not_in_table(symtab, name);
+    rec->info->use_line = line;
+    rec->status |= YASM_SYM_USED;
+    return rec;
 }
 
-static /*@dependent@*/ yasm_symrec *
-symtab_define(yasm_symtab *symtab, const char *name, sym_type type,
-              int in_table, unsigned long line)
+yasm_symrec *
+yasm_symtab_get(yasm_symtab *symtab, const char *name)
 {
-    yasm_symrec *rec = symtab_get_or_new(symtab, name, in_table);
+    const char *iname = symtab->case_sensitive ? yasm_intern_find(name)
+                                               : yasm_intern_find_lower(name);
+    if (!iname)
+        return NULL;
+    return symtab_find_slot(symtab, iname, yasm_intern_hash(iname))->sym;
+}
 
+static void
+symrec_define(yasm_symrec *rec, const char *name, sym_type type,
+              unsigned long line)
+{
     /* Has it been defined before (either by DEFINED or COMMON/EXTERN)? */
     if (rec->status & YASM_SYM_DEFINED) {
-        yasm_error_set_xref(rec->def_line!=0 ? rec->def_line : rec->decl_line,
+        yasm_error_set_xref(rec->info->def_line!=0 ? rec->info->def_line
+                                                  : rec->info->decl_line,
                             N_("`%s' previously defined here"), name);
         yasm_error_set(YASM_ERROR_GENERAL, N_("redefinition of `%s'"),
                        name);
@@ -306,12 +420,22 @@ symtab_define(yasm_symtab *symtab, const char *name, sym_type type,
         if (rec->visibility & YASM_SYM_EXTERN)
             yasm_warn_set(YASM_WARN_GENERAL,
                           N_("`%s' both defined and declared extern"), name);
-        rec->def_line = line;   /* set line number of definition */
+        rec->info->def_line = line; /* set line number of definition */
         rec->type = type;
         rec->status |= YASM_SYM_DEFINED;
-        rec->size = 0;
-        rec->segment = NULL;
+        if (rec->info->extra) {
+            rec->info->extra->size = 0;
+            rec->info->extra->segment = NULL;
+        }
     }
+}
+
+static /*@dependent@*/ yasm_symrec *
+symtab_define(yasm_symtab *symtab, const char *name, sym_type type,
+              int in_table, unsigned long line)
+{
+    yasm_symrec *rec = symtab_get_or_new(symtab, name, in_table);
+    symrec_define(rec, name, type, line);
     return rec;
 }
 
@@ -341,6 +465,18 @@ yasm_symtab_define_label(yasm_symtab *symtab, const char *name,
     return rec;
 }
 
+void
+yasm_symrec_define_label(yasm_symrec *rec, yasm_bytecode *precbc,
+                         unsigned long line)
+{
+    symrec_define(rec, rec->name, SYM_LABEL, line);
+    if (yasm_error_occurred())
+        return;
+    rec->value.precbc = precbc;
+    if (!(rec->status & YASM_SYM_NOTINTABLE) && precbc)
+        yasm_bc__add_symrec(precbc, rec);
+}
+
 yasm_symrec *
 yasm_symtab_define_curpos(yasm_symtab *symtab, const char *name,
                           yasm_bytecode *precbc, unsigned long line)
@@ -392,12 +528,13 @@ yasm_symrec_declare(yasm_symrec *rec, yasm_sym_vis vis, unsigned long line)
          (!(rec->visibility & (YASM_SYM_COMMON | YASM_SYM_EXTERN)) ||
           ((rec->visibility & YASM_SYM_COMMON) && (vis == YASM_SYM_COMMON)) ||
           ((rec->visibility & YASM_SYM_EXTERN) && (vis == YASM_SYM_EXTERN))))) {
-        rec->decl_line = line;
+        rec->info->decl_line = line;
         rec->visibility |= vis;
     } else
         yasm_error_set(YASM_ERROR_GENERAL,
             N_("duplicate definition of `%s'; first defined on line %lu"),
-            rec->name, rec->def_line!=0 ? rec->def_line : rec->decl_line);
+            rec->name, rec->info->def_line!=0 ? rec->info->def_line
+                                              : rec->info->decl_line);
 }
 
 typedef struct symtab_finalize_info {
@@ -419,9 +556,9 @@ symtab_parser_finalize_checksym(yasm_symrec *sym, /*@null@*/ void *d)
         else {
             yasm_error_set(YASM_ERROR_GENERAL,
                            N_("undefined symbol `%s' (first use)"), sym->name);
-            yasm_errwarn_propagate(info->errwarns, sym->use_line);
-            if (sym->use_line < info->firstundef_line)
-                info->firstundef_line = sym->use_line;
+            yasm_errwarn_propagate(info->errwarns, sym->info->use_line);
+            if (sym->info->use_line < info->firstundef_line)
+                info->firstundef_line = sym->info->use_line;
         }
     }
 
@@ -447,14 +584,19 @@ yasm_symtab_parser_finalize(yasm_symtab *symtab, int undef_extern,
 void
 yasm_symtab_destroy(yasm_symtab *symtab)
 {
-    HAMT_destroy(symtab->sym_table, symrec_destroy_one);
+    unsigned int used = symtab->chunk_used;
+
+    while (symtab->chunks) {
+        symrec_chunk *chunk = symtab->chunks;
+        unsigned int i;
 
-    while (!SLIST_EMPTY(&symtab->non_table_syms)) {
-        non_table_symrec *sym = SLIST_FIRST(&symtab->non_table_syms);
-        SLIST_REMOVE_HEAD(&symtab->non_table_syms, link);
-        symrec_destroy_one(sym->rec);
-        yasm_xfree(sym);
+        for (i=0; i<used; i++)
+            symrec_destroy_one(&chunk->recs[i]);
+        symtab->chunks = chunk->next;
+        yasm_xfree(chunk);
+        used = SYMREC_CHUNK_SIZE;
     }
+    yasm_xfree(symtab->slots);
 
     yasm_xfree(symtab);
 }
@@ -521,19 +663,19 @@ yasm_symrec_get_status(const yasm_symrec *sym)
 unsigned long
 yasm_symrec_get_def_line(const yasm_symrec *sym)
 {
-    return sym->def_line;
+    return sym->info->def_line;
 }
 
 unsigned long
 yasm_symrec_get_decl_line(const yasm_symrec *sym)
 {
-    return sym->decl_line;
+    return sym->info->decl_line;
 }
 
 unsigned long
 yasm_symrec_get_use_line(const yasm_symrec *sym)
 {
-    return sym->use_line;
+    return sym->info->use_line;
 }
 
 const yasm_expr *
@@ -544,6 +686,27 @@ yasm_symrec_get_equ(const yasm_symrec *sym)
     return (const yasm_expr *)NULL;
 }
 
+const yasm_expr *
+yasm_symrec__get_equ_cache(const yasm_symrec *sym)
+{
+    if (!sym->info->extra)
+        return NULL;
+    return sym->info->extra->equ_cache;
+}
+
+void
+yasm_symrec__set_equ_cache(yasm_symrec *sym, yasm_expr *e)
+{
+    symrec_extra *extra;
+
+    if (sym->type != SYM_EQU)
+        yasm_internal_error(N_("setting equ cache of non-equ symbol"));
+    extra = symrec_get_extra(sym);
+    if (extra->equ_cache)
+        yasm_expr_destroy(extra->equ_cache);
+    extra->equ_cache = e;
+}
+
 int
 yasm_symrec_get_label(const yasm_symrec *sym,
                       yasm_symrec_get_label_bytecodep *precbc)
@@ -560,32 +723,36 @@ yasm_symrec_get_label(const yasm_symrec *sym,
 void
 yasm_symrec_set_size(yasm_symrec *sym, int size)
 {
-    sym->size = size;
+    symrec_get_extra(sym)->size = size;
 }
 
 int
 yasm_symrec_get_size(const yasm_symrec *sym)
 {
-    return sym->size;
+    if (!sym->info->extra)
+        return 0;
+    return sym->info->extra->size;
 }
 
 void
 yasm_symrec_set_segment(yasm_symrec *sym, const char *segment)
 {
-    sym->segment = segment;
+    symrec_get_extra(sym)->segment = segment;
 }
 
 const char *
 yasm_symrec_get_segment(const yasm_symrec *sym)
 {
-    return sym->segment;
+    if (!sym->info->extra)
+        return NULL;
+    return sym->info->extra->segment;
 }
 
 int
 yasm_symrec_is_abs(const yasm_symrec *sym)
 {
-    return (sym->def_line == 0 && sym->type == SYM_EQU &&
-            sym->name[0] == '\0');
+    return (sym->type == SYM_EQU && sym->name[0] == '\0' &&
+            sym->info->def_line == 0);
 }
 
 int
@@ -604,47 +771,75 @@ void
 yasm_symrec_set_objext_valparams(yasm_symrec *sym,
                                  /*@only@*/ yasm_valparamhead *objext_valparams)
 {
-    yasm_symrec_add_data(sym, &objext_valparams_cb, objext_valparams);
+    symrec_extra *extra = symrec_get_extra(sym);
+    if (extra->objext_valparams &&
+        extra->objext_valparams != objext_valparams)
+        yasm_vps_destroy(extra->objext_valparams);
+    extra->objext_valparams = objext_valparams;
 }
 
 yasm_valparamhead *
 yasm_symrec_get_objext_valparams(yasm_symrec *sym)
 {
-    return yasm_symrec_get_data(sym, &objext_valparams_cb);
+    if (!sym->info->extra)
+        return NULL;
+    return sym->info->extra->objext_valparams;
 }
 
 void
 yasm_symrec_set_common_size(yasm_symrec *sym,
                             /*@only@*/ yasm_expr *common_size)
 {
-    yasm_expr **ep = yasm_xmalloc(sizeof(yasm_expr *));
-    *ep = common_size;
-    yasm_symrec_add_data(sym, &common_size_cb, ep);
+    symrec_extra *extra = symrec_get_extra(sym);
+    if (extra->common_size)
+        yasm_expr_destroy(extra->common_size);
+    extra->common_size = common_size;
 }
 
 yasm_expr **
 yasm_symrec_get_common_size(yasm_symrec *sym)
 {
-    return (yasm_expr **)yasm_symrec_get_data(sym, &common_size_cb);
+    if (!sym->info->extra || !sym->info->extra->common_size)
+        return NULL;
+    return &sym->info->extra->common_size;
 }
 
 void *
 yasm_symrec_get_data(yasm_symrec *sym,
                      const yasm_assoc_data_callback *callback)
 {
-    return yasm__assoc_data_get(sym->assoc_data, callback);
+    if (sym->data_cb == callback)
+        return sym->data;
+    if (!sym->info->extra)
+        return NULL;
+    return yasm__assoc_data_get(sym->info->extra->assoc_data, callback);
 }
 
 void
 yasm_symrec_add_data(yasm_symrec *sym,
                      const yasm_assoc_data_callback *callback, void *data)
 {
-    sym->assoc_data = yasm__assoc_data_add(sym->assoc_data, callback, data);
+    symrec_extra *extra;
+
+    if (!sym->data_cb)
+        sym->data_cb = callback;
+    if (sym->data_cb == callback) {
+        /* Delete existing data (if any) */
+        if (sym->data && sym->data != data)
+            callback->destroy(sym->data);
+        sym->data = data;
+        return;
+    }
+    extra = symrec_get_extra(sym);
+    extra->assoc_data = yasm__assoc_data_add(extra->assoc_data, callback,
+                                             data);
 }
 
 void
 yasm_symrec_print(const yasm_symrec *sym, FILE *f, int indent_level)
 {
+    const symrec_extra *extra = sym->info->extra;
+
     switch (sym->type) {
         case SYM_UNKNOWN:
             fprintf(f, "%*s-Unknown (Common/Extern)-\n", indent_level, "");
@@ -701,14 +896,30 @@ yasm_symrec_print(const yasm_symrec *sym, FILE *f, int indent_level)
         fprintf(f, "\n");
     }
 
-    if (sym->assoc_data) {
+    if (extra && extra->objext_valparams) {
+        fprintf(f, "%*sObject Extension Valparams=", indent_level, "");
+        yasm_vps_print(extra->objext_valparams, f);
+        fprintf(f, "\n");
+    }
+
+    if (extra && extra->common_size) {
+        fprintf(f, "%*sCommon Size=", indent_level, "");
+        yasm_expr_print(extra->common_size, f);
+        fprintf(f, "\n");
+    }
+
+    if (sym->data_cb || (extra && extra->assoc_data)) {
         fprintf(f, "%*sAssociated data:\n", indent_level, "");
-        yasm__assoc_data_print(sym->assoc_data, f, indent_level+1);
+        if (sym->data_cb)
+            sym->data_cb->print(sym->data, f, indent_level+1);
+        if (extra)
+            yasm__assoc_data_print(extra->assoc_data, f, indent_level+1);
     }
 
     fprintf(f, "%*sLine Index (Defined)=%lu\n", indent_level, "",
-            sym->def_line);
+            sym->info->def_line);
     fprintf(f, "%*sLine Index (Declared)=%lu\n", indent_level, "",
-            sym->decl_line);
-    fprintf(f, "%*sLine Index (Used)=%lu\n", indent_level, "", sym->use_line);
+            sym->info->decl_line);
+    fprintf(f, "%*sLine Index (Used)=%lu\n", indent_level, "",
+            sym->info->use_line);
 }
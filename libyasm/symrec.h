@@ -98,6 +98,19 @@ YASM_LIB_DECL
 /*@dependent@*/ yasm_symrec *yasm_symtab_use
     (yasm_symtab *symtab, const char *name, unsigned long line);
 
+/** Get a reference to (use) a new symbol that is not inserted into the
+ * symbol table.  Each call creates a distinct symbol, even if the name is
+ * the same; the caller is responsible for keeping track of it.  The symbol
+ * can later be defined with yasm_symrec_define_label().
+ * \param symtab    symbol table
+ * \param name      symbol name (only used for messages)
+ * \param line      virtual line where referenced
+ * \return Symbol (dependent pointer, do not free).
+ */
+YASM_LIB_DECL
+/*@dependent@*/ yasm_symrec *yasm_symtab_use_not_in_table
+    (yasm_symtab *symtab, const char *name, unsigned long line);
+
 /** Get a reference to a symbol, without "using" it.  Should be used for cases
  * when an internal assembler usage of a symbol shouldn't be treated like a
  * normal user symbol usage.
@@ -136,6 +149,17 @@ YASM_LIB_DECL
     (yasm_symtab *symtab, const char *name,
      /*@dependent@*/ yasm_bytecode *precbc, int in_table, unsigned long line);
 
+/** Define an existing symbol as a label.  Useful for symbols created by
+ * yasm_symtab_use_not_in_table().
+ * \param symrec    symbol
+ * \param precbc    bytecode preceding label
+ * \param line      virtual line of label
+ */
+YASM_LIB_DECL
+void yasm_symrec_define_label(yasm_symrec *symrec,
+                              /*@dependent@*/ yasm_bytecode *precbc,
+                              unsigned long line);
+
 /** Define a symbol as a label representing the current assembly position.
  * This should be used for this purpose instead of yasm_symtab_define_label()
  * as value_finalize_scan() looks for usage of this symbol type for special
@@ -252,7 +276,7 @@ void yasm_symtab_print(yasm_symtab *symtab, FILE *f, int indent_level);
 
 /** Get the name of a symbol.
  * \param sym       symbol
- * \return Symbol name.
+ * \return Symbol name (an interned string; see yasm_intern()).
  */
 YASM_LIB_DECL
 /*@observer@*/ const char *yasm_symrec_get_name(const yasm_symrec *sym);
@@ -309,6 +333,26 @@ YASM_LIB_DECL
 /*@observer@*/ /*@null@*/ const yasm_expr *yasm_symrec_get_equ
     (const yasm_symrec *sym);
 
+/** Get the cached expanded EQU value of a symbol.  This is the EQU value
+ * with all EQUs it references expanded and simplified; it is maintained by
+ * yasm_expr__level_tree().
+ * \internal
+ * \param sym       symbol
+ * \return Cached expanded EQU value, or NULL if none has been set.
+ */
+YASM_LIB_DECL
+/*@observer@*/ /*@null@*/ const yasm_expr *yasm_symrec__get_equ_cache
+    (const yasm_symrec *sym);
+
+/** Set the cached expanded EQU value of a symbol.  Only valid for EQU
+ * symbols.
+ * \internal
+ * \param sym       symbol
+ * \param e         expanded EQU value
+ */
+YASM_LIB_DECL
+void yasm_symrec__set_equ_cache(yasm_symrec *sym, /*@only@*/ yasm_expr *e);
+
 /** Dependent pointer to a bytecode. */
 typedef /*@dependent@*/ yasm_bytecode *yasm_symrec_get_label_bytecodep;
 
@@ -415,7 +459,9 @@ YASM_LIB_DECL
 /*@dependent@*/ /*@null@*/ void *yasm_symrec_get_data
     (yasm_symrec *sym, const yasm_assoc_data_callback *callback);
 
-/** Add associated data to a symbol.
+/** Add associated data to a symbol.  The first callback used with a symbol
+ * gets a dedicated slot in the symbol, so it should be the one looked up
+ * most often (typically the object format's per-symbol data).
  * \attention Deletes any existing associated data for that data callback.
  * \param sym       symbol
  * \param callback  callback
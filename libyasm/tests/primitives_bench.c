@@ -0,0 +1,728 @@
+/*
+ * Microbenchmarks for libyasm primitives
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "util.h"
+#include "libyasm.h"
+#include "libyasm/bitvect.h"
+
+/* Each benchmark runs its operation reps times (or reps times over a fixed
+ * data set) and returns the number of operations performed.  The driver
+ * doubles reps until a run takes at least MIN_TIME seconds, then reports
+ * the time per operation.  Operations that consume their input (e.g. expr
+ * leveling) include the cost of rebuilding it; the corresponding "copy"
+ * benchmark gives that baseline.
+ */
+#define MIN_TIME    0.2
+
+typedef struct bench {
+    const char *name;
+    unsigned long (*run) (unsigned long reps);
+} bench;
+
+static const char *filter = NULL;
+
+/* Values used across benchmarks; set up in main */
+static yasm_intnum *small_a, *small_b, *large_a, *large_b;
+static yasm_symtab *symtab;
+
+/*
+ * yasm_intnum_calc
+ */
+static yasm_expr_op calc_op;
+static int calc_large;
+
+static unsigned long
+run_intnum_calc(unsigned long reps)
+{
+    yasm_intnum *acc = yasm_intnum_create_uint(0);
+    yasm_intnum *a = calc_large ? large_a : small_a;
+    yasm_intnum *b = calc_large ? large_b : small_b;
+    unsigned long i;
+
+    for (i=0; i<reps; i++) {
+        yasm_intnum_set(acc, a);
+        yasm_intnum_calc(acc, calc_op, b);
+    }
+    yasm_intnum_destroy(acc);
+    return reps;
+}
+
+#define INTNUM_CALC_BENCH(fn, op, large) \
+static unsigned long                            \
+fn(unsigned long reps)                          \
+{                                               \
+    calc_op = op;                               \
+    calc_large = large;                         \
+    return run_intnum_calc(reps);               \
+}
+
+INTNUM_CALC_BENCH(intnum_add, YASM_EXPR_ADD, 0)
+INTNUM_CALC_BENCH(intnum_mul, YASM_EXPR_MUL, 0)
+INTNUM_CALC_BENCH(intnum_div, YASM_EXPR_DIV, 0)
+INTNUM_CALC_BENCH(intnum_shl, YASM_EXPR_SHL, 0)
+INTNUM_CALC_BENCH(intnum_and, YASM_EXPR_AND, 0)
+INTNUM_CALC_BENCH(intnum_neg, YASM_EXPR_NEG, 0)
+INTNUM_CALC_BENCH(intnum_add_large, YASM_EXPR_ADD, 1)
+INTNUM_CALC_BENCH(intnum_mul_large, YASM_EXPR_MUL, 1)
+INTNUM_CALC_BENCH(intnum_div_large, YASM_EXPR_DIV, 1)
+
+/*
+ * yasm_intnum_size_leb128 / yasm_intnum_get_leb128
+ */
+static const int leb128_sign[4] = {0, 1, 1, 0};
+
+static unsigned long
+leb128_size(unsigned long reps)
+{
+    yasm_intnum *vals[4];
+    unsigned long i, total = 0;
+    int j;
+
+    vals[0] = yasm_intnum_create_uint(0x12);
+    vals[1] = yasm_intnum_create_uint(0x3239);
+    vals[2] = yasm_intnum_create_int(-0x12345678L);
+    vals[3] = yasm_intnum_copy(large_a);
+    for (i=0; i<reps; i++) {
+        for (j=0; j<4; j++)
+            total += yasm_intnum_size_leb128(vals[j], leb128_sign[j]);
+    }
+    for (j=0; j<4; j++)
+        yasm_intnum_destroy(vals[j]);
+    return total ? reps*4 : 0;
+}
+
+static unsigned long
+leb128_get(unsigned long reps)
+{
+    yasm_intnum *vals[4];
+    unsigned char buf[32];
+    unsigned long i;
+    int j;
+
+    vals[0] = yasm_intnum_create_uint(0x12);
+    vals[1] = yasm_intnum_create_uint(0x3239);
+    vals[2] = yasm_intnum_create_int(-0x12345678L);
+    vals[3] = yasm_intnum_copy(large_a);
+    for (i=0; i<reps; i++) {
+        for (j=0; j<4; j++)
+            yasm_intnum_get_leb128(vals[j], buf, leb128_sign[j]);
+    }
+    for (j=0; j<4; j++)
+        yasm_intnum_destroy(vals[j]);
+    return reps*4;
+}
+
+/*
+ * BitVector
+ */
+#define BV_BITS     128
+
+static unsigned long
+bitvect_add(unsigned long reps)
+{
+    wordptr x = BitVector_Create(BV_BITS, TRUE);
+    wordptr y = BitVector_Create(BV_BITS, TRUE);
+    wordptr z = BitVector_Create(BV_BITS, TRUE);
+    boolean carry;
+    unsigned long i;
+
+    BitVector_from_Hex(y, (charptr)"123456789ABCDEF0FEDCBA9876543210");
+    BitVector_from_Hex(z, (charptr)"0F0F0F0F0F0F0F0F0F0F0F0F0F0F0F0F");
+    for (i=0; i<reps; i++) {
+        carry = 0;
+        BitVector_add(x, y, z, &carry);
+    }
+    BitVector_Destroy(x);
+    BitVector_Destroy(y);
+    BitVector_Destroy(z);
+    return reps;
+}
+
+static unsigned long
+bitvect_multiply(unsigned long reps)
+{
+    wordptr x = BitVector_Create(BV_BITS, TRUE);
+    wordptr y = BitVector_Create(BV_BITS, TRUE);
+    wordptr z = BitVector_Create(BV_BITS, TRUE);
+    unsigned long i;
+
+    BitVector_from_Hex(y, (charptr)"123456789ABCDEF0");
+    BitVector_from_Hex(z, (charptr)"0F0F0F0F0F0F");
+    for (i=0; i<reps; i++)
+        BitVector_Multiply(x, y, z);
+    BitVector_Destroy(x);
+    BitVector_Destroy(y);
+    BitVector_Destroy(z);
+    return reps;
+}
+
+static unsigned long
+bitvect_divide(unsigned long reps)
+{
+    wordptr q = BitVector_Create(BV_BITS, TRUE);
+    wordptr r = BitVector_Create(BV_BITS, TRUE);
+    wordptr x = BitVector_Create(BV_BITS, TRUE);
+    wordptr y = BitVector_Create(BV_BITS, TRUE);
+    unsigned long i;
+
+    BitVector_from_Hex(x, (charptr)"123456789ABCDEF0FEDCBA98765432");
+    BitVector_from_Hex(y, (charptr)"0F0F0F0F0F0F");
+    for (i=0; i<reps; i++)
+        BitVector_Divide(q, x, y, r);
+    BitVector_Destroy(q);
+    BitVector_Destroy(r);
+    BitVector_Destroy(x);
+    BitVector_Destroy(y);
+    return reps;
+}
+
+static unsigned long
+bitvect_shift(unsigned long reps)
+{
+    wordptr x = BitVector_Create(BV_BITS, TRUE);
+    unsigned long i;
+
+    for (i=0; i<reps; i++) {
+        BitVector_from_Hex(x, (charptr)"1");
+        BitVector_Move_Left(x, 77);
+    }
+    BitVector_Destroy(x);
+    return reps;
+}
+
+static unsigned long
+bitvect_to_dec(unsigned long reps)
+{
+    wordptr x = BitVector_Create(BV_BITS, TRUE);
+    unsigned long i;
+
+    BitVector_from_Hex(x, (charptr)"123456789ABCDEF0FEDCBA98765432");
+    for (i=0; i<reps; i++)
+        BitVector_Dispose(BitVector_to_Dec(x));
+    BitVector_Destroy(x);
+    return reps;
+}
+
+/*
+ * yasm_expr__level_tree
+ */
+#define EXPR_WIDTH  256
+#define EXPR_DEPTH  64
+
+static yasm_expr *expr_wide, *expr_deep;
+
+/* sym0 + 1 + sym2 + 3 + ..., built one term at a time as the parser does;
+ * leveling folds the constants out of the single wide ADD node.
+ */
+static yasm_expr *
+build_expr_wide(void)
+{
+    yasm_expr *e = yasm_expr_create_ident(
+        yasm_expr_int(yasm_intnum_create_uint(0)), 0);
+    char name[32];
+    int i;
+
+    for (i=0; i<EXPR_WIDTH; i++) {
+        yasm_expr__item *item;
+        if (i & 1)
+            item = yasm_expr_int(yasm_intnum_create_uint((unsigned long)i));
+        else {
+            sprintf(name, "sym%d", i);
+            item = yasm_expr_sym(yasm_symtab_use(symtab, name, 0));
+        }
+        e = yasm_expr_create(YASM_EXPR_ADD, yasm_expr_expr(e), item, 0);
+    }
+    return e;
+}
+
+/* ((sym0 * 2 + 1) * 2 + 1) ... alternating ops, so nothing flattens. */
+static yasm_expr *
+build_expr_deep(void)
+{
+    yasm_expr *e = yasm_expr_create_ident(
+        yasm_expr_sym(yasm_symtab_use(symtab, "sym0", 0)), 0);
+    int i;
+
+    for (i=0; i<EXPR_DEPTH; i++) {
+        e = yasm_expr_create(YASM_EXPR_MUL, yasm_expr_expr(e),
+                             yasm_expr_int(yasm_intnum_create_uint(2)), 0);
+        e = yasm_expr_create(YASM_EXPR_ADD, yasm_expr_expr(e),
+                             yasm_expr_int(yasm_intnum_create_uint(1)), 0);
+    }
+    return e;
+}
+
+static unsigned long
+run_expr(yasm_expr *orig, int level, unsigned long reps)
+{
+    unsigned long i;
+
+    for (i=0; i<reps; i++) {
+        yasm_expr *e = yasm_expr_copy(orig);
+        if (level)
+            e = yasm_expr__level_tree(e, 1, 1, 1, 0, NULL, NULL);
+        yasm_expr_destroy(e);
+    }
+    return reps;
+}
+
+static unsigned long
+expr_copy_wide(unsigned long reps)
+{
+    return run_expr(expr_wide, 0, reps);
+}
+
+static unsigned long
+expr_level_wide(unsigned long reps)
+{
+    return run_expr(expr_wide, 1, reps);
+}
+
+static unsigned long
+expr_copy_deep(unsigned long reps)
+{
+    return run_expr(expr_deep, 0, reps);
+}
+
+static unsigned long
+expr_level_deep(unsigned long reps)
+{
+    return run_expr(expr_deep, 1, reps);
+}
+
+static unsigned long
+expr_create_deep(unsigned long reps)
+{
+    unsigned long i;
+
+    for (i=0; i<reps; i++)
+        yasm_expr_destroy(build_expr_deep());
+    return reps;
+}
+
+/*
+ * HAMT
+ */
+#define NUM_NAMES   20000
+
+static char *names[NUM_NAMES];
+static char *miss_names[NUM_NAMES];
+
+static void
+hamt_error(const char *file, unsigned int line, const char *message)
+{
+    fprintf(stderr, "%s:%u: %s\n", file, line, message);
+    exit(EXIT_FAILURE);
+}
+
+static void
+hamt_nodelete(/*@unused@*/ void *data)
+{
+}
+
+/* Make a symbol name in one of the styles commonly seen in real code:
+ * local labels, C identifiers, mangled C++ names, and import thunks.
+ */
+static char *
+make_name(unsigned long i, const char *tag)
+{
+    char buf[128];
+
+    switch (i % 4) {
+        case 0:
+            sprintf(buf, ".L%s%lu", tag, i);
+            break;
+        case 1:
+            sprintf(buf, "%s_module_function_%lu", tag, i);
+            break;
+        case 2:
+            sprintf(buf, "_ZN4yasm%s7Section12add_bytecodeEPNS_8Bytecode%luE",
+                    tag, i);
+            break;
+        default:
+            sprintf(buf, "__imp__%sCreateFileW%lu@28", tag, i);
+            break;
+    }
+    return yasm__xstrdup(buf);
+}
+
+static HAMT *
+build_hamt(void)
+{
+    HAMT *hamt = HAMT_create(0, hamt_error);
+    int replace;
+    unsigned long i;
+
+    for (i=0; i<NUM_NAMES; i++) {
+        replace = 0;
+        HAMT_insert(hamt, names[i], names[i], &replace, hamt_nodelete);
+    }
+    return hamt;
+}
+
+static unsigned long
+hamt_insert(unsigned long reps)
+{
+    unsigned long i;
+
+    for (i=0; i<reps; i++)
+        HAMT_destroy(build_hamt(), hamt_nodelete);
+    return reps*NUM_NAMES;
+}
+
+static unsigned long
+hamt_search_hit(unsigned long reps)
+{
+    HAMT *hamt = build_hamt();
+    unsigned long i, j, found = 0;
+
+    for (i=0; i<reps; i++) {
+        for (j=0; j<NUM_NAMES; j++)
+            if (HAMT_search(hamt, names[j]))
+                found++;
+    }
+    HAMT_destroy(hamt, hamt_nodelete);
+    return found;
+}
+
+static unsigned long
+hamt_search_miss(unsigned long reps)
+{
+    HAMT *hamt = build_hamt();
+    unsigned long i, j, found = 0;
+
+    for (i=0; i<reps; i++) {
+        for (j=0; j<NUM_NAMES; j++)
+            if (HAMT_search(hamt, miss_names[j]))
+                found++;
+    }
+    HAMT_destroy(hamt, hamt_nodelete);
+    return found ? 0 : reps*NUM_NAMES;
+}
+
+/*
+ * yasm_linemap_lookup: every virtual line in ascending order, as the debug
+ * formats do, over a map with one mapping per NUM_LINE_INC lines (as for
+ * %line or #line directives in preprocessed or generated source).
+ */
+#define NUM_MAPPINGS    20000
+#define NUM_LINE_INC    3
+
+static yasm_linemap *linemap;
+
+static yasm_linemap *
+build_linemap(void)
+{
+    yasm_linemap *lm = yasm_linemap_create();
+    unsigned long i, j;
+
+    for (i=0; i<NUM_MAPPINGS; i++) {
+        yasm_linemap_set(lm, names[i % 50], 0, i*10+1, 1);
+        for (j=0; j<NUM_LINE_INC; j++)
+            yasm_linemap_goto_next(lm);
+    }
+    return lm;
+}
+
+static unsigned long
+linemap_lookup(unsigned long reps)
+{
+    unsigned long i, line, file_line, sum = 0;
+    const char *filename;
+
+    for (i=0; i<reps; i++) {
+        for (line=1; line<=NUM_MAPPINGS*NUM_LINE_INC; line++) {
+            yasm_linemap_lookup(linemap, line, &filename, &file_line);
+            sum += file_line;
+        }
+    }
+    return sum ? reps*NUM_MAPPINGS*NUM_LINE_INC : 0;
+}
+
+static unsigned long
+linemap_lookup_cursor(unsigned long reps)
+{
+    yasm_linemap_cursor cursor;
+    unsigned long i, line, file_line, sum = 0;
+    const char *filename;
+
+    for (i=0; i<reps; i++) {
+        yasm_linemap_cursor_init(&cursor);
+        for (line=1; line<=NUM_MAPPINGS*NUM_LINE_INC; line++) {
+            yasm_linemap_lookup_cursor(linemap, &cursor, line, &filename,
+                                       &file_line);
+            sum += file_line;
+        }
+    }
+    return sum ? reps*NUM_MAPPINGS*NUM_LINE_INC : 0;
+}
+
+/*
+ * Symbol table traversal as done by the object formats at output time: each
+ * symbol has object format data attached, which is looked up per symbol.
+ */
+static void
+symdata_destroy(void *data)
+{
+    yasm_xfree(data);
+}
+
+static void
+symdata_print(void *data, FILE *f, int indent_level)
+{
+}
+
+static const yasm_assoc_data_callback symdata_cb = {
+    symdata_destroy,
+    symdata_print
+};
+
+static yasm_symtab *
+build_symtab(void)
+{
+    yasm_symtab *st = yasm_symtab_create();
+    unsigned long i;
+
+    for (i=0; i<NUM_NAMES; i++) {
+        unsigned long *data = yasm_xmalloc(sizeof(unsigned long));
+        *data = i;
+        yasm_symrec_add_data(yasm_symtab_use(st, names[i], i+1), &symdata_cb,
+                             data);
+    }
+    return st;
+}
+
+static unsigned long
+symtab_build(unsigned long reps)
+{
+    unsigned long i;
+
+    for (i=0; i<reps; i++)
+        yasm_symtab_destroy(build_symtab());
+    return reps*NUM_NAMES;
+}
+
+static int
+symtab_traverse_cb(yasm_symrec *sym, void *d)
+{
+    unsigned long *data = yasm_symrec_get_data(sym, &symdata_cb);
+    if (yasm_symrec_get_visibility(sym) == YASM_SYM_LOCAL)
+        *(unsigned long *)d += *data;
+    return 0;
+}
+
+static unsigned long
+symtab_traverse(unsigned long reps)
+{
+    yasm_symtab *st = build_symtab();
+    unsigned long i, sum = 0;
+
+    for (i=0; i<reps; i++)
+        yasm_symtab_traverse(st, &sum, symtab_traverse_cb);
+    yasm_symtab_destroy(st);
+    return sum ? reps*NUM_NAMES : 0;
+}
+
+/*
+ * yasm_floatnum_get_sized
+ */
+static unsigned long
+run_floatnum(size_t size, unsigned long reps)
+{
+    static const char *vals[] = {"3.14159265358979", "1.0e-300", "6.02e23",
+                                 "-0.5"};
+    yasm_floatnum *flts[4];
+    unsigned char buf[10];
+    unsigned long i;
+    int j;
+
+    for (j=0; j<4; j++)
+        flts[j] = yasm_floatnum_create(vals[j]);
+    for (i=0; i<reps; i++) {
+        for (j=0; j<4; j++)
+            yasm_floatnum_get_sized(flts[j], buf, size/8, size, 0, 0, 0);
+    }
+    for (j=0; j<4; j++)
+        yasm_floatnum_destroy(flts[j]);
+    return reps*4;
+}
+
+static unsigned long
+floatnum_get32(unsigned long reps)
+{
+    return run_floatnum(32, reps);
+}
+
+static unsigned long
+floatnum_get64(unsigned long reps)
+{
+    return run_floatnum(64, reps);
+}
+
+static unsigned long
+floatnum_get80(unsigned long reps)
+{
+    return run_floatnum(80, reps);
+}
+
+static unsigned long
+floatnum_create(unsigned long reps)
+{
+    unsigned long i;
+
+    for (i=0; i<reps; i++)
+        yasm_floatnum_destroy(yasm_floatnum_create("3.14159265358979e10"));
+    return reps;
+}
+
+static const bench benches[] = {
+    {"intnum_calc add", intnum_add},
+    {"intnum_calc mul", intnum_mul},
+    {"intnum_calc div", intnum_div},
+    {"intnum_calc shl", intnum_shl},
+    {"intnum_calc and", intnum_and},
+    {"intnum_calc neg", intnum_neg},
+    {"intnum_calc add (large)", intnum_add_large},
+    {"intnum_calc mul (large)", intnum_mul_large},
+    {"intnum_calc div (large)", intnum_div_large},
+    {"intnum_size_leb128", leb128_size},
+    {"intnum_get_leb128", leb128_get},
+    {"BitVector_add", bitvect_add},
+    {"BitVector_Multiply", bitvect_multiply},
+    {"BitVector_Divide", bitvect_divide},
+    {"BitVector_Move_Left", bitvect_shift},
+    {"BitVector_to_Dec", bitvect_to_dec},
+    {"expr_copy (wide)", expr_copy_wide},
+    {"expr__level_tree (wide)", expr_level_wide},
+    {"expr_copy (deep)", expr_copy_deep},
+    {"expr__level_tree (deep)", expr_level_deep},
+    {"expr_create (deep)", expr_create_deep},
+    {"HAMT_insert", hamt_insert},
+    {"HAMT_search (hit)", hamt_search_hit},
+    {"HAMT_search (miss)", hamt_search_miss},
+    {"linemap_lookup", linemap_lookup},
+    {"linemap_lookup_cursor", linemap_lookup_cursor},
+    {"symtab_use + add_data", symtab_build},
+    {"symtab_traverse get_data", symtab_traverse},
+    {"floatnum_create", floatnum_create},
+    {"floatnum_get_sized 32", floatnum_get32},
+    {"floatnum_get_sized 64", floatnum_get64},
+    {"floatnum_get_sized 80", floatnum_get80},
+};
+#define NUM_BENCHES (sizeof(benches)/sizeof(benches[0]))
+
+static void
+run_bench(const bench *b)
+{
+    unsigned long reps = 1, ops;
+    double start, elapsed;
+
+    for (;;) {
+        start = (double)clock()/CLOCKS_PER_SEC;
+        ops = b->run(reps);
+        elapsed = (double)clock()/CLOCKS_PER_SEC - start;
+        if (elapsed >= MIN_TIME || reps >= (~0UL)/2)
+            break;
+        reps *= 2;
+    }
+
+    if (ops == 0) {
+        printf("%-28s  FAILED\n", b->name);
+        return;
+    }
+    printf("%-28s %12.1f ns/op\n", b->name, elapsed*1.0e9/ops);
+    fflush(stdout);
+}
+
+int
+main(int argc, char *argv[])
+{
+    char *str;
+    size_t i;
+
+    if (argc > 2) {
+        fprintf(stderr, "Usage: %s [name-substring]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (argc == 2)
+        filter = argv[1];
+
+    if (BitVector_Boot() != ErrCode_Ok) {
+        fprintf(stderr, "could not initialize BitVector\n");
+        return EXIT_FAILURE;
+    }
+    yasm_intnum_initialize();
+    yasm_floatnum_initialize();
+    yasm_errwarn_initialize();
+
+    small_a = yasm_intnum_create_uint(0x12345678UL);
+    small_b = yasm_intnum_create_uint(13);
+    str = yasm__xstrdup("123456789ABCDEF0FEDCBA98765432");
+    large_a = yasm_intnum_create_hex(str);
+    yasm_xfree(str);
+    str = yasm__xstrdup("10000000000000001");
+    large_b = yasm_intnum_create_hex(str);
+    yasm_xfree(str);
+
+    symtab = yasm_symtab_create();
+    expr_wide = build_expr_wide();
+    expr_deep = build_expr_deep();
+
+    for (i=0; i<NUM_NAMES; i++) {
+        names[i] = make_name((unsigned long)i, "");
+        miss_names[i] = make_name((unsigned long)i, "x");
+    }
+    linemap = build_linemap();
+
+    for (i=0; i<NUM_BENCHES; i++) {
+        if (!filter || strstr(benches[i].name, filter))
+            run_bench(&benches[i]);
+    }
+
+    yasm_linemap_destroy(linemap);
+    for (i=0; i<NUM_NAMES; i++) {
+        yasm_xfree(names[i]);
+        yasm_xfree(miss_names[i]);
+    }
+    yasm_expr_destroy(expr_wide);
+    yasm_expr_destroy(expr_deep);
+    yasm_symtab_destroy(symtab);
+    yasm_intnum_destroy(small_a);
+    yasm_intnum_destroy(small_b);
+    yasm_intnum_destroy(large_a);
+    yasm_intnum_destroy(large_b);
+
+    yasm_floatnum_cleanup();
+    yasm_intnum_cleanup();
+    yasm_errwarn_cleanup();
+    BitVector_Shutdown();
+    return EXIT_SUCCESS;
+}
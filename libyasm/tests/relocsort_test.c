@@ -0,0 +1,148 @@
+/*
+ *
+ *  Copyright (C) 2026  Yasm developers
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND OTHER CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR OTHER CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libyasm/section.c"
+
+#define MAX_RELOCS  16
+
+typedef struct Test_Entry {
+    /* description */
+    const char *name;
+
+    /* number of relocations */
+    int num;
+
+    /* relocation addresses, in order of addition */
+    unsigned long addrs[MAX_RELOCS];
+} Test_Entry;
+
+static Test_Entry tests[] = {
+    {"empty", 0, {0}},
+    {"single", 1, {5}},
+    {"sorted", 5, {0, 1, 1, 0x100, 0x10000}},
+    {"reversed", 5, {4, 3, 2, 1, 0}},
+    {"equal keys", 8, {5, 1, 5, 1, 5, 0, 1, 5}},
+    {"all equal", 4, {7, 7, 7, 7}},
+    {"above 2^16", 8,
+     {0x10000, 0xFFFF, 0x10001, 0x1FFFF, 0x20000, 0xFFFF, 0x10000, 0xFF}},
+    {"above 2^24", 9,
+     {0x1000000, 0xFFFFFF, 0x1000000, 0x2000001, 0x10000, 0x1FFFFFF, 0,
+      0x1000001, 0xFFFFFF}},
+    {"same low bytes", 8,
+     {0x3000012, 0x12, 0x2000012, 0x1000012, 0x12, 0x20012, 0x3000012,
+      0x10012}},
+    {"mixed widths", 10,
+     {0x1234567, 0x34567, 0x1234567, 0x567, 0x34567, 0x7FFFFFFF, 0x1234567,
+      0x67, 0x80000000UL, 0x567}},
+};
+
+/* Relocation as an object format would extend it: the sequence number
+ * records the order of addition, to check that the sort is stable.
+ */
+typedef struct test_reloc {
+    yasm_reloc reloc;
+    int seq;
+} test_reloc;
+
+static char failed[1000];
+static char failmsg[100];
+
+static int
+run_test(Test_Entry *test)
+{
+    yasm_section sect;
+    test_reloc r, expect[MAX_RELOCS];
+    yasm_reloc *reloc;
+    int i, j, bad = 0;
+
+    memset(&sect, 0, sizeof(sect));
+    sect.relocs_sorted = 1;
+
+    for (i=0; i<test->num; i++) {
+        r.reloc.addr = test->addrs[i];
+        r.reloc.sym = NULL;
+        r.seq = i;
+        yasm_section_add_reloc(&sect, &r.reloc, sizeof(test_reloc), NULL);
+
+        /* build expected result with a stable insertion sort */
+        for (j=i; j>0 && expect[j-1].reloc.addr > r.reloc.addr; j--)
+            expect[j] = expect[j-1];
+        expect[j] = r;
+    }
+
+    yasm_section_relocs_sort(&sect);
+
+    if (yasm_section_num_relocs(&sect) != (unsigned long)test->num) {
+        sprintf(failmsg, "%s: expected %d relocs, got %lu!", test->name,
+                test->num, yasm_section_num_relocs(&sect));
+        bad = 1;
+    }
+
+    for (i=0, reloc = yasm_section_relocs_first(&sect); reloc && !bad;
+         i++, reloc = yasm_section_reloc_next(&sect, reloc)) {
+        test_reloc *tr = (test_reloc *)reloc;
+        if (i >= test->num) {
+            sprintf(failmsg, "%s: too many relocs!", test->name);
+            bad = 1;
+        } else if (tr->reloc.addr != expect[i].reloc.addr ||
+                   tr->seq != expect[i].seq) {
+            sprintf(failmsg, "%s: bad reloc %d: expected 0x%lx (#%d), got 0x%lx (#%d)!",
+                    test->name, i, expect[i].reloc.addr, expect[i].seq,
+                    tr->reloc.addr, tr->seq);
+            bad = 1;
+        }
+    }
+
+    if (sect.relocs)
+        yasm_xfree(sect.relocs);
+    return bad;
+}
+
+int
+main(void)
+{
+    int nf = 0;
+    int numtests = sizeof(tests)/sizeof(Test_Entry);
+    int i;
+
+    failed[0] = '\0';
+    printf("Test relocsort_test: ");
+    for (i=0; i<numtests; i++) {
+        int fail = run_test(&tests[i]);
+        printf("%c", fail>0 ? 'F':'.');
+        fflush(stdout);
+        if (fail)
+            sprintf(failed, "%s ** F: %s\n", failed, failmsg);
+        nf += fail;
+    }
+
+    printf(" +%d-%d/%d %d%%\n%s",
+           numtests-nf, nf, numtests, 100*(numtests-nf)/numtests, failed);
+    return (nf == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
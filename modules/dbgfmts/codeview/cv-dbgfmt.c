@@ -52,6 +52,10 @@ cv_dbgfmt_create(yasm_object *object, yasm_dbgfmt_module *module, int version)
         dbgfmt_cv->filenames[i].info_off = 0;
     }
 
+    dbgfmt_cv->filenames_hash_size = 64;
+    dbgfmt_cv->filenames_hash =
+        yasm_xcalloc(dbgfmt_cv->filenames_hash_size, sizeof(size_t));
+
     dbgfmt_cv->version = version;
 
     return (yasm_dbgfmt *)dbgfmt_cv;
@@ -75,6 +79,7 @@ cv_dbgfmt_destroy(/*@only@*/ yasm_dbgfmt *dbgfmt)
             yasm_xfree(dbgfmt_cv->filenames[i].filename);
     }
     yasm_xfree(dbgfmt_cv->filenames);
+    yasm_xfree(dbgfmt_cv->filenames_hash);
     yasm_xfree(dbgfmt);
 }
 
@@ -43,6 +43,12 @@ typedef struct yasm_dbgfmt_cv {
     size_t filenames_size;
     size_t filenames_allocated;
 
+    /* Open-addressed hash index into filenames, keyed on filename.  Each
+     * slot holds a 1-based table index, or 0 if empty.
+     */
+    size_t *filenames_hash;
+    size_t filenames_hash_size;
+
     int version;
 } yasm_dbgfmt_cv;
 
@@ -30,6 +30,7 @@
 #include <util.h>
 
 #include <libyasm.h>
+#include <libyasm/phash.h>
 
 #include "cv-dbgfmt.h"
 
@@ -120,25 +121,46 @@ typedef struct cv8_linepair {
     unsigned long line;
 } cv8_linepair;
 
-/* Decrease linked list overhead a bit doing it this way */
-typedef struct cv8_lineset {
-    STAILQ_ENTRY(cv8_lineset) link;
-    cv8_linepair pairs[126];
-    size_t num_pairs;
-} cv8_lineset;
-
 /* Note: Due to line number sorting requirements (by section offset it seems)
- *       one file may need more than one record per section. */
+ *       one file may need more than one record per section.  Records are
+ *       built by walking each section's bytecodes in order, so the pairs
+ *       array is always sorted by offset.
+ */
 typedef struct cv8_lineinfo {
     STAILQ_ENTRY(cv8_lineinfo) link;
     const cv_filename *fn;      /* filename associated with line numbers */
     yasm_section *sect;         /* section line numbers are for */
     yasm_symrec *sectsym;       /* symbol for beginning of sect */
     unsigned long num_linenums;
+    unsigned long alloc_linenums;
     int first_in_sect;          /* First lineinfo for this section. */
-    STAILQ_HEAD(cv8_lineset_head, cv8_lineset) linesets;
+    /*@owned@*/ cv8_linepair *pairs;
 } cv8_lineinfo;
 
+/* Source filename string table.  Each pathname is only stored once; the
+ * hash table maps it back to its offset and to the order it was added in
+ * (which is also its index in the source file info table).
+ */
+typedef struct cv_strtab_slot {
+    unsigned long offset;       /* 0 if empty */
+    size_t index;
+} cv_strtab_slot;
+
+typedef struct cv_strtab {
+    char *data;
+    unsigned long len;
+    unsigned long alloc;
+    cv_strtab_slot *hash;
+    unsigned long hash_size;
+    size_t count;
+} cv_strtab;
+
+/* Read buffer size for source file checksums */
+#define CV_DIGEST_BUFSIZE   65536
+
+/* Size of a source file info table entry */
+#define CV8_FILEINFO_SIZE   24
+
 /* Symbols use a bit of meta-programming to encode formats: each character
  * of format represents the output generated, as follows:
  * 'b' : 1 byte value (integer)
@@ -334,83 +356,180 @@ cv8_add_sym_data(yasm_section *sect, unsigned long type, yasm_symrec *sym,
     return cvs;
 }
 
+/* Find filename in the filename table.  Returns its 0-based index plus one,
+ * or 0 if not found.
+ */
 static size_t
-cv_dbgfmt_add_file(yasm_dbgfmt_cv *dbgfmt_cv, size_t filenum,
-                   const char *filename)
+cv_dbgfmt_find_file(const yasm_dbgfmt_cv *dbgfmt_cv, const char *filename)
+{
+    size_t mask = dbgfmt_cv->filenames_hash_size-1;
+    size_t i = phash_lookup(filename, strlen(filename), 0) & mask;
+    size_t n;
+
+    while ((n = dbgfmt_cv->filenames_hash[i]) != 0) {
+        if (strcmp(dbgfmt_cv->filenames[n-1].filename, filename) == 0)
+            return n;
+        i = (i+1) & mask;
+    }
+    return 0;
+}
+
+static void
+cv_dbgfmt_index_file(yasm_dbgfmt_cv *dbgfmt_cv, size_t filenum)
+{
+    const char *filename = dbgfmt_cv->filenames[filenum].filename;
+    size_t mask = dbgfmt_cv->filenames_hash_size-1;
+    size_t i = phash_lookup(filename, strlen(filename), 0) & mask;
+
+    while (dbgfmt_cv->filenames_hash[i] != 0)
+        i = (i+1) & mask;
+    dbgfmt_cv->filenames_hash[i] = filenum+1;
+}
+
+/* Calculate MD5 checksum of a source file. */
+static void
+cv_file_digest(const char *filename, /*@out@*/ unsigned char digest[16])
 {
-    char *pathname;
-    size_t i;
     yasm_md5_context context;
     FILE *f;
     unsigned char *buf;
     size_t len;
 
-    /* Put the filename into the filename table */
-    if (filenum == 0) {
-        /* Look to see if we already have that filename in the table */
-        for (; filenum<dbgfmt_cv->filenames_size; filenum++) {
-            if (!dbgfmt_cv->filenames[filenum].filename ||
-                strcmp(dbgfmt_cv->filenames[filenum].filename, filename) == 0)
-                break;
-        }
-    } else
-        filenum--;      /* array index is 0-based */
-
-    /* Realloc table if necessary */
-    if (filenum >= dbgfmt_cv->filenames_allocated) {
-        size_t old_allocated = dbgfmt_cv->filenames_allocated;
-        dbgfmt_cv->filenames_allocated = filenum+32;
-        dbgfmt_cv->filenames = yasm_xrealloc(dbgfmt_cv->filenames,
-            sizeof(cv_filename)*dbgfmt_cv->filenames_allocated);
-        for (i=old_allocated; i<dbgfmt_cv->filenames_allocated; i++) {
-            dbgfmt_cv->filenames[i].pathname = NULL;
-            dbgfmt_cv->filenames[i].filename = NULL;
-            dbgfmt_cv->filenames[i].str_off = 0;
-            dbgfmt_cv->filenames[i].info_off = 0;
-        }
-    }
-
-    /* Calculate MD5 checksum of file */
-    buf = yasm_xmalloc(1024);
-    yasm_md5_init(&context);
     f = fopen(filename, "rb");
     if (!f)
         yasm__fatal(N_("codeview: could not open source file"));
-    while ((len = fread(buf, 1, 1024, f)) > 0)
+    buf = yasm_xmalloc(CV_DIGEST_BUFSIZE);
+    yasm_md5_init(&context);
+    while ((len = fread(buf, 1, CV_DIGEST_BUFSIZE, f)) > 0)
         yasm_md5_update(&context, buf, (unsigned long)len);
-    yasm_md5_final(dbgfmt_cv->filenames[filenum].digest, &context);
-    fclose(f);
+    yasm_md5_final(digest, &context);
     yasm_xfree(buf);
+    fclose(f);
+}
 
-    /* Actually save in table */
-    if (dbgfmt_cv->filenames[filenum].pathname)
-        yasm_xfree(dbgfmt_cv->filenames[filenum].pathname);
-    if (dbgfmt_cv->filenames[filenum].filename)
-        yasm_xfree(dbgfmt_cv->filenames[filenum].filename);
+static size_t
+cv_dbgfmt_add_file(yasm_dbgfmt_cv *dbgfmt_cv, const char *filename)
+{
+    size_t filenum, i;
 
-    pathname = yasm__abspath(filename);
-    dbgfmt_cv->filenames[filenum].pathname = pathname;
-    dbgfmt_cv->filenames[filenum].filename = yasm__xstrdup(filename);
+    /* Nothing to do if we already have that filename in the table */
+    filenum = cv_dbgfmt_find_file(dbgfmt_cv, filename);
+    if (filenum != 0)
+        return filenum-1;
 
-    /* Update table size */
-    if (filenum >= dbgfmt_cv->filenames_size)
-        dbgfmt_cv->filenames_size = filenum + 1;
+    /* Append to the filename table, reallocating it if necessary */
+    filenum = dbgfmt_cv->filenames_size;
+    if (filenum >= dbgfmt_cv->filenames_allocated) {
+        dbgfmt_cv->filenames_allocated *= 2;
+        dbgfmt_cv->filenames = yasm_xrealloc(dbgfmt_cv->filenames,
+            sizeof(cv_filename)*dbgfmt_cv->filenames_allocated);
+    }
+
+    cv_file_digest(filename, dbgfmt_cv->filenames[filenum].digest);
+    dbgfmt_cv->filenames[filenum].pathname = yasm__abspath(filename);
+    dbgfmt_cv->filenames[filenum].filename = yasm__xstrdup(filename);
+    dbgfmt_cv->filenames[filenum].str_off = 0;
+    dbgfmt_cv->filenames[filenum].info_off = 0;
+    dbgfmt_cv->filenames_size++;
+
+    /* Add to the hash index, keeping it at most half full */
+    if (dbgfmt_cv->filenames_size*2 > dbgfmt_cv->filenames_hash_size) {
+        yasm_xfree(dbgfmt_cv->filenames_hash);
+        dbgfmt_cv->filenames_hash_size *= 2;
+        dbgfmt_cv->filenames_hash =
+            yasm_xcalloc(dbgfmt_cv->filenames_hash_size, sizeof(size_t));
+        for (i=0; i<dbgfmt_cv->filenames_size; i++)
+            cv_dbgfmt_index_file(dbgfmt_cv, i);
+    } else
+        cv_dbgfmt_index_file(dbgfmt_cv, filenum);
 
     return filenum;
 }
 
+static void
+cv_strtab_init(cv_strtab *strtab)
+{
+    strtab->alloc = 1024;
+    strtab->data = yasm_xmalloc(strtab->alloc);
+    strtab->data[0] = '\0';     /* string table starts with an empty string */
+    strtab->len = 1;
+    strtab->hash_size = 64;
+    strtab->hash = yasm_xcalloc(strtab->hash_size, sizeof(cv_strtab_slot));
+    strtab->count = 0;
+}
+
+/* Add a string to the string table (if not already present).  Returns its
+ * offset; *index is set to the order in which the string was first added.
+ */
+static unsigned long
+cv_strtab_add(cv_strtab *strtab, const char *str, /*@out@*/ size_t *index)
+{
+    size_t len = strlen(str);
+    unsigned long mask, i, offset;
+
+    /* Keep the hash table at most half full */
+    if ((strtab->count+1)*2 > strtab->hash_size) {
+        cv_strtab_slot *oldhash = strtab->hash;
+        unsigned long oldsize = strtab->hash_size, j;
+
+        strtab->hash_size *= 2;
+        strtab->hash = yasm_xcalloc(strtab->hash_size, sizeof(cv_strtab_slot));
+        mask = strtab->hash_size-1;
+        for (j=0; j<oldsize; j++) {
+            const char *s;
+            if (oldhash[j].offset == 0)
+                continue;
+            s = strtab->data + oldhash[j].offset;
+            i = phash_lookup(s, strlen(s), 0) & mask;
+            while (strtab->hash[i].offset != 0)
+                i = (i+1) & mask;
+            strtab->hash[i] = oldhash[j];
+        }
+        yasm_xfree(oldhash);
+    }
+
+    mask = strtab->hash_size-1;
+    i = phash_lookup(str, len, 0) & mask;
+    while ((offset = strtab->hash[i].offset) != 0) {
+        if (strcmp(strtab->data + offset, str) == 0) {
+            *index = strtab->hash[i].index;
+            return offset;
+        }
+        i = (i+1) & mask;
+    }
+
+    /* Not found; append */
+    offset = strtab->len;
+    if (offset + len + 1 > strtab->alloc) {
+        while (offset + len + 1 > strtab->alloc)
+            strtab->alloc *= 2;
+        strtab->data = yasm_xrealloc(strtab->data, strtab->alloc);
+    }
+    memcpy(strtab->data + offset, str, len+1);
+    strtab->len += (unsigned long)(len + 1);
+    strtab->hash[i].offset = offset;
+    strtab->hash[i].index = strtab->count;
+    *index = strtab->count++;
+    return offset;
+}
+
+/* Append the string table contents to a section as a single data bytecode.
+ * The table's data buffer is handed over to the bytecode.
+ */
 static yasm_bytecode *
-cv_append_str(yasm_section *sect, const char *str)
+cv_strtab_append(yasm_section *sect, /*@only@*/ cv_strtab *strtab)
 {
     yasm_datavalhead dvs;
     yasm_bytecode *bc;
 
     yasm_dvs_initialize(&dvs);
-    yasm_dvs_append(&dvs, yasm_dv_create_string(yasm__xstrdup(str),
-                                                strlen(str)));
-    bc = yasm_bc_create_data(&dvs, 1, 1, NULL, 0);
+    yasm_dvs_append(&dvs, yasm_dv_create_raw((unsigned char *)strtab->data,
+                                             strtab->len));
+    bc = yasm_bc_create_data(&dvs, 1, 0, NULL, 0);
     yasm_bc_finalize(bc, yasm_cv__append_bc(sect, bc));
     yasm_bc_calc_len(bc, NULL, NULL);
+
+    yasm_xfree(strtab->hash);
     return bc;
 }
 
@@ -419,11 +538,15 @@ typedef struct cv_line_info {
     yasm_object *object;
     yasm_dbgfmt_cv *dbgfmt_cv;
     yasm_linemap *linemap;
+    yasm_linemap_cursor cursor;
     yasm_errwarns *errwarns;
     unsigned int num_lineinfos;
     STAILQ_HEAD(cv8_lineinfo_head, cv8_lineinfo) cv8_lineinfos;
     /*@null@*/ cv8_lineinfo *cv8_cur_li;
-    /*@null@*/ cv8_lineset *cv8_cur_ls;
+    /* Filename of cv8_cur_li as returned by the linemap; linemap filenames
+     * are interned, so a pointer compare is enough to detect a change.
+     */
+    /*@null@*/ /*@dependent@*/ const char *cv8_cur_filename;
 } cv_line_info;
 
 static int
@@ -436,59 +559,58 @@ cv_generate_line_bc(yasm_bytecode *bc, /*@null@*/ void *d)
     unsigned long line;
     /*@null@*/ yasm_bytecode *nextbc = yasm_bc__next(bc);
     yasm_section *sect = yasm_bc_get_section(bc);
+    cv8_lineinfo *li;
 
     if (nextbc && bc->offset == nextbc->offset)
         return 0;
 
-    yasm_linemap_lookup(info->linemap, bc->line, &filename, &line);
+    yasm_linemap_lookup_cursor(info->linemap, &info->cursor, bc->line,
+                               &filename, &line);
 
-    if (!info->cv8_cur_li
-        || strcmp(filename, info->cv8_cur_li->fn->filename) != 0) {
-        yasm_bytecode *sectbc;
-        char symname[8];
-        int first_in_sect = !info->cv8_cur_li;
+    if (!info->cv8_cur_li || filename != info->cv8_cur_filename) {
+        /*@null@*/ cv8_lineinfo *prev_li = info->cv8_cur_li;
 
         /* Find file */
-        for (i=0; i<dbgfmt_cv->filenames_size; i++) {
-            if (strcmp(filename, dbgfmt_cv->filenames[i].filename) == 0)
-                break;
-        }
-        if (i >= dbgfmt_cv->filenames_size)
+        i = cv_dbgfmt_find_file(dbgfmt_cv, filename);
+        if (i == 0)
             yasm_internal_error(N_("could not find filename in table"));
 
         /* and create new lineinfo structure */
-        info->cv8_cur_li = yasm_xmalloc(sizeof(cv8_lineinfo));
-        info->cv8_cur_li->fn = &dbgfmt_cv->filenames[i];
-        info->cv8_cur_li->sect = sect;
-        info->cv8_cur_li->first_in_sect = first_in_sect;
-        sectbc = yasm_section_bcs_first(sect);
-        if (sectbc->symrecs && sectbc->symrecs[0])
-            info->cv8_cur_li->sectsym = sectbc->symrecs[0];
+        li = yasm_xmalloc(sizeof(cv8_lineinfo));
+        li->fn = &dbgfmt_cv->filenames[i-1];
+        li->sect = sect;
+        li->first_in_sect = !prev_li;
+        if (prev_li)
+            li->sectsym = prev_li->sectsym;
         else {
-            sprintf(symname, ".%06u", info->num_lineinfos++);
-            info->cv8_cur_li->sectsym =
-                yasm_symtab_define_label(info->object->symtab, symname, sectbc,
-                                         1, 0);
+            yasm_bytecode *sectbc = yasm_section_bcs_first(sect);
+            if (sectbc->symrecs && sectbc->symrecs[0])
+                li->sectsym = sectbc->symrecs[0];
+            else {
+                char symname[8];
+                sprintf(symname, ".%06u", info->num_lineinfos++);
+                li->sectsym = yasm_symtab_define_label(info->object->symtab,
+                                                       symname, sectbc, 1, 0);
+            }
         }
-        info->cv8_cur_li->num_linenums = 0;
-        STAILQ_INIT(&info->cv8_cur_li->linesets);
-        STAILQ_INSERT_TAIL(&info->cv8_lineinfos, info->cv8_cur_li, link);
-        info->cv8_cur_ls = NULL;
-    }
-
-    /* build new lineset if necessary */
-    if (!info->cv8_cur_ls || info->cv8_cur_ls->num_pairs >= 126) {
-        info->cv8_cur_ls = yasm_xmalloc(sizeof(cv8_lineset));
-        info->cv8_cur_ls->num_pairs = 0;
-        STAILQ_INSERT_TAIL(&info->cv8_cur_li->linesets, info->cv8_cur_ls, link);
+        li->num_linenums = 0;
+        li->alloc_linenums = 16;
+        li->pairs = yasm_xmalloc(li->alloc_linenums*sizeof(cv8_linepair));
+        STAILQ_INSERT_TAIL(&info->cv8_lineinfos, li, link);
+        info->cv8_cur_li = li;
+        info->cv8_cur_filename = filename;
     }
+    li = info->cv8_cur_li;
 
     /* add linepair for this bytecode */
-    info->cv8_cur_ls->pairs[info->cv8_cur_ls->num_pairs].offset = bc->offset;
-    info->cv8_cur_ls->pairs[info->cv8_cur_ls->num_pairs].line =
-        0x80000000 | line;
-    info->cv8_cur_ls->num_pairs++;
-    info->cv8_cur_li->num_linenums++;
+    if (li->num_linenums >= li->alloc_linenums) {
+        li->alloc_linenums *= 2;
+        li->pairs = yasm_xrealloc(li->pairs,
+                                  li->alloc_linenums*sizeof(cv8_linepair));
+    }
+    li->pairs[li->num_linenums].offset = bc->offset;
+    li->pairs[li->num_linenums].line = 0x80000000 | line;
+    li->num_linenums++;
 
     return 0;
 }
@@ -502,7 +624,7 @@ cv_generate_line_section(yasm_section *sect, /*@null@*/ void *d)
         return 0;       /* not code, so no line data for this section */
 
     info->cv8_cur_li = NULL;
-    info->cv8_cur_ls = NULL;
+    info->cv8_cur_filename = NULL;
 
     yasm_section_bcs_traverse(sect, info->errwarns, info, cv_generate_line_bc);
 
@@ -512,7 +634,7 @@ cv_generate_line_section(yasm_section *sect, /*@null@*/ void *d)
 static int
 cv_generate_filename(const char *filename, void *d)
 {
-    cv_dbgfmt_add_file((yasm_dbgfmt_cv *)d, 0, filename);
+    cv_dbgfmt_add_file((yasm_dbgfmt_cv *)d, filename);
     return 0;
 }
 
@@ -550,6 +672,7 @@ yasm_cv__generate_symline(yasm_object *object, yasm_linemap *linemap,
     cv8_symhead *head;
     cv8_lineinfo *li;
     yasm_bytecode *bc;
+    cv_strtab strtab;
     unsigned long off;
 
     /* Generate filenames based on linemap */
@@ -559,30 +682,34 @@ yasm_cv__generate_symline(yasm_object *object, yasm_linemap *linemap,
     info.object = object;
     info.dbgfmt_cv = dbgfmt_cv;
     info.linemap = linemap;
+    yasm_linemap_cursor_init(&info.cursor);
     info.errwarns = errwarns;
     info.debug_symline =
         yasm_object_get_general(object, ".debug$S", 1, 0, 0, &new, 0);
     info.num_lineinfos = 0;
     STAILQ_INIT(&info.cv8_lineinfos);
     info.cv8_cur_li = NULL;
-    info.cv8_cur_ls = NULL;
+    info.cv8_cur_filename = NULL;
 
-    /* source filenames string table */
+    /* source filenames string table; files with the same full pathname
+     * share a single string and source file info entry.
+     */
     head = cv8_add_symhead(info.debug_symline, CV8_FILE_STRTAB, 1);
-    cv_append_str(info.debug_symline, "");
-    off = 1;
+    cv_strtab_init(&strtab);
     for (i=0; i<dbgfmt_cv->filenames_size; i++) {
+        size_t index;
         if (!dbgfmt_cv->filenames[i].pathname) {
             yasm_error_set(YASM_ERROR_GENERAL,
                            N_("codeview file number %d unassigned"), i+1);
             yasm_errwarn_propagate(errwarns, 0);
             continue;
         }
-        bc = cv_append_str(info.debug_symline,
-                           dbgfmt_cv->filenames[i].pathname);
-        dbgfmt_cv->filenames[i].str_off = off;
-        off += bc->len;
+        dbgfmt_cv->filenames[i].str_off =
+            cv_strtab_add(&strtab, dbgfmt_cv->filenames[i].pathname, &index);
+        dbgfmt_cv->filenames[i].info_off =
+            (unsigned long)index*CV8_FILEINFO_SIZE;
     }
+    cv_strtab_append(info.debug_symline, &strtab);
     cv8_set_symhead_end(head, yasm_section_bcs_last(info.debug_symline));
 
     /* Align 4 */
@@ -596,11 +723,12 @@ yasm_cv__generate_symline(yasm_object *object, yasm_linemap *linemap,
     head = cv8_add_symhead(info.debug_symline, CV8_FILE_INFO, 0);
     off = 0;
     for (i=0; i<dbgfmt_cv->filenames_size; i++) {
-        if (!dbgfmt_cv->filenames[i].pathname)
+        /* only the first file with each pathname gets an entry */
+        if (!dbgfmt_cv->filenames[i].pathname
+            || dbgfmt_cv->filenames[i].info_off != off)
             continue;
-        bc = cv8_add_fileinfo(info.debug_symline, &dbgfmt_cv->filenames[i]);
-        dbgfmt_cv->filenames[i].info_off = off;
-        off += bc->len;
+        cv8_add_fileinfo(info.debug_symline, &dbgfmt_cv->filenames[i]);
+        off += CV8_FILEINFO_SIZE;
     }
     cv8_set_symhead_end(head, yasm_section_bcs_last(info.debug_symline));
 
@@ -767,7 +895,7 @@ cv8_add_fileinfo(yasm_section *sect, const cv_filename *fn)
     fi->fn = fn;
 
     bc = yasm_bc_create_common(&cv8_fileinfo_bc_callback, fi, 0);
-    bc->len = 24;
+    bc->len = CV8_FILEINFO_SIZE;
 
     yasm_cv__append_bc(sect, bc);
     return bc;
@@ -834,16 +962,8 @@ static void
 cv8_lineinfo_bc_destroy(void *contents)
 {
     cv8_lineinfo *li = (cv8_lineinfo *)contents;
-    cv8_lineset *ls1, *ls2;
-
-    /* delete line sets */
-    ls1 = STAILQ_FIRST(&li->linesets);
-    while (ls1) {
-        ls2 = STAILQ_NEXT(ls1, link);
-        yasm_xfree(ls1);
-        ls1 = ls2;
-    }
 
+    yasm_xfree(li->pairs);
     yasm_xfree(contents);
 }
 
@@ -873,7 +993,6 @@ cv8_lineinfo_bc_tobytes(yasm_bytecode *bc, unsigned char **bufp,
     unsigned char *buf = *bufp;
     yasm_intnum *cval;
     unsigned long i;
-    cv8_lineset *ls;
 
     if (li->first_in_sect) {
         /* start offset and section */
@@ -907,21 +1026,10 @@ cv8_lineinfo_bc_tobytes(yasm_bytecode *bc, unsigned char **bufp,
     yasm_arch_intnum_tobytes(object->arch, cval, buf, 4, 32, 0, bc, 0);
     buf += 4;
 
-    /* Offset / line number pairs */
-    i = 0;
-    STAILQ_FOREACH(ls, &li->linesets, link) {
-        unsigned long j;
-        for (j=0; i<li->num_linenums && j<126; i++, j++) {
-            /* offset in section */
-            yasm_intnum_set_uint(cval, ls->pairs[j].offset);
-            yasm_arch_intnum_tobytes(object->arch, cval, buf, 4, 32, 0, bc, 0);
-            buf += 4;
-
-            /* line number in file */
-            yasm_intnum_set_uint(cval, ls->pairs[j].line);
-            yasm_arch_intnum_tobytes(object->arch, cval, buf, 4, 32, 0, bc, 0);
-            buf += 4;
-        }
+    /* Offset / line number pairs (CodeView is always little endian) */
+    for (i=0; i<li->num_linenums; i++) {
+        YASM_WRITE_32_L(buf, li->pairs[i].offset);  /* offset in section */
+        YASM_WRITE_32_L(buf, li->pairs[i].line);    /* line number in file */
     }
 
     *bufp = buf;
@@ -98,6 +98,16 @@ dwarf2_dbgfmt_create(yasm_object *object)
         dbgfmt_dwarf2->filenames[i].dir = 0;
     }
 
+    dbgfmt_dwarf2->dirs_hash_size = 64;
+    dbgfmt_dwarf2->dirs_hash =
+        yasm_xcalloc(dbgfmt_dwarf2->dirs_hash_size, sizeof(unsigned long));
+    dbgfmt_dwarf2->filenames_hash_size = 64;
+    dbgfmt_dwarf2->filenames_hash_count = 0;
+    dbgfmt_dwarf2->filenames_hash =
+        yasm_xcalloc(dbgfmt_dwarf2->filenames_hash_size,
+                     sizeof(unsigned long));
+    dbgfmt_dwarf2->filenames_free = 0;
+
     dbgfmt_dwarf2->format = DWARF2_FORMAT_32BIT;    /* TODO: flexible? */
 
     dbgfmt_dwarf2->sizeof_address = yasm_arch_get_address_size(object->arch)/8;
@@ -130,6 +140,8 @@ dwarf2_dbgfmt_destroy(/*@only@*/ yasm_dbgfmt *dbgfmt)
             yasm_xfree(dbgfmt_dwarf2->filenames[i].filename);
     }
     yasm_xfree(dbgfmt_dwarf2->filenames);
+    yasm_xfree(dbgfmt_dwarf2->dirs_hash);
+    yasm_xfree(dbgfmt_dwarf2->filenames_hash);
     yasm_xfree(dbgfmt);
 }
 
@@ -48,6 +48,19 @@ typedef struct yasm_dbgfmt_dwarf2 {
     unsigned long filenames_size;
     unsigned long filenames_allocated;
 
+    /* Open-addressed hash indexes into the above tables.  Each slot holds
+     * a 1-based table index, or 0 if empty.  The dirs index is keyed on the
+     * directory name; the filenames index on the (dir, filename) pair.
+     */
+    unsigned long *dirs_hash;
+    unsigned long dirs_hash_size;
+    unsigned long *filenames_hash;
+    unsigned long filenames_hash_size;
+    unsigned long filenames_hash_count;
+
+    /* lowest unassigned filenames slot (filenames_size if none) */
+    unsigned long filenames_free;
+
     enum {
         DWARF2_FORMAT_32BIT,
         DWARF2_FORMAT_64BIT
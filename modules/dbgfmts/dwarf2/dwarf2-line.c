@@ -30,6 +30,7 @@
 #include <util.h>
 
 #include <libyasm.h>
+#include <libyasm/phash.h>
 
 #include "dwarf2-dbgfmt.h"
 
@@ -106,6 +107,7 @@ typedef struct dwarf2_line_state {
 
     /* other state information */
     /*@null@*/ yasm_bytecode *precbc;
+    struct dwarf2_line_prog *prog;      /* program being generated */
 } dwarf2_line_state;
 
 typedef struct dwarf2_spp {
@@ -113,16 +115,29 @@ typedef struct dwarf2_spp {
     yasm_bytecode *line_end_prevbc;
 } dwarf2_spp;
 
-typedef struct dwarf2_line_op {
-    dwarf_line_number_op opcode;
-    /*@owned@*/ /*@null@*/ yasm_intnum *operand;
+/* Line number program for one sequence, encoded directly into a byte
+ * buffer.  The only operands needing relocation are DW_LNE_set_address
+ * addresses; their positions are recorded and output at tobytes time.
+ */
+typedef struct dwarf2_line_addr {
+    unsigned long pos;                  /* offset of address in buf */
+    /*@dependent@*/ yasm_symrec *sym;
+} dwarf2_line_addr;
+
+typedef struct dwarf2_line_prog {
+    /*@owned@*/ unsigned char *buf;
+    unsigned long len;
+    unsigned long alloc;
+
+    /*@owned@*/ /*@null@*/ dwarf2_line_addr *addrs;
+    unsigned long num_addrs;
+    unsigned long alloc_addrs;
+
+    unsigned int sizeof_address;
+} dwarf2_line_prog;
 
-    /* extended opcode */
-    dwarf_line_number_ext_op ext_opcode;
-    /*@null@*/ /*@dependent@*/ yasm_symrec *ext_operand;  /* unsigned */
-    /*@null@*/ /*@dependent@*/ yasm_intnum *ext_operand_int; /* unsigned */
-    unsigned long ext_operandsize;
-} dwarf2_line_op;
+/* Maximum encoded size of a single line program opcode */
+#define DWARF2_LINE_OP_MAXLEN   32
 
 /* Bytecode callback function prototypes */
 static void dwarf2_spp_bc_destroy(void *contents);
@@ -135,12 +150,12 @@ static int dwarf2_spp_bc_tobytes
      yasm_output_value_func output_value,
      /*@null@*/ yasm_output_reloc_func output_reloc);
 
-static void dwarf2_line_op_bc_destroy(void *contents);
-static void dwarf2_line_op_bc_print(const void *contents, FILE *f,
-                                    int indent_level);
-static int dwarf2_line_op_bc_calc_len
+static void dwarf2_line_prog_bc_destroy(void *contents);
+static void dwarf2_line_prog_bc_print(const void *contents, FILE *f,
+                                      int indent_level);
+static int dwarf2_line_prog_bc_calc_len
     (yasm_bytecode *bc, yasm_bc_add_span_func add_span, void *add_span_data);
-static int dwarf2_line_op_bc_tobytes
+static int dwarf2_line_prog_bc_tobytes
     (yasm_bytecode *bc, unsigned char **bufp, unsigned char *bufstart, void *d,
      yasm_output_value_func output_value,
      /*@null@*/ yasm_output_reloc_func output_reloc);
@@ -157,18 +172,140 @@ static const yasm_bytecode_callback dwarf2_spp_bc_callback = {
     0
 };
 
-static const yasm_bytecode_callback dwarf2_line_op_bc_callback = {
-    dwarf2_line_op_bc_destroy,
-    dwarf2_line_op_bc_print,
+static const yasm_bytecode_callback dwarf2_line_prog_bc_callback = {
+    dwarf2_line_prog_bc_destroy,
+    dwarf2_line_prog_bc_print,
     yasm_bc_finalize_common,
     NULL,
-    dwarf2_line_op_bc_calc_len,
+    dwarf2_line_prog_bc_calc_len,
     yasm_bc_expand_common,
-    dwarf2_line_op_bc_tobytes,
+    dwarf2_line_prog_bc_tobytes,
     0
 };
 
 
+/* Look up a directory (the first dirlen characters of pathname) in the
+ * directory table.  Returns the 1-based directory index, or 0 if not found;
+ * in that case *slot is set to the empty hash slot it should be put in.
+ */
+static unsigned long
+dwarf2_dbgfmt_find_dir(const yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2,
+                       const char *pathname, size_t dirlen,
+                       /*@out@*/ unsigned long *slot)
+{
+    unsigned long mask = dbgfmt_dwarf2->dirs_hash_size-1;
+    unsigned long i = phash_lookup(pathname, dirlen, 0) & mask;
+    unsigned long dir;
+
+    while ((dir = dbgfmt_dwarf2->dirs_hash[i]) != 0) {
+        if (strncmp(dbgfmt_dwarf2->dirs[dir-1], pathname, dirlen) == 0
+            && dbgfmt_dwarf2->dirs[dir-1][dirlen] == '\0')
+            break;
+        i = (i+1) & mask;
+    }
+    *slot = i;
+    return dir;
+}
+
+static unsigned long
+dwarf2_dbgfmt_add_dir(yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2, const char *pathname,
+                      size_t dirlen)
+{
+    unsigned long dir, slot;
+
+    /* Keep the hash index at most half full */
+    if ((dbgfmt_dwarf2->dirs_size+1)*2 > dbgfmt_dwarf2->dirs_hash_size) {
+        unsigned long mask;
+
+        yasm_xfree(dbgfmt_dwarf2->dirs_hash);
+        dbgfmt_dwarf2->dirs_hash_size *= 2;
+        dbgfmt_dwarf2->dirs_hash =
+            yasm_xcalloc(dbgfmt_dwarf2->dirs_hash_size, sizeof(unsigned long));
+        mask = dbgfmt_dwarf2->dirs_hash_size-1;
+        for (dir=1; dir<dbgfmt_dwarf2->dirs_size+1; dir++) {
+            const char *d = dbgfmt_dwarf2->dirs[dir-1];
+            slot = phash_lookup(d, strlen(d), 0) & mask;
+            while (dbgfmt_dwarf2->dirs_hash[slot] != 0)
+                slot = (slot+1) & mask;
+            dbgfmt_dwarf2->dirs_hash[slot] = dir;
+        }
+    }
+
+    /* Look to see if we already have that dir in the table */
+    dir = dwarf2_dbgfmt_find_dir(dbgfmt_dwarf2, pathname, dirlen, &slot);
+    if (dir != 0)
+        return dir;
+
+    /* Not found in table, add to end, reallocing if necessary */
+    dir = dbgfmt_dwarf2->dirs_size+1;
+    if (dir >= dbgfmt_dwarf2->dirs_allocated+1) {
+        dbgfmt_dwarf2->dirs_allocated = dir+32;
+        dbgfmt_dwarf2->dirs = yasm_xrealloc(dbgfmt_dwarf2->dirs,
+            sizeof(char *)*dbgfmt_dwarf2->dirs_allocated);
+    }
+    dbgfmt_dwarf2->dirs[dir-1] = yasm__xstrndup(pathname, dirlen);
+    dbgfmt_dwarf2->dirs_size = dir;
+    dbgfmt_dwarf2->dirs_hash[slot] = dir;
+    return dir;
+}
+
+/* Look up a (dir, filename) pair in the filename table.  Returns the lowest
+ * matching 0-based index plus one, or 0 if not found.  The hash index may
+ * hold stale entries for slots that were later redefined by an explicit
+ * file number, so each candidate is checked against the table itself.
+ */
+static unsigned long
+dwarf2_dbgfmt_find_filename(const yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2,
+                            unsigned long dir, const char *filename)
+{
+    unsigned long mask = dbgfmt_dwarf2->filenames_hash_size-1;
+    unsigned long i = phash_lookup(filename, strlen(filename), dir) & mask;
+    unsigned long n, found = 0;
+
+    while ((n = dbgfmt_dwarf2->filenames_hash[i]) != 0) {
+        const dwarf2_filename *fn = &dbgfmt_dwarf2->filenames[n-1];
+        if ((found == 0 || n < found) && fn->filename && fn->dir == dir
+            && strcmp(fn->filename, filename) == 0)
+            found = n;
+        i = (i+1) & mask;
+    }
+    return found;
+}
+
+static void
+dwarf2_dbgfmt_index_filename(yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2,
+                             unsigned long filenum)
+{
+    const dwarf2_filename *fn = &dbgfmt_dwarf2->filenames[filenum];
+    unsigned long mask = dbgfmt_dwarf2->filenames_hash_size-1;
+    unsigned long i = phash_lookup(fn->filename, strlen(fn->filename),
+                                   fn->dir) & mask;
+
+    while (dbgfmt_dwarf2->filenames_hash[i] != 0)
+        i = (i+1) & mask;
+    dbgfmt_dwarf2->filenames_hash[i] = filenum+1;
+    dbgfmt_dwarf2->filenames_hash_count++;
+}
+
+/* Find the 1-based file number of pathname in the filename table, or 0 if
+ * it's not in the table.
+ */
+static unsigned long
+dwarf2_dbgfmt_find_file(const yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2,
+                        const char *pathname)
+{
+    const char *filename;
+    size_t dirlen = yasm__splitpath(pathname, &filename);
+    unsigned long dir = 0, slot;
+
+    if (dirlen > 0) {
+        dir = dwarf2_dbgfmt_find_dir(dbgfmt_dwarf2, pathname, dirlen, &slot);
+        if (dir == 0)
+            return 0;
+    }
+    return dwarf2_dbgfmt_find_filename(dbgfmt_dwarf2, dir, filename);
+}
+
 static size_t
 dwarf2_dbgfmt_add_file(yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2, unsigned long filenum,
                        const char *pathname)
@@ -180,35 +317,19 @@ dwarf2_dbgfmt_add_file(yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2, unsigned long filenum,
     /* Put the directory into the directory table */
     dir = 0;
     dirlen = yasm__splitpath(pathname, &filename);
-    if (dirlen > 0) {
-        /* Look to see if we already have that dir in the table */
-        for (dir=1; dir<dbgfmt_dwarf2->dirs_size+1; dir++) {
-            if (strncmp(dbgfmt_dwarf2->dirs[dir-1], pathname, dirlen) == 0
-                && dbgfmt_dwarf2->dirs[dir-1][dirlen] == '\0')
-                break;
-        }
-        if (dir >= dbgfmt_dwarf2->dirs_size+1) {
-            /* Not found in table, add to end, reallocing if necessary */
-            if (dir >= dbgfmt_dwarf2->dirs_allocated+1) {
-                dbgfmt_dwarf2->dirs_allocated = dir+32;
-                dbgfmt_dwarf2->dirs = yasm_xrealloc(dbgfmt_dwarf2->dirs,
-                    sizeof(char *)*dbgfmt_dwarf2->dirs_allocated);
-            }
-            dbgfmt_dwarf2->dirs[dir-1] = yasm__xstrndup(pathname, dirlen);
-            dbgfmt_dwarf2->dirs_size = dir;
-        }
-    }
+    if (dirlen > 0)
+        dir = dwarf2_dbgfmt_add_dir(dbgfmt_dwarf2, pathname, dirlen);
 
     /* Put the filename into the filename table */
     if (filenum == 0) {
-        /* Look to see if we already have that filename in the table */
-        for (; filenum<dbgfmt_dwarf2->filenames_size; filenum++) {
-            if (!dbgfmt_dwarf2->filenames[filenum].filename ||
-                (dbgfmt_dwarf2->filenames[filenum].dir == dir
-                 && strcmp(dbgfmt_dwarf2->filenames[filenum].filename,
-                           filename) == 0))
-                break;
-        }
+        /* Use the first slot that's either unassigned or already has that
+         * filename.
+         */
+        filenum = dwarf2_dbgfmt_find_filename(dbgfmt_dwarf2, dir, filename);
+        if (filenum == 0 || filenum-1 > dbgfmt_dwarf2->filenames_free)
+            filenum = dbgfmt_dwarf2->filenames_free;
+        else
+            filenum--;
     } else
         filenum--;      /* array index is 0-based */
 
@@ -234,86 +355,194 @@ dwarf2_dbgfmt_add_file(yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2, unsigned long filenum,
     dbgfmt_dwarf2->filenames[filenum].filename = yasm__xstrdup(filename);
     dbgfmt_dwarf2->filenames[filenum].dir = dir;
 
-    /* Update table size */
+    /* Update table size and the lowest unassigned slot */
     if (filenum >= dbgfmt_dwarf2->filenames_size)
         dbgfmt_dwarf2->filenames_size = filenum + 1;
+    while (dbgfmt_dwarf2->filenames_free < dbgfmt_dwarf2->filenames_size
+           && dbgfmt_dwarf2->filenames[dbgfmt_dwarf2->filenames_free].filename)
+        dbgfmt_dwarf2->filenames_free++;
+
+    /* Update hash index; rebuild it (dropping stale entries) if it's
+     * getting full.
+     */
+    if ((dbgfmt_dwarf2->filenames_hash_count+1)*2 >
+        dbgfmt_dwarf2->filenames_hash_size) {
+        yasm_xfree(dbgfmt_dwarf2->filenames_hash);
+        while (dbgfmt_dwarf2->filenames_size*2 >=
+               dbgfmt_dwarf2->filenames_hash_size)
+            dbgfmt_dwarf2->filenames_hash_size *= 2;
+        dbgfmt_dwarf2->filenames_hash =
+            yasm_xcalloc(dbgfmt_dwarf2->filenames_hash_size,
+                         sizeof(unsigned long));
+        dbgfmt_dwarf2->filenames_hash_count = 0;
+        for (i=0; i<dbgfmt_dwarf2->filenames_size; i++) {
+            if (dbgfmt_dwarf2->filenames[i].filename)
+                dwarf2_dbgfmt_index_filename(dbgfmt_dwarf2, i);
+        }
+    } else
+        dwarf2_dbgfmt_index_filename(dbgfmt_dwarf2, filenum);
 
     return filenum;
 }
 
-/* Create and add a new line opcode to a section, updating offset on insertion;
- * no optimization necessary.
+static dwarf2_line_prog *
+dwarf2_line_prog_create(const yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2)
+{
+    dwarf2_line_prog *prog = yasm_xmalloc(sizeof(dwarf2_line_prog));
+
+    prog->alloc = 256;
+    prog->buf = yasm_xmalloc(prog->alloc);
+    prog->len = 0;
+    prog->addrs = NULL;
+    prog->num_addrs = 0;
+    prog->alloc_addrs = 0;
+    prog->sizeof_address = dbgfmt_dwarf2->sizeof_address;
+    return prog;
+}
+
+static void
+dwarf2_line_prog_destroy(/*@only@*/ dwarf2_line_prog *prog)
+{
+    yasm_xfree(prog->buf);
+    if (prog->addrs)
+        yasm_xfree(prog->addrs);
+    yasm_xfree(prog);
+}
+
+/* Make room for at least one more opcode and return a pointer to the end of
+ * the program.
  */
-static yasm_bytecode *
-dwarf2_dbgfmt_append_line_op(yasm_section *sect, dwarf_line_number_op opcode,
-                             /*@only@*/ /*@null@*/ yasm_intnum *operand)
+static unsigned char *
+dwarf2_line_prog_reserve(dwarf2_line_prog *prog)
 {
-    dwarf2_line_op *line_op = yasm_xmalloc(sizeof(dwarf2_line_op));
-    yasm_bytecode *bc;
+    if (prog->len + DWARF2_LINE_OP_MAXLEN > prog->alloc) {
+        prog->alloc *= 2;
+        prog->buf = yasm_xrealloc(prog->buf, prog->alloc);
+    }
+    return prog->buf + prog->len;
+}
+
+/* LEB128 encoders for full-width (unsigned) long values */
+static unsigned long
+dwarf2_write_uleb128(unsigned long v, unsigned char *ptr)
+{
+    unsigned char *ptr_orig = ptr;
+
+    do {
+        *ptr = (unsigned char)(v & 0x7F);
+        v >>= 7;
+        if (v != 0)
+            *ptr |= 0x80;
+        ptr++;
+    } while (v != 0);
+    return (unsigned long)(ptr-ptr_orig);
+}
 
-    line_op->opcode = opcode;
-    line_op->operand = operand;
-    line_op->ext_opcode = 0;
-    line_op->ext_operand = NULL;
-    line_op->ext_operand_int = NULL;
-    line_op->ext_operandsize = 0;
+static unsigned long
+dwarf2_write_sleb128(long v, unsigned char *ptr)
+{
+    unsigned char *ptr_orig = ptr;
+    unsigned char byte;
+    int more;
+
+    do {
+        byte = (unsigned char)(v & 0x7F);
+        if (v < 0)
+            v = ~(~v >> 7);     /* arithmetic shift */
+        else
+            v >>= 7;
+        more = !((v == 0 && !(byte & 0x40)) || (v == -1 && (byte & 0x40)));
+        if (more)
+            byte |= 0x80;
+        *ptr++ = byte;
+    } while (more);
+    return (unsigned long)(ptr-ptr_orig);
+}
 
-    bc = yasm_bc_create_common(&dwarf2_line_op_bc_callback, line_op, 0);
-    bc->len = 1;
-    if (operand)
-        bc->len += yasm_intnum_size_leb128(operand,
-                                           opcode == DW_LNS_advance_line);
+/* Append a line opcode with no operands. */
+static void
+dwarf2_line_prog_op(dwarf2_line_prog *prog, unsigned int opcode)
+{
+    unsigned char *buf = dwarf2_line_prog_reserve(prog);
+    buf[0] = (unsigned char)opcode;
+    prog->len++;
+}
 
-    yasm_dwarf2__append_bc(sect, bc);
-    return bc;
+/* Append a line opcode with a single unsigned LEB128 operand. */
+static void
+dwarf2_line_prog_op_uleb(dwarf2_line_prog *prog, dwarf_line_number_op opcode,
+                         unsigned long operand)
+{
+    unsigned char *buf = dwarf2_line_prog_reserve(prog);
+    buf[0] = (unsigned char)opcode;
+    prog->len += 1 + dwarf2_write_uleb128(operand, buf+1);
 }
 
-/* Create and add a new extended line opcode to a section, updating offset on
- * insertion; no optimization necessary.
+/* Append a line opcode with a single signed LEB128 operand. */
+static void
+dwarf2_line_prog_op_sleb(dwarf2_line_prog *prog, dwarf_line_number_op opcode,
+                         long operand)
+{
+    unsigned char *buf = dwarf2_line_prog_reserve(prog);
+    buf[0] = (unsigned char)opcode;
+    prog->len += 1 + dwarf2_write_sleb128(operand, buf+1);
+}
+
+/* Append an extended line opcode with an optional unsigned LEB128 operand
+ * (only if operandsize is nonzero).
  */
-static yasm_bytecode *
-dwarf2_dbgfmt_append_line_ext_op(yasm_section *sect,
-                                 dwarf_line_number_ext_op ext_opcode,
-                                 unsigned long ext_operandsize,
-                                 /*@null@*/ yasm_symrec *ext_operand)
+static void
+dwarf2_line_prog_ext_op(dwarf2_line_prog *prog,
+                        dwarf_line_number_ext_op ext_opcode,
+                        unsigned long operandsize, unsigned long operand)
 {
-    dwarf2_line_op *line_op = yasm_xmalloc(sizeof(dwarf2_line_op));
-    yasm_bytecode *bc;
+    unsigned char *buf = dwarf2_line_prog_reserve(prog);
+    unsigned long len = 0;
+
+    buf[len++] = DW_LNS_extended_op;
+    len += dwarf2_write_uleb128(operandsize+1, buf+len);
+    buf[len++] = (unsigned char)ext_opcode;
+    if (operandsize > 0)
+        len += dwarf2_write_uleb128(operand, buf+len);
+    prog->len += len;
+}
 
-    line_op->opcode = DW_LNS_extended_op;
-    line_op->operand = yasm_intnum_create_uint(ext_operandsize+1);
-    line_op->ext_opcode = ext_opcode;
-    line_op->ext_operand = ext_operand;
-    line_op->ext_operand_int = NULL;
-    line_op->ext_operandsize = ext_operandsize;
+/* Append a DW_LNE_set_address to sym.  The address itself is filled in
+ * (and relocated) at output time.
+ */
+static void
+dwarf2_line_prog_set_address(dwarf2_line_prog *prog, yasm_symrec *sym)
+{
+    unsigned char *buf = dwarf2_line_prog_reserve(prog);
+    unsigned long len = 0;
 
-    bc = yasm_bc_create_common(&dwarf2_line_op_bc_callback, line_op, 0);
-    bc->len = 2 + yasm_intnum_size_leb128(line_op->operand, 0) +
-        ext_operandsize;
+    buf[len++] = DW_LNS_extended_op;
+    len += dwarf2_write_uleb128(prog->sizeof_address+1, buf+len);
+    buf[len++] = DW_LNE_set_address;
 
-    yasm_dwarf2__append_bc(sect, bc);
-    return bc;
+    if (prog->num_addrs >= prog->alloc_addrs) {
+        prog->alloc_addrs = prog->alloc_addrs ? prog->alloc_addrs*2 : 4;
+        prog->addrs = yasm_xrealloc(prog->addrs,
+                                    prog->alloc_addrs*sizeof(dwarf2_line_addr));
+    }
+    prog->addrs[prog->num_addrs].pos = prog->len + len;
+    prog->addrs[prog->num_addrs].sym = sym;
+    prog->num_addrs++;
+
+    memset(buf+len, 0, prog->sizeof_address);
+    prog->len += len + prog->sizeof_address;
 }
 
+/* Add a finished line program to a section as a single bytecode, updating
+ * offset on insertion; no optimization necessary.
+ */
 static yasm_bytecode *
-dwarf2_dbgfmt_append_line_ext_op_int(yasm_section *sect,
-                                     dwarf_line_number_ext_op ext_opcode,
-                                     /*@only@*/ yasm_intnum *ext_operand)
+dwarf2_line_prog_append(yasm_section *sect, /*@only@*/ dwarf2_line_prog *prog)
 {
-    dwarf2_line_op *line_op = yasm_xmalloc(sizeof(dwarf2_line_op));
-    unsigned long ext_operandsize = yasm_intnum_size_leb128(ext_operand, 0);
     yasm_bytecode *bc;
 
-    line_op->opcode = DW_LNS_extended_op;
-    line_op->operand = yasm_intnum_create_uint(ext_operandsize+1);
-    line_op->ext_opcode = ext_opcode;
-    line_op->ext_operand = NULL;
-    line_op->ext_operand_int = ext_operand;
-    line_op->ext_operandsize = ext_operandsize;
-
-    bc = yasm_bc_create_common(&dwarf2_line_op_bc_callback, line_op, 0);
-    bc->len = 2 + yasm_intnum_size_leb128(line_op->operand, 0) +
-        ext_operandsize;
+    bc = yasm_bc_create_common(&dwarf2_line_prog_bc_callback, prog, 0);
+    bc->len = prog->len;
 
     yasm_dwarf2__append_bc(sect, bc);
     return bc;
@@ -352,54 +581,50 @@ dwarf2_dbgfmt_finalize_locs(yasm_section *sect, dwarf2_section_data *dsd)
 }
 
 static int
-dwarf2_dbgfmt_gen_line_op(yasm_section *debug_line, dwarf2_line_state *state,
-                          const dwarf2_loc *loc,
+dwarf2_dbgfmt_gen_line_op(dwarf2_line_state *state, const dwarf2_loc *loc,
                           /*@null@*/ const dwarf2_loc *nextloc)
 {
     unsigned long addr_delta;
     long line_delta;
     int opcode1, opcode2;
     yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2 = state->dbgfmt_dwarf2;
+    dwarf2_line_prog *prog = state->prog;
 
     if (state->file != loc->file) {
         state->file = loc->file;
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_set_file,
-                                     yasm_intnum_create_uint(state->file));
+        dwarf2_line_prog_op_uleb(prog, DW_LNS_set_file, state->file);
     }
     if (state->column != loc->column) {
         state->column = loc->column;
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_set_column,
-                                     yasm_intnum_create_uint(state->column));
+        dwarf2_line_prog_op_uleb(prog, DW_LNS_set_column, state->column);
     }
     if (loc->discriminator != 0) {
-        dwarf2_dbgfmt_append_line_ext_op_int(debug_line,
-            DW_LNE_set_discriminator,
-            yasm_intnum_create_uint(loc->discriminator));
+        dwarf2_line_prog_ext_op(prog, DW_LNE_set_discriminator,
+                                yasm_size_uleb128(loc->discriminator),
+                                loc->discriminator);
     }
 #ifdef WITH_DWARF3
     if (loc->isa_change) {
         state->isa = loc->isa;
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_set_isa,
-                                     yasm_intnum_create_uint(state->isa));
+        dwarf2_line_prog_op_uleb(prog, DW_LNS_set_isa, state->isa);
     }
 #endif
     if (state->is_stmt == 0 && loc->is_stmt == IS_STMT_SET) {
         state->is_stmt = 1;
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_negate_stmt, NULL);
+        dwarf2_line_prog_op(prog, DW_LNS_negate_stmt);
     } else if (state->is_stmt == 1 && loc->is_stmt == IS_STMT_CLEAR) {
         state->is_stmt = 0;
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_negate_stmt, NULL);
+        dwarf2_line_prog_op(prog, DW_LNS_negate_stmt);
     }
     if (loc->basic_block) {
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_set_basic_block, NULL);
+        dwarf2_line_prog_op(prog, DW_LNS_set_basic_block);
     }
 #ifdef WITH_DWARF3
     if (loc->prologue_end) {
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_set_prologue_end, NULL);
+        dwarf2_line_prog_op(prog, DW_LNS_set_prologue_end);
     }
     if (loc->epilogue_begin) {
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_set_epilogue_begin,
-                                     NULL);
+        dwarf2_line_prog_op(prog, DW_LNS_set_epilogue_begin);
     }
 #endif
 
@@ -415,8 +640,7 @@ dwarf2_dbgfmt_gen_line_op(yasm_section *debug_line, dwarf2_line_state *state,
                            N_("could not find label prior to loc"));
             return 1;
         }
-        dwarf2_dbgfmt_append_line_ext_op(debug_line, DW_LNE_set_address,
-            dbgfmt_dwarf2->sizeof_address, loc->sym);
+        dwarf2_line_prog_set_address(prog, loc->sym);
         addr_delta = 0;
     } else if (loc->bc) {
         if (state->precbc->offset > loc->bc->offset)
@@ -435,8 +659,7 @@ dwarf2_dbgfmt_gen_line_op(yasm_section *debug_line, dwarf2_line_state *state,
     if (line_delta < DWARF2_LINE_BASE
         || line_delta >= DWARF2_LINE_BASE+DWARF2_LINE_RANGE) {
         /* Won't fit in special opcode, use (signed) line advance */
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_advance_line,
-                                     yasm_intnum_create_int(line_delta));
+        dwarf2_line_prog_op_sleb(prog, DW_LNS_advance_line, line_delta);
         line_delta = 0;
     }
 
@@ -448,26 +671,25 @@ dwarf2_dbgfmt_gen_line_op(yasm_section *debug_line, dwarf2_line_state *state,
                              dbgfmt_dwarf2->min_insn_len);
     if (line_delta == 0 && addr_delta == 0) {
         /* Both line and addr deltas are 0: do DW_LNS_copy */
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_copy, NULL);
+        dwarf2_line_prog_op(prog, DW_LNS_copy);
     } else if (addr_delta <= DWARF2_MAX_SPECIAL_ADDR_DELTA && opcode1 <= 255) {
         /* Addr delta in range of special opcode */
-        dwarf2_dbgfmt_append_line_op(debug_line, opcode1, NULL);
+        dwarf2_line_prog_op(prog, opcode1);
     } else if (addr_delta <= 2*DWARF2_MAX_SPECIAL_ADDR_DELTA
                && opcode2 <= 255) {
         /* Addr delta in range of const_add_pc + special */
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_const_add_pc, NULL);
-        dwarf2_dbgfmt_append_line_op(debug_line, opcode2, NULL);
+        dwarf2_line_prog_op(prog, DW_LNS_const_add_pc);
+        dwarf2_line_prog_op(prog, opcode2);
     } else {
         /* Need advance_pc */
-        dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_advance_pc,
-                                     yasm_intnum_create_uint(addr_delta));
+        dwarf2_line_prog_op_uleb(prog, DW_LNS_advance_pc, addr_delta);
         /* Take care of any remaining line_delta and add entry to matrix */
         if (line_delta == 0)
-            dwarf2_dbgfmt_append_line_op(debug_line, DW_LNS_copy, NULL);
+            dwarf2_line_prog_op(prog, DW_LNS_copy);
         else {
             unsigned int opcode;
             opcode = DWARF2_LINE_OPCODE_BASE + line_delta - DWARF2_LINE_BASE;
-            dwarf2_dbgfmt_append_line_op(debug_line, opcode, NULL);
+            dwarf2_line_prog_op(prog, opcode);
         }
     }
     state->precbc = loc->bc;
@@ -475,44 +697,24 @@ dwarf2_dbgfmt_gen_line_op(yasm_section *debug_line, dwarf2_line_state *state,
 }
 
 typedef struct dwarf2_line_bc_info {
-    yasm_section *debug_line;
     yasm_object *object;
     yasm_linemap *linemap;
+    yasm_linemap_cursor cursor;
     yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2;
     dwarf2_line_state *state;
     dwarf2_loc loc;
-    unsigned long lastfile;
+    /* Last pathname seen; linemap pathnames are interned, so a pointer
+     * compare is enough to reuse its file number.
+     */
+    /*@null@*/ /*@dependent@*/ const char *lastpath;
 } dwarf2_line_bc_info;
 
-static int
-dwarf2_filename_equals(const dwarf2_filename *fn,
-                       char **dirs,
-                       const char *pathname,
-                       unsigned long dirlen,
-                       const char *filename)
-{
-    /* check directory */
-    if (fn->dir == 0) {
-        if (dirlen != 0)
-            return 0;
-    } else {
-        if (strncmp(dirs[fn->dir-1], pathname, dirlen) != 0 ||
-            dirs[fn->dir-1][dirlen] != '\0')
-            return 0;
-    }
-
-    /* check filename */
-    return strcmp(fn->filename, filename) == 0;
-}
-
 static int
 dwarf2_generate_line_bc(yasm_bytecode *bc, /*@null@*/ void *d)
 {
     dwarf2_line_bc_info *info = (dwarf2_line_bc_info *)d;
-    yasm_dbgfmt_dwarf2 *dbgfmt_dwarf2 = info->dbgfmt_dwarf2;
     unsigned long i;
-    size_t dirlen;
-    const char *pathname, *filename;
+    const char *pathname;
     /*@null@*/ yasm_bytecode *nextbc = yasm_bc__next(bc);
 
     if (nextbc && bc->offset == nextbc->offset)
@@ -530,29 +732,18 @@ dwarf2_generate_line_bc(yasm_bytecode *bc, /*@null@*/ void *d)
         }
     }
 
-    yasm_linemap_lookup(info->linemap, bc->line, &pathname, &info->loc.line);
-    dirlen = yasm__splitpath(pathname, &filename);
+    yasm_linemap_lookup_cursor(info->linemap, &info->cursor, bc->line,
+                               &pathname, &info->loc.line);
 
-    /* Find file index; just linear search it unless it was the last used */
-    if (info->lastfile > 0
-        && dwarf2_filename_equals(&dbgfmt_dwarf2->filenames[info->lastfile-1],
-                                  dbgfmt_dwarf2->dirs, pathname, dirlen,
-                                  filename))
-        info->loc.file = info->lastfile;
-    else {
-        for (i=0; i<dbgfmt_dwarf2->filenames_size; i++) {
-            if (dwarf2_filename_equals(&dbgfmt_dwarf2->filenames[i],
-                                       dbgfmt_dwarf2->dirs, pathname, dirlen,
-                                       filename))
-                break;
-        }
-        if (i >= dbgfmt_dwarf2->filenames_size)
+    /* Find file index unless it was the last used */
+    if (pathname != info->lastpath) {
+        info->loc.file = dwarf2_dbgfmt_find_file(info->dbgfmt_dwarf2,
+                                                 pathname);
+        if (info->loc.file == 0)
             yasm_internal_error(N_("could not find filename in table"));
-        info->loc.file = i+1;
-        info->lastfile = i+1;
+        info->lastpath = pathname;
     }
-    if (dwarf2_dbgfmt_gen_line_op(info->debug_line, info->state, &info->loc,
-                                  NULL))
+    if (dwarf2_dbgfmt_gen_line_op(info->state, &info->loc, NULL))
         return 1;
     return 0;
 }
@@ -608,16 +799,18 @@ dwarf2_generate_line_section(yasm_section *sect, /*@null@*/ void *d)
     state.isa = 0;
     state.is_stmt = DWARF2_LINE_DEFAULT_IS_STMT;
     state.precbc = NULL;
+    state.prog = dwarf2_line_prog_create(dbgfmt_dwarf2);
 
     if (info->asm_source) {
         dwarf2_line_bc_info bcinfo;
 
-        bcinfo.debug_line = info->debug_line;
         bcinfo.object = info->object;
         bcinfo.linemap = info->linemap;
+        yasm_linemap_cursor_init(&bcinfo.cursor);
         bcinfo.dbgfmt_dwarf2 = dbgfmt_dwarf2;
         bcinfo.state = &state;
-        bcinfo.lastfile = 0;
+        bcinfo.lastpath = NULL;
+        bcinfo.loc.file = 0;
         bcinfo.loc.isa_change = 0;
         bcinfo.loc.column = 0;
         bcinfo.loc.discriminator = 0;
@@ -647,9 +840,11 @@ dwarf2_generate_line_section(yasm_section *sect, /*@null@*/ void *d)
         dwarf2_dbgfmt_finalize_locs(sect, dsd);
 
         STAILQ_FOREACH(loc, &dsd->locs, link) {
-            if (dwarf2_dbgfmt_gen_line_op(info->debug_line, &state, loc,
-                                          STAILQ_NEXT(loc, link)))
+            if (dwarf2_dbgfmt_gen_line_op(&state, loc,
+                                          STAILQ_NEXT(loc, link))) {
+                dwarf2_line_prog_destroy(state.prog);
                 return 1;
+            }
         }
     }
 
@@ -662,13 +857,13 @@ dwarf2_generate_line_section(yasm_section *sect, /*@null@*/ void *d)
     bc = yasm_section_bcs_last(sect);
     addr_delta = yasm_bc_next_offset(bc) - state.precbc->offset;
     if (addr_delta == DWARF2_MAX_SPECIAL_ADDR_DELTA)
-        dwarf2_dbgfmt_append_line_op(info->debug_line, DW_LNS_const_add_pc,
-                                     NULL);
+        dwarf2_line_prog_op(state.prog, DW_LNS_const_add_pc);
     else if (addr_delta > 0)
-        dwarf2_dbgfmt_append_line_op(info->debug_line, DW_LNS_advance_pc,
-                                     yasm_intnum_create_uint(addr_delta));
-    dwarf2_dbgfmt_append_line_ext_op(info->debug_line, DW_LNE_end_sequence, 0,
-                                     NULL);
+        dwarf2_line_prog_op_uleb(state.prog, DW_LNS_advance_pc, addr_delta);
+    dwarf2_line_prog_ext_op(state.prog, DW_LNE_end_sequence, 0, 0);
+
+    /* The whole sequence goes into .debug_line as a single bytecode */
+    dwarf2_line_prog_append(info->debug_line, state.prog);
 
     return 0;
 }
@@ -835,60 +1030,49 @@ dwarf2_spp_bc_tobytes(yasm_bytecode *bc, unsigned char **bufp,
 }
 
 static void
-dwarf2_line_op_bc_destroy(void *contents)
+dwarf2_line_prog_bc_destroy(void *contents)
 {
-    dwarf2_line_op *line_op = (dwarf2_line_op *)contents;
-    if (line_op->operand)
-        yasm_intnum_destroy(line_op->operand);
-    if (line_op->ext_operand_int)
-        yasm_intnum_destroy(line_op->ext_operand_int);
-    yasm_xfree(contents);
+    dwarf2_line_prog_destroy((dwarf2_line_prog *)contents);
 }
 
 static void
-dwarf2_line_op_bc_print(const void *contents, FILE *f, int indent_level)
+dwarf2_line_prog_bc_print(const void *contents, FILE *f, int indent_level)
 {
     /* TODO */
 }
 
 static int
-dwarf2_line_op_bc_calc_len(yasm_bytecode *bc, yasm_bc_add_span_func add_span,
-                           void *add_span_data)
+dwarf2_line_prog_bc_calc_len(yasm_bytecode *bc, yasm_bc_add_span_func add_span,
+                             void *add_span_data)
 {
-    yasm_internal_error(N_("tried to calc_len a dwarf2 line_op bytecode"));
+    yasm_internal_error(N_("tried to calc_len a dwarf2 line_prog bytecode"));
     /*@notreached@*/
     return 0;
 }
 
 static int
-dwarf2_line_op_bc_tobytes(yasm_bytecode *bc, unsigned char **bufp,
-                          unsigned char *bufstart, void *d,
-                          yasm_output_value_func output_value,
-                          yasm_output_reloc_func output_reloc)
+dwarf2_line_prog_bc_tobytes(yasm_bytecode *bc, unsigned char **bufp,
+                            unsigned char *bufstart, void *d,
+                            yasm_output_value_func output_value,
+                            yasm_output_reloc_func output_reloc)
 {
-    dwarf2_line_op *line_op = (dwarf2_line_op *)bc->contents;
+    dwarf2_line_prog *prog = (dwarf2_line_prog *)bc->contents;
     unsigned char *buf = *bufp;
+    unsigned long i;
 
-    YASM_WRITE_8(buf, line_op->opcode);
-    if (line_op->operand)
-        buf += yasm_intnum_get_leb128(line_op->operand, buf,
-                                      line_op->opcode == DW_LNS_advance_line);
-    if (line_op->ext_opcode > 0) {
-        YASM_WRITE_8(buf, line_op->ext_opcode);
-        if (line_op->ext_operand) {
-            yasm_value value;
-            yasm_value_init_sym(&value, line_op->ext_operand,
-                                line_op->ext_operandsize*8);
-            output_value(&value, buf, line_op->ext_operandsize,
-                         (unsigned long)(buf-bufstart), bc, 0, d);
-            buf += line_op->ext_operandsize;
-        }
-        if (line_op->ext_operand_int) {
-            buf += yasm_intnum_get_leb128(line_op->ext_operand_int, buf, 0);
-        }
+    memcpy(buf, prog->buf, prog->len);
+
+    /* Fill in set_address operands */
+    for (i=0; i<prog->num_addrs; i++) {
+        unsigned char *abuf = buf + prog->addrs[i].pos;
+        yasm_value value;
+        yasm_value_init_sym(&value, prog->addrs[i].sym,
+                            prog->sizeof_address*8);
+        output_value(&value, abuf, prog->sizeof_address,
+                     (unsigned long)(abuf-bufstart), bc, 0, d);
     }
 
-    *bufp = buf;
+    *bufp = buf + prog->len;
     return 0;
 }
 
@@ -0,0 +1,23 @@
+.file 3 "dir/a.c"
+.file 1 "dir/b.c"
+.file 2 "other/a.c"
+.file 1 "dir/a.c"
+
+.text
+f:
+.loc 1 10 0
+	nop
+.loc 3 12 4 is_stmt 0 discriminator 300
+	nop
+.loc 2 100000 1 isa 2 basic_block
+	movl	$1, %eax
+.loc 1 5
+.loc 1 7
+	nop
+.section .text.b,"ax"
+g:
+.loc 2 3
+	ret
+.fill 300,1,0x90
+.loc 3 1
+	ret
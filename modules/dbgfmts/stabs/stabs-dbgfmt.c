@@ -97,6 +97,7 @@ typedef struct {
 
     yasm_object *object;
     yasm_linemap *linemap;
+    yasm_linemap_cursor cursor;
     yasm_errwarns *errwarns;
 } stabs_info;
 
@@ -254,8 +255,8 @@ static int
 stabs_dbgfmt_generate_bcs(yasm_bytecode *bc, void *d)
 {
     stabs_info *info = (stabs_info *)d;
-    yasm_linemap_lookup(info->linemap, bc->line, &info->curfile,
-                        &info->curline);
+    yasm_linemap_lookup_cursor(info->linemap, &info->cursor, bc->line,
+                               &info->curfile, &info->curline);
 
     /* check for new function */
     stabs_dbgfmt_generate_n_fun(info, bc);
@@ -329,6 +330,7 @@ stabs_dbgfmt_generate(yasm_object *object, yasm_linemap *linemap,
 
     info.object = object;
     info.linemap = linemap;
+    yasm_linemap_cursor_init(&info.cursor);
     info.errwarns = errwarns;
     info.lastline = 0;
     info.stabcount = 0;
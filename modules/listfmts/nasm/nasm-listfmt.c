@@ -58,6 +58,7 @@ typedef struct bcreloc {
 typedef struct nasm_listfmt_output_info {
     yasm_arch *arch;
     /*@reldef@*/ STAILQ_HEAD(bcrelochead, bcreloc) bcrelocs;
+    yasm_section *sect;
     /*@null@*/ yasm_reloc *next_reloc;  /* next relocation in section */
     unsigned long next_reloc_addr;
 } nasm_listfmt_output_info;
@@ -108,12 +109,11 @@ nasm_listfmt_output_value(yasm_value *value, unsigned char *buf,
         STAILQ_INSERT_TAIL(&info->bcrelocs, reloc, link);
 
         /* Get next reloc's info */
-        info->next_reloc = yasm_section_reloc_next(info->next_reloc);
+        info->next_reloc = yasm_section_reloc_next(info->sect,
+                                                   info->next_reloc);
         if (info->next_reloc) {
-            yasm_intnum *addr;
             yasm_symrec *sym;
-            yasm_reloc_get(info->next_reloc, &addr, &sym);
-            info->next_reloc_addr = yasm_intnum_get_uint(addr);
+            yasm_reloc_get(info->next_reloc, &info->next_reloc_addr, &sym);
         }
     }
 
@@ -181,20 +181,21 @@ nasm_listfmt_output(yasm_listfmt *listfmt, FILE *f, yasm_linemap *linemap,
                     /* not found, add to list*/
                     last_hist = yasm_xmalloc(sizeof(sectreloc));
                     last_hist->sect = sect;
+                    /* relocs are walked in step with the bytecodes */
+                    yasm_section_relocs_sort(sect);
                     last_hist->next_reloc = yasm_section_relocs_first(sect);
 
                     if (last_hist->next_reloc) {
-                        yasm_intnum *addr;
                         yasm_symrec *sym;
-                        yasm_reloc_get(last_hist->next_reloc, &addr, &sym);
-                        last_hist->next_reloc_addr =
-                            yasm_intnum_get_uint(addr);
+                        yasm_reloc_get(last_hist->next_reloc,
+                                       &last_hist->next_reloc_addr, &sym);
                     }
 
                     SLIST_INSERT_HEAD(&reloc_hist, last_hist, link);
                 }
             }
 
+            info.sect = sect;
             info.next_reloc = last_hist->next_reloc;
             info.next_reloc_addr = last_hist->next_reloc_addr;
             STAILQ_INIT(&info.bcrelocs);
@@ -26,6 +26,8 @@
  */
 #include <util.h>
 
+#include <limits.h>
+
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
@@ -57,6 +59,14 @@ typedef struct bin_section_data {
 
     /* Calculated (final) length, used only during output() */
     /*@null@*/ /*@owned@*/ yasm_intnum *length;
+
+    /* Group of the layout pass (LMA or VMA) in progress, used only during
+     * output()
+     */
+    /*@null@*/ /*@dependent@*/ struct bin_group *group;
+
+    /* Index of the section in the map file, used only during output() */
+    unsigned long map_index;
 } bin_section_data;
 
 typedef struct yasm_objfmt_bin {
@@ -67,7 +77,8 @@ typedef struct yasm_objfmt_bin {
         MAP_NONE = 0x01,
         MAP_BRIEF = 0x02,
         MAP_SECTIONS = 0x04,
-        MAP_SYMBOLS = 0x08
+        MAP_SYMBOLS = 0x08,
+        MAP_SORTED = 0x10       /* sort symbols by address */
     } map_flags;
     /*@null@*/ /*@only@*/ char *map_filename;
 
@@ -132,38 +143,57 @@ typedef struct bin_group {
      * group's section.
      */
     bin_groups follow_groups;
+
+    /* Union-find link towards the top-level group whose tree contains this
+     * group; NULL if this group is top-level.
+     */
+    /*@null@*/ /*@dependent@*/ struct bin_group *root;
 } bin_group;
 
-/* Recursive function to find group containing named section. */
+/* Find group of the current layout pass containing named section. */
 static bin_group *
-find_group_by_name(bin_groups *groups, const char *name)
+find_group_by_name(yasm_object *object, const char *name)
 {
-    bin_group *group, *found;
-    TAILQ_FOREACH(group, groups, link) {
-        if (strcmp(yasm_section_get_name(group->section), name) == 0)
-            return group;
-        /* Recurse to loop through follow groups */
-        found = find_group_by_name(&group->follow_groups, name);
-        if (found)
-            return found;
-    }
-    return NULL;
+    yasm_section *sect = yasm_object_find_general(object, name);
+    bin_section_data *bsd;
+
+    if (!sect)
+        return NULL;
+    bsd = yasm_section_get_data(sect, &bin_section_data_cb);
+    return bsd ? bsd->group : NULL;
 }
 
-/* Recursive function to find group.  Returns NULL if not found. */
+/* Find the top-level group whose tree contains group. */
 static bin_group *
-find_group_by_section(bin_groups *groups, yasm_section *section)
+find_group_root(bin_group *group)
 {
-    bin_group *group, *found;
-    TAILQ_FOREACH(group, groups, link) {
-        if (group->section == section)
-            return group;
-        /* Recurse to loop through follow groups */
-        found = find_group_by_section(&group->follow_groups, section);
-        if (found)
-            return found;
+    while (group->root) {
+        /* Path halving */
+        if (group->root->root)
+            group->root = group->root->root;
+        group = group->root;
     }
-    return NULL;
+    return group;
+}
+
+/* Move top-level group into the follow groups of found.  Returns nonzero
+ * (and does nothing) if that would create a loop, i.e. if found is in the
+ * tree of group.
+ */
+static int
+follow_group(bin_groups *groups, bin_group *group, bin_group *found)
+{
+    bin_group *root = find_group_root(found);
+
+    if (root == group)
+        return 1;
+
+    /* Remove this section from main groups list */
+    TAILQ_REMOVE(groups, group, link);
+    /* Add it after the section it's supposed to follow. */
+    TAILQ_INSERT_TAIL(&found->follow_groups, group, link);
+    group->root = root;
+    return 0;
 }
 
 #if 0
@@ -251,6 +281,8 @@ bin_lma_create_group(yasm_section *sect, /*@null@*/ void *d)
     group->section = sect;
     group->bsd = bsd;
     TAILQ_INIT(&group->follow_groups);
+    group->root = NULL;
+    bsd->group = group;
 
     /* Determine section alignment as necessary. */
     if (!bsd->align)
@@ -331,6 +363,8 @@ bin_vma_create_group(yasm_section *sect, /*@null@*/ void *d)
     group->section = sect;
     group->bsd = bsd;
     TAILQ_INIT(&group->follow_groups);
+    group->root = NULL;
+    bsd->group = group;
 
     TAILQ_INSERT_TAIL(&info->vma_groups, group, link);
     return 0;
@@ -581,23 +615,179 @@ bin_objfmt_expr_xform(/*@returned@*/ /*@only@*/ yasm_expr *e,
     return e;
 }
 
+/* Get the low bits of an intnum, two's complement, as an unsigned long. */
+static unsigned long
+bin_intnum_low(const yasm_intnum *intn)
+{
+    unsigned char buf[sizeof(unsigned long)];
+    unsigned long val = 0;
+    size_t i;
+
+    if (yasm_intnum_check_size(intn, 32, 0, 2)) {
+        if (yasm_intnum_sign(intn) < 0)
+            return (unsigned long)yasm_intnum_get_int(intn);
+        return yasm_intnum_get_uint(intn);
+    }
+
+    /* yasm_intnum_get_uint() saturates above 32 bits */
+    yasm_intnum_get_sized(intn, buf, sizeof(buf), sizeof(buf)*CHAR_BIT, 0, 0,
+                          0);
+    for (i=sizeof(buf); i != 0; i--)
+        val = (val << 8) | buf[i-1];
+    return val;
+}
+
+#define MAP_OUTBUF_SIZE     65536
+
+/* One symbol in the map.  Symbols are collected in a single symtab
+ * traversal and then bucketed by section.
+ */
+typedef struct map_symbol {
+    /*@dependent@*/ yasm_symrec *sym;
+    unsigned long sect;         /* map index of section; 0 for EQUs */
+    unsigned long value;        /* label offset or (low bits of) EQU value */
+    /*@null@*/ /*@only@*/ yasm_intnum *ivalue;  /* EQU value, if not native */
+} map_symbol;
+
 typedef struct map_output_info {
     /* address width */
     int bytes;
     int vseg_present;
 
-    /* intnum output static data areas */
+    /* nonzero if addresses of the above width fit in an unsigned long */
+    int native;
+    unsigned long mask;     /* native mask for the above width */
+
+    /* intnum output static data areas (non-native only) */
     unsigned char *buf;
     yasm_intnum *intn;
 
-    /* symrec output information */
-    unsigned long count;
-    yasm_section *section;  /* NULL for EQUs */
+    /* collected symbols, and the first symbol of each section */
+    /*@only@*/ map_symbol *syms;
+    unsigned long num_syms, alloc_syms;
+    /*@only@*/ unsigned long *sect_first;
+    unsigned long num_sects;
 
     yasm_object *object;    /* object */
     FILE *f;                /* map output file */
+
+    /* output buffer */
+    char *outbuf;
+    size_t outlen;
 } map_output_info;
 
+static void
+map_flush(map_output_info *info)
+{
+    if (info->outlen > 0)
+        fwrite(info->outbuf, info->outlen, 1, info->f);
+    info->outlen = 0;
+}
+
+static void
+map_write(map_output_info *info, const char *s, size_t len)
+{
+    if (info->outlen + len > MAP_OUTBUF_SIZE) {
+        map_flush(info);
+        if (len > MAP_OUTBUF_SIZE) {
+            fwrite(s, len, 1, info->f);
+            return;
+        }
+    }
+    memcpy(&info->outbuf[info->outlen], s, len);
+    info->outlen += len;
+}
+
+static void
+map_puts(map_output_info *info, const char *s)
+{
+    map_write(info, s, strlen(s));
+}
+
+/* Output n copies of c (nothing if n is not positive). */
+static void
+map_fill(map_output_info *info, char c, long n)
+{
+    while (n > 0) {
+        size_t len = (size_t)n;
+        if (info->outlen == MAP_OUTBUF_SIZE)
+            map_flush(info);
+        if (len > MAP_OUTBUF_SIZE - info->outlen)
+            len = MAP_OUTBUF_SIZE - info->outlen;
+        memset(&info->outbuf[info->outlen], c, len);
+        info->outlen += len;
+        n -= (long)len;
+    }
+}
+
+/* Output s left-justified in a field of width characters. */
+static void
+map_pad(map_output_info *info, const char *s, int width)
+{
+    size_t len = strlen(s);
+    map_write(info, s, len);
+    map_fill(info, ' ', (long)width - (long)len);
+}
+
+/* Output a section header line: "---- Section name ----...". */
+static void
+map_section_header(map_output_info *info, const char *name)
+{
+    map_puts(info, "---- Section ");
+    map_puts(info, name);
+    map_puts(info, " ");
+    map_fill(info, '-', 65 - (long)strlen(name));
+}
+
+static void
+map_print_native(unsigned long val, map_output_info *info)
+{
+    static const char hexdigits[] = "0123456789ABCDEF";
+    char str[2*sizeof(unsigned long)];
+    int i;
+
+    for (i=info->bytes*2; i != 0; i--) {
+        str[i-1] = hexdigits[val & 0xF];
+        val >>= 4;
+    }
+    map_write(info, str, (size_t)info->bytes*2);
+}
+
+static void
+map_print_intnum(const yasm_intnum *intn, map_output_info *info)
+{
+    static const char hexdigits[] = "0123456789ABCDEF";
+    size_t i;
+
+    if (info->native) {
+        map_print_native(bin_intnum_low(intn), info);
+        return;
+    }
+
+    yasm_intnum_get_sized(intn, info->buf, info->bytes, info->bytes*8, 0, 0,
+                          0);
+    for (i=info->bytes; i != 0; i--) {
+        char str[2];
+        str[0] = hexdigits[info->buf[i-1] >> 4];
+        str[1] = hexdigits[info->buf[i-1] & 0xF];
+        map_write(info, str, 2);
+    }
+}
+
+/* Output base+offset. */
+static void
+map_print_sum(const yasm_intnum *base, unsigned long offset,
+              map_output_info *info)
+{
+    if (info->native) {
+        map_print_native(bin_intnum_low(base) + offset, info);
+        return;
+    }
+    yasm_intnum_set_uint(info->intn, offset);
+    yasm_intnum_calc(info->intn, YASM_EXPR_ADD, (yasm_intnum *)base);
+    map_print_intnum(info->intn, info);
+}
+
 static int
 map_prescan_bytes(yasm_section *sect, void *d)
 {
@@ -622,57 +812,57 @@ map_prescan_bytes(yasm_section *sect, void *d)
     return 0;
 }
 
-static void
-map_print_intnum(const yasm_intnum *intn, map_output_info *info)
-{
-    size_t i;
-    yasm_intnum_get_sized(intn, info->buf, info->bytes, info->bytes*8, 0, 0,
-                          0);
-    for (i=info->bytes; i != 0; i--)
-        fprintf(info->f, "%02X", info->buf[i-1]);
-}
-
 static void
 map_sections_summary(bin_groups *groups, map_output_info *info)
 {
     bin_group *group;
     TAILQ_FOREACH(group, groups, link) {
         bin_section_data *bsd = group->bsd;
+        unsigned long length;
 
         assert(bsd != NULL);
         assert(info != NULL);
 
-        map_print_intnum(bsd->ivstart, info);
-        fprintf(info->f, "  ");
+        length = bin_intnum_low(bsd->length);
 
-        yasm_intnum_set(info->intn, bsd->ivstart);
-        yasm_intnum_calc(info->intn, YASM_EXPR_ADD, bsd->length);
-        map_print_intnum(info->intn, info);
-        fprintf(info->f, "  ");
+        map_print_intnum(bsd->ivstart, info);
+        map_puts(info, "  ");
+
+        if (info->native)
+            map_print_sum(bsd->ivstart, length, info);
+        else {
+            yasm_intnum_set(info->intn, bsd->ivstart);
+            yasm_intnum_calc(info->intn, YASM_EXPR_ADD, bsd->length);
+            map_print_intnum(info->intn, info);
+        }
+        map_puts(info, "  ");
 
         if (info->vseg_present) {
-            if (bsd->ivseg == NULL) {
-                size_t i;
-                for (i = info->bytes; i != 0; i--)
-                    fprintf(info->f, "--");
-            } else
+            if (bsd->ivseg == NULL)
+                map_fill(info, '-', info->bytes*2);
+            else
                 map_print_intnum(bsd->ivseg, info);
-            fprintf(info->f, "  ");
+            map_puts(info, "  ");
         }
 
         map_print_intnum(bsd->istart, info);
-        fprintf(info->f, "  ");
-
-        yasm_intnum_set(info->intn, bsd->istart);
-        yasm_intnum_calc(info->intn, YASM_EXPR_ADD, bsd->length);
-        map_print_intnum(info->intn, info);
-        fprintf(info->f, "  ");
+        map_puts(info, "  ");
+
+        if (info->native)
+            map_print_sum(bsd->istart, length, info);
+        else {
+            yasm_intnum_set(info->intn, bsd->istart);
+            yasm_intnum_calc(info->intn, YASM_EXPR_ADD, bsd->length);
+            map_print_intnum(info->intn, info);
+        }
+        map_puts(info, "  ");
 
         map_print_intnum(bsd->length, info);
-        fprintf(info->f, "  ");
+        map_puts(info, "  ");
 
-        fprintf(info->f, "%-*s", 10, bsd->bss ? "nobits" : "progbits");
-        fprintf(info->f, "%s\n", yasm_section_get_name(group->section));
+        map_pad(info, bsd->bss ? "nobits" : "progbits", 10);
+        map_puts(info, yasm_section_get_name(group->section));
+        map_puts(info, "\n");
 
         /* Recurse to loop through follow groups */
         map_sections_summary(&group->follow_groups, info);
@@ -685,98 +875,189 @@ map_sections_detail(bin_groups *groups, map_output_info *info)
     bin_group *group;
     TAILQ_FOREACH(group, groups, link) {
         bin_section_data *bsd = group->bsd;
-        size_t i;
-        const char *s;
 
-        s = yasm_section_get_name(group->section);
-        fprintf(info->f, "---- Section %s ", s);
-        for (i=0; i<(65-strlen(s)); i++)
-            fputc('-', info->f);
+        map_section_header(info, yasm_section_get_name(group->section));
 
-        fprintf(info->f, "\n\nclass:     %s",
-                bsd->bss ? "nobits" : "progbits");
-        fprintf(info->f, "\nlength:    ");
+        map_puts(info, "\n\nclass:     ");
+        map_puts(info, bsd->bss ? "nobits" : "progbits");
+        map_puts(info, "\nlength:    ");
         map_print_intnum(bsd->length, info);
-        fprintf(info->f, "\nstart:     ");
+        map_puts(info, "\nstart:     ");
         map_print_intnum(bsd->istart, info);
-        fprintf(info->f, "\nalign:     ");
+        map_puts(info, "\nalign:     ");
         map_print_intnum(bsd->align, info);
-        fprintf(info->f, "\nfollows:   %s",
-                bsd->follows ? bsd->follows : "not defined");
-        fprintf(info->f, "\nvstart:    ");
+        map_puts(info, "\nfollows:   ");
+        map_puts(info, bsd->follows ? bsd->follows : "not defined");
+        map_puts(info, "\nvstart:    ");
         map_print_intnum(bsd->ivstart, info);
-        fprintf(info->f, "\nvseg:      ");
+        map_puts(info, "\nvseg:      ");
         if (bsd->ivseg)
             map_print_intnum(bsd->ivseg, info);
         else
-            fprintf(info->f, "not defined");
-        fprintf(info->f, "\nvalign:    ");
+            map_puts(info, "not defined");
+        map_puts(info, "\nvalign:    ");
         map_print_intnum(bsd->valign, info);
-        fprintf(info->f, "\nvfollows:  %s\n\n",
-                bsd->vfollows ? bsd->vfollows : "not defined");
+        map_puts(info, "\nvfollows:  ");
+        map_puts(info, bsd->vfollows ? bsd->vfollows : "not defined");
+        map_puts(info, "\n\n");
 
         /* Recurse to loop through follow groups */
         map_sections_detail(&group->follow_groups, info);
     }
 }
 
-static int
-map_symrec_count(yasm_symrec *sym, void *d)
+/* Number the sections in output order, starting from 1 (0 is EQUs). */
+static void
+map_number_sections(bin_groups *groups, map_output_info *info)
 {
-    map_output_info *info = (map_output_info *)d;
-    /*@dependent@*/ yasm_bytecode *precbc;
-
-    assert(info != NULL);
-
-    /* TODO: autodetect wider size */
-    if (!info->section && yasm_symrec_get_equ(sym)) {
-        info->count++;
-    } else if (yasm_symrec_get_label(sym, &precbc) &&
-               yasm_bc_get_section(precbc) == info->section) {
-        info->count++;
+    bin_group *group;
+    TAILQ_FOREACH(group, groups, link) {
+        group->bsd->map_index = ++info->num_sects;
+        map_number_sections(&group->follow_groups, info);
     }
-    return 0;
 }
 
 static int
-map_symrec_output(yasm_symrec *sym, void *d)
+map_symrec_collect(yasm_symrec *sym, void *d)
 {
     map_output_info *info = (map_output_info *)d;
     const yasm_expr *equ;
     /*@dependent@*/ yasm_bytecode *precbc;
-    /*@only@*/ char *name = yasm_symrec_get_global_name(sym, info->object);
+    map_symbol *msym;
 
     assert(info != NULL);
 
-    if (!info->section && (equ = yasm_symrec_get_equ(sym))) {
+    if (info->num_syms >= info->alloc_syms) {
+        info->alloc_syms *= 2;
+        info->syms = yasm_xrealloc(info->syms,
+                                   info->alloc_syms*sizeof(map_symbol));
+    }
+    msym = &info->syms[info->num_syms];
+    msym->sym = sym;
+    msym->ivalue = NULL;
+
+    /* TODO: autodetect wider size */
+    if ((equ = yasm_symrec_get_equ(sym))) {
         yasm_expr *realequ = yasm_expr_copy(equ);
+        const yasm_intnum *intn;
+
         realequ = yasm_expr__level_tree
             (realequ, 1, 1, 1, 0, bin_objfmt_expr_xform, NULL);
-        yasm_intnum_set(info->intn, yasm_expr_get_intnum(&realequ, 0));
+        intn = yasm_expr_get_intnum(&realequ, 0);
+        if (!intn) {
+            yasm_expr_destroy(realequ);
+            return 0;
+        }
+        msym->sect = 0;
+        msym->value = bin_intnum_low(intn) & info->mask;
+        if (!info->native)
+            msym->ivalue = yasm_intnum_copy(intn);
         yasm_expr_destroy(realequ);
-        map_print_intnum(info->intn, info);
-        fprintf(info->f, "  %s\n", name);
-    } else if (yasm_symrec_get_label(sym, &precbc) &&
-               yasm_bc_get_section(precbc) == info->section) {
+    } else if (yasm_symrec_get_label(sym, &precbc)) {
+        yasm_section *sect = yasm_bc_get_section(precbc);
         bin_section_data *bsd =
-            yasm_section_get_data(info->section, &bin_section_data_cb);
+            yasm_section_get_data(sect, &bin_section_data_cb);
 
-        /* Real address */
-        yasm_intnum_set_uint(info->intn, yasm_bc_next_offset(precbc));
-        yasm_intnum_calc(info->intn, YASM_EXPR_ADD, bsd->istart);
-        map_print_intnum(info->intn, info);
-        fprintf(info->f, "  ");
+        if (!bsd || bsd->map_index == 0)
+            return 0;
+        msym->sect = bsd->map_index;
+        msym->value = yasm_bc_next_offset(precbc);
+    } else
+        return 0;
 
-        /* Virtual address */
-        yasm_intnum_set_uint(info->intn, yasm_bc_next_offset(precbc));
-        yasm_intnum_calc(info->intn, YASM_EXPR_ADD, bsd->ivstart);
-        map_print_intnum(info->intn, info);
+    info->num_syms++;
+    return 0;
+}
+
+static int
+map_symbol_compare(const void *a, const void *b)
+{
+    const map_symbol *sa = a, *sb = b;
+    if (sa->ivalue && sb->ivalue)
+        return yasm_intnum_compare(sa->ivalue, sb->ivalue);
+    if (sa->value < sb->value)
+        return -1;
+    if (sa->value > sb->value)
+        return 1;
+    return 0;
+}
+
+/* Collect all the symbols in one pass and bucket them by section, keeping
+ * symbol table order within each section unless sort is nonzero, in which
+ * case each section is sorted by address (EQUs by value).
+ */
+static void
+map_collect_symbols(bin_groups *groups, map_output_info *info, int sort)
+{
+    map_symbol *sorted;
+    unsigned long *first;
+    unsigned long i;
+
+    info->num_sects = 0;
+    map_number_sections(groups, info);
+
+    info->num_syms = 0;
+    info->alloc_syms = 256;
+    info->syms = yasm_xmalloc(info->alloc_syms*sizeof(map_symbol));
+    yasm_symtab_traverse(info->object->symtab, info, map_symrec_collect);
+
+    /* Counting sort by section; stable, so symtab order is kept. */
+    first = yasm_xcalloc(info->num_sects+2, sizeof(unsigned long));
+    for (i=0; i<info->num_syms; i++)
+        first[info->syms[i].sect+1]++;
+    for (i=1; i<info->num_sects+2; i++)
+        first[i] += first[i-1];
+    sorted = yasm_xmalloc((info->num_syms ? info->num_syms : 1)*
+                          sizeof(map_symbol));
+    for (i=0; i<info->num_syms; i++)
+        sorted[first[info->syms[i].sect]++] = info->syms[i];
+    /* first[s] now holds the end of section s; shift back to the start */
+    for (i=info->num_sects+1; i>0; i--)
+        first[i] = first[i-1];
+    first[0] = 0;
+
+    yasm_xfree(info->syms);
+    info->syms = sorted;
+    info->sect_first = first;
+
+    if (sort) {
+        for (i=0; i<=info->num_sects; i++)
+            yasm__mergesort(&sorted[first[i]], first[i+1]-first[i],
+                            sizeof(map_symbol), map_symbol_compare);
+    }
+}
+
+static void
+map_symbols_output(unsigned long sect, /*@null@*/ bin_section_data *bsd,
+                   map_output_info *info)
+{
+    unsigned long i;
+
+    for (i=info->sect_first[sect]; i<info->sect_first[sect+1]; i++) {
+        const map_symbol *msym = &info->syms[i];
+        /*@only@*/ char *name =
+            yasm_symrec_get_global_name(msym->sym, info->object);
+
+        if (!bsd) {
+            if (msym->ivalue)
+                map_print_intnum(msym->ivalue, info);
+            else
+                map_print_native(msym->value, info);
+        } else {
+            /* Real address */
+            map_print_sum(bsd->istart, msym->value, info);
+            map_puts(info, "  ");
+
+            /* Virtual address */
+            map_print_sum(bsd->ivstart, msym->value, info);
+        }
 
         /* Name */
-        fprintf(info->f, "  %s\n", name);
+        map_puts(info, "  ");
+        map_puts(info, name);
+        map_puts(info, "\n");
+        yasm_xfree(name);
     }
-    yasm_xfree(name);
-    return 0;
 }
 
 static void
@@ -784,23 +1065,16 @@ map_sections_symbols(bin_groups *groups, map_output_info *info)
 {
     bin_group *group;
     TAILQ_FOREACH(group, groups, link) {
-        info->count = 0;
-        info->section = group->section;
-        yasm_symtab_traverse(info->object->symtab, info, map_symrec_count);
-
-        if (info->count > 0) {
-            const char *s = yasm_section_get_name(group->section);
-            size_t i;
-            fprintf(info->f, "---- Section %s ", s);
-            for (i=0; i<(65-strlen(s)); i++)
-                fputc('-', info->f);
-            fprintf(info->f, "\n\n%-*s%-*s%s\n",
-                    info->bytes*2+2, "Real",
-                    info->bytes*2+2, "Virtual",
-                    "Name");
-            yasm_symtab_traverse(info->object->symtab, info,
-                                 map_symrec_output);
-            fprintf(info->f, "\n\n");
+        unsigned long sect = group->bsd->map_index;
+
+        if (info->sect_first[sect+1] > info->sect_first[sect]) {
+            map_section_header(info, yasm_section_get_name(group->section));
+            map_puts(info, "\n\n");
+            map_pad(info, "Real", info->bytes*2+2);
+            map_pad(info, "Virtual", info->bytes*2+2);
+            map_puts(info, "Name\n");
+            map_symbols_output(sect, group->bsd, info);
+            map_puts(info, "\n\n");
         }
 
         /* Recurse to loop through follow groups */
@@ -813,14 +1087,14 @@ output_map(bin_objfmt_output_info *info)
 {
     yasm_objfmt_bin *objfmt_bin = (yasm_objfmt_bin *)info->object->objfmt;
     FILE *f;
-    int i;
+    unsigned long i;
     map_output_info mapinfo;
 
     if (objfmt_bin->map_flags == NO_MAP)
         return;
 
-    if (objfmt_bin->map_flags == MAP_NONE)
-        objfmt_bin->map_flags = MAP_BRIEF;          /* default to brief */
+    if (!(objfmt_bin->map_flags & (MAP_BRIEF|MAP_SECTIONS|MAP_SYMBOLS)))
+        objfmt_bin->map_flags |= MAP_BRIEF;         /* default to brief */
 
     if (!objfmt_bin->map_filename)
         f = stdout;                                 /* default to stdout */
@@ -837,6 +1111,8 @@ output_map(bin_objfmt_output_info *info)
 
     mapinfo.object = info->object;
     mapinfo.f = f;
+    mapinfo.outbuf = yasm_xmalloc(MAP_OUTBUF_SIZE);
+    mapinfo.outlen = 0;
 
     /* Temporary intnum */
     mapinfo.intn = info->tmp_intn;
@@ -849,84 +1125,93 @@ output_map(bin_objfmt_output_info *info)
     while (!yasm_intnum_check_size(info->origin, mapinfo.bytes * 8, 0, 0))
         mapinfo.bytes *= 2;
     yasm_object_sections_traverse(info->object, &mapinfo, map_prescan_bytes);
+    mapinfo.native = (size_t)mapinfo.bytes <= sizeof(unsigned long);
+    if ((size_t)mapinfo.bytes < sizeof(unsigned long))
+        mapinfo.mask = (1UL << (mapinfo.bytes*8)) - 1;
+    else
+        mapinfo.mask = ULONG_MAX;
     mapinfo.buf = yasm_xmalloc(mapinfo.bytes);
 
-    fprintf(f, "\n- YASM Map file ");
-    for (i=0; i<63; i++)
-        fputc('-', f);
-    fprintf(f, "\n\nSource file:  %s\n", info->object->src_filename);
-    fprintf(f, "Output file:  %s\n\n", info->object->obj_filename);
-
-    fprintf(f, "-- Program origin ");
-    for (i=0; i<61; i++)
-        fputc('-', f);
-    fprintf(f, "\n\n");
+    map_puts(&mapinfo, "\n- YASM Map file ");
+    map_fill(&mapinfo, '-', 63);
+    map_puts(&mapinfo, "\n\nSource file:  ");
+    map_puts(&mapinfo, info->object->src_filename);
+    map_puts(&mapinfo, "\nOutput file:  ");
+    map_puts(&mapinfo, info->object->obj_filename);
+    map_puts(&mapinfo, "\n\n");
+
+    map_puts(&mapinfo, "-- Program origin ");
+    map_fill(&mapinfo, '-', 61);
+    map_puts(&mapinfo, "\n\n");
     map_print_intnum(info->origin, &mapinfo);
-    fprintf(f, "\n\n");
+    map_puts(&mapinfo, "\n\n");
 
     if (objfmt_bin->map_flags & MAP_BRIEF) {
-        fprintf(f, "-- Sections (summary) ");
-        for (i=0; i<57; i++)
-            fputc('-', f);
-        fprintf(f, "\n\n%-*s%-*s%-*s%-*s%-*s%-*s%-*s%s\n",
-                mapinfo.bytes*2+2, "Vstart",
-                mapinfo.bytes*2+2, "Vstop",
-                mapinfo.vseg_present ? mapinfo.bytes*2+2 : 0,
-                mapinfo.vseg_present ? "Vseg" : "",
-                mapinfo.bytes*2+2, "Start",
-                mapinfo.bytes*2+2, "Stop",
-                mapinfo.bytes*2+2, "Length",
-                10, "Class", "Name");
+        map_puts(&mapinfo, "-- Sections (summary) ");
+        map_fill(&mapinfo, '-', 57);
+        map_puts(&mapinfo, "\n\n");
+        map_pad(&mapinfo, "Vstart", mapinfo.bytes*2+2);
+        map_pad(&mapinfo, "Vstop", mapinfo.bytes*2+2);
+        if (mapinfo.vseg_present)
+            map_pad(&mapinfo, "Vseg", mapinfo.bytes*2+2);
+        map_pad(&mapinfo, "Start", mapinfo.bytes*2+2);
+        map_pad(&mapinfo, "Stop", mapinfo.bytes*2+2);
+        map_pad(&mapinfo, "Length", mapinfo.bytes*2+2);
+        map_pad(&mapinfo, "Class", 10);
+        map_puts(&mapinfo, "Name\n");
 
         map_sections_summary(&info->lma_groups, &mapinfo);
-        fprintf(f, "\n");
+        map_puts(&mapinfo, "\n");
     }
 
     if (objfmt_bin->map_flags & MAP_SECTIONS) {
-        fprintf(f, "-- Sections (detailed) ");
-        for (i=0; i<56; i++)
-            fputc('-', f);
-        fprintf(f, "\n\n");
+        map_puts(&mapinfo, "-- Sections (detailed) ");
+        map_fill(&mapinfo, '-', 56);
+        map_puts(&mapinfo, "\n\n");
         map_sections_detail(&info->lma_groups, &mapinfo);
     }
 
     if (objfmt_bin->map_flags & MAP_SYMBOLS) {
-        fprintf(f, "-- Symbols ");
-        for (i=0; i<68; i++)
-            fputc('-', f);
-        fprintf(f, "\n\n");
-
-        /* We do two passes for EQU and each section; the first pass
-         * determines the byte width to use for the value and whether any
-         * symbols are present, the second pass actually outputs the text.
-         */
+        map_puts(&mapinfo, "-- Symbols ");
+        map_fill(&mapinfo, '-', 68);
+        map_puts(&mapinfo, "\n\n");
+
+        map_collect_symbols(&info->lma_groups, &mapinfo,
+                            objfmt_bin->map_flags & MAP_SORTED);
 
         /* EQUs */
-        mapinfo.count = 0;
-        mapinfo.section = NULL;
-        yasm_symtab_traverse(info->object->symtab, &mapinfo, map_symrec_count);
-
-        if (mapinfo.count > 0) {
-            fprintf(f, "---- No Section ");
-            for (i=0; i<63; i++)
-                fputc('-', f);
-            fprintf(f, "\n\n%-*s%s\n", mapinfo.bytes*2+2, "Value", "Name");
-            yasm_symtab_traverse(info->object->symtab, &mapinfo,
-                                 map_symrec_output);
-            fprintf(f, "\n\n");
+        if (mapinfo.sect_first[1] > 0) {
+            map_puts(&mapinfo, "---- No Section ");
+            map_fill(&mapinfo, '-', 63);
+            map_puts(&mapinfo, "\n\n");
+            map_pad(&mapinfo, "Value", mapinfo.bytes*2+2);
+            map_puts(&mapinfo, "Name\n");
+            map_symbols_output(0, NULL, &mapinfo);
+            map_puts(&mapinfo, "\n\n");
         }
 
         /* Other sections */
         map_sections_symbols(&info->lma_groups, &mapinfo);
+
+        for (i=0; i<mapinfo.num_syms; i++) {
+            if (mapinfo.syms[i].ivalue)
+                yasm_intnum_destroy(mapinfo.syms[i].ivalue);
+        }
+        yasm_xfree(mapinfo.syms);
+        yasm_xfree(mapinfo.sect_first);
     }
 
+    map_flush(&mapinfo);
     if (f != stdout)
         fclose(f);
 
+    yasm_xfree(mapinfo.outbuf);
     yasm_xfree(mapinfo.buf);
 }
 
-/* Check for LMA overlap using a simple N^2 algorithm. */
+/* Find a pair of sections with overlapping LMAs using a simple N^2
+ * algorithm.
+ */
 static int
 check_lma_overlap(yasm_section *sect, /*@null@*/ void *d)
 {
@@ -1134,51 +1419,6 @@ done:
     return 1;
 }
 
-static int
-bin_objfmt_output_bytecode(yasm_bytecode *bc, /*@null@*/ void *d)
-{
-    /*@null@*/ bin_objfmt_output_info *info = (bin_objfmt_output_info *)d;
-    /*@null@*/ /*@only@*/ unsigned char *bigbuf;
-    unsigned long size = REGULAR_OUTBUF_SIZE;
-    int gap;
-
-    assert(info != NULL);
-
-    bigbuf = yasm_bc_tobytes(bc, info->buf, &size, &gap, info,
-                             bin_objfmt_output_value, NULL);
-
-    /* Don't bother doing anything else if size ended up being 0. */
-    if (size == 0) {
-        if (bigbuf)
-            yasm_xfree(bigbuf);
-        return 0;
-    }
-
-    /* Warn that gaps are converted to 0 and write out the 0's. */
-    if (gap) {
-        unsigned long left;
-        yasm_warn_set(YASM_WARN_UNINIT_CONTENTS,
-            N_("uninitialized space declared in code/data section: zeroing"));
-        /* Write out in chunks */
-        memset(info->buf, 0, REGULAR_OUTBUF_SIZE);
-        left = size;
-        while (left > REGULAR_OUTBUF_SIZE) {
-            fwrite(info->buf, REGULAR_OUTBUF_SIZE, 1, info->f);
-            left -= REGULAR_OUTBUF_SIZE;
-        }
-        fwrite(info->buf, left, 1, info->f);
-    } else {
-        /* Output buf (or bigbuf if non-NULL) to file */
-        fwrite(bigbuf ? bigbuf : info->buf, (size_t)size, 1, info->f);
-    }
-
-    /* If bigbuf was allocated, free it */
-    if (bigbuf)
-        yasm_xfree(bigbuf);
-
-    return 0;
-}
-
 /* Check to ensure bytecode is res* (for BSS sections) */
 static int
 bin_objfmt_no_output_bytecode(yasm_bytecode *bc, /*@null@*/ void *d)
@@ -1215,6 +1455,7 @@ bin_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
 {
     bin_section_data *bsd = yasm_section_get_data(sect, &bin_section_data_cb);
     /*@null@*/ bin_objfmt_output_info *info = (bin_objfmt_output_info *)d;
+    yasm_section_contents contents;
 
     assert(bsd != NULL);
     assert(info != NULL);
@@ -1242,8 +1483,11 @@ bin_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
         if (fseek(info->f, yasm_intnum_get_int(info->tmp_intn) + info->start,
                   SEEK_SET) < 0)
             yasm__fatal(N_("could not seek on output file"));
-        yasm_section_bcs_traverse(sect, info->errwarns,
-                                  info, bin_objfmt_output_bytecode);
+        yasm_section_tobytes(sect, info->errwarns,
+            N_("uninitialized space declared in code/data section: zeroing"),
+            info, bin_objfmt_output_value, NULL, &contents);
+        yasm_section_contents_write(&contents, info->f);
+        yasm_section_contents_delete(&contents);
     }
 
     return 0;
@@ -1265,15 +1509,195 @@ bin_objfmt_cleanup(bin_objfmt_output_info *info)
         bin_group_destroy(group);
 }
 
+/* Sort entry for a top-level LMA group. */
+typedef struct bin_sort_ent {
+    bin_group *group;
+    /* Start address, or for groups without one, the maximum start address
+     * of the groups before it in the input (NULL if none; sorts before all
+     * start addresses).
+     */
+    /*@null@*/ /*@dependent@*/ const yasm_intnum *ikey;
+    unsigned long key;          /* ikey as a native address */
+    int native;                 /* ikey fits into key */
+    unsigned long order;        /* input order */
+} bin_sort_ent;
+
+static int
+bin_sort_ent_compare(const void *a, const void *b)
+{
+    const bin_sort_ent *ea = a, *eb = b;
+
+    if (!ea->ikey || !eb->ikey) {
+        if (ea->ikey != eb->ikey)
+            return ea->ikey ? 1 : -1;
+    } else if (ea->native && eb->native) {
+        if (ea->key != eb->key)
+            return ea->key < eb->key ? -1 : 1;
+    } else {
+        int cmp = yasm_intnum_compare(ea->ikey, eb->ikey);
+        if (cmp != 0)
+            return cmp;
+    }
+    if (ea->order != eb->order)
+        return ea->order < eb->order ? -1 : 1;
+    return 0;
+}
+
+/* Get an intnum as a native address.  Returns nonzero if it doesn't fit. */
+static int
+bin_native_addr(const yasm_intnum *intn, unsigned long *addr)
+{
+    if (yasm_intnum_sign(intn) < 0 ||
+        !yasm_intnum_check_size(intn, sizeof(unsigned long)*CHAR_BIT, 0, 0))
+        return 1;
+    *addr = bin_intnum_low(intn);
+    return 0;
+}
+
+/* Sort top-level groups by start address.  Groups with a start address
+ * are stably sorted among themselves.  A group without one stays after
+ * every group with a start address that came before it in the input, and
+ * after any later group with a lower start address.  Pure-BSS groups
+ * without a start address go to the end.
+ */
+static void
+bin_sort_groups(bin_groups *groups)
+{
+    bin_sort_ent *ents, max;
+    bin_groups bss_groups;
+    bin_group *group, *group_temp;
+    unsigned long n = 0, i;
+
+    TAILQ_FOREACH(group, groups, link)
+        n++;
+    if (n == 0)
+        return;
+    ents = yasm_xmalloc(n*sizeof(bin_sort_ent));
+
+    TAILQ_INIT(&bss_groups);
+    max.ikey = NULL;
+    i = 0;
+    TAILQ_FOREACH_SAFE(group, groups, link, group_temp) {
+        TAILQ_REMOVE(groups, group, link);
+        if (!group->bsd->istart) {
+            if (group->bsd->bss) {
+                TAILQ_INSERT_TAIL(&bss_groups, group, link);
+                continue;
+            }
+            ents[i] = max;
+        } else {
+            ents[i].ikey = group->bsd->istart;
+            ents[i].native = !bin_native_addr(ents[i].ikey, &ents[i].key);
+            ents[i].order = 0;
+            if (bin_sort_ent_compare(&ents[i], &max) > 0)
+                max = ents[i];
+        }
+        ents[i].group = group;
+        ents[i].order = i;
+        i++;
+    }
+    n = i;
+
+    yasm__mergesort(ents, n, sizeof(bin_sort_ent), bin_sort_ent_compare);
+    for (i=0; i<n; i++)
+        TAILQ_INSERT_TAIL(groups, ents[i].group, link);
+    yasm_xfree(ents);
+
+    /* Move the pure-BSS sections to the end of the LMA list. */
+    TAILQ_CONCAT(groups, &bss_groups, link);
+}
+
+/* LMA interval of a section, for the overlap check. */
+typedef struct bin_interval {
+    unsigned long start, end;
+} bin_interval;
+
+static int
+bin_interval_compare(const void *a, const void *b)
+{
+    const bin_interval *ia = a, *ib = b;
+    if (ia->start != ib->start)
+        return ia->start < ib->start ? -1 : 1;
+    return 0;
+}
+
+typedef struct bin_overlap_info {
+    /*@only@*/ bin_interval *intervals;
+    unsigned long n, alloc;
+    int native;                 /* all intervals fit in an unsigned long */
+} bin_overlap_info;
+
+static int
+bin_collect_interval(yasm_section *sect, /*@null@*/ void *d)
+{
+    bin_overlap_info *info = (bin_overlap_info *)d;
+    bin_section_data *bsd = yasm_section_get_data(sect, &bin_section_data_cb);
+    unsigned long start, length;
+
+    if (yasm_intnum_is_zero(bsd->length))
+        return 0;
+    if (bin_native_addr(bsd->istart, &start) ||
+        bin_native_addr(bsd->length, &length) || start + length < start) {
+        info->native = 0;
+        return 1;
+    }
+    if (info->n >= info->alloc) {
+        info->alloc *= 2;
+        info->intervals = yasm_xrealloc(info->intervals,
+                                        info->alloc*sizeof(bin_interval));
+    }
+    info->intervals[info->n].start = start;
+    info->intervals[info->n].end = start + length;
+    info->n++;
+    return 0;
+}
+
+/* Check for LMA overlap.  Overlap is detected by sorting the sections by
+ * start address and sweeping; only when there is an overlap (or addresses
+ * don't fit into an unsigned long) are the sections compared pairwise to
+ * find the pair to report.
+ */
+static int
+bin_check_overlap(yasm_object *object)
+{
+    bin_overlap_info info;
+    unsigned long i, maxend;
+    int overlap = 0;
+
+    info.alloc = 64;
+    info.intervals = yasm_xmalloc(info.alloc*sizeof(bin_interval));
+    info.n = 0;
+    info.native = 1;
+    yasm_object_sections_traverse(object, &info, bin_collect_interval);
+
+    if (info.native && info.n > 1) {
+        qsort(info.intervals, info.n, sizeof(bin_interval),
+              bin_interval_compare);
+        maxend = info.intervals[0].end;
+        for (i=1; i<info.n; i++) {
+            if (info.intervals[i].start < maxend) {
+                overlap = 1;
+                break;
+            }
+            if (info.intervals[i].end > maxend)
+                maxend = info.intervals[i].end;
+        }
+    }
+    yasm_xfree(info.intervals);
+
+    if (!info.native || overlap)
+        return yasm_object_sections_traverse(object, NULL, check_lma_overlap);
+    return 0;
+}
+
 static void
 bin_objfmt_output(yasm_object *object, FILE *f, /*@unused@*/ int all_syms,
                   yasm_errwarns *errwarns)
 {
     yasm_objfmt_bin *objfmt_bin = (yasm_objfmt_bin *)object->objfmt;
     bin_objfmt_output_info info;
-    bin_group *group, *lma_group, *vma_group, *group_temp;
+    bin_group *lma_group, *vma_group, *group_temp;
     yasm_intnum *start, *last, *vdelta;
-    bin_groups unsorted_groups, bss_groups;
 
     info.start = ftell(f);
 
@@ -1327,8 +1751,7 @@ bin_objfmt_output(yasm_object *object, FILE *f, /*@unused@*/ int all_syms,
         if (lma_group->bsd->follows) {
             bin_group *found;
             /* Need to find group containing section this section follows. */
-            found =
-                find_group_by_name(&info.lma_groups, lma_group->bsd->follows);
+            found = find_group_by_name(object, lma_group->bsd->follows);
             if (!found) {
                 yasm_error_set(YASM_ERROR_VALUE,
                                N_("section `%s' follows an invalid or unknown section `%s'"),
@@ -1340,9 +1763,7 @@ bin_objfmt_output(yasm_object *object, FILE *f, /*@unused@*/ int all_syms,
             }
 
             /* Check for loops */
-            if (lma_group->section == found->section ||
-                find_group_by_section(&lma_group->follow_groups,
-                                      found->section)) {
+            if (follow_group(&info.lma_groups, lma_group, found)) {
                 yasm_error_set(YASM_ERROR_VALUE,
                                N_("follows loop between section `%s' and section `%s'"),
                                yasm_section_get_name(lma_group->section),
@@ -1351,54 +1772,15 @@ bin_objfmt_output(yasm_object *object, FILE *f, /*@unused@*/ int all_syms,
                 bin_objfmt_cleanup(&info);
                 return;
             }
-
-            /* Remove this section from main lma groups list */
-            TAILQ_REMOVE(&info.lma_groups, lma_group, link);
-            /* Add it after the section it's supposed to follow. */
-            TAILQ_INSERT_TAIL(&found->follow_groups, lma_group, link);
         }
     }
 
     /* Sort the top-level groups according to their start address.
-     * Use Shell sort for ease of implementation.
      * If no start address is specified for a section, don't change the order,
      * and move BSS sections to a separate list so they can be moved to the
      * end of the lma list after all other sections are sorted.
      */
-    unsorted_groups = info.lma_groups;  /* structure copy */
-    TAILQ_INIT(&info.lma_groups);
-    TAILQ_INIT(&bss_groups);
-    TAILQ_FOREACH_SAFE(lma_group, &unsorted_groups, link, group_temp) {
-        bin_group *before;
-
-        if (!lma_group->bsd->istart) {
-            if (lma_group->bsd->bss)
-                TAILQ_INSERT_TAIL(&bss_groups, lma_group, link);
-            else
-                TAILQ_INSERT_TAIL(&info.lma_groups, lma_group, link);
-            continue;
-        }
-
-        before = NULL;
-        TAILQ_FOREACH(group, &info.lma_groups, link) {
-            if (!group->bsd->istart)
-                continue;
-            if (yasm_intnum_compare(group->bsd->istart,
-                                    lma_group->bsd->istart) > 0) {
-                before = group;
-                break;
-            }
-        }
-        if (before)
-            TAILQ_INSERT_BEFORE(before, lma_group, link);
-        else
-            TAILQ_INSERT_TAIL(&info.lma_groups, lma_group, link);
-    }
-
-    /* Move the pure-BSS sections to the end of the LMA list. */
-    TAILQ_FOREACH_SAFE(group, &bss_groups, link, group_temp)
-        TAILQ_INSERT_TAIL(&info.lma_groups, group, link);
-    TAILQ_INIT(&bss_groups);    /* For sanity */
+    bin_sort_groups(&info.lma_groups);
 
     /* Assign a LMA start address to every section.
      * Also assign VMA=LMA unless otherwise specified.
@@ -1451,8 +1833,7 @@ bin_objfmt_output(yasm_object *object, FILE *f, /*@unused@*/ int all_syms,
         if (vma_group->bsd->vfollows) {
             bin_group *found;
             /* Need to find group containing section this section follows. */
-            found = find_group_by_name(&info.vma_groups,
-                                       vma_group->bsd->vfollows);
+            found = find_group_by_name(object, vma_group->bsd->vfollows);
             if (!found) {
                 yasm_error_set(YASM_ERROR_VALUE,
                                N_("section `%s' vfollows an invalid or unknown section `%s'"),
@@ -1465,22 +1846,16 @@ bin_objfmt_output(yasm_object *object, FILE *f, /*@unused@*/ int all_syms,
             }
 
             /* Check for loops */
-            if (vma_group->section == found->section ||
-                find_group_by_section(&vma_group->follow_groups,
-                                      found->section)) {
+            if (follow_group(&info.vma_groups, vma_group, found)) {
                 yasm_error_set(YASM_ERROR_VALUE,
                                N_("vfollows loop between section `%s' and section `%s'"),
                                yasm_section_get_name(vma_group->section),
                                yasm_section_get_name(found->section));
                 yasm_errwarn_propagate(errwarns, 0);
+                yasm_intnum_destroy(start);
                 bin_objfmt_cleanup(&info);
                 return;
             }
-
-            /* Remove this section from main lma groups list */
-            TAILQ_REMOVE(&info.vma_groups, vma_group, link);
-            /* Add it after the section it's supposed to follow. */
-            TAILQ_INSERT_TAIL(&found->follow_groups, vma_group, link);
         }
     }
 
@@ -1500,11 +1875,8 @@ bin_objfmt_output(yasm_object *object, FILE *f, /*@unused@*/ int all_syms,
     /* Output map file */
     output_map(&info);
 
-    /* Ensure we don't have overlapping progbits LMAs.
-     * Use a dumb O(N^2) algorithm as the number of sections is essentially
-     * always low.
-     */
-    if (yasm_object_sections_traverse(object, NULL, check_lma_overlap)) {
+    /* Ensure we don't have overlapping progbits LMAs. */
+    if (bin_check_overlap(object)) {
         yasm_errwarn_propagate(errwarns, 0);
         yasm_intnum_destroy(start);
         bin_objfmt_cleanup(&info);
@@ -1570,6 +1942,8 @@ bin_objfmt_init_new_section(yasm_section *sect, unsigned long line)
     data->istart = NULL;
     data->ivstart = NULL;
     data->length = NULL;
+    data->group = NULL;
+    data->map_index = 0;
     yasm_section_add_data(sect, &bin_section_data_cb, data);
 
     define_section_symbol(object->symtab, sect, sectname, ".start",
@@ -1832,7 +2206,9 @@ bin_objfmt_dir_map(yasm_object *object,
         { "segments", 0, yasm_dir_helper_flag_or,
           offsetof(struct bin_dir_map_data, flags), MAP_SECTIONS },
         { "symbols", 0, yasm_dir_helper_flag_or,
-          offsetof(struct bin_dir_map_data, flags), MAP_SYMBOLS }
+          offsetof(struct bin_dir_map_data, flags), MAP_SYMBOLS },
+        { "sorted", 0, yasm_dir_helper_flag_or,
+          offsetof(struct bin_dir_map_data, flags), MAP_SORTED }
     };
 
     data.flags = objfmt_bin->map_flags | MAP_NONE;
@@ -0,0 +1,6 @@
+org 0xFFFFFF00
+[map brief]
+section a start=0x100000000
+db 1
+section b start=0xFFFFFF80
+db 2
@@ -0,0 +1,14 @@
+[map symbols sorted]
+org 0x100
+val2 equ 0x20
+val1 equ 0x10
+section .text
+start:
+	dw	third, second
+first:	db	1
+second:	db	2
+third:	db	3
+section data follows=.text vstart=0x8000
+	dw	last
+mid:	dd	0
+last:	dd	0
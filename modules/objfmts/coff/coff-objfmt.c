@@ -28,6 +28,7 @@
 #include <time.h>
 
 #include <libyasm.h>
+#include <libyasm/phash.h>
 
 #include "coff-objfmt.h"
 
@@ -184,6 +185,20 @@ typedef struct yasm_objfmt_coff {
     yasm_symrec *ssym_imagebase;            /* ..imagebase symbol for win64 */
 } yasm_objfmt_coff;
 
+/* String table builder.  Strings are stored once each; a hash table of
+ * string table offsets (0 = empty slot) finds earlier copies.  The first
+ * 4 bytes of data are reserved for the total length, so every string
+ * offset is nonzero.
+ */
+typedef struct coff_strtab {
+    /*@only@*/ char *data;
+    unsigned long len;                  /* bytes used in data */
+    unsigned long alloc;                /* bytes allocated for data */
+    /*@only@*/ unsigned long *hash;     /* open-addressed offset table */
+    unsigned long hash_size;            /* power of 2 */
+    unsigned long count;                /* number of strings in table */
+} coff_strtab;
+
 typedef struct coff_objfmt_output_info {
     yasm_object *object;
     yasm_objfmt_coff *objfmt_coff;
@@ -196,7 +211,13 @@ typedef struct coff_objfmt_output_info {
 
     unsigned long indx;                 /* current symbol index */
     int all_syms;                       /* outputting all symbols? */
-    unsigned long strtab_offset;        /* current string table offset */
+
+    /* symbol table entries, collected for a single write */
+    /*@only@*/ unsigned char *symtab;
+    unsigned long symtab_len;           /* bytes used in symtab */
+    unsigned long symtab_alloc;         /* bytes allocated for symtab */
+
+    coff_strtab strtab;                 /* string table */
 } coff_objfmt_output_info;
 
 static void coff_section_data_destroy(/*@only@*/ void *d);
@@ -421,6 +442,78 @@ coff_objfmt_init_new_section(yasm_section *sect, unsigned long line)
     data->sym = sym;
 }
 
+static void
+coff_strtab_init(coff_strtab *strtab)
+{
+    strtab->alloc = 1024;
+    strtab->data = yasm_xmalloc(strtab->alloc);
+    strtab->len = 4;
+    strtab->hash_size = 256;
+    strtab->hash = yasm_xcalloc(strtab->hash_size, sizeof(unsigned long));
+    strtab->count = 0;
+}
+
+static void
+coff_strtab_destroy(coff_strtab *strtab)
+{
+    yasm_xfree(strtab->data);
+    yasm_xfree(strtab->hash);
+}
+
+/* Add a string to the string table (if not already present) and return
+ * its offset.
+ */
+static unsigned long
+coff_strtab_add(coff_strtab *strtab, const char *str, size_t len)
+{
+    unsigned long mask, i, offset;
+
+    /* Keep the hash table at most half full */
+    if (strtab->count*2 >= strtab->hash_size) {
+        unsigned long *oldhash = strtab->hash;
+        unsigned long oldsize = strtab->hash_size, j;
+
+        strtab->hash_size *= 2;
+        strtab->hash = yasm_xcalloc(strtab->hash_size, sizeof(unsigned long));
+        mask = strtab->hash_size-1;
+        for (j=0; j<oldsize; j++) {
+            const char *s;
+            offset = oldhash[j];
+            if (offset == 0)
+                continue;
+            s = strtab->data + offset;
+            i = phash_lookup(s, strlen(s), 0) & mask;
+            while (strtab->hash[i] != 0)
+                i = (i+1) & mask;
+            strtab->hash[i] = offset;
+        }
+        yasm_xfree(oldhash);
+    }
+
+    mask = strtab->hash_size-1;
+    i = phash_lookup(str, len, 0) & mask;
+    while ((offset = strtab->hash[i]) != 0) {
+        if (strncmp(strtab->data + offset, str, len) == 0 &&
+            strtab->data[offset+len] == '\0')
+            return offset;
+        i = (i+1) & mask;
+    }
+
+    /* Not found; append */
+    offset = strtab->len;
+    if (offset + len + 1 > strtab->alloc) {
+        while (offset + len + 1 > strtab->alloc)
+            strtab->alloc *= 2;
+        strtab->data = yasm_xrealloc(strtab->data, strtab->alloc);
+    }
+    memcpy(strtab->data + offset, str, len);
+    strtab->data[offset+len] = '\0';
+    strtab->len += (unsigned long)(len + 1);
+    strtab->hash[i] = offset;
+    strtab->count++;
+    return offset;
+}
+
 static int
 coff_objfmt_output_value(yasm_value *value, unsigned char *buf,
                          unsigned int destsize, unsigned long offset,
@@ -469,7 +562,7 @@ coff_objfmt_output_value(yasm_value *value, unsigned char *buf,
         yasm_sym_vis vis = yasm_symrec_get_visibility(value->rel);
         /*@dependent@*/ /*@null@*/ yasm_symrec *sym = value->rel;
         unsigned long addr;
-        coff_reloc *reloc;
+        coff_reloc reloc;
         int nobase = info->csd->flags2 & COFF_FLAG_NOBASE;
 
         /* Sometimes we want the relocation to be generated against one
@@ -520,10 +613,16 @@ coff_objfmt_output_value(yasm_value *value, unsigned char *buf,
 
                 intn_val += yasm_intnum_get_uint(common_size);
             }
-        } else if (!(vis & YASM_SYM_EXTERN) && !objfmt_coff->win64) {
+        } else if (!(vis & YASM_SYM_EXTERN) &&
+                   (!objfmt_coff->win64 ||
+                    (yasm_symrec_get_status(sym) & YASM_SYM_NOTINTABLE))) {
             /*@dependent@*/ /*@null@*/ yasm_bytecode *sym_precbc;
 
-            /* Local symbols need relocation to their section's start */
+            /* Local symbols need relocation to their section's start.
+             * Win64 normally keeps the symbol itself, but symbols not in
+             * the symbol table (e.g. GAS numeric local labels) have no
+             * symbol table entry to relocate against.
+             */
             if (yasm_symrec_get_label(sym, &sym_precbc)) {
                 yasm_section *sym_sect = yasm_bc_get_section(sym_precbc);
                 /*@null@*/ coff_section_data *sym_csd;
@@ -558,15 +657,14 @@ coff_objfmt_output_value(yasm_value *value, unsigned char *buf,
         }
 
         /* Generate reloc */
-        reloc = yasm_xmalloc(sizeof(coff_reloc));
         addr = bc->offset + offset;
-        reloc->reloc.addr = yasm_intnum_create_uint(addr);
-        reloc->reloc.sym = sym;
+        reloc.reloc.addr = addr;
+        reloc.reloc.sym = sym;
 
         if (value->curpos_rel) {
             if (objfmt_coff->machine == COFF_MACHINE_I386) {
                 if (valsize == 32)
-                    reloc->type = COFF_RELOC_I386_REL32;
+                    reloc.type = COFF_RELOC_I386_REL32;
                 else {
                     yasm_error_set(YASM_ERROR_TYPE,
                                    N_("coff: invalid relocation size"));
@@ -579,25 +677,25 @@ coff_objfmt_output_value(yasm_value *value, unsigned char *buf,
                     return 1;
                 }
                 if (!value->ip_rel)
-                    reloc->type = COFF_RELOC_AMD64_REL32;
+                    reloc.type = COFF_RELOC_AMD64_REL32;
                 else switch (bc->len*bc->mult_int - (offset+destsize)) {
                     case 0:
-                        reloc->type = COFF_RELOC_AMD64_REL32;
+                        reloc.type = COFF_RELOC_AMD64_REL32;
                         break;
                     case 1:
-                        reloc->type = COFF_RELOC_AMD64_REL32_1;
+                        reloc.type = COFF_RELOC_AMD64_REL32_1;
                         break;
                     case 2:
-                        reloc->type = COFF_RELOC_AMD64_REL32_2;
+                        reloc.type = COFF_RELOC_AMD64_REL32_2;
                         break;
                     case 3:
-                        reloc->type = COFF_RELOC_AMD64_REL32_3;
+                        reloc.type = COFF_RELOC_AMD64_REL32_3;
                         break;
                     case 4:
-                        reloc->type = COFF_RELOC_AMD64_REL32_4;
+                        reloc.type = COFF_RELOC_AMD64_REL32_4;
                         break;
                     case 5:
-                        reloc->type = COFF_RELOC_AMD64_REL32_5;
+                        reloc.type = COFF_RELOC_AMD64_REL32_5;
                         break;
                     default:
                         yasm_error_set(YASM_ERROR_TYPE,
@@ -608,32 +706,32 @@ coff_objfmt_output_value(yasm_value *value, unsigned char *buf,
                 yasm_internal_error(N_("coff objfmt: unrecognized machine"));
         } else if (value->seg_of) {
             if (objfmt_coff->machine == COFF_MACHINE_I386)
-                reloc->type = COFF_RELOC_I386_SECTION;
+                reloc.type = COFF_RELOC_I386_SECTION;
             else if (objfmt_coff->machine == COFF_MACHINE_AMD64)
-                reloc->type = COFF_RELOC_AMD64_SECTION;
+                reloc.type = COFF_RELOC_AMD64_SECTION;
             else
                 yasm_internal_error(N_("coff objfmt: unrecognized machine"));
         } else if (value->section_rel) {
             if (objfmt_coff->machine == COFF_MACHINE_I386)
-                reloc->type = COFF_RELOC_I386_SECREL;
+                reloc.type = COFF_RELOC_I386_SECREL;
             else if (objfmt_coff->machine == COFF_MACHINE_AMD64)
-                reloc->type = COFF_RELOC_AMD64_SECREL;
+                reloc.type = COFF_RELOC_AMD64_SECREL;
             else
                 yasm_internal_error(N_("coff objfmt: unrecognized machine"));
         } else {
             if (objfmt_coff->machine == COFF_MACHINE_I386) {
                 if (nobase)
-                    reloc->type = COFF_RELOC_I386_ADDR32NB;
+                    reloc.type = COFF_RELOC_I386_ADDR32NB;
                 else
-                    reloc->type = COFF_RELOC_I386_ADDR32;
+                    reloc.type = COFF_RELOC_I386_ADDR32;
             } else if (objfmt_coff->machine == COFF_MACHINE_AMD64) {
                 if (valsize == 32) {
                     if (nobase)
-                        reloc->type = COFF_RELOC_AMD64_ADDR32NB;
+                        reloc.type = COFF_RELOC_AMD64_ADDR32NB;
                     else
-                        reloc->type = COFF_RELOC_AMD64_ADDR32;
+                        reloc.type = COFF_RELOC_AMD64_ADDR32;
                 } else if (valsize == 64)
-                    reloc->type = COFF_RELOC_AMD64_ADDR64;
+                    reloc.type = COFF_RELOC_AMD64_ADDR64;
                 else {
                     yasm_error_set(YASM_ERROR_TYPE,
                                    N_("coff: invalid relocation size"));
@@ -643,7 +741,8 @@ coff_objfmt_output_value(yasm_value *value, unsigned char *buf,
                 yasm_internal_error(N_("coff objfmt: unrecognized machine"));
         }
         info->csd->nreloc++;
-        yasm_section_add_reloc(info->sect, (yasm_reloc *)reloc, yasm_xfree);
+        yasm_section_add_reloc(info->sect, (yasm_reloc *)&reloc,
+                               sizeof(coff_reloc), NULL);
     }
 
     /* Build up final integer output from intn_val, intn_minus, value->abs,
@@ -681,51 +780,19 @@ coff_objfmt_output_value(yasm_value *value, unsigned char *buf,
     return retval;
 }
 
-static int
-coff_objfmt_output_bytecode(yasm_bytecode *bc, /*@null@*/ void *d)
+static void
+coff_objfmt_write_reloc(yasm_reloc *reloc, unsigned char *buf,
+                        /*@unused@*/ void *d)
 {
-    /*@null@*/ coff_objfmt_output_info *info = (coff_objfmt_output_info *)d;
-    /*@null@*/ /*@only@*/ unsigned char *bigbuf;
-    unsigned long size = REGULAR_OUTBUF_SIZE;
-    int gap;
-
-    assert(info != NULL);
-
-    bigbuf = yasm_bc_tobytes(bc, info->buf, &size, &gap, info,
-                             coff_objfmt_output_value, NULL);
-
-    /* Don't bother doing anything else if size ended up being 0. */
-    if (size == 0) {
-        if (bigbuf)
-            yasm_xfree(bigbuf);
-        return 0;
-    }
-
-    info->csd->size += size;
-
-    /* Warn that gaps are converted to 0 and write out the 0's. */
-    if (gap) {
-        unsigned long left;
-        yasm_warn_set(YASM_WARN_UNINIT_CONTENTS,
-            N_("uninitialized space declared in code/data section: zeroing"));
-        /* Write out in chunks */
-        memset(info->buf, 0, REGULAR_OUTBUF_SIZE);
-        left = size;
-        while (left > REGULAR_OUTBUF_SIZE) {
-            fwrite(info->buf, REGULAR_OUTBUF_SIZE, 1, info->f);
-            left -= REGULAR_OUTBUF_SIZE;
-        }
-        fwrite(info->buf, left, 1, info->f);
-    } else {
-        /* Output buf (or bigbuf if non-NULL) to file */
-        fwrite(bigbuf ? bigbuf : info->buf, (size_t)size, 1, info->f);
-    }
+    /*@null@*/ coff_symrec_data *csymd;
 
-    /* If bigbuf was allocated, free it */
-    if (bigbuf)
-        yasm_xfree(bigbuf);
+    csymd = yasm_symrec_get_data(reloc->sym, &coff_symrec_data_cb);
+    if (!csymd)
+        yasm_internal_error(N_("coff: no symbol data for relocated symbol"));
 
-    return 0;
+    YASM_WRITE_32_L(buf, reloc->addr);          /* address of relocation */
+    YASM_WRITE_32_L(buf, csymd->index);         /* relocated symbol */
+    YASM_WRITE_16_L(buf, ((coff_reloc *)reloc)->type); /* type of relocation */
 }
 
 static int
@@ -733,8 +800,8 @@ coff_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
 {
     /*@null@*/ coff_objfmt_output_info *info = (coff_objfmt_output_info *)d;
     /*@dependent@*/ /*@null@*/ coff_section_data *csd;
+    yasm_section_contents contents;
     long pos;
-    coff_reloc *reloc;
     unsigned char *localbuf;
 
     assert(info != NULL);
@@ -744,10 +811,10 @@ coff_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
     /* Add to strtab if in win32 format and name > 8 chars */
     if (info->objfmt_coff->win32) {
         size_t namelen = strlen(yasm_section_get_name(sect));
-        if (namelen > 8) {
-            csd->strtab_name = info->strtab_offset;
-            info->strtab_offset += (unsigned long)(namelen + 1);
-        }
+        if (namelen > 8)
+            csd->strtab_name = coff_strtab_add(&info->strtab,
+                                               yasm_section_get_name(sect),
+                                               namelen);
     }
 
     if (!csd->isdebug)
@@ -769,8 +836,12 @@ coff_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
 
         info->sect = sect;
         info->csd = csd;
-        yasm_section_bcs_traverse(sect, info->errwarns, info,
-                                  coff_objfmt_output_bytecode);
+        yasm_section_tobytes(sect, info->errwarns,
+            N_("uninitialized space declared in code/data section: zeroing"),
+            info, coff_objfmt_output_value, NULL, &contents);
+        csd->size += contents.size;
+        yasm_section_contents_write(&contents, info->f);
+        yasm_section_contents_delete(&contents);
 
         /* Sanity check final section size */
         if (yasm_errwarns_num_errors(info->errwarns, 0) == 0 &&
@@ -810,43 +881,11 @@ coff_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
         fwrite(info->buf, 10, 1, info->f);
     }
 
-    reloc = (coff_reloc *)yasm_section_relocs_first(sect);
-    while (reloc) {
-        /*@null@*/ coff_symrec_data *csymd;
-        localbuf = info->buf;
+    /* Relocations are expected in ascending address order */
+    yasm_section_relocs_sort(sect);
+    yasm_section_relocs_write(sect, info->f, 10, coff_objfmt_write_reloc,
+                              NULL);
 
-        csymd = yasm_symrec_get_data(reloc->reloc.sym, &coff_symrec_data_cb);
-        if (!csymd)
-            yasm_internal_error(
-                N_("coff: no symbol data for relocated symbol"));
-
-        yasm_intnum_get_sized(reloc->reloc.addr, localbuf, 4, 32, 0, 0, 0);
-        localbuf += 4;                          /* address of relocation */
-        YASM_WRITE_32_L(localbuf, csymd->index);    /* relocated symbol */
-        YASM_WRITE_16_L(localbuf, reloc->type);     /* type of relocation */
-        fwrite(info->buf, 10, 1, info->f);
-
-        reloc = (coff_reloc *)yasm_section_reloc_next((yasm_reloc *)reloc);
-    }
-
-    return 0;
-}
-
-static int
-coff_objfmt_output_sectstr(yasm_section *sect, /*@null@*/ void *d)
-{
-    /*@null@*/ coff_objfmt_output_info *info = (coff_objfmt_output_info *)d;
-    const char *name;
-    size_t len;
-
-    /* Add to strtab if in win32 format and name > 8 chars */
-    if (!info->objfmt_coff->win32)
-       return 0;
-    
-    name = yasm_section_get_name(sect);
-    len = strlen(name);
-    if (len > 8)
-        fwrite(name, len+1, 1, info->f);
     return 0;
 }
 
@@ -1044,11 +1083,14 @@ coff_objfmt_output_sym(yasm_symrec *sym, /*@null@*/ void *d)
                 scnum = 0;
         }
 
-        localbuf = info->buf;
+        if (info->symtab_len + 18*(1+csymd->numaux) > info->symtab_alloc)
+            yasm_internal_error(N_("coff: symbol table size mismatch"));
+        localbuf = info->symtab + info->symtab_len;
+        info->symtab_len += 18*(1+csymd->numaux);
         if (len > 8) {
             YASM_WRITE_32_L(localbuf, 0);       /* "zeros" field */
-            YASM_WRITE_32_L(localbuf, info->strtab_offset); /* strtab offset */
-            info->strtab_offset += (unsigned long)(len+1);
+            YASM_WRITE_32_L(localbuf,           /* strtab offset */
+                            coff_strtab_add(&info->strtab, name, len));
         } else {
             /* <8 chars, so no string table entry needed */
             strncpy((char *)localbuf, name, 8);
@@ -1059,70 +1101,31 @@ coff_objfmt_output_sym(yasm_symrec *sym, /*@null@*/ void *d)
         YASM_WRITE_16_L(localbuf, csymd->type); /* type */
         YASM_WRITE_8(localbuf, csymd->sclass);  /* storage class */
         YASM_WRITE_8(localbuf, csymd->numaux);  /* number of aux entries */
-        fwrite(info->buf, 18, 1, info->f);
         for (aux=0; aux<csymd->numaux; aux++) {
-            localbuf = info->buf;
-            memset(localbuf, 0, 18);
+            unsigned char *auxbuf = localbuf + 18*aux;
+            memset(auxbuf, 0, 18);
             switch (csymd->auxtype) {
                 case COFF_SYMTAB_AUX_NONE:
                     break;
                 case COFF_SYMTAB_AUX_SECT:
-                    YASM_WRITE_32_L(localbuf, scnlen);  /* section length */
-                    YASM_WRITE_16_L(localbuf, nreloc);  /* number relocs */
-                    YASM_WRITE_16_L(localbuf, 0);       /* number line nums */
+                    YASM_WRITE_32_L(auxbuf, scnlen);    /* section length */
+                    YASM_WRITE_16_L(auxbuf, nreloc);    /* number relocs */
+                    YASM_WRITE_16_L(auxbuf, 0);         /* number line nums */
                     break;
                 case COFF_SYMTAB_AUX_FILE:
                     len = strlen(csymd->aux[0].fname);
                     if (len > 14) {
-                        YASM_WRITE_32_L(localbuf, 0);
-                        YASM_WRITE_32_L(localbuf, info->strtab_offset);
-                        info->strtab_offset += (unsigned long)(len+1);
+                        YASM_WRITE_32_L(auxbuf, 0);
+                        YASM_WRITE_32_L(auxbuf,
+                            coff_strtab_add(&info->strtab,
+                                            csymd->aux[0].fname, len));
                     } else
-                        strncpy((char *)localbuf, csymd->aux[0].fname, 14);
+                        strncpy((char *)auxbuf, csymd->aux[0].fname, 14);
                     break;
                 default:
                     yasm_internal_error(
                         N_("coff: unrecognized aux symtab type"));
             }
-            fwrite(info->buf, 18, 1, info->f);
-        }
-        yasm_xfree(name);
-    }
-    return 0;
-}
-
-static int
-coff_objfmt_output_str(yasm_symrec *sym, /*@null@*/ void *d)
-{
-    /*@null@*/ coff_objfmt_output_info *info = (coff_objfmt_output_info *)d;
-    yasm_sym_vis vis = yasm_symrec_get_visibility(sym);
-    /*@dependent@*/ /*@null@*/ coff_symrec_data *csymd;
-    csymd = yasm_symrec_get_data(sym, &coff_symrec_data_cb);
-
-    assert(info != NULL);
-
-    /* Don't output local syms unless outputting all syms */
-    if (info->all_syms || vis != YASM_SYM_LOCAL ||
-        (csymd && csymd->forcevis)) {
-        /*@only@*/ char *name = yasm_symrec_get_global_name(sym, info->object);
-        size_t len = strlen(name);
-        int aux;
-
-        if (!csymd)
-            yasm_internal_error(N_("coff: expected sym data to be present"));
-
-        if (len > 8)
-            fwrite(name, len+1, 1, info->f);
-        for (aux=0; aux<csymd->numaux; aux++) {
-            switch (csymd->auxtype) {
-                case COFF_SYMTAB_AUX_FILE:
-                    len = strlen(csymd->aux[0].fname);
-                    if (len > 14)
-                        fwrite(csymd->aux[0].fname, len+1, 1, info->f);
-                    break;
-                default:
-                    break;
-            }
         }
         yasm_xfree(name);
     }
@@ -1162,7 +1165,6 @@ coff_objfmt_output(yasm_object *object, FILE *f, int all_syms,
      */
     all_syms |= objfmt_coff->win64;
 
-    info.strtab_offset = 4;
     info.object = object;
     info.objfmt_coff = objfmt_coff;
     info.errwarns = errwarns;
@@ -1183,10 +1185,14 @@ coff_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     symtab_count = info.indx;
 
     /* Section data/relocs */
+    coff_strtab_init(&info.strtab);
     info.addr = 0;
     if (yasm_object_sections_traverse(object, &info,
-                                      coff_objfmt_output_section))
+                                      coff_objfmt_output_section)) {
+        coff_strtab_destroy(&info.strtab);
+        yasm_xfree(info.buf);
         return;
+    }
 
     /* Symbol table */
     pos = ftell(f);
@@ -1196,12 +1202,18 @@ coff_objfmt_output(yasm_object *object, FILE *f, int all_syms,
         return;
     }
     symtab_pos = (unsigned long)pos;
+    info.symtab_alloc = 18*symtab_count;
+    info.symtab = yasm_xmalloc(info.symtab_alloc ? info.symtab_alloc : 1);
+    info.symtab_len = 0;
     yasm_symtab_traverse(object->symtab, &info, coff_objfmt_output_sym);
+    fwrite(info.symtab, info.symtab_len, 1, f);
+    yasm_xfree(info.symtab);
 
     /* String table */
-    yasm_fwrite_32_l(info.strtab_offset, f); /* total length */
-    yasm_object_sections_traverse(object, &info, coff_objfmt_output_sectstr);
-    yasm_symtab_traverse(object->symtab, &info, coff_objfmt_output_str);
+    localbuf = (unsigned char *)info.strtab.data;
+    YASM_WRITE_32_L(localbuf, info.strtab.len);     /* total length */
+    fwrite(info.strtab.data, info.strtab.len, 1, f);
+    coff_strtab_destroy(&info.strtab);
 
     /* Write headers */
     if (fseek(f, 0, SEEK_SET) < 0) {
@@ -101,13 +101,13 @@ elf_objfmt_symtab_append(yasm_objfmt_elf *objfmt_elf, yasm_symrec *sym,
         yasm_symrec_add_data(sym, &elf_symrec_data, entry);
     }
 
+    elf_symtab_set_nonzero(entry, NULL, sectidx, bind, type, size, value);
+    elf_sym_set_visibility(entry, vis);
+
     /* Only append to table if not already appended */
     if (!elf_sym_in_table(entry))
         elf_symtab_append_entry(objfmt_elf->elf_symtab, entry);
 
-    elf_symtab_set_nonzero(entry, NULL, sectidx, bind, type, size, value);
-    elf_sym_set_visibility(entry, vis);
-
     return entry;
 }
 
@@ -462,14 +462,13 @@ elf_objfmt_output_reloc(yasm_symrec *sym, yasm_bytecode *bc,
     yasm_intnum *zero;
     int retval;
 
-    reloc = elf_reloc_entry_create(sym, NULL,
-        yasm_intnum_create_uint(bc->offset), 0, valsize, 0);
+    /* allocate .rel[a] sections on a need-basis */
+    reloc = elf_secthead_append_reloc(info->sect, info->shead, sym, NULL,
+                                      bc->offset, 0, valsize, 0);
     if (reloc == NULL) {
         yasm_error_set(YASM_ERROR_TYPE, N_("elf: invalid relocation size"));
         return 1;
     }
-    /* allocate .rel[a] sections on a need-basis */
-    elf_secthead_append_reloc(info->sect, info->shead, reloc);
 
     zero = yasm_intnum_create_uint(0);
     elf_handle_reloc_addend(zero, reloc, 0);
@@ -556,16 +555,16 @@ elf_objfmt_output_value(yasm_value *value, unsigned char *buf,
             intn_val += offset;
 
         /* Check for _GLOBAL_OFFSET_TABLE_ symbol reference */
-        reloc = elf_reloc_entry_create(sym, wrt,
-            yasm_intnum_create_uint(bc->offset + offset), value->curpos_rel,
-            valsize, sym == info->GOT_sym);
+        /* allocate .rel[a] sections on a need-basis */
+        reloc = elf_secthead_append_reloc(info->sect, info->shead, sym, wrt,
+                                          bc->offset + offset,
+                                          value->curpos_rel, valsize,
+                                          sym == info->GOT_sym);
         if (reloc == NULL) {
             yasm_error_set(YASM_ERROR_TYPE,
                            N_("elf: invalid relocation (WRT or size)"));
             return 1;
         }
-        /* allocate .rel[a] sections on a need-basis */
-        elf_secthead_append_reloc(info->sect, info->shead, reloc);
     }
 
     intn = yasm_intnum_create_uint(intn_val);
@@ -589,66 +588,19 @@ elf_objfmt_output_value(yasm_value *value, unsigned char *buf,
     return retval;
 }
 
-static int
-elf_objfmt_output_bytecode(yasm_bytecode *bc, /*@null@*/ void *d)
-{
-    /*@null@*/ elf_objfmt_output_info *info = (elf_objfmt_output_info *)d;
-    unsigned char buf[256];
-    /*@null@*/ /*@only@*/ unsigned char *bigbuf;
-    unsigned long size = 256;
-    int gap;
-
-    if (info == NULL)
-        yasm_internal_error("null info struct");
-
-    bigbuf = yasm_bc_tobytes(bc, buf, &size, &gap, info,
-                             elf_objfmt_output_value, elf_objfmt_output_reloc);
-
-    /* Don't bother doing anything else if size ended up being 0. */
-    if (size == 0) {
-        if (bigbuf)
-            yasm_xfree(bigbuf);
-        return 0;
-    }
-    else {
-        yasm_intnum *bcsize = yasm_intnum_create_uint(size);
-        elf_secthead_add_size(info->shead, bcsize);
-        yasm_intnum_destroy(bcsize);
-    }
-
-    /* Warn that gaps are converted to 0 and write out the 0's. */
-    if (gap) {
-        unsigned long left;
-        yasm_warn_set(YASM_WARN_UNINIT_CONTENTS,
-            N_("uninitialized space declared in code/data section: zeroing"));
-        /* Write out in chunks */
-        memset(buf, 0, 256);
-        left = size;
-        while (left > 256) {
-            fwrite(buf, 256, 1, info->f);
-            left -= 256;
-        }
-        fwrite(buf, left, 1, info->f);
-    } else {
-        /* Output buf (or bigbuf if non-NULL) to file */
-        fwrite(bigbuf ? bigbuf : buf, (size_t)size, 1, info->f);
-    }
-
-    /* If bigbuf was allocated, free it */
-    if (bigbuf)
-        yasm_xfree(bigbuf);
-
-    return 0;
-}
-
 static int
 elf_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
 {
     /*@null@*/ elf_objfmt_output_info *info = (elf_objfmt_output_info *)d;
     /*@dependent@*/ /*@null@*/ elf_secthead *shead;
+    yasm_section_contents contents;
+    /*@null@*/ /*@only@*/ unsigned char *cbuf = NULL;
+    unsigned long size;
     long pos;
     char *relname;
     const char *sectname;
+    unsigned long data_align = 0;
+    int compress = 0, compressed = 0;
 
     if (info == NULL)
         yasm_internal_error("null info struct");
@@ -659,6 +611,18 @@ elf_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
     if (elf_secthead_get_align(shead) == 0)
         elf_secthead_set_align(shead, yasm_section_get_align(sect));
 
+    /* Debugging sections may be compressed; the compressed section starts
+     * with a compression header, so align the file offset for that.
+     */
+    sectname = yasm_section_get_name(sect);
+    if (info->object->debug_compress != YASM_DEBUG_COMPRESS_NONE &&
+        strncmp(sectname, ".debug_", 7) == 0) {
+        compress = 1;
+        data_align = elf_secthead_get_align(shead);
+        if (data_align < elf_secthead_compress_align())
+            elf_secthead_set_align(shead, elf_secthead_compress_align());
+    }
+
     /* don't output header-only sections */
     if ((elf_secthead_get_type(shead) & SHT_NOBITS) == SHT_NOBITS)
     {
@@ -686,8 +650,29 @@ elf_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
 
     info->sect = sect;
     info->shead = shead;
-    yasm_section_bcs_traverse(sect, info->errwarns, info,
-                              elf_objfmt_output_bytecode);
+    yasm_section_tobytes(sect, info->errwarns,
+        N_("uninitialized space declared in code/data section: zeroing"),
+        info, elf_objfmt_output_value, elf_objfmt_output_reloc, &contents);
+    size = contents.size;
+    if (size > 0) {
+        yasm_intnum *sectsize;
+        if (compress)
+            cbuf = elf_secthead_compress(shead,
+                info->object->debug_compress, data_align ? data_align : 1,
+                &contents, &size);
+        sectsize = yasm_intnum_create_uint(size);
+        elf_secthead_add_size(shead, sectsize);
+        yasm_intnum_destroy(sectsize);
+        if (cbuf) {
+            fwrite(cbuf, (size_t)size, 1, info->f);
+            yasm_xfree(cbuf);
+            compressed = 1;
+        } else
+            yasm_section_contents_write(&contents, info->f);
+    }
+    yasm_section_contents_delete(&contents);
+    if (compress && !compressed)
+        elf_secthead_set_align(shead, data_align);
 
     elf_secthead_set_index(shead, ++info->sindex);
 
@@ -698,7 +683,6 @@ elf_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
     elf_secthead_set_rel_index(shead, ++info->sindex);
 
     /* name the relocation section .rel[a].foo */
-    sectname = yasm_section_get_name(sect);
     relname = elf_secthead_name_reloc_section(sectname);
     elf_secthead_set_rel_name(shead,
         elf_strtab_append_str(info->objfmt_elf->shstrtab, relname));
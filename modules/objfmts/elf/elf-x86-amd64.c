@@ -194,7 +194,7 @@ static void
 elf_x86_amd64_write_reloc(unsigned char *bufp, elf_reloc_entry *reloc,
                           unsigned int r_type, unsigned int r_sym)
 {
-    YASM_WRITE_64I_L(bufp, reloc->reloc.addr);
+    YASM_WRITE_64Z_L(bufp, reloc->reloc.addr);
     /*YASM_WRITE_64_L(bufp, ELF64_R_INFO(r_sym, r_type));*/
     YASM_WRITE_64C_L(bufp, r_sym, r_type);
     if (reloc->addend)
@@ -28,6 +28,13 @@
 #include <util.h>
 
 #include <libyasm.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 #define YASM_OBJFMT_ELF_INTERNAL
 #include "elf.h"
 #include "elf-machine.h"
@@ -149,31 +156,25 @@ elf_ssym_has_flag(yasm_symrec *wrt, int flag)
     return 0;
 }
 
-/* takes ownership of addr */
-elf_reloc_entry *
-elf_reloc_entry_create(yasm_symrec *sym,
-                       yasm_symrec *wrt,
-                       yasm_intnum *addr,
-                       int rel,
-                       size_t valsize,
-                       int is_GOT_sym)
+/* returns nonzero if the machine does not accept the relocation */
+static int
+elf_reloc_entry_init(elf_reloc_entry *entry,
+                     yasm_symrec *sym,
+                     yasm_symrec *wrt,
+                     unsigned long addr,
+                     int rel,
+                     size_t valsize,
+                     int is_GOT_sym)
 {
-    elf_reloc_entry *entry;
-
     if (!elf_march->accepts_reloc)
         yasm_internal_error(N_("Unsupported machine for ELF output"));
 
     if (!elf_march->accepts_reloc(valsize, wrt))
-    {
-        if (addr)
-            yasm_intnum_destroy(addr);
-        return NULL;
-    }
+        return 1;
 
     if (sym == NULL)
         yasm_internal_error("sym is null");
 
-    entry = yasm_xmalloc(sizeof(elf_reloc_entry));
     entry->reloc.sym = sym;
     entry->reloc.addr = addr;
     entry->rtype_rel = rel;
@@ -182,7 +183,7 @@ elf_reloc_entry_create(yasm_symrec *sym,
     entry->wrt = wrt;
     entry->is_GOT_sym = is_GOT_sym;
 
-    return entry;
+    return 0;
 }
 
 void
@@ -190,7 +191,6 @@ elf_reloc_entry_destroy(void *entry)
 {
     if (((elf_reloc_entry*)entry)->addend)
         yasm_intnum_destroy(((elf_reloc_entry*)entry)->addend);
-    yasm_xfree(entry);
 }
 
 /* strtab functions */
@@ -198,7 +198,7 @@ elf_strtab_entry *
 elf_strtab_entry_create(const char *str)
 {
     elf_strtab_entry *entry = yasm_xmalloc(sizeof(elf_strtab_entry));
-    entry->str = yasm__xstrdup(str);
+    entry->str = yasm_intern(str);
     entry->index = 0;
     return entry;
 }
@@ -207,15 +207,14 @@ void
 elf_strtab_entry_set_str(elf_strtab_entry *entry, const char *str)
 {
     elf_strtab_entry *last;
-    if (entry->str)
-        yasm_xfree(entry->str);
-    entry->str = yasm__xstrdup(str);
+    entry->str = yasm_intern(str);
 
     /* Update all following indices since string length probably changes */
     last = entry;
     entry = STAILQ_NEXT(last, qlink);
     while (entry) {
-        entry->index = last->index + (unsigned long)strlen(last->str) + 1;
+        entry->index = last->index +
+            (unsigned long)yasm_intern_length(last->str) + 1;
         last = entry;
         entry = STAILQ_NEXT(last, qlink);
     }
@@ -229,7 +228,7 @@ elf_strtab_create()
 
     STAILQ_INIT(strtab);
     entry->index = 0;
-    entry->str = yasm__xstrdup("");
+    entry->str = yasm_intern("");
 
     STAILQ_INSERT_TAIL(strtab, entry, qlink);
     return strtab;
@@ -248,7 +247,8 @@ elf_strtab_append_str(elf_strtab_head *strtab, const char *str)
     last = STAILQ_LAST(strtab, elf_strtab_entry, qlink);
 
     entry = elf_strtab_entry_create(str);
-    entry->index = last->index + (unsigned long)strlen(last->str) + 1;
+    entry->index = last->index +
+        (unsigned long)yasm_intern_length(last->str) + 1;
 
     STAILQ_INSERT_TAIL(strtab, entry, qlink);
     return entry;
@@ -267,7 +267,6 @@ elf_strtab_destroy(elf_strtab_head *strtab)
     s1 = STAILQ_FIRST(strtab);
     while (s1 != NULL) {
         s2 = STAILQ_NEXT(s1, qlink);
-        yasm_xfree(s1->str);
         yasm_xfree(s1);
         s1 = s2;
     }
@@ -285,7 +284,7 @@ elf_strtab_output_to_file(FILE *f, elf_strtab_head *strtab)
 
     /* consider optimizing tables here */
     STAILQ_FOREACH(entry, strtab, qlink) {
-        size_t len = 1 + strlen(entry->str);
+        size_t len = 1 + yasm_intern_length(entry->str);
         fwrite(entry->str, len, 1, f);
         size += (unsigned long)len;
     }
@@ -372,13 +371,44 @@ elf_ssym_symtab_entry_print(void *data, FILE *f, int indent_level)
     /* TODO */
 }
 
+static void
+elf_symtab_bucket_init(elf_symtab_bucket *bucket)
+{
+    bucket->num = 0;
+    bucket->alloc = 16;
+    bucket->entries =
+        yasm_xmalloc(bucket->alloc*sizeof(elf_symtab_entry *));
+}
+
+static void
+elf_symtab_bucket_add(elf_symtab_bucket *bucket, elf_symtab_entry *entry)
+{
+    if (bucket->num >= bucket->alloc) {
+        bucket->alloc *= 2;
+        bucket->entries = yasm_xrealloc(bucket->entries,
+            bucket->alloc*sizeof(elf_symtab_entry *));
+    }
+    bucket->entries[bucket->num++] = entry;
+    entry->in_table = 1;
+}
+
+static void
+elf_symtab_bucket_destroy(elf_symtab_bucket *bucket)
+{
+    unsigned long i;
+    for (i=0; i<bucket->num; i++)
+        elf_symtab_entry_destroy(bucket->entries[i]);
+    yasm_xfree(bucket->entries);
+}
+
 elf_symtab_head *
 elf_symtab_create()
 {
     elf_symtab_head *symtab = yasm_xmalloc(sizeof(elf_symtab_head));
     elf_symtab_entry *entry = yasm_xmalloc(sizeof(elf_symtab_entry));
 
-    STAILQ_INIT(symtab);
+    elf_symtab_bucket_init(&symtab->locals);
+    elf_symtab_bucket_init(&symtab->globals);
     entry->in_table = 1;
     entry->sym = NULL;
     entry->sect = NULL;
@@ -391,10 +421,12 @@ elf_symtab_create()
     entry->type = STT_NOTYPE;
     entry->vis = STV_DEFAULT;
     entry->symindex = 0;
-    STAILQ_INSERT_TAIL(symtab, entry, qlink);
+    elf_symtab_bucket_add(&symtab->locals, entry);
+    symtab->nhead = 1;
     return symtab;
 }
 
+/* The entry's binding must be set before it is appended. */
 void
 elf_symtab_append_entry(elf_symtab_head *symtab, elf_symtab_entry *entry)
 {
@@ -402,142 +434,158 @@ elf_symtab_append_entry(elf_symtab_head *symtab, elf_symtab_entry *entry)
         yasm_internal_error("symtab is null");
     if (entry == NULL)
         yasm_internal_error("symtab entry is null");
-    if (STAILQ_EMPTY(symtab))
+    if (symtab->locals.num == 0)
         yasm_internal_error(N_("symtab is missing initial dummy entry"));
 
-    STAILQ_INSERT_TAIL(symtab, entry, qlink);
-    entry->in_table = 1;
+    if (entry->bind != STB_LOCAL)
+        elf_symtab_bucket_add(&symtab->globals, entry);
+    else {
+        if (symtab->nhead == symtab->locals.num)
+            symtab->nhead++;
+        elf_symtab_bucket_add(&symtab->locals, entry);
+    }
 }
 
 void
 elf_symtab_insert_local_sym(elf_symtab_head *symtab, elf_symtab_entry *entry)
 {
-    elf_symtab_entry *after = STAILQ_FIRST(symtab);
-    elf_symtab_entry *before = NULL;
-
-    while (after && (after->bind == STB_LOCAL)) {
-        before = after;
-        if (before->type == STT_FILE) break;
-        after = STAILQ_NEXT(after, qlink);
-    }
-    STAILQ_INSERT_AFTER(symtab, before, entry, qlink);
-    entry->in_table = 1;
+    elf_symtab_bucket_add(&symtab->locals, entry);
 }
 
 void
 elf_symtab_destroy(elf_symtab_head *symtab)
 {
-    elf_symtab_entry *s1, *s2;
-
     if (symtab == NULL)
         yasm_internal_error("symtab is null");
-    if (STAILQ_EMPTY(symtab))
+    if (symtab->locals.num == 0)
         yasm_internal_error(N_("symtab is missing initial dummy entry"));
 
-    s1 = STAILQ_FIRST(symtab);
-    while (s1 != NULL) {
-        s2 = STAILQ_NEXT(s1, qlink);
-        elf_symtab_entry_destroy(s1);
-        s1 = s2;
-    }
+    elf_symtab_bucket_destroy(&symtab->locals);
+    elf_symtab_bucket_destroy(&symtab->globals);
     yasm_xfree(symtab);
 }
 
+/* Put the locals in their final order and number all the entries.
+ * Returns the number of locals (the index of the first global).
+ */
 unsigned long
 elf_symtab_assign_indices(elf_symtab_head *symtab)
 {
-    elf_symtab_entry *entry, *prev=NULL;
-    unsigned long last_local=0;
+    elf_symtab_entry **locals;
+    unsigned long i, j;
 
     if (symtab == NULL)
         yasm_internal_error("symtab is null");
-    if (STAILQ_EMPTY(symtab))
+    if (symtab->locals.num == 0)
         yasm_internal_error(N_("symtab is missing initial dummy entry"));
 
-    STAILQ_FOREACH(entry, symtab, qlink) {
-        if (prev)
-            entry->symindex = prev->symindex + 1;
-        if (entry->bind == STB_LOCAL)
-            last_local = entry->symindex;
-        prev = entry;
+    locals = symtab->locals.entries;
+    for (i=symtab->nhead, j=symtab->locals.num; i+1 < j; i++, j--) {
+        elf_symtab_entry *temp = locals[i];
+        locals[i] = locals[j-1];
+        locals[j-1] = temp;
     }
-    return last_local + 1;
+    symtab->nhead = symtab->locals.num;
+
+    for (i=0; i<symtab->locals.num; i++)
+        locals[i]->symindex = i;
+    for (j=0; j<symtab->globals.num; j++)
+        symtab->globals.entries[j]->symindex = i+j;
+    return symtab->locals.num;
 }
 
-unsigned long
-elf_symtab_write_to_file(FILE *f, elf_symtab_head *symtab,
-                         yasm_errwarns *errwarns)
+static void
+elf_symtab_write_entry(elf_symtab_entry *entry, unsigned char *bufp,
+                       yasm_errwarns *errwarns)
 {
-    unsigned char buf[SYMTAB_MAXSIZE], *bufp;
-    elf_symtab_entry *entry;
-    unsigned long size = 0;
-
-    if (!symtab)
-        yasm_internal_error(N_("symtab is null"));
+    yasm_intnum *size_intn=NULL, *value_intn=NULL;
+
+    /* get size (if specified); expr overrides stored integer */
+    if (entry->xsize) {
+        size_intn = yasm_intnum_copy(
+            yasm_expr_get_intnum(&entry->xsize, 1));
+        if (!size_intn) {
+            yasm_error_set(YASM_ERROR_VALUE,
+                           N_("size specifier not an integer expression"));
+            yasm_errwarn_propagate(errwarns, entry->xsize->line);
+        }
+    }
+    else
+        size_intn = yasm_intnum_create_uint(entry->size);
 
-    STAILQ_FOREACH(entry, symtab, qlink) {
+    /* get EQU value for constants */
+    if (entry->sym) {
+        const yasm_expr *equ_expr_c;
+        equ_expr_c = yasm_symrec_get_equ(entry->sym);
 
-        yasm_intnum *size_intn=NULL, *value_intn=NULL;
-        bufp = buf;
+        if (equ_expr_c != NULL) {
+            const yasm_intnum *equ_intn;
+            yasm_expr *equ_expr = yasm_expr_copy(equ_expr_c);
+            equ_intn = yasm_expr_get_intnum(&equ_expr, 1);
 
-        /* get size (if specified); expr overrides stored integer */
-        if (entry->xsize) {
-            size_intn = yasm_intnum_copy(
-                yasm_expr_get_intnum(&entry->xsize, 1));
-            if (!size_intn) {
+            if (equ_intn == NULL) {
                 yasm_error_set(YASM_ERROR_VALUE,
-                               N_("size specifier not an integer expression"));
-                yasm_errwarn_propagate(errwarns, entry->xsize->line);
-            }
+                               N_("EQU value not an integer expression"));
+                yasm_errwarn_propagate(errwarns, equ_expr->line);
+            } else
+                value_intn = yasm_intnum_copy(equ_intn);
+            entry->index = SHN_ABS;
+            yasm_expr_destroy(equ_expr);
         }
-        else
-            size_intn = yasm_intnum_create_uint(entry->size);
-
-        /* get EQU value for constants */
-        if (entry->sym) {
-            const yasm_expr *equ_expr_c;
-            equ_expr_c = yasm_symrec_get_equ(entry->sym);
-
-            if (equ_expr_c != NULL) {
-                const yasm_intnum *equ_intn;
-                yasm_expr *equ_expr = yasm_expr_copy(equ_expr_c);
-                equ_intn = yasm_expr_get_intnum(&equ_expr, 1);
-
-                if (equ_intn == NULL) {
-                    yasm_error_set(YASM_ERROR_VALUE,
-                                   N_("EQU value not an integer expression"));
-                    yasm_errwarn_propagate(errwarns, equ_expr->line);
-                } else
-                    value_intn = yasm_intnum_copy(equ_intn);
-                entry->index = SHN_ABS;
-                yasm_expr_destroy(equ_expr);
-            }
-        }
-        if (value_intn == NULL)
-            value_intn = yasm_intnum_create_uint(entry->value);
-
-        /* If symbol is in a TLS section, force its type to TLS. */
-        if (entry->sym) {
-            yasm_bytecode *precbc;
-            yasm_section *sect;
-            elf_secthead *shead;
-            if (yasm_symrec_get_label(entry->sym, &precbc) &&
-                (sect = yasm_bc_get_section(precbc)) &&
-                (shead = yasm_section_get_data(sect, &elf_section_data)) &&
-                shead->flags & SHF_TLS) {
-                entry->type = STT_TLS;
-            }
+    }
+    if (value_intn == NULL)
+        value_intn = yasm_intnum_create_uint(entry->value);
+
+    /* If symbol is in a TLS section, force its type to TLS. */
+    if (entry->sym) {
+        yasm_bytecode *precbc;
+        yasm_section *sect;
+        elf_secthead *shead;
+        if (yasm_symrec_get_label(entry->sym, &precbc) &&
+            (sect = yasm_bc_get_section(precbc)) &&
+            (shead = yasm_section_get_data(sect, &elf_section_data)) &&
+            shead->flags & SHF_TLS) {
+            entry->type = STT_TLS;
         }
+    }
+
+    elf_march->write_symtab_entry(bufp, entry, value_intn, size_intn);
 
-        if (!elf_march->write_symtab_entry || !elf_march->symtab_entry_size)
-            yasm_internal_error(N_("Unsupported machine for ELF output"));
-        elf_march->write_symtab_entry(bufp, entry, value_intn, size_intn);
-        fwrite(buf, elf_march->symtab_entry_size, 1, f);
-        size += elf_march->symtab_entry_size;
+    yasm_intnum_destroy(size_intn);
+    yasm_intnum_destroy(value_intn);
+}
 
-        yasm_intnum_destroy(size_intn);
-        yasm_intnum_destroy(value_intn);
+/* Serializes the whole table into one buffer and writes it at once.
+ * elf_symtab_assign_indices() must be called first.
+ */
+unsigned long
+elf_symtab_write_to_file(FILE *f, elf_symtab_head *symtab,
+                         yasm_errwarns *errwarns)
+{
+    unsigned char *buf, *bufp;
+    unsigned long i, size;
+
+    if (!symtab)
+        yasm_internal_error(N_("symtab is null"));
+    if (!elf_march->write_symtab_entry || !elf_march->symtab_entry_size)
+        yasm_internal_error(N_("Unsupported machine for ELF output"));
+
+    size = (symtab->locals.num + symtab->globals.num) *
+        elf_march->symtab_entry_size;
+    buf = yasm_xmalloc(size);
+
+    bufp = buf;
+    for (i=0; i<symtab->locals.num; i++) {
+        elf_symtab_write_entry(symtab->locals.entries[i], bufp, errwarns);
+        bufp += elf_march->symtab_entry_size;
+    }
+    for (i=0; i<symtab->globals.num; i++) {
+        elf_symtab_write_entry(symtab->globals.entries[i], bufp, errwarns);
+        bufp += elf_march->symtab_entry_size;
     }
+
+    fwrite(buf, size, 1, f);
+    yasm_xfree(buf);
     return size;
 }
 
@@ -687,19 +735,29 @@ elf_secthead_write_to_file(FILE *f, elf_secthead *shead,
     return 0;
 }
 
-void
+/* returns NULL if the machine does not accept the relocation */
+elf_reloc_entry *
 elf_secthead_append_reloc(yasm_section *sect, elf_secthead *shead,
-                          elf_reloc_entry *reloc)
+                          yasm_symrec *sym, yasm_symrec *wrt,
+                          unsigned long addr, int rel, size_t valsize,
+                          int is_GOT_sym)
 {
+    elf_reloc_entry reloc;
+
     if (sect == NULL)
         yasm_internal_error("sect is null");
     if (shead == NULL)
         yasm_internal_error("shead is null");
-    if (reloc == NULL)
-        yasm_internal_error("reloc is null");
+
+    if (elf_reloc_entry_init(&reloc, sym, wrt, addr, rel, valsize,
+                             is_GOT_sym))
+        return NULL;
 
     shead->nreloc++;
-    yasm_section_add_reloc(sect, (yasm_reloc *)reloc, elf_reloc_entry_destroy);
+    return (elf_reloc_entry *)
+        yasm_section_add_reloc(sect, (yasm_reloc *)&reloc,
+                               sizeof(elf_reloc_entry),
+                               elf_reloc_entry_destroy);
 }
 
 char *
@@ -754,20 +812,32 @@ elf_secthead_write_rel_to_file(FILE *f, elf_section_index symtab_idx,
     return 0;
 }
 
+static void
+elf_reloc_write(yasm_reloc *reloc, unsigned char *buf, /*@unused@*/ void *d)
+{
+    unsigned int r_type, r_sym;
+    elf_symtab_entry *esym;
+
+    esym = yasm_symrec_get_data(reloc->sym, &elf_symrec_data);
+    if (esym)
+        r_sym = esym->symindex;
+    else
+        r_sym = STN_UNDEF;
+
+    r_type = elf_march->map_reloc_info_to_type((elf_reloc_entry *)reloc);
+    elf_march->write_reloc(buf, (elf_reloc_entry *)reloc, r_type, r_sym);
+}
+
 unsigned long
 elf_secthead_write_relocs_to_file(FILE *f, yasm_section *sect,
                                   elf_secthead *shead, yasm_errwarns *errwarns)
 {
-    elf_reloc_entry *reloc;
-    unsigned char buf[RELOC_MAXSIZE], *bufp;
-    unsigned long size = 0;
     long pos;
 
     if (shead == NULL)
         yasm_internal_error("shead is null");
 
-    reloc = (elf_reloc_entry *)yasm_section_relocs_first(sect);
-    if (!reloc)
+    if (!yasm_section_relocs_first(sect))
         return 0;
 
     /* first align section to multiple of 4 */
@@ -784,32 +854,15 @@ elf_secthead_write_relocs_to_file(FILE *f, yasm_section *sect,
     }
     shead->rel_offset = (unsigned long)pos;
 
+    if (!elf_march->map_reloc_info_to_type)
+        yasm_internal_error(N_("Unsupported arch/machine for elf output"));
+    if (!elf_march->write_reloc || !elf_march->reloc_entry_size)
+        yasm_internal_error(N_("Unsupported arch/machine for elf output"));
 
-    while (reloc) {
-        unsigned int r_type=0, r_sym;
-        elf_symtab_entry *esym;
-
-        esym = yasm_symrec_get_data(reloc->reloc.sym, &elf_symrec_data);
-        if (esym)
-            r_sym = esym->symindex;
-        else
-            r_sym = STN_UNDEF;
-
-        if (!elf_march->map_reloc_info_to_type)
-            yasm_internal_error(N_("Unsupported arch/machine for elf output"));
-        r_type = elf_march->map_reloc_info_to_type(reloc);
-
-        bufp = buf;
-        if (!elf_march->write_reloc || !elf_march->reloc_entry_size)
-            yasm_internal_error(N_("Unsupported arch/machine for elf output"));
-        elf_march->write_reloc(bufp, reloc, r_type, r_sym);
-        fwrite(buf, elf_march->reloc_entry_size, 1, f);
-        size += elf_march->reloc_entry_size;
-
-        reloc = (elf_reloc_entry *)
-            yasm_section_reloc_next((yasm_reloc *)reloc);
-    }
-    return size;
+    /* Emit relocations in ascending address order, as GNU as does */
+    yasm_section_relocs_sort(sect);
+    return yasm_section_relocs_write(sect, f, elf_march->reloc_entry_size,
+                                     elf_reloc_write, NULL);
 }
 
 elf_section_type
@@ -906,6 +959,114 @@ elf_secthead_add_size(elf_secthead *shead, yasm_intnum *size)
     }
 }
 
+/* Alignment of the compression header (and thus of compressed sections). */
+unsigned long
+elf_secthead_compress_align(void)
+{
+    return (elf_march->bits == 64) ? CHDR64_ALIGN : CHDR32_ALIGN;
+}
+
+/* Compress section contents for output as a SHF_COMPRESSED section.
+ * On success, returns a buffer holding the compression header followed by
+ * the compressed data, sets *size to its length and flags the section
+ * SHF_COMPRESSED.  addralign is the alignment of the uncompressed data.
+ * Returns NULL, leaving *size alone, for allocated sections, methods not
+ * available in this build, or if compression doesn't shrink the section.
+ */
+unsigned char *
+elf_secthead_compress(elf_secthead *shead, yasm_debug_compress method,
+                      unsigned long addralign,
+                      const yasm_section_contents *contents,
+                      unsigned long *size)
+{
+    unsigned long hdrsize = (elf_march->bits == 64) ? CHDR64_SIZE
+                                                    : CHDR32_SIZE;
+    unsigned long csize;
+    unsigned char *buf = NULL, *bufp, *data;
+    elf_compress_type chtype;
+
+    if (shead->flags & SHF_ALLOC)
+        return NULL;
+
+    /* The compressors need contiguous input, so fill in any gaps */
+    if (contents->num_gaps > 0) {
+        data = yasm_xmalloc(*size);
+        yasm_section_contents_copy(contents, data);
+    } else
+        data = contents->data;
+
+    switch (method) {
+#ifdef HAVE_ZLIB
+        case YASM_DEBUG_COMPRESS_ZLIB:
+        {
+            unsigned long bound;
+            uLongf destlen;
+
+            bound = (unsigned long)compressBound((uLong)*size);
+            buf = yasm_xmalloc(hdrsize + bound);
+            destlen = (uLongf)bound;
+            if (compress2(buf + hdrsize, &destlen, data, (uLong)*size,
+                          Z_DEFAULT_COMPRESSION) != Z_OK) {
+                yasm_xfree(buf);
+                buf = NULL;
+                break;
+            }
+            csize = (unsigned long)destlen;
+            chtype = ELFCOMPRESS_ZLIB;
+            break;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case YASM_DEBUG_COMPRESS_ZSTD:
+        {
+            unsigned long bound;
+            size_t ret;
+
+            bound = (unsigned long)ZSTD_compressBound((size_t)*size);
+            buf = yasm_xmalloc(hdrsize + bound);
+            /* level 0 selects the library default */
+            ret = ZSTD_compress(buf + hdrsize, (size_t)bound, data,
+                                (size_t)*size, 0);
+            if (ZSTD_isError(ret)) {
+                yasm_xfree(buf);
+                buf = NULL;
+                break;
+            }
+            csize = (unsigned long)ret;
+            chtype = ELFCOMPRESS_ZSTD;
+            break;
+        }
+#endif
+        default:
+            break;
+    }
+
+    if (data != contents->data)
+        yasm_xfree(data);
+    if (!buf)
+        return NULL;
+    if (hdrsize + csize >= *size) {
+        yasm_xfree(buf);
+        return NULL;
+    }
+
+    bufp = buf;
+    if (elf_march->bits == 64) {
+        YASM_WRITE_32_L(bufp, chtype);          /* ch_type */
+        YASM_WRITE_32_L(bufp, 0);               /* ch_reserved */
+        YASM_WRITE_64Z_L(bufp, *size);          /* ch_size */
+        YASM_WRITE_64Z_L(bufp, addralign);      /* ch_addralign */
+    } else {
+        YASM_WRITE_32_L(bufp, chtype);          /* ch_type */
+        YASM_WRITE_32_L(bufp, *size);           /* ch_size */
+        YASM_WRITE_32_L(bufp, addralign);       /* ch_addralign */
+    }
+
+    *size = hdrsize + csize;
+    shead->flags |= SHF_COMPRESSED;
+    return buf;
+}
+
 long
 elf_secthead_set_file_offset(elf_secthead *shead, long pos)
 {
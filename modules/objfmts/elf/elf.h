@@ -155,10 +155,17 @@ typedef enum {
     SHF_STRINGS = 0x20,         /* contains 0-terminated strings */
     SHF_GROUP = 0x200,          /* member of a section group */
     SHF_TLS = 0x400,            /* thread local storage */
+    SHF_COMPRESSED = 0x800,     /* contents compressed, with Chdr header */
     SHF_MASKOS = 0x0f000000/*,*//* environment specific use */
     /*SHF_MASKPROC = 0xf0000000*/       /* bits reserved for processor specific needs */
 } elf_section_flags;
 
+/* elf compression type (ch_type of Chdr) */
+typedef enum {
+    ELFCOMPRESS_ZLIB = 1,       /* zlib (deflate) */
+    ELFCOMPRESS_ZSTD = 2        /* Zstandard */
+} elf_compress_type;
+
 /* elf section index - just the special ones */
 typedef enum {
     SHN_UNDEF = 0,              /* undefined symbol; requires other global */
@@ -236,6 +243,12 @@ typedef enum {
 #define SHDR64_SIZE 64
 #define SHDR_MAXSIZE 64
 
+#define CHDR32_SIZE 12
+#define CHDR64_SIZE 24
+
+#define CHDR32_ALIGN 4
+#define CHDR64_ALIGN 8
+
 #define SYMTAB32_SIZE 16
 #define SYMTAB64_SIZE 24
 #define SYMTAB_MAXSIZE 24
@@ -398,12 +411,29 @@ STAILQ_HEAD(elf_strtab_head, elf_strtab_entry);
 struct elf_strtab_entry {
     STAILQ_ENTRY(elf_strtab_entry) qlink;
     unsigned long        index;
-    char                *str;
+    /*@dependent@*/ const char *str;   /* interned */
+};
+
+/* A growable array of symbol table entries. */
+typedef struct elf_symtab_bucket {
+    /*@owned@*/ elf_symtab_entry **entries;
+    unsigned long       num;
+    unsigned long       alloc;
+} elf_symtab_bucket;
+
+/* ELF requires all local symbols to come before the others, so they are
+ * kept in separate buckets.  The first nhead locals (the null symbol and
+ * the STT_FILE symbol) come from elf_symtab_append_entry(); the locals
+ * added after them with elf_symtab_insert_local_sym() follow in reverse
+ * order of insertion.
+ */
+struct elf_symtab_head {
+    elf_symtab_bucket   locals;
+    elf_symtab_bucket   globals;        /* global and weak symbols */
+    unsigned long       nhead;
 };
 
-STAILQ_HEAD(elf_symtab_head, elf_symtab_entry);
 struct elf_symtab_entry {
-    STAILQ_ENTRY(elf_symtab_entry) qlink;
     int                 in_table;
     yasm_symrec         *sym;
     yasm_section        *sect;
@@ -434,12 +464,6 @@ yasm_symrec *elf_get_special_sym(const char *name, const char *parser);
 /* reloc functions */
 int elf_is_wrt_sym_relative(yasm_symrec *wrt);
 int elf_is_wrt_pos_adjusted(yasm_symrec *wrt);
-elf_reloc_entry *elf_reloc_entry_create(yasm_symrec *sym,
-                                        /*@null@*/ yasm_symrec *wrt,
-                                        yasm_intnum *addr,
-                                        int rel,
-                                        size_t valsize,
-                                        int is_GOT_sym);
 void elf_reloc_entry_destroy(void *entry);
 
 /* strtab functions */
@@ -483,8 +507,10 @@ elf_secthead *elf_secthead_create(elf_strtab_entry      *name,
 void elf_secthead_destroy(elf_secthead *esd);
 unsigned long elf_secthead_write_to_file(FILE *f, elf_secthead *esd,
                                          elf_section_index sindex);
-void elf_secthead_append_reloc(yasm_section *sect, elf_secthead *shead,
-                               elf_reloc_entry *reloc);
+/*@null@*/ elf_reloc_entry *elf_secthead_append_reloc
+    (yasm_section *sect, elf_secthead *shead, yasm_symrec *sym,
+     /*@null@*/ yasm_symrec *wrt, unsigned long addr, int rel, size_t valsize,
+     int is_GOT_sym);
 elf_section_type elf_secthead_get_type(elf_secthead *shead);
 void elf_secthead_set_typeflags(elf_secthead *shead, elf_section_type type,
                                 elf_section_flags flags);
@@ -507,6 +533,10 @@ elf_size elf_secthead_set_entsize(elf_secthead *shead, elf_size size);
 struct yasm_symrec *elf_secthead_set_sym(elf_secthead *shead,
                                          struct yasm_symrec *sym);
 void elf_secthead_add_size(elf_secthead *shead, yasm_intnum *size);
+unsigned long elf_secthead_compress_align(void);
+/*@null@*/ /*@only@*/ unsigned char *elf_secthead_compress
+    (elf_secthead *shead, yasm_debug_compress method, unsigned long addralign,
+     const yasm_section_contents *contents, unsigned long *size);
 char *elf_secthead_name_reloc_section(const char *basesect);
 void elf_handle_reloc_addend(yasm_intnum *intn,
                              elf_reloc_entry *reloc,
@@ -93,6 +93,7 @@
 #include <util.h>
 
 #include <libyasm.h>
+#include <libyasm/phash.h>
 
 /* MACH-O DEFINES */
 /* Mach-O in-file header structure sizes (32 BIT, see below for 64 bit defs) */
@@ -100,6 +101,7 @@
 #define MACHO_SEGCMD_SIZE       56
 #define MACHO_SECTCMD_SIZE      68
 #define MACHO_SYMCMD_SIZE       24
+#define MACHO_DYSYMCMD_SIZE     80
 #define MACHO_NLIST_SIZE        12
 #define MACHO_RELINFO_SIZE      8
 
@@ -144,6 +146,7 @@
 
 #define LC_SEGMENT              0x1     /* segment load command */
 #define LC_SYMTAB               0x2     /* symbol table load command */
+#define LC_DYSYMTAB             0xb     /* dynamic symbol table command */
 #define LC_SEGMENT_64           0x19    /* segment load command */
 
 
@@ -230,8 +233,6 @@
 
 #define NO_SECT 0               /* no section for symbol in nlist */
 
-#define REGULAR_OUTBUF_SIZE     1024
-
 
 typedef struct macho_reloc {
     yasm_reloc reloc;
@@ -275,10 +276,38 @@ typedef struct macho_section_data {
 
 typedef struct macho_symrec_data {
     unsigned long index;        /* index in output order */
-    yasm_intnum *value;         /* valid after writing symtable to file */
-    unsigned long length;       /* length + 1 (plus auto underscore) */
+    unsigned long value;        /* valid after building symtable */
 } macho_symrec_data;
 
+/* Symbol groups, in output order */
+enum macho_symgroup {
+    MACHO_SYMGROUP_LOCAL = 0,
+    MACHO_SYMGROUP_EXTDEF,
+    MACHO_SYMGROUP_UNDEF
+};
+
+typedef struct macho_nlist {
+    /*@dependent@*/ macho_symrec_data *symd;
+    /*@dependent@*/ const char *name;   /* points into string table */
+    unsigned long strx;         /* offset in string table */
+    unsigned long order;        /* symbol table traversal order */
+    unsigned long value;
+    unsigned int n_type, n_sect, n_desc;
+    enum macho_symgroup group;
+} macho_nlist;
+
+/* String table; strings are deduplicated through an open addressing hash
+ * table of offsets into data (0 = empty slot; offset 0 is never a string).
+ */
+typedef struct macho_strtab {
+    /*@only@*/ char *data;
+    unsigned long len;          /* length of all strings */
+    unsigned long alloc;
+    /*@only@*/ unsigned long *hash;
+    unsigned long hash_size;    /* power of 2 */
+    unsigned long count;        /* number of strings */
+} macho_strtab;
+
 
 typedef struct yasm_objfmt_macho {
     yasm_objfmt_base objfmt;    /* base structure */
@@ -296,6 +325,7 @@ typedef struct macho_objfmt_output_info {
     yasm_errwarns *errwarns;
     /*@dependent@ */ FILE *f;
     /*@only@ */ unsigned char *buf;
+    unsigned char *bufp;        /* current position in buf (headers) */
     yasm_section *sect;
     /*@dependent@ */ macho_section_data *msd;
 
@@ -310,10 +340,14 @@ typedef struct macho_objfmt_output_info {
     unsigned long rel_base;     /* first relocation in file */
     unsigned long s_reloff;     /* in-file offset to relocations */
 
-    unsigned long indx;         /* current symbol size in bytes (name length+1) */
-    unsigned long symindex;     /* current symbol index in output order */
+    /* rendered section contents, indexed by scnum (empty for BSS) */
+    /*@only@*/ yasm_section_contents *contents;
+
     int all_syms;               /* outputting all symbols? */
-    unsigned long strlength;    /* length of all strings */
+    /*@only@*/ macho_nlist *nlists;      /* symbol table entries */
+    unsigned long num_nlists;
+    unsigned long alloc_nlists;
+    macho_strtab strtab;        /* symbol names */
 } macho_objfmt_output_info;
 
 
@@ -413,7 +447,7 @@ macho_objfmt_output_value(yasm_value *value, unsigned char *buf,
     unsigned long intn_minus = 0, intn_plus = 0;
     int retval;
     unsigned int valsize = value->size;
-    macho_reloc *reloc = NULL;
+    macho_reloc reloc;
 
     assert(info != NULL);
     objfmt_macho = info->objfmt_macho;
@@ -444,60 +478,55 @@ macho_objfmt_output_value(yasm_value *value, unsigned char *buf,
     if (value->rel) {
         yasm_sym_vis vis = yasm_symrec_get_visibility(value->rel);
 
-        reloc = yasm_xcalloc(sizeof(macho_reloc), 1);
-        reloc->reloc.addr = yasm_intnum_create_uint(bc->offset + offset);
-        reloc->reloc.sym = value->rel;
+        reloc.reloc.addr = bc->offset + offset;
+        reloc.reloc.sym = value->rel;
         switch (valsize) {
             case 64:
-                reloc->length = 3;
+                reloc.length = 3;
                 break;
             case 32:
-                reloc->length = 2;
+                reloc.length = 2;
                 break;
             case 16:
-                reloc->length = 1;
+                reloc.length = 1;
                 break;
             case 8:
-                reloc->length = 0;
+                reloc.length = 0;
                 break;
             default:
                 yasm_error_set(YASM_ERROR_TOO_COMPLEX,
                                N_("macho: relocation size unsupported"));
-                yasm_xfree(reloc);
                 return 1;
         }
-        reloc->pcrel = 0;
-        reloc->ext = 0;
-        reloc->type = GENERIC_RELOC_VANILLA;
+        reloc.pcrel = 0;
+        reloc.ext = 0;
+        reloc.type = GENERIC_RELOC_VANILLA;
         /* R_ABS */
 
         if (value->rshift > 0) {
             yasm_error_set(YASM_ERROR_TOO_COMPLEX,
                            N_("macho: shifted relocations not supported"));
-            yasm_xfree(reloc);
             return 1;
         }
 
         if (value->seg_of) {
             yasm_error_set(YASM_ERROR_TOO_COMPLEX,
                            N_("macho: SEG not supported"));
-            yasm_xfree(reloc);
             return 1;
         }
 
         if (value->curpos_rel && objfmt_macho->gotpcrel_sym &&
             value->wrt == objfmt_macho->gotpcrel_sym) {
-            reloc->type = X86_64_RELOC_GOT;
+            reloc.type = X86_64_RELOC_GOT;
             value->wrt = NULL;
         } else if (value->wrt) {
             yasm_error_set(YASM_ERROR_TOO_COMPLEX,
                            N_("macho: invalid WRT"));
-            yasm_xfree(reloc);
             return 1;
         }
 
         if (value->curpos_rel) {
-            reloc->pcrel = 1;
+            reloc.pcrel = 1;
             if (!info->is_64) {
                 /* Adjust to start of section, so subtract out the bytecode
                  * offset.
@@ -506,14 +535,14 @@ macho_objfmt_output_value(yasm_value *value, unsigned char *buf,
             } else {
                 /* Add in the offset plus value size to end up with 0. */
                 intn_plus = offset+destsize;
-                if (reloc->type == X86_64_RELOC_GOT) {
+                if (reloc.type == X86_64_RELOC_GOT) {
                     /* XXX: This is a hack */
                     if (offset >= 2 && buf[-2] == 0x8B)
-                        reloc->type = X86_64_RELOC_GOT_LOAD;
+                        reloc.type = X86_64_RELOC_GOT_LOAD;
                 } else if (value->jump_target)
-                    reloc->type = X86_64_RELOC_BRANCH;
+                    reloc.type = X86_64_RELOC_BRANCH;
                 else
-                    reloc->type = X86_64_RELOC_SIGNED;
+                    reloc.type = X86_64_RELOC_SIGNED;
             }
         } else if (info->is_64) {
             if (valsize == 32) {
@@ -521,19 +550,34 @@ macho_objfmt_output_value(yasm_value *value, unsigned char *buf,
                     N_("macho: sorry, cannot apply 32 bit absolute relocations in 64 bit mode, consider \"[_symbol wrt rip]\" for mem access, \"qword\" and \"dq _foo\" for pointers."));
                 return 1;
             }
-            reloc->type = X86_64_RELOC_UNSIGNED;
+            reloc.type = X86_64_RELOC_UNSIGNED;
         }
 
-        /* It seems that x86-64 objects need to have all extern relocs? */
-        if (info->is_64)
-            reloc->ext = 1;
+        /* It seems that x86-64 objects need to have all extern relocs?
+         * Symbols not in the symbol table (e.g. GAS numeric local labels)
+         * have no symbol table entry, so they must use a section-based
+         * reloc instead.
+         */
+        if (info->is_64 &&
+            !(yasm_symrec_get_status(value->rel) & YASM_SYM_NOTINTABLE))
+            reloc.ext = 1;
 
         if ((vis & YASM_SYM_EXTERN) || (vis & YASM_SYM_COMMON)) {
-            reloc->ext = 1;
+            reloc.ext = 1;
             info->msd->extreloc = 1;    /* section has external relocations */
-        } else if (!info->is_64) {
+        } else if (!reloc.ext) {
             /*@dependent@*/ /*@null@*/ yasm_bytecode *sym_precbc;
 
+            if (info->is_64 && reloc.type != X86_64_RELOC_UNSIGNED &&
+                reloc.type != X86_64_RELOC_SIGNED) {
+                if (reloc.type != X86_64_RELOC_BRANCH) {
+                    yasm_error_set(YASM_ERROR_TOO_COMPLEX,
+                        N_("macho: invalid relocation to local label"));
+                    return 1;
+                }
+                reloc.type = X86_64_RELOC_SIGNED;
+            }
+
             /* Local symbols need valued to their actual address */
             if (yasm_symrec_get_label(value->rel, &sym_precbc)) {
                 yasm_section *sym_sect = yasm_bc_get_section(sym_precbc);
@@ -542,11 +586,21 @@ macho_objfmt_output_value(yasm_value *value, unsigned char *buf,
                 assert(msd != NULL);
                 intn_plus += msd->vmoff + yasm_bc_next_offset(sym_precbc);
             }
+
+            /* x86-64 section-based PC-relative relocs hold the final
+             * displacement, so adjust to the bytecode's address rather
+             * than adding in the value size.
+             */
+            if (info->is_64 && reloc.pcrel) {
+                intn_plus -= offset+destsize;
+                intn_minus += info->msd->vmoff + bc->offset;
+            }
         }
 
         info->msd->nreloc++;
-        /*printf("reloc %s type %d ",yasm_symrec_get_name(reloc->reloc.sym),reloc->type);*/
-        yasm_section_add_reloc(info->sect, (yasm_reloc *)reloc, yasm_xfree);
+        /*printf("reloc %s type %d ",yasm_symrec_get_name(reloc.reloc.sym),reloc.type);*/
+        yasm_section_add_reloc(info->sect, (yasm_reloc *)&reloc,
+                               sizeof(macho_reloc), NULL);
     }
 
     if (intn_minus <= intn_plus)
@@ -576,53 +630,31 @@ macho_objfmt_output_value(yasm_value *value, unsigned char *buf,
 }
 
 static int
-macho_objfmt_output_bytecode(yasm_bytecode *bc, /*@null@*/ void *d)
+macho_objfmt_output_section(yasm_section *sect, /*@null@ */ void *d)
 {
-    /*@null@*/ macho_objfmt_output_info *info = (macho_objfmt_output_info *)d;
-    /*@null@*/ /*@only@*/ unsigned char *bigbuf;
-    unsigned long size = REGULAR_OUTBUF_SIZE;
-    int gap;
+    /*@null@ */ macho_objfmt_output_info *info =
+        (macho_objfmt_output_info *) d;
+    /*@dependent@ *//*@null@ */ macho_section_data *msd;
 
     assert(info != NULL);
+    msd = yasm_section_get_data(sect, &macho_section_data_cb);
+    assert(msd != NULL);
 
-    bigbuf = yasm_bc_tobytes(bc, info->buf, &size, &gap, info,
-                             macho_objfmt_output_value, NULL);
-
-    /* Don't bother doing anything else if size ended up being 0. */
-    if (size == 0) {
-        if (bigbuf)
-            yasm_xfree(bigbuf);
-        return 0;
-    }
-
-    /* Warn that gaps are converted to 0 and write out the 0's. */
-    if (gap) {
-        unsigned long left;
-
-        yasm_warn_set(YASM_WARN_UNINIT_CONTENTS,
-                      N_("uninitialized space: zeroing"));
-        /* Write out in chunks */
-        memset(info->buf, 0, REGULAR_OUTBUF_SIZE);
-        left = size;
-        while (left > REGULAR_OUTBUF_SIZE) {
-            fwrite(info->buf, REGULAR_OUTBUF_SIZE, 1, info->f);
-            left -= REGULAR_OUTBUF_SIZE;
-        }
-        fwrite(info->buf, left, 1, info->f);
-    } else {
-        /* Output buf (or bigbuf if non-NULL) to file */
-        fwrite(bigbuf ? bigbuf : info->buf, (size_t) size, 1, info->f);
+    if (!(msd->flags & S_ZEROFILL)) {
+        /* Render non-BSS sections; they are written once the headers are
+         * known.
+         */
+        info->sect = sect;
+        info->msd = msd;
+        yasm_section_tobytes(sect, info->errwarns,
+            N_("uninitialized space: zeroing"), info,
+            macho_objfmt_output_value, NULL, &info->contents[msd->scnum]);
     }
-
-    /* If bigbuf was allocated, free it */
-    if (bigbuf)
-        yasm_xfree(bigbuf);
-
     return 0;
 }
 
 static int
-macho_objfmt_output_section(yasm_section *sect, /*@null@ */ void *d)
+macho_objfmt_write_section(yasm_section *sect, /*@null@ */ void *d)
 {
     /*@null@ */ macho_objfmt_output_info *info =
         (macho_objfmt_output_info *) d;
@@ -632,55 +664,50 @@ macho_objfmt_output_section(yasm_section *sect, /*@null@ */ void *d)
     msd = yasm_section_get_data(sect, &macho_section_data_cb);
     assert(msd != NULL);
 
-    if (!(msd->flags & S_ZEROFILL)) {
-        /* Output non-BSS sections */
-        info->sect = sect;
-        info->msd = msd;
-        yasm_section_bcs_traverse(sect, info->errwarns, info,
-                                  macho_objfmt_output_bytecode);
-    }
+    yasm_section_contents_write(&info->contents[msd->scnum], info->f);
+    yasm_section_contents_delete(&info->contents[msd->scnum]);
     return 0;
 }
 
+static void
+macho_objfmt_write_reloc(yasm_reloc *r, unsigned char *buf,
+                         /*@unused@*/ void *d)
+{
+    macho_reloc *reloc = (macho_reloc *)r;
+    /*@dependent@*/ /*@null@*/ macho_section_data *msd;
+    /*@null@*/ macho_symrec_data *xsymd;
+    unsigned long symnum;
+
+    xsymd = yasm_symrec_get_data(reloc->reloc.sym, &macho_symrec_data_cb);
+    YASM_WRITE_32_L(buf, reloc->reloc.addr);    /* address of relocation */
+
+    if (reloc->ext)
+        symnum = xsymd->index;
+    else {
+        /* find section where the symbol relates to */
+        /*@dependent@*/ /*@null@*/ yasm_section *dsect;
+        /*@dependent@*/ /*@null@*/ yasm_bytecode *precbc;
+        symnum = 0; /* default to absolute */
+        if (yasm_symrec_get_label(reloc->reloc.sym, &precbc) &&
+            (dsect = yasm_bc_get_section(precbc)) &&
+            (msd = yasm_section_get_data(dsect, &macho_section_data_cb)))
+            symnum = msd->scnum+1;
+    }
+    YASM_WRITE_32_L(buf,
+                    (symnum & 0x00ffffff) |
+                    (((unsigned long)reloc->pcrel & 1) << 24) |
+                    (((unsigned long)reloc->length & 3) << 25) |
+                    (((unsigned long)reloc->ext & 1) << 27) |
+                    (((unsigned long)reloc->type & 0xf) << 28));
+}
+
 static int
 macho_objfmt_output_relocs(yasm_section *sect, /*@null@*/ void *d)
 {
     /*@null@*/ macho_objfmt_output_info *info = (macho_objfmt_output_info *)d;
-    /*@dependent@*/ /*@null@*/ macho_section_data *msd;
-    macho_reloc *reloc;
-
-    reloc = (macho_reloc *)yasm_section_relocs_first(sect);
-    while (reloc) {
-        unsigned char *localbuf = info->buf;
-        /*@null@*/ macho_symrec_data *xsymd;
-        unsigned long symnum;
-
-        xsymd = yasm_symrec_get_data(reloc->reloc.sym, &macho_symrec_data_cb);
-        yasm_intnum_get_sized(reloc->reloc.addr, localbuf, 4, 32, 0, 0, 0);
-        localbuf += 4;          /* address of relocation */
-
-        if (reloc->ext)
-            symnum = xsymd->index;
-        else {
-            /* find section where the symbol relates to */
-            /*@dependent@*/ /*@null@*/ yasm_section *dsect;
-            /*@dependent@*/ /*@null@*/ yasm_bytecode *precbc;
-            symnum = 0; /* default to absolute */
-            if (yasm_symrec_get_label(reloc->reloc.sym, &precbc) &&
-                (dsect = yasm_bc_get_section(precbc)) &&
-                (msd = yasm_section_get_data(dsect, &macho_section_data_cb)))
-                symnum = msd->scnum+1;
-        }
-        YASM_WRITE_32_L(localbuf,
-                        (symnum & 0x00ffffff) |
-                        (((unsigned long)reloc->pcrel & 1) << 24) |
-                        (((unsigned long)reloc->length & 3) << 25) |
-                        (((unsigned long)reloc->ext & 1) << 27) |
-                        (((unsigned long)reloc->type & 0xf) << 28));
-        fwrite(info->buf, 8, 1, info->f);
-        reloc = (macho_reloc *)yasm_section_reloc_next((yasm_reloc *)reloc);
-    }
 
+    yasm_section_relocs_write(sect, info->f, 8, macho_objfmt_write_reloc,
+                              NULL);
     return 0;
 }
 
@@ -698,34 +725,6 @@ exp2_to_bits(unsigned long val)
     return ret;
 }
 
-static int
-macho_objfmt_is_section_label(yasm_symrec *sym)
-{
-    /*@dependent@*/ /*@null@*/ yasm_section *sect;
-    /*@dependent@*/ /*@null@*/ yasm_bytecode *precbc;
-
-    /* Look at symrec for value/scnum/etc. */
-    if (yasm_symrec_get_label(sym, &precbc)) {
-        if (precbc)
-            sect = yasm_bc_get_section(precbc);
-        else
-            sect = NULL;
-        /* it's a label: get value and offset.
-         * If there is not a section, leave as debugging symbol.
-         */
-        if (sect) {
-            /*@dependent@*/ /*@null@*/ macho_section_data *msd;
-
-            msd = yasm_section_get_data(sect, &macho_section_data_cb);
-            if (msd) {
-                if (msd->sym == sym)
-                    return 1;   /* don't store section names */
-            }
-        }
-    }
-    return 0;
-}
-
 static int
 macho_objfmt_output_secthead(yasm_section *sect, /*@null@*/ void *d)
 {
@@ -737,7 +736,7 @@ macho_objfmt_output_secthead(yasm_section *sect, /*@null@*/ void *d)
     msd = yasm_section_get_data(sect, &macho_section_data_cb);
     assert(msd != NULL);
 
-    localbuf = info->buf;
+    localbuf = info->bufp;
 
     memset(localbuf, 0, 16);
     strncpy((char *)localbuf, msd->sectname, 16);
@@ -780,208 +779,244 @@ macho_objfmt_output_secthead(yasm_section *sect, /*@null@*/ void *d)
     YASM_WRITE_32_L(localbuf, msd->flags);      /* flags */
     YASM_WRITE_32_L(localbuf, 0);       /* reserved 1 */
     YASM_WRITE_32_L(localbuf, 0);       /* reserved 2 */
-
     if (info->is_64)
-        fwrite(info->buf, MACHO_SECTCMD64_SIZE, 1, info->f);
-    else
-        fwrite(info->buf, MACHO_SECTCMD_SIZE, 1, info->f);
+        YASM_WRITE_32_L(localbuf, 0);   /* reserved 3 */
+
+    info->bufp = localbuf;
 
     return 0;
 }
 
+static void
+macho_strtab_init(macho_strtab *strtab)
+{
+    strtab->alloc = 1024;
+    strtab->data = yasm_xmalloc(strtab->alloc);
+    strtab->data[0] = '\0';     /* string table starts with a zero byte */
+    strtab->len = 1;
+    strtab->hash_size = 256;
+    strtab->hash = yasm_xcalloc(strtab->hash_size, sizeof(unsigned long));
+    strtab->count = 0;
+}
 
-static int
-macho_objfmt_count_sym(yasm_symrec *sym, /*@null@*/ void *d)
+static void
+macho_strtab_destroy(macho_strtab *strtab)
 {
-    /*@null@*/ macho_objfmt_output_info *info = (macho_objfmt_output_info *)d;
-    /*@only@*/ char *name;
-    yasm_sym_vis vis = yasm_symrec_get_visibility(sym);
+    yasm_xfree(strtab->data);
+    yasm_xfree(strtab->hash);
+}
 
-    assert(info != NULL);
-    if (info->all_syms ||
-        vis & (YASM_SYM_GLOBAL | YASM_SYM_COMMON | YASM_SYM_EXTERN)) {
-        if (0 == macho_objfmt_is_section_label(sym)) {
-            /* Save index in symrec data */
-            macho_symrec_data *sym_data =
-                yasm_symrec_get_data(sym, &macho_symrec_data_cb);
-            if (!sym_data) {
-                sym_data = yasm_xcalloc(sizeof(macho_symrec_data), 1);
-                yasm_symrec_add_data(sym, &macho_symrec_data_cb, sym_data);
-            }
-            sym_data->index = info->symindex;
-            info->symindex++;
-
-            name = yasm_symrec_get_global_name(sym, info->object);
-            /*printf("%s\n",name); */
-            /* name length + delimiter */
-            sym_data->length = (unsigned long)strlen(name) + 1;
-            info->strlength += sym_data->length;
-            info->indx++;
-            yasm_xfree(name);
+/* Add a string to the string table (if not already present) and return
+ * its offset.
+ */
+static unsigned long
+macho_strtab_add(macho_strtab *strtab, const char *str)
+{
+    size_t len = strlen(str);
+    unsigned long mask, i, offset;
+
+    /* Keep the hash table at most half full */
+    if (strtab->count*2 >= strtab->hash_size) {
+        unsigned long *oldhash = strtab->hash;
+        unsigned long oldsize = strtab->hash_size, j;
+
+        strtab->hash_size *= 2;
+        strtab->hash = yasm_xcalloc(strtab->hash_size, sizeof(unsigned long));
+        mask = strtab->hash_size-1;
+        for (j=0; j<oldsize; j++) {
+            const char *s;
+            offset = oldhash[j];
+            if (offset == 0)
+                continue;
+            s = strtab->data + offset;
+            i = phash_lookup(s, strlen(s), 0) & mask;
+            while (strtab->hash[i] != 0)
+                i = (i+1) & mask;
+            strtab->hash[i] = offset;
         }
+        yasm_xfree(oldhash);
+    }
+
+    mask = strtab->hash_size-1;
+    i = phash_lookup(str, len, 0) & mask;
+    while ((offset = strtab->hash[i]) != 0) {
+        if (strcmp(strtab->data + offset, str) == 0)
+            return offset;
+        i = (i+1) & mask;
     }
-    return 0;
-}
 
+    /* Not found; append */
+    offset = strtab->len;
+    if (offset + len + 1 > strtab->alloc) {
+        while (offset + len + 1 > strtab->alloc)
+            strtab->alloc *= 2;
+        strtab->data = yasm_xrealloc(strtab->data, strtab->alloc);
+    }
+    memcpy(strtab->data + offset, str, len+1);
+    strtab->len += (unsigned long)(len + 1);
+    strtab->hash[i] = offset;
+    strtab->count++;
+    return offset;
+}
 
+/* Build the nlist entry for a symbol, if it goes in the symbol table. */
 static int
-macho_objfmt_output_symtable(yasm_symrec *sym, /*@null@*/ void *d)
+macho_objfmt_build_symtab(yasm_symrec *sym, /*@null@*/ void *d)
 {
     /*@null@*/ macho_objfmt_output_info *info = (macho_objfmt_output_info *)d;
     yasm_sym_vis vis = yasm_symrec_get_visibility(sym);
+    const yasm_expr *equ_val;
+    const yasm_intnum *intn;
+    unsigned long value = 0;
+    long scnum = -3;        /* -3 = debugging symbol */
+    /*@dependent@*/ /*@null@*/ yasm_section *sect;
+    /*@dependent@*/ /*@null@*/ yasm_bytecode *precbc;
+    unsigned int n_type = 0, n_desc = 0;
+    macho_symrec_data *symd;
+    macho_nlist *nl;
+    /*@only@*/ char *name;
 
     assert(info != NULL);
 
-    if (info->all_syms ||
-        vis & (YASM_SYM_GLOBAL | YASM_SYM_COMMON | YASM_SYM_EXTERN)) {
-        const yasm_expr *equ_val;
-        const yasm_intnum *intn;
-        unsigned long value = 0;
-        long scnum = -3;        /* -3 = debugging symbol */
-        /*@dependent@*/ /*@null@*/ yasm_section *sect;
-        /*@dependent@*/ /*@null@*/ yasm_bytecode *precbc;
-        unsigned char *localbuf;
-        yasm_intnum *val;
-        unsigned int long_int_bytes = (info->is_64) ? 8 : 4;
-        unsigned int n_type = 0, n_sect = 0, n_desc = 0;
-        macho_symrec_data *symd;
-
-        val = yasm_intnum_create_uint(0);
+    if (!info->all_syms &&
+        !(vis & (YASM_SYM_GLOBAL | YASM_SYM_COMMON | YASM_SYM_EXTERN)))
+        return 0;
 
-        symd = yasm_symrec_get_data(sym, &macho_symrec_data_cb);
+    /* Look at symrec for value/scnum/etc. */
+    if (yasm_symrec_get_label(sym, &precbc)) {
+        if (precbc)
+            sect = yasm_bc_get_section(precbc);
+        else
+            sect = NULL;
+        /* it's a label: get value and offset.
+         * If there is not a section, leave as debugging symbol.
+         */
+        if (sect) {
+            /*@dependent@*/ /*@null@*/ macho_section_data *msd;
 
-        /* Look at symrec for value/scnum/etc. */
-        if (yasm_symrec_get_label(sym, &precbc)) {
+            msd = yasm_section_get_data(sect, &macho_section_data_cb);
+            if (msd) {
+                if (msd->sym == sym)
+                    return 0;   /* don't store section names */
+                scnum = msd->scnum;
+                n_type = N_SECT;
+            } else
+                yasm_internal_error(N_("didn't understand section"));
             if (precbc)
-                sect = yasm_bc_get_section(precbc);
-            else
-                sect = NULL;
-            /* it's a label: get value and offset.
-             * If there is not a section, leave as debugging symbol.
+                value += yasm_bc_next_offset(precbc);
+            /* all values are subject to correction: base offset is first
+             * raw section, therefore add section offset
              */
-            if (sect) {
-                /*@dependent@*/ /*@null@*/ macho_section_data *msd;
-
-                msd = yasm_section_get_data(sect, &macho_section_data_cb);
-                if (msd) {
-                    if (msd->sym == sym) {
-                        /* don't store section names */
-                        yasm_intnum_destroy(val);
-                        return 0;
-                    }
-                    scnum = msd->scnum;
-                    n_type = N_SECT;
-                } else
-                    yasm_internal_error(N_("didn't understand section"));
-                if (precbc)
-                    value += yasm_bc_next_offset(precbc);
-                /* all values are subject to correction: base offset is first
-                 * raw section, therefore add section offset
-                 */
-                if (msd)
-                    value += msd->vmoff;
-                yasm_intnum_set_uint(val, value);
-                /*printf("%s offset %lx\n",name,value);*/
+            if (msd)
+                value += msd->vmoff;
+        }
+    } else if ((equ_val = yasm_symrec_get_equ(sym))) {
+        yasm_expr *equ_val_copy = yasm_expr_copy(equ_val);
+
+        intn = yasm_expr_get_intnum(&equ_val_copy, 1);
+        if (!intn) {
+            if (vis & YASM_SYM_GLOBAL) {
+                yasm_error_set(YASM_ERROR_NOT_CONSTANT,
+                    N_("global EQU value not an integer expression"));
+                yasm_errwarn_propagate(info->errwarns, equ_val->line);
             }
-        } else if ((equ_val = yasm_symrec_get_equ(sym))) {
-            yasm_expr *equ_val_copy = yasm_expr_copy(equ_val);
+        } else
+            value = yasm_intnum_get_uint(intn);
+        yasm_expr_destroy(equ_val_copy);
+        n_type = N_ABS;
+        scnum = -2;         /* -2 = absolute symbol */
+    }
 
-            intn = yasm_expr_get_intnum(&equ_val_copy, 1);
+    if (vis & YASM_SYM_EXTERN) {
+        n_type = N_EXT;
+        scnum = -1;
+        /*n_desc = REFERENCE_FLAG_UNDEFINED_LAZY;   * FIXME: see definition of REFERENCE_FLAG_* above */
+    } else if (vis & YASM_SYM_COMMON) {
+        yasm_expr **csize = yasm_symrec_get_common_size(sym);
+        n_type = N_UNDF | N_EXT;
+        if (csize) {
+            intn = yasm_expr_get_intnum(csize, 1);
             if (!intn) {
-                if (vis & YASM_SYM_GLOBAL) {
-                    yasm_error_set(YASM_ERROR_NOT_CONSTANT,
-                        N_("global EQU value not an integer expression"));
-                    yasm_errwarn_propagate(info->errwarns, equ_val->line);
-                }
+                yasm_error_set(YASM_ERROR_NOT_CONSTANT,
+                               N_("COMMON data size not an integer expression"));
+                yasm_errwarn_propagate(info->errwarns, (*csize)->line);
             } else
                 value = yasm_intnum_get_uint(intn);
-            yasm_expr_destroy(equ_val_copy);
-            yasm_intnum_set_uint(val, value);
-            n_type = N_ABS;
-            scnum = -2;         /* -2 = absolute symbol */
         }
-
-        if (vis & YASM_SYM_EXTERN) {
-            n_type = N_EXT;
-            scnum = -1;
-            /*n_desc = REFERENCE_FLAG_UNDEFINED_LAZY;   * FIXME: see definition of REFERENCE_FLAG_* above */
-        } else if (vis & YASM_SYM_COMMON) {
-            yasm_expr **csize = yasm_symrec_get_common_size(sym);
-            n_type = N_UNDF | N_EXT;
-            if (csize) {
-                intn = yasm_expr_get_intnum(csize, 1);
-                if (!intn) {
-                    yasm_error_set(YASM_ERROR_NOT_CONSTANT,
-                                   N_("COMMON data size not an integer expression"));
-                    yasm_errwarn_propagate(info->errwarns, (*csize)->line);
-                } else
-                    yasm_intnum_set_uint(val, yasm_intnum_get_uint(intn));
-            }
-            /*printf("common symbol %s val %lu\n", name, yasm_intnum_get_uint(val));*/
-        } else if (vis & YASM_SYM_GLOBAL) {
-            yasm_valparamhead *valparams =
-                yasm_symrec_get_objext_valparams(sym);
-
-            struct macho_global_data {
-                unsigned long flag; /* N_PEXT */
-            } data;
-
-            data.flag = 0;
-
-            if (valparams) {
-                static const yasm_dir_help help[] = {
-                    { "private_extern", 0, yasm_dir_helper_flag_set,
-                      offsetof(struct macho_global_data, flag), N_PEXT },
-                };
-                yasm_dir_helper(sym, yasm_vps_first(valparams),
-                                yasm_symrec_get_decl_line(sym), help, NELEMS(help),
-                                &data, yasm_dir_helper_valparam_warn);
-            }
-
-            n_type |= N_EXT | data.flag;
+    } else if (vis & YASM_SYM_GLOBAL) {
+        yasm_valparamhead *valparams =
+            yasm_symrec_get_objext_valparams(sym);
+
+        struct macho_global_data {
+            unsigned long flag; /* N_PEXT */
+        } data;
+
+        data.flag = 0;
+
+        if (valparams) {
+            static const yasm_dir_help help[] = {
+                { "private_extern", 0, yasm_dir_helper_flag_set,
+                  offsetof(struct macho_global_data, flag), N_PEXT },
+            };
+            yasm_dir_helper(sym, yasm_vps_first(valparams),
+                            yasm_symrec_get_decl_line(sym), help, NELEMS(help),
+                            &data, yasm_dir_helper_valparam_warn);
         }
 
-        localbuf = info->buf;
-        YASM_WRITE_32_L(localbuf, info->indx);  /* offset in string table */
-        YASM_WRITE_8(localbuf, n_type); /* type of symbol entry */
-        n_sect = (scnum >= 0) ? scnum + 1 : NO_SECT;
-        YASM_WRITE_8(localbuf, n_sect); /* referring section where symbol is found */
-        YASM_WRITE_16_L(localbuf, n_desc);      /* extra description */
-        yasm_intnum_get_sized(val, localbuf, long_int_bytes, ((long_int_bytes) << 3), 0, 0, 0); /* value/argument */
-        localbuf += long_int_bytes;
-        if (symd)
-            symd->value = val;
-        else
-            yasm_intnum_destroy(val);
+        n_type |= N_EXT | data.flag;
+    }
 
-        info->indx += symd->length;
+    /* Save value in symrec data; the index is assigned after sorting */
+    symd = yasm_symrec_get_data(sym, &macho_symrec_data_cb);
+    if (!symd) {
+        symd = yasm_xcalloc(sizeof(macho_symrec_data), 1);
+        yasm_symrec_add_data(sym, &macho_symrec_data_cb, symd);
+    }
+    symd->value = value;
 
-        fwrite(info->buf, 8 + long_int_bytes, 1, info->f);
+    if (info->num_nlists >= info->alloc_nlists) {
+        info->alloc_nlists *= 2;
+        info->nlists = yasm_xrealloc(info->nlists,
+                                     info->alloc_nlists*sizeof(macho_nlist));
     }
+    nl = &info->nlists[info->num_nlists];
+    nl->symd = symd;
+    name = yasm_symrec_get_global_name(sym, info->object);
+    nl->strx = macho_strtab_add(&info->strtab, name);
+    yasm_xfree(name);
+    nl->order = info->num_nlists;
+    nl->value = value;
+    nl->n_type = n_type;
+    nl->n_sect = (scnum >= 0) ? (unsigned int)scnum + 1 : NO_SECT;
+    nl->n_desc = n_desc;
+    if (!(n_type & N_EXT))
+        nl->group = MACHO_SYMGROUP_LOCAL;
+    else if ((n_type & N_TYPE) == N_UNDF)
+        nl->group = MACHO_SYMGROUP_UNDEF;
+    else
+        nl->group = MACHO_SYMGROUP_EXTDEF;
+    info->num_nlists++;
 
     return 0;
 }
 
-
+/* Locals keep symbol table order; external defined and undefined symbols
+ * are sorted by name.
+ */
 static int
-macho_objfmt_output_str(yasm_symrec *sym, /*@null@*/ void *d)
+macho_nlist_compare(const void *a, const void *b)
 {
-    /*@null@*/ macho_objfmt_output_info *info = (macho_objfmt_output_info *)d;
-    yasm_sym_vis vis = yasm_symrec_get_visibility(sym);
-
-    assert(info != NULL);
-
-    if (info->all_syms ||
-        vis & (YASM_SYM_GLOBAL | YASM_SYM_COMMON | YASM_SYM_EXTERN)) {
-        if (0 == macho_objfmt_is_section_label(sym)) {
-            /*@only@*/ char *name =
-                yasm_symrec_get_global_name(sym, info->object);
-            size_t len = strlen(name);
-
-            fwrite(name, len + 1, 1, info->f);
-            yasm_xfree(name);
-        }
+    const macho_nlist *na = a, *nb = b;
+
+    if (na->group != nb->group)
+        return na->group < nb->group ? -1 : 1;
+    if (na->group != MACHO_SYMGROUP_LOCAL) {
+        int cmp = strcmp(na->name, nb->name);
+        if (cmp != 0)
+            return cmp;
     }
+    if (na->order != nb->order)
+        return na->order < nb->order ? -1 : 1;
     return 0;
 }
 
@@ -1035,15 +1070,14 @@ macho_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     unsigned int macho_segcmd;
     unsigned int head_ncmds, head_sizeofcmds;
     unsigned long fileoffset, fileoff_sections;
-    yasm_intnum *val;
-    unsigned long long_int_bytes;
+    unsigned long nlocal, nextdef, nundef;
+    unsigned long i;
     const char pad_data[3] = "\0\0\0";
 
     info.object = object;
     info.objfmt_macho = objfmt_macho;
     info.errwarns = errwarns;
     info.f = f;
-    info.buf = yasm_xmalloc(REGULAR_OUTBUF_SIZE);
 
     if (objfmt_macho->parse_scnum == 0) {
         yasm_internal_error(N_("no sections defined"));
@@ -1051,10 +1085,8 @@ macho_objfmt_output(yasm_object *object, FILE *f, int all_syms,
         return;
     }
 
-    val = yasm_intnum_create_uint(0);
-
     /*
-     * MACH-O Header, Seg CMD, Sect CMDs, Sym Tab, Reloc Data
+     * MACH-O Header, Seg CMD, Sect CMDs, Sym Tab, Dysym Tab, Reloc Data
      */
     info.is_64 = (objfmt_macho->bits == 32) ? 0 : 1;
     if (info.is_64) {
@@ -1062,38 +1094,20 @@ macho_objfmt_output(yasm_object *object, FILE *f, int all_syms,
         headsize =
             MACHO_HEADER64_SIZE + MACHO_SEGCMD64_SIZE +
             (MACHO_SECTCMD64_SIZE * (objfmt_macho->parse_scnum)) +
-            MACHO_SYMCMD_SIZE;
+            MACHO_SYMCMD_SIZE + MACHO_DYSYMCMD_SIZE;
         macho_segcmd = LC_SEGMENT_64;
         macho_segcmdsize = MACHO_SEGCMD64_SIZE;
         macho_sectcmdsize = MACHO_SECTCMD64_SIZE;
         macho_nlistsize = MACHO_NLIST64_SIZE;
-        long_int_bytes = 8;
     } else {
         headsize =
             MACHO_HEADER_SIZE + MACHO_SEGCMD_SIZE +
             (MACHO_SECTCMD_SIZE * (objfmt_macho->parse_scnum)) +
-            MACHO_SYMCMD_SIZE;
+            MACHO_SYMCMD_SIZE + MACHO_DYSYMCMD_SIZE;
         macho_segcmd = LC_SEGMENT;
         macho_segcmdsize = MACHO_SEGCMD_SIZE;
         macho_sectcmdsize = MACHO_SECTCMD_SIZE;
         macho_nlistsize = MACHO_NLIST_SIZE;
-        long_int_bytes = 4;
-    }
-
-    /* Get number of symbols */
-    info.symindex = 0;
-    info.indx = 0;
-    info.strlength = 1;         /* string table starts with a zero byte */
-    info.all_syms = all_syms || info.is_64;
-    /*info.all_syms = 1;                * force all syms into symbol table */
-    yasm_symtab_traverse(object->symtab, &info, macho_objfmt_count_sym);
-    symtab_count = info.indx;
-
-    /* write raw section data first */
-    if (fseek(f, (long)headsize, SEEK_SET) < 0) {
-        yasm__fatal(N_("could not seek on output file"));
-        /*@notreached@ */
-        return;
     }
 
     /* get size of sections in memory (including BSS) and size of sections
@@ -1104,18 +1118,45 @@ macho_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     info.offset = headsize;
     yasm_object_sections_traverse(object, &info, macho_objfmt_calc_sectsize);
 
-    /* output sections to file */
+    /* Render sections; this also counts the relocations needed by the
+     * section headers.  Raw section data starts right after the headers.
+     */
+    info.contents = yasm_xcalloc(objfmt_macho->parse_scnum,
+                                 sizeof(yasm_section_contents));
     yasm_object_sections_traverse(object, &info, macho_objfmt_output_section);
+    fileoff_sections = info.offset;
 
-    fileoff_sections = ftell(f);
+    /* Build the symbol table and string table in a single symbol pass */
+    macho_strtab_init(&info.strtab);
+    info.num_nlists = 0;
+    info.alloc_nlists = 64;
+    info.nlists = yasm_xmalloc(info.alloc_nlists*sizeof(macho_nlist));
+    info.all_syms = all_syms || info.is_64;
+    /*info.all_syms = 1;                * force all syms into symbol table */
+    yasm_symtab_traverse(object->symtab, &info, macho_objfmt_build_symtab);
+    symtab_count = info.num_nlists;
 
-    /* Write headers */
-    if (fseek(f, 0, SEEK_SET) < 0) {
-        yasm__fatal(N_("could not seek on output file"));
-        /*@notreached@*/
-        return;
+    /* Order symbols as locals, external defined, then undefined (as the
+     * dynamic symbol table command requires), and number them.
+     */
+    for (i=0; i<symtab_count; i++)
+        info.nlists[i].name = info.strtab.data + info.nlists[i].strx;
+    yasm__mergesort(info.nlists, symtab_count, sizeof(macho_nlist),
+                    macho_nlist_compare);
+    nlocal = nextdef = nundef = 0;
+    for (i=0; i<symtab_count; i++) {
+        macho_nlist *nl = &info.nlists[i];
+        nl->symd->index = i;
+        if (nl->group == MACHO_SYMGROUP_LOCAL)
+            nlocal++;
+        else if (nl->group == MACHO_SYMGROUP_EXTDEF)
+            nextdef++;
+        else
+            nundef++;
     }
 
+    /* Build all headers in memory */
+    info.buf = yasm_xmalloc(headsize);
     localbuf = info.buf;
 
     /* header size is common to 32 bit and 64 bit variants */
@@ -1139,10 +1180,9 @@ macho_objfmt_output(yasm_object *object, FILE *f, int all_syms,
         head_sizeofcmds +=
             macho_segcmdsize + macho_sectcmdsize * objfmt_macho->parse_scnum;
     }
-    if (symtab_count > 0) {
-        head_ncmds++;
-        head_sizeofcmds += MACHO_SYMCMD_SIZE;
-    }
+    /* symbol table commands, always present */
+    head_ncmds += 2;
+    head_sizeofcmds += MACHO_SYMCMD_SIZE + MACHO_DYSYMCMD_SIZE;
 
     YASM_WRITE_32_L(localbuf, head_ncmds);
     YASM_WRITE_32_L(localbuf, head_sizeofcmds);
@@ -1169,24 +1209,21 @@ macho_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     YASM_WRITE_32_L(localbuf, 0);
     YASM_WRITE_32_L(localbuf, 0);
 
-    /* in-memory offset, in-memory size */
-    yasm_intnum_set_uint(val, 0);       /* offset in memory (vmaddr) */
-    yasm_intnum_get_sized(val, localbuf, long_int_bytes,
-                          ((long_int_bytes) << 3), 0, 0, 0);
-    localbuf += long_int_bytes;
-    yasm_intnum_set_uint(val, info.vmsize);     /* size in memory (vmsize) */
-    yasm_intnum_get_sized(val, localbuf, long_int_bytes,
-                          ((long_int_bytes) << 3), 0, 0, 0);
-    localbuf += long_int_bytes;
-    /* offset in file to first section */
-    yasm_intnum_set_uint(val, fileoffset);
-    yasm_intnum_get_sized(val, localbuf, long_int_bytes,
-                          ((long_int_bytes) << 3), 0, 0, 0);
-    localbuf += long_int_bytes;
-    yasm_intnum_set_uint(val, info.filesize);   /* overall size in file */
-    yasm_intnum_get_sized(val, localbuf, long_int_bytes,
-                          ((long_int_bytes) << 3), 0, 0, 0);
-    localbuf += long_int_bytes;
+    /* in-memory offset, in-memory size, offset in file to first section,
+     * overall size in file; 64 bits wide in 64 bit mode
+     */
+    YASM_WRITE_32_L(localbuf, 0);               /* offset in memory (vmaddr) */
+    if (info.is_64)
+        YASM_WRITE_32_L(localbuf, 0);
+    YASM_WRITE_32_L(localbuf, info.vmsize);     /* size in memory (vmsize) */
+    if (info.is_64)
+        YASM_WRITE_32_L(localbuf, 0);
+    YASM_WRITE_32_L(localbuf, fileoffset);
+    if (info.is_64)
+        YASM_WRITE_32_L(localbuf, 0);
+    YASM_WRITE_32_L(localbuf, info.filesize);
+    if (info.is_64)
+        YASM_WRITE_32_L(localbuf, 0);
 
     YASM_WRITE_32_L(localbuf, VM_PROT_DEFAULT); /* VM protection, maximum */
     YASM_WRITE_32_L(localbuf, VM_PROT_DEFAULT); /* VM protection, initial */
@@ -1194,17 +1231,15 @@ macho_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     YASM_WRITE_32_L(localbuf, objfmt_macho->parse_scnum);
     YASM_WRITE_32_L(localbuf, 0);       /* no flags */
 
-    /* write MACH-O header and segment command to outfile */
-    fwrite(info.buf, (size_t) (localbuf - info.buf), 1, f);
-
     /* next: section headers */
     /* offset to relocs for first section */
     info.rel_base = align32((long)fileoff_sections);
     info.s_reloff = 0;          /* offset for relocs of following sections */
+    info.bufp = localbuf;
     yasm_object_sections_traverse(object, &info, macho_objfmt_output_secthead);
+    localbuf = info.bufp;
 
-    localbuf = info.buf;
-    /* write out symbol command */
+    /* symbol command */
     YASM_WRITE_32_L(localbuf, LC_SYMTAB);       /* cmd == LC_SYMTAB */
     YASM_WRITE_32_L(localbuf, MACHO_SYMCMD_SIZE);
     /* symbol table offset */
@@ -1213,19 +1248,25 @@ macho_objfmt_output(yasm_object *object, FILE *f, int all_syms,
 
     YASM_WRITE_32_L(localbuf, macho_nlistsize * symtab_count + info.rel_base +
                     info.s_reloff);     /* string table offset */
-    YASM_WRITE_32_L(localbuf, info.strlength);  /* string table size */
-    /* write symbol command */
-    fwrite(info.buf, (size_t)(localbuf - info.buf), 1, f);
+    YASM_WRITE_32_L(localbuf, info.strtab.len); /* string table size */
 
-    /*printf("num symbols %d, vmsize %d, filesize %d\n",symtab_count,
-      info.vmsize, info.filesize ); */
-
-    /* get back to end of raw section data */
-    if (fseek(f, (long)fileoff_sections, SEEK_SET) < 0) {
-        yasm__fatal(N_("could not seek on output file"));
-        /*@notreached@*/
-        return;
-    }
+    /* dynamic symbol table command: only the symbol groups are used in an
+     * object file
+     */
+    YASM_WRITE_32_L(localbuf, LC_DYSYMTAB);     /* cmd == LC_DYSYMTAB */
+    YASM_WRITE_32_L(localbuf, MACHO_DYSYMCMD_SIZE);
+    YASM_WRITE_32_L(localbuf, 0);               /* ilocalsym */
+    YASM_WRITE_32_L(localbuf, nlocal);          /* nlocalsym */
+    YASM_WRITE_32_L(localbuf, nlocal);          /* iextdefsym */
+    YASM_WRITE_32_L(localbuf, nextdef);         /* nextdefsym */
+    YASM_WRITE_32_L(localbuf, nlocal+nextdef);  /* iundefsym */
+    YASM_WRITE_32_L(localbuf, nundef);          /* nundefsym */
+    memset(localbuf, 0, MACHO_DYSYMCMD_SIZE-32); /* no tables */
+    localbuf += MACHO_DYSYMCMD_SIZE-32;
+
+    /* write all headers at once, followed by raw section data */
+    fwrite(info.buf, (size_t)(localbuf - info.buf), 1, f);
+    yasm_object_sections_traverse(object, &info, macho_objfmt_write_section);
 
     /* padding to long boundary */
     if ((info.rel_base - fileoff_sections) > 0) {
@@ -1236,14 +1277,29 @@ macho_objfmt_output(yasm_object *object, FILE *f, int all_syms,
     yasm_object_sections_traverse(object, &info, macho_objfmt_output_relocs);
 
     /* symbol table (NLIST) */
-    info.indx = 1;              /* restart symbol table indices */
-    yasm_symtab_traverse(object->symtab, &info, macho_objfmt_output_symtable);
+    yasm_xfree(info.buf);
+    info.buf = yasm_xmalloc(symtab_count*macho_nlistsize + 1);
+    localbuf = info.buf;
+    for (i=0; i<symtab_count; i++) {
+        const macho_nlist *nl = &info.nlists[i];
+        YASM_WRITE_32_L(localbuf, nl->strx);    /* offset in string table */
+        YASM_WRITE_8(localbuf, nl->n_type);     /* type of symbol entry */
+        /* referring section where symbol is found */
+        YASM_WRITE_8(localbuf, nl->n_sect);
+        YASM_WRITE_16_L(localbuf, nl->n_desc);  /* extra description */
+        /* value/argument */
+        YASM_WRITE_32_L(localbuf, nl->value & 0xFFFFFFFFUL);
+        if (info.is_64)
+            YASM_WRITE_32_L(localbuf, ((nl->value >> 16) >> 16) & 0xFFFFFFFFUL);
+    }
+    fwrite(info.buf, (size_t)(localbuf - info.buf), 1, f);
 
     /* symbol strings */
-    fwrite(pad_data, 1, 1, f);
-    yasm_symtab_traverse(object->symtab, &info, macho_objfmt_output_str);
+    fwrite(info.strtab.data, info.strtab.len, 1, f);
 
-    yasm_intnum_destroy(val);
+    macho_strtab_destroy(&info.strtab);
+    yasm_xfree(info.nlists);
+    yasm_xfree(info.contents);
     yasm_xfree(info.buf);
 }
 
@@ -1546,12 +1602,8 @@ macho_symrec_data_print(void *data, FILE *f, int indent_level)
 {
     macho_symrec_data *msd = (macho_symrec_data *)data;
 
-    fprintf(f, "%*sindex=%ld\n", indent_level, "", msd->index);
-    fprintf(f, "%*svalue=", indent_level, "");
-    if (msd->value)
-        fprintf(f, "%ld\n", yasm_intnum_get_int(msd->value));
-    else
-        fprintf(f, "nil\n");
+    fprintf(f, "%*sindex=%lu\n", indent_level, "", msd->index);
+    fprintf(f, "%*svalue=%lu\n", indent_level, "", msd->value);
 }
 
 
@@ -92,7 +92,7 @@ typedef struct rdf_section_data {
     unsigned int reserved;  /* reserved data */
     unsigned long size;     /* size of raw data (section data) in bytes */
 
-    unsigned char *raw_data;    /* raw section data, only used during output */
+    yasm_section_contents raw_data; /* section data, only used during output */
 } rdf_section_data;
 
 typedef struct rdf_symrec_data {
@@ -223,25 +223,24 @@ rdf_objfmt_output_value(yasm_value *value, unsigned char *buf,
     intn_minus = 0;
     intn_plus = 0;
     if (value->rel) {
-        rdf_reloc *reloc;
+        rdf_reloc reloc;
         /*@null@*/ rdf_symrec_data *rsymd;
         /*@dependent@*/ yasm_bytecode *precbc;
 
-        reloc = yasm_xmalloc(sizeof(rdf_reloc));
-        reloc->reloc.addr = yasm_intnum_create_uint(bc->offset + offset);
-        reloc->reloc.sym = value->rel;
-        reloc->size = valsize/8;
+        reloc.reloc.addr = bc->offset + offset;
+        reloc.reloc.sym = value->rel;
+        reloc.size = valsize/8;
 
         if (value->seg_of)
-            reloc->type = RDF_RELOC_SEG;
+            reloc.type = RDF_RELOC_SEG;
         else if (value->curpos_rel) {
-            reloc->type = RDF_RELOC_REL;
+            reloc.type = RDF_RELOC_REL;
             /* Adjust to start of section, so subtract out the bytecode
              * offset.
              */
             intn_minus = bc->offset;
         } else
-            reloc->type = RDF_RELOC_NORM;
+            reloc.type = RDF_RELOC_NORM;
 
         if (yasm_symrec_get_label(value->rel, &precbc)) {
             /* local, set the value to be the offset, and the refseg to the
@@ -254,19 +253,20 @@ rdf_objfmt_output_value(yasm_value *value, unsigned char *buf,
             csectd = yasm_section_get_data(sect, &rdf_section_data_cb);
             if (!csectd)
                 yasm_internal_error(N_("didn't understand section"));
-            reloc->refseg = csectd->scnum;
+            reloc.refseg = csectd->scnum;
             intn_plus = yasm_bc_next_offset(precbc);
         } else {
             /* must be common/external */
-            rsymd = yasm_symrec_get_data(reloc->reloc.sym,
+            rsymd = yasm_symrec_get_data(reloc.reloc.sym,
                                          &rdf_symrec_data_cb);
             if (!rsymd)
                 yasm_internal_error(
                     N_("rdf: no symbol data for relocated symbol"));
-            reloc->refseg = rsymd->segment;
+            reloc.refseg = rsymd->segment;
         }
 
-        yasm_section_add_reloc(info->sect, (yasm_reloc *)reloc, yasm_xfree);
+        yasm_section_add_reloc(info->sect, (yasm_reloc *)&reloc,
+                               sizeof(rdf_reloc), NULL);
     }
 
     if (intn_minus > 0) {
@@ -292,47 +292,6 @@ rdf_objfmt_output_value(yasm_value *value, unsigned char *buf,
     return retval;
 }
 
-static int
-rdf_objfmt_output_bytecode(yasm_bytecode *bc, /*@null@*/ void *d)
-{
-    /*@null@*/ rdf_objfmt_output_info *info = (rdf_objfmt_output_info *)d;
-    /*@null@*/ /*@only@*/ unsigned char *bigbuf;
-    unsigned long size = REGULAR_OUTBUF_SIZE;
-    int gap;
-
-    assert(info != NULL);
-
-    bigbuf = yasm_bc_tobytes(bc, info->buf, &size, &gap, info,
-                             rdf_objfmt_output_value, NULL);
-
-    /* Don't bother doing anything else if size ended up being 0. */
-    if (size == 0) {
-        if (bigbuf)
-            yasm_xfree(bigbuf);
-        return 0;
-    }
-
-    /* Warn that gaps are converted to 0 and write out the 0's. */
-    if (gap) {
-        yasm_warn_set(YASM_WARN_UNINIT_CONTENTS,
-                      N_("uninitialized space: zeroing"));
-        /* Write out in chunks */
-        memset(&info->rsd->raw_data[info->rsd->size], 0, size);
-    } else {
-        /* Output buf (or bigbuf if non-NULL) to file */
-        memcpy(&info->rsd->raw_data[info->rsd->size],
-               bigbuf ? bigbuf : info->buf, (size_t)size);
-    }
-
-    info->rsd->size += size;
-
-    /* If bigbuf was allocated, free it */
-    if (bigbuf)
-        yasm_xfree(bigbuf);
-
-    return 0;
-}
-
 static int
 rdf_objfmt_output_section_mem(yasm_section *sect, /*@null@*/ void *d)
 {
@@ -359,13 +318,12 @@ rdf_objfmt_output_section_mem(yasm_section *sect, /*@null@*/ void *d)
         return 0;
 
     /* See UGH comment in output() for why we're doing this */
-    rsd->raw_data = yasm_xmalloc(size);
-    rsd->size = 0;
-
     info->sect = sect;
     info->rsd = rsd;
-    yasm_section_bcs_traverse(sect, info->errwarns, info,
-                              rdf_objfmt_output_bytecode);
+    yasm_section_tobytes(sect, info->errwarns,
+        N_("uninitialized space: zeroing"), info, rdf_objfmt_output_value,
+        NULL, &rsd->raw_data);
+    rsd->size = rsd->raw_data.size;
 
     /* Sanity check final section size */
     if (rsd->size != size)
@@ -375,12 +333,30 @@ rdf_objfmt_output_section_mem(yasm_section *sect, /*@null@*/ void *d)
     return 0;
 }
 
+static void
+rdf_objfmt_write_reloc(yasm_reloc *r, unsigned char *buf, void *d)
+{
+    rdf_reloc *reloc = (rdf_reloc *)r;
+    rdf_section_data *rsd = (rdf_section_data *)d;
+
+    if (reloc->type == RDF_RELOC_SEG)
+        YASM_WRITE_8(buf, RDFREC_SEGRELOC);
+    else
+        YASM_WRITE_8(buf, RDFREC_RELOC);
+    YASM_WRITE_8(buf, 8);                       /* record length */
+    /* Section number, +0x40 if relative reloc */
+    YASM_WRITE_8(buf, rsd->scnum +
+                 (reloc->type == RDF_RELOC_REL ? 0x40 : 0));
+    YASM_WRITE_32_L(buf, reloc->reloc.addr);    /* offset of relocation */
+    YASM_WRITE_8(buf, reloc->size);             /* size of relocation */
+    YASM_WRITE_16_L(buf, reloc->refseg);        /* relocated symbol */
+}
+
 static int
 rdf_objfmt_output_section_reloc(yasm_section *sect, /*@null@*/ void *d)
 {
     /*@null@*/ rdf_objfmt_output_info *info = (rdf_objfmt_output_info *)d;
     /*@dependent@*/ /*@null@*/ rdf_section_data *rsd;
-    rdf_reloc *reloc;
 
     assert(info != NULL);
     rsd = yasm_section_get_data(sect, &rdf_section_data_cb);
@@ -395,26 +371,8 @@ rdf_objfmt_output_section_reloc(yasm_section *sect, /*@null@*/ void *d)
     if (rsd->size == 0)
         return 0;
 
-    reloc = (rdf_reloc *)yasm_section_relocs_first(sect);
-    while (reloc) {
-        unsigned char *localbuf = info->buf;
-
-        if (reloc->type == RDF_RELOC_SEG)
-            YASM_WRITE_8(localbuf, RDFREC_SEGRELOC);
-        else
-            YASM_WRITE_8(localbuf, RDFREC_RELOC);
-        YASM_WRITE_8(localbuf, 8);              /* record length */
-        /* Section number, +0x40 if relative reloc */
-        YASM_WRITE_8(localbuf, rsd->scnum +
-                     (reloc->type == RDF_RELOC_REL ? 0x40 : 0));
-        yasm_intnum_get_sized(reloc->reloc.addr, localbuf, 4, 32, 0, 0, 0);
-        localbuf += 4;                          /* offset of relocation */
-        YASM_WRITE_8(localbuf, reloc->size);        /* size of relocation */
-        YASM_WRITE_16_L(localbuf, reloc->refseg);   /* relocated symbol */
-        fwrite(info->buf, 10, 1, info->f);
-
-        reloc = (rdf_reloc *)yasm_section_reloc_next((yasm_reloc *)reloc);
-    }
+    yasm_section_relocs_write(sect, info->f, 10, rdf_objfmt_write_reloc,
+                              rsd);
 
     return 0;
 }
@@ -448,11 +406,10 @@ rdf_objfmt_output_section_file(yasm_section *sect, /*@null@*/ void *d)
     fwrite(info->buf, 10, 1, info->f);
 
     /* Section data */
-    fwrite(rsd->raw_data, rsd->size, 1, info->f);
+    yasm_section_contents_write(&rsd->raw_data, info->f);
 
     /* Free section data */
-    yasm_xfree(rsd->raw_data);
-    rsd->raw_data = NULL;
+    yasm_section_contents_delete(&rsd->raw_data);
 
     return 0;
 }
@@ -822,7 +779,10 @@ rdf_objfmt_init_new_section(yasm_section *sect, unsigned long line)
     data->type = 0;
     data->reserved = 0;
     data->size = 0;
-    data->raw_data = NULL;
+    data->raw_data.data = NULL;
+    data->raw_data.size = 0;
+    data->raw_data.gaps = NULL;
+    data->raw_data.num_gaps = 0;
     yasm_section_add_data(sect, &rdf_section_data_cb, data);
 
     sym = yasm_symtab_define_label(object->symtab, sectname,
@@ -970,8 +930,7 @@ static void
 rdf_section_data_destroy(void *data)
 {
     rdf_section_data *rsd = (rdf_section_data *)data;
-    if (rsd->raw_data)
-        yasm_xfree(rsd->raw_data);
+    yasm_section_contents_delete(&rsd->raw_data);
     yasm_xfree(data);
 }
 
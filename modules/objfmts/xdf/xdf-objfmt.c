@@ -181,30 +181,30 @@ xdf_objfmt_output_value(yasm_value *value, unsigned char *buf,
 
     intn_minus = 0;
     if (value->rel) {
-        xdf_reloc *reloc;
+        xdf_reloc reloc;
 
-        reloc = yasm_xmalloc(sizeof(xdf_reloc));
-        reloc->reloc.addr = yasm_intnum_create_uint(bc->offset + offset);
-        reloc->reloc.sym = value->rel;
-        reloc->base = NULL;
-        reloc->size = valsize/8;
-        reloc->shift = value->rshift;
+        reloc.reloc.addr = bc->offset + offset;
+        reloc.reloc.sym = value->rel;
+        reloc.base = NULL;
+        reloc.size = valsize/8;
+        reloc.shift = value->rshift;
 
         if (value->seg_of)
-            reloc->type = XDF_RELOC_SEG;
+            reloc.type = XDF_RELOC_SEG;
         else if (value->wrt) {
-            reloc->base = value->wrt;
-            reloc->type = XDF_RELOC_WRT;
+            reloc.base = value->wrt;
+            reloc.type = XDF_RELOC_WRT;
         } else if (value->curpos_rel) {
-            reloc->type = XDF_RELOC_RIP;
+            reloc.type = XDF_RELOC_RIP;
             /* Adjust to start of section, so subtract out the bytecode
              * offset.
              */
             intn_minus = bc->offset;
         } else
-            reloc->type = XDF_RELOC_REL;
+            reloc.type = XDF_RELOC_REL;
         info->xsd->nreloc++;
-        yasm_section_add_reloc(info->sect, (yasm_reloc *)reloc, yasm_xfree);
+        yasm_section_add_reloc(info->sect, (yasm_reloc *)&reloc,
+                               sizeof(xdf_reloc), NULL);
     }
 
     if (intn_minus > 0) {
@@ -230,51 +230,35 @@ xdf_objfmt_output_value(yasm_value *value, unsigned char *buf,
     return retval;
 }
 
-static int
-xdf_objfmt_output_bytecode(yasm_bytecode *bc, /*@null@*/ void *d)
+static void
+xdf_objfmt_write_reloc(yasm_reloc *r, unsigned char *buf,
+                       /*@unused@*/ void *d)
 {
-    /*@null@*/ xdf_objfmt_output_info *info = (xdf_objfmt_output_info *)d;
-    /*@null@*/ /*@only@*/ unsigned char *bigbuf;
-    unsigned long size = REGULAR_OUTBUF_SIZE;
-    int gap;
-
-    assert(info != NULL);
-
-    bigbuf = yasm_bc_tobytes(bc, info->buf, &size, &gap, info,
-                             xdf_objfmt_output_value, NULL);
+    xdf_reloc *reloc = (xdf_reloc *)r;
+    /*@null@*/ xdf_symrec_data *xsymd;
 
-    /* Don't bother doing anything else if size ended up being 0. */
-    if (size == 0) {
-        if (bigbuf)
-            yasm_xfree(bigbuf);
-        return 0;
-    }
+    xsymd = yasm_symrec_get_data(reloc->reloc.sym, &xdf_symrec_data_cb);
+    if (!xsymd)
+        yasm_internal_error(N_("xdf: no symbol data for relocated symbol"));
 
-    info->xsd->size += size;
-
-    /* Warn that gaps are converted to 0 and write out the 0's. */
-    if (gap) {
-        unsigned long left;
-        yasm_warn_set(YASM_WARN_UNINIT_CONTENTS,
-                      N_("uninitialized space: zeroing"));
-        /* Write out in chunks */
-        memset(info->buf, 0, REGULAR_OUTBUF_SIZE);
-        left = size;
-        while (left > REGULAR_OUTBUF_SIZE) {
-            fwrite(info->buf, REGULAR_OUTBUF_SIZE, 1, info->f);
-            left -= REGULAR_OUTBUF_SIZE;
-        }
-        fwrite(info->buf, left, 1, info->f);
+    YASM_WRITE_32_L(buf, reloc->reloc.addr);    /* address of relocation */
+    YASM_WRITE_32_L(buf, xsymd->index);         /* relocated symbol */
+    if (reloc->base) {
+        xsymd = yasm_symrec_get_data(reloc->base, &xdf_symrec_data_cb);
+        if (!xsymd)
+            yasm_internal_error(
+                N_("xdf: no symbol data for relocated base symbol"));
+        YASM_WRITE_32_L(buf, xsymd->index);     /* base symbol */
     } else {
-        /* Output buf (or bigbuf if non-NULL) to file */
-        fwrite(bigbuf ? bigbuf : info->buf, (size_t)size, 1, info->f);
+        if (reloc->type == XDF_RELOC_WRT)
+            yasm_internal_error(
+                N_("xdf: no base symbol for WRT relocation"));
+        YASM_WRITE_32_L(buf, 0);                /* no base symbol */
     }
-
-    /* If bigbuf was allocated, free it */
-    if (bigbuf)
-        yasm_xfree(bigbuf);
-
-    return 0;
+    YASM_WRITE_8(buf, reloc->type);             /* type of relocation */
+    YASM_WRITE_8(buf, reloc->size);             /* size of relocation */
+    YASM_WRITE_8(buf, reloc->shift);            /* relocation shift */
+    YASM_WRITE_8(buf, 0);                       /* flags */
 }
 
 static int
@@ -282,8 +266,8 @@ xdf_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
 {
     /*@null@*/ xdf_objfmt_output_info *info = (xdf_objfmt_output_info *)d;
     /*@dependent@*/ /*@null@*/ xdf_section_data *xsd;
+    yasm_section_contents contents;
     long pos;
-    xdf_reloc *reloc;
 
     assert(info != NULL);
     xsd = yasm_section_get_data(sect, &xdf_section_data_cb);
@@ -305,8 +289,12 @@ xdf_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
 
         info->sect = sect;
         info->xsd = xsd;
-        yasm_section_bcs_traverse(sect, info->errwarns, info,
-                                  xdf_objfmt_output_bytecode);
+        yasm_section_tobytes(sect, info->errwarns,
+            N_("uninitialized space: zeroing"), info,
+            xdf_objfmt_output_value, NULL, &contents);
+        xsd->size += contents.size;
+        yasm_section_contents_write(&contents, info->f);
+        yasm_section_contents_delete(&contents);
 
         /* Sanity check final section size */
         if (xsd->size != yasm_bc_next_offset(yasm_section_bcs_last(sect)))
@@ -332,39 +320,8 @@ xdf_objfmt_output_section(yasm_section *sect, /*@null@*/ void *d)
     }
     xsd->relptr = (unsigned long)pos;
 
-    reloc = (xdf_reloc *)yasm_section_relocs_first(sect);
-    while (reloc) {
-        unsigned char *localbuf = info->buf;
-        /*@null@*/ xdf_symrec_data *xsymd;
-
-        xsymd = yasm_symrec_get_data(reloc->reloc.sym, &xdf_symrec_data_cb);
-        if (!xsymd)
-            yasm_internal_error(
-                N_("xdf: no symbol data for relocated symbol"));
-
-        yasm_intnum_get_sized(reloc->reloc.addr, localbuf, 4, 32, 0, 0, 0);
-        localbuf += 4;                          /* address of relocation */
-        YASM_WRITE_32_L(localbuf, xsymd->index);    /* relocated symbol */
-        if (reloc->base) {
-            xsymd = yasm_symrec_get_data(reloc->base, &xdf_symrec_data_cb);
-            if (!xsymd)
-                yasm_internal_error(
-                    N_("xdf: no symbol data for relocated base symbol"));
-            YASM_WRITE_32_L(localbuf, xsymd->index); /* base symbol */
-        } else {
-            if (reloc->type == XDF_RELOC_WRT)
-                yasm_internal_error(
-                    N_("xdf: no base symbol for WRT relocation"));
-            YASM_WRITE_32_L(localbuf, 0);           /* no base symbol */
-        }
-        YASM_WRITE_8(localbuf, reloc->type);        /* type of relocation */
-        YASM_WRITE_8(localbuf, reloc->size);        /* size of relocation */
-        YASM_WRITE_8(localbuf, reloc->shift);       /* relocation shift */
-        YASM_WRITE_8(localbuf, 0);                  /* flags */
-        fwrite(info->buf, 16, 1, info->f);
-
-        reloc = (xdf_reloc *)yasm_section_reloc_next((yasm_reloc *)reloc);
-    }
+    yasm_section_relocs_write(sect, info->f, 16, xdf_objfmt_write_reloc,
+                              NULL);
 
     return 0;
 }
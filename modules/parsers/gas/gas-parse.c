@@ -58,6 +58,9 @@ static yasm_expr *parse_expr1(yasm_parser_gas *parser_gas);
 static yasm_expr *parse_expr2(yasm_parser_gas *parser_gas);
 
 static void define_label(yasm_parser_gas *parser_gas, char *name, int local);
+static void define_local_label(yasm_parser_gas *parser_gas, unsigned int n);
+static yasm_symrec *use_local_label(yasm_parser_gas *parser_gas,
+                                    unsigned int n, int forward);
 static void define_lcomm(yasm_parser_gas *parser_gas, /*@only@*/ char *name,
                          yasm_expr *size, /*@null@*/ yasm_expr *align);
 static yasm_section *gas_get_section
@@ -159,6 +162,9 @@ expect_(yasm_parser_gas *parser_gas, int token)
         case RIGHT_OP:          str = ">>"; break;
         case ID:                str = "identifier"; break;
         case LABEL:             str = "label"; break;
+        case LOCAL_LABEL:       str = "local label"; break;
+        case LOCAL_FORWARD:
+        case LOCAL_BACKWARD:    str = "local label reference"; break;
         default:
             strch[1] = token;
             str = strch;
@@ -241,6 +247,10 @@ parse_line(yasm_parser_gas *parser_gas)
             define_label(parser_gas, LABEL_val, 0);
             get_next_token(); /* LABEL */
             return parse_line(parser_gas);
+        case LOCAL_LABEL:
+            define_local_label(parser_gas, LOCAL_val);
+            get_next_token(); /* LOCAL_LABEL */
+            return parse_line(parser_gas);
         case CPP_LINE_MARKER:
             get_next_token();
             cpp_line_marker(parser_gas);
@@ -1489,6 +1499,12 @@ parse_expr2(yasm_parser_gas *parser_gas)
 
             return p_expr_new_ident(yasm_expr_sym(sym));
         }
+        case LOCAL_FORWARD:
+        case LOCAL_BACKWARD:
+            sym = use_local_label(parser_gas, LOCAL_val,
+                                  curtok == LOCAL_FORWARD);
+            get_next_token();
+            return p_expr_new_ident(yasm_expr_sym(sym));
         default:
             return NULL;
     }
@@ -1511,6 +1527,53 @@ define_label(yasm_parser_gas *parser_gas, char *name, int local)
     yasm_xfree(name);
 }
 
+/* Numeric local labels are kept out of the symbol table; see local_bwd and
+ * local_fwd in yasm_parser_gas.
+ */
+static void
+define_local_label(yasm_parser_gas *parser_gas, unsigned int n)
+{
+    yasm_symrec *sym = parser_gas->local_fwd[n];
+
+    if (sym)
+        yasm_symrec_define_label(sym, parser_gas->prev_bc, cur_line);
+    else {
+        char name[2];
+        name[0] = '0'+n;
+        name[1] = '\0';
+        sym = yasm_symtab_define_label(p_symtab, name, parser_gas->prev_bc, 0,
+                                       cur_line);
+    }
+    parser_gas->local_bwd[n] = sym;
+    parser_gas->local_fwd[n] = NULL;
+}
+
+static yasm_symrec *
+use_local_label(yasm_parser_gas *parser_gas, unsigned int n, int forward)
+{
+    char name[2];
+
+    if (forward && parser_gas->local_fwd[n])
+        return parser_gas->local_fwd[n];
+    if (!forward && parser_gas->local_bwd[n])
+        return parser_gas->local_bwd[n];
+
+    name[0] = '0'+n;
+    name[1] = '\0';
+    if (forward) {
+        parser_gas->local_fwd[n] =
+            yasm_symtab_use_not_in_table(p_symtab, name, cur_line);
+        return parser_gas->local_fwd[n];
+    }
+
+    /* Backward reference without a definition; return an undefined symbol
+     * so that parsing can continue.
+     */
+    yasm_error_set(YASM_ERROR_GENERAL,
+                   N_("undefined local label `%ub'"), n);
+    return yasm_symtab_use_not_in_table(p_symtab, name, cur_line);
+}
+
 static void
 define_lcomm(yasm_parser_gas *parser_gas, /*@only@*/ char *name,
              yasm_expr *size, /*@null@*/ yasm_expr *align)
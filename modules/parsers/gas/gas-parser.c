@@ -70,8 +70,10 @@ gas_parser_do_parse(yasm_object *object, yasm_preproc *pp,
 
     parser_gas.state = INITIAL;
 
-    for (i=0; i<10; i++)
-        parser_gas.local[i] = 0;
+    for (i=0; i<10; i++) {
+        parser_gas.local_bwd[i] = NULL;
+        parser_gas.local_fwd[i] = NULL;
+    }
 
     parser_gas.intel_syntax = 0;
 
@@ -94,6 +96,16 @@ gas_parser_do_parse(yasm_object *object, yasm_preproc *pp,
 
     yasm_scanner_delete(&parser_gas.s);
 
+    /* Check for forward references to local labels never defined */
+    for (i=0; i<10; i++) {
+        if (parser_gas.local_fwd[i]) {
+            yasm_error_set(YASM_ERROR_GENERAL,
+                           N_("undefined local label `%df' (first use)"), i);
+            yasm_errwarn_propagate(errwarns,
+                yasm_symrec_get_use_line(parser_gas.local_fwd[i]));
+        }
+    }
+
     /* Free locallabel base if necessary */
     if (parser_gas.locallabel_base)
         yasm_xfree(parser_gas.locallabel_base);
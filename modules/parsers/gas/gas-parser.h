@@ -46,6 +46,9 @@ enum tokentype {
     RIGHT_OP,
     ID,
     LABEL,
+    LOCAL_LABEL,
+    LOCAL_FORWARD,
+    LOCAL_BACKWARD,
     CPP_LINE_MARKER,
     NASM_LINE_MARKER,
     NONE
@@ -114,10 +117,13 @@ typedef struct yasm_parser_gas {
     yystype peek_tokval;
     char peek_tokch;
 
-    /* Index of local labels; what's stored here is the /next/ index,
-     * so these are all 0 at start.
+    /* Numeric local labels (0: through 9:).  These are not put in the
+     * symbol table.  local_bwd holds the most recent definition of each
+     * (the target of Nb); local_fwd holds the symbol for the next
+     * definition once it has been referenced (by Nf), or NULL.
      */
-    unsigned long local[10];
+    /*@null@*/ /*@dependent@*/ yasm_symrec *local_bwd[10];
+    /*@null@*/ /*@dependent@*/ yasm_symrec *local_fwd[10];
 
     /* Parser-handled directives HAMT lookup */
     HAMT *dirs;
@@ -146,6 +152,7 @@ typedef struct yasm_parser_gas {
 #define ID_len                  (curval.str.len)
 #define LABEL_val               (curval.str.contents)
 #define LABEL_len               (curval.str.len)
+#define LOCAL_val               (curval.int_info)
 
 #define cur_line        (yasm_linemap_get_current(parser_gas->linemap))
 
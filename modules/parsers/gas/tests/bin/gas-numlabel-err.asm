@@ -0,0 +1,6 @@
+	jmp	1b
+1:	nop
+	jmp	2f
+	jmp	2f
+	jmp	1f
+1:	nop
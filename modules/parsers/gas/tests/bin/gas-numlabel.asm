@@ -0,0 +1,14 @@
+# Numeric local labels: each digit may be redefined any number of times;
+# Nb refers to the most recent definition and Nf to the next one.
+	.code32
+1:	nop
+	jmp	1b
+	jmp	1f
+1:	nop
+	jmp	1b
+0:	jmp	9f
+	.long	1b, 9f
+9:	.long	0b, 9b
+1:	jmp	1b
+	jmp	1f
+1:	ret
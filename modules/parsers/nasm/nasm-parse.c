@@ -113,11 +113,13 @@ destroy_curtok_(yasm_parser_nasm *parser_nasm)
         case DIRECTIVE_NAME:
         case FILENAME:
         case ID:
-        case LOCAL_ID:
         case SPECIAL_ID:
         case NONLOCAL_ID:
             yasm_xfree(curval.str_val);
             break;
+        case LOCAL_ID:
+            /* points into a scratch buffer */
+            break;
         case STRING:
             yasm_xfree(curval.str.contents);
             break;
@@ -389,7 +391,10 @@ parse_line(yasm_parser_nasm *parser_nasm)
         case NONLOCAL_ID:
         case LOCAL_ID:
         {
-            char *name = ID_val;
+            /* Local label names live in a scratch buffer that is reused by
+             * later tokens on the line, so take a copy.
+             */
+            char *name = curtok == LOCAL_ID ? yasm__xstrdup(ID_val) : ID_val;
             int local = parser_nasm->tasm
                 ? (curtok == ID || curtok == LOCAL_ID ||
                         (curtok == SPECIAL_ID && name[0] == '@'))
@@ -1015,7 +1020,8 @@ parse_operand(yasm_parser_nasm *parser_nasm)
                                                        cur_line);
                     yasm_expr *e = p_expr_new_ident(yasm_expr_sym(sym)), *f;
                     yasm_effaddr *ea;
-                    yasm_xfree(ID_val);
+                    if (curtok != LOCAL_ID)
+                        yasm_xfree(ID_val);
                     get_next_token();
                     get_next_token();
                     f = parse_bexpr(parser_nasm, NORM_EXPR);
@@ -1464,7 +1470,8 @@ parse_expr6(yasm_parser_nasm *parser_nasm, expr_type type)
         case NONLOCAL_ID:
             sym = yasm_symtab_use(p_symtab, ID_val, cur_line);
             e = p_expr_new_ident(yasm_expr_sym(sym));
-            yasm_xfree(ID_val);
+            if (curtok != LOCAL_ID)
+                yasm_xfree(ID_val);
             break;
         case '$':
             /* "$" references the current assembly position */
@@ -50,6 +50,14 @@ typedef struct yasm_parser_nasm {
     /*@null@*/ char *locallabel_base;
     size_t locallabel_base_len;
 
+    /* Scratch buffers for the full names of local labels.  LOCAL_ID token
+     * values point into these instead of being allocated; two are needed
+     * as both the current and the lookahead token may be local labels.
+     */
+    /*@null@*/ /*@only@*/ char *localname[2];
+    size_t localname_alloc[2];
+    int localname_cur;
+
     /*@dependent@*/ yasm_preproc *preproc;
     /*@dependent@*/ yasm_errwarns *errwarns;
 
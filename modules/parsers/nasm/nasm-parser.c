@@ -46,6 +46,12 @@ nasm_do_parse(yasm_object *object, yasm_preproc *pp, int save_input,
     parser_nasm.locallabel_base = (char *)NULL;
     parser_nasm.locallabel_base_len = 0;
 
+    parser_nasm.localname[0] = NULL;
+    parser_nasm.localname[1] = NULL;
+    parser_nasm.localname_alloc[0] = 0;
+    parser_nasm.localname_alloc[1] = 0;
+    parser_nasm.localname_cur = 0;
+
     parser_nasm.preproc = pp;
     parser_nasm.errwarns = errwarns;
 
@@ -70,6 +76,10 @@ nasm_do_parse(yasm_object *object, yasm_preproc *pp, int save_input,
     /* Free locallabel base if necessary */
     if (parser_nasm.locallabel_base)
         yasm_xfree(parser_nasm.locallabel_base);
+    if (parser_nasm.localname[0])
+        yasm_xfree(parser_nasm.localname[0]);
+    if (parser_nasm.localname[1])
+        yasm_xfree(parser_nasm.localname[1]);
 
     /* Check for undefined symbols */
     yasm_symtab_parser_finalize(object->symtab, 0, errwarns);
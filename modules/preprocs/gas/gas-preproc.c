@@ -655,8 +655,10 @@ static int eval_include(yasm_preproc_gas *pp, int unused, const char *arg1)
     } else {
         current_filename = SLIST_FIRST(&pp->included_files)->filename;
     }
+    yasm_trace_begin("include", filename);
     file = yasm_fopen_include(filename, current_filename, "r", NULL);
     if (!file) {
+        yasm_trace_end();
         yasm_error_set(YASM_ERROR_SYNTAX, N_("unable to open included file \"%s\""), filename);
         yasm_errwarn_propagate(pp->errwarns, pp->current_line_number);
         return 0;
@@ -678,6 +680,7 @@ static int eval_include(yasm_preproc_gas *pp, int unused, const char *arg1)
         line = read_line_from_file(pp, file);
         num_lines++;
     }
+    yasm_trace_end();
 
     inc_file = yasm_xmalloc(sizeof(included_file));
     inc_file->filename = yasm__xstrdup(filename);
@@ -1171,7 +1174,9 @@ static int process_line(yasm_preproc_gas *pp, char **line_ptr)
         const char *remainder = starts_with(line, macro->name);
         if (remainder && (!*remainder || isspace(*remainder))) {
             skip_whitespace2(&line);
+            yasm_trace_begin("macro", macro->name);
             expand_macro(pp, macro, remainder);
+            yasm_trace_end();
             return FALSE;
         }
     }
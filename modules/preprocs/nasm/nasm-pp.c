@@ -39,6 +39,7 @@
 #include <libyasm/intnum.h>
 #include <libyasm/expr.h>
 #include <libyasm/file.h>
+#include <libyasm/stats.h>
 #include <stdarg.h>
 #include <ctype.h>
 #include <limits.h>
@@ -705,7 +706,7 @@ check_tasm_directive(char *line)
             "%%define %s %%1\n";
         char **data;
 
-        data = malloc(2*sizeof(char*));
+        data = nasm_malloc(2*sizeof(char*));
         oldline = line;
         line = nasm_malloc(strlen(irp_format) - 2 + len2 + 1);
         sprintf(line,irp_format,q);
@@ -2734,7 +2735,10 @@ do_directive(Token * tline)
             inc = nasm_malloc(sizeof(Include));
             inc->next = istk;
             inc->conds = NULL;
+            yasm_trace_begin("include-open", p);
             inc->fp = inc_fopen(p, &newname);
+            yasm_trace_end();
+            yasm_trace_begin("include", newname);
             nasm_free(p);
             inc->fname = nasm_src_set_fname(newname);
             inc->lineno = nasm_src_set_linnum(0);
@@ -3249,6 +3253,7 @@ do_directive(Token * tline)
             istk->mstk = defining;
 
             list->uplevel(defining->nolist ? LIST_MACRO_NOLIST : LIST_MACRO);
+            yasm_trace_begin("macro", "%rep");
             tmp_defining = defining;
             defining = defining->rep_nest;
             free_tlist(origline);
@@ -4799,6 +4804,7 @@ expand_mmacro(Token * tline)
     }
 
     list->uplevel(m->nolist ? LIST_MACRO_NOLIST : LIST_MACRO);
+    yasm_trace_begin("macro", m->name);
 
     return 1;
 }
@@ -5011,6 +5017,7 @@ pp_getline(void)
                 istk->expansion = l->next;
                 nasm_free(l);
                 list->downlevel(LIST_MACRO);
+                yasm_trace_end();
             }
         }
         while (1)
@@ -5052,6 +5059,7 @@ pp_getline(void)
                 {
                     nasm_src_set_linnum(i->lineno);
                     nasm_free(nasm_src_set_fname(nasm_strdup(i->fname)));
+                    yasm_trace_end();   /* end of %include */
                 }
                 istk = i->next;
                 list->downlevel(LIST_INCLUDE);
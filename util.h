@@ -140,6 +140,29 @@
         d = BC_COUNT(d, 4);                     \
     } while (0)
 
+/* Count trailing zero bits of a nonzero 32-bit value. */
+#if defined(__GNUC__) && (__GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4))
+#define BitCountTrailingZeros(d, s)     d = __builtin_ctzl(s)
+#else
+#define BitCountTrailingZeros(d, s)     do {                            \
+        static const unsigned char bc_ctz_tab[32] = {                   \
+            0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,   \
+            31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9  \
+        };                                                              \
+        d = bc_ctz_tab[((((s) & (~(s)+1)) * 0x077CB531UL)               \
+                        & 0xFFFFFFFFUL) >> 27];                         \
+    } while (0)
+#endif
+
+/* Storage class for per-thread state, where the compiler supports it. */
+#if defined(__GNUC__) && !defined(__DJGPP__)
+#define YASM_THREAD_LOCAL   __thread
+#elif defined(_MSC_VER)
+#define YASM_THREAD_LOCAL   __declspec(thread)
+#else
+#define YASM_THREAD_LOCAL
+#endif
+
 /** Determine if a value is exactly a power of 2.  Zero is treated as a power
  * of two.
  * \param x     value